@@ -42,6 +42,8 @@
 
 #include <osg/PositionAttitudeTransform>
 
+#include <osgSim/TerrainHeightCache>
+
 
 //#include <osgCal/CoreModel>
 //#include <osgCal/Model>
@@ -102,8 +104,8 @@ void mHiOsgTerrain::PostConfig()
 //	double tankXPosition = -100.0;
 //	double tankYPosition = -10.0;
 	
-	m_TrackLocationSegment = new osgUtil::LineSegmentIntersector(osg::Vec3(0.0f, 0.0f, 0.0f), osg::Vec3(0.0f, 0.0f, 0.0f) );
-	m_findTrackElevationVisitor = new osgUtil::IntersectionVisitor(m_TrackLocationSegment);
+	m_TerrainHeightCache = new osgSim::TerrainHeightCache();
+	m_TerrainHeightCache->setTerrain(m_TerrainNode);
 	
 	
 //	m_TerrainNode->accept(findTankElevationVisitor);
@@ -135,28 +137,12 @@ void mHiOsgTerrain::Update()
 	}
 
 	
-	m_ChaUpPos.set( 0.0f,m_ChaXPos, 999.0f);
-	m_ChaDownPos.set( 0.0f,m_ChaXPos, -999.0f);
-	
-	m_TrackLocationSegment->setStart(m_ChaUpPos);
-	m_TrackLocationSegment->setEnd(m_ChaDownPos);
-	m_TerrainNode->accept(*m_findTrackElevationVisitor);
-	
+	m_TerrainHeightCache->update();
 	
-	//?ᅮ?ᄃ?ᆯ?ᅬ?ᅳ?ᄌ?ᄋ?ᆨ??ᆷ?ᅡ( ?ᅡ?ᄋ?ᆫ????ᅵ?ᄋ?ᄆ?ᆫ ?ᅵ???ᆼ?ᅢ?ᅮ?ᄃ?? )
-	if ( m_TrackLocationSegment->containsIntersections() )
+	double height;
+	if ( m_TerrainHeightCache->getHeight(0.0, m_ChaXPos, height) )
 	{
-		/*
-		const osgUtil::LineSegmentIntersector::Intersection& intersection 
-		= m_TrackLocationSegment->getFirstIntersection();
-		*/
-		static osgUtil::LineSegmentIntersector::Intersection intersection = m_TrackLocationSegment->getFirstIntersection();
-
-
-		m_TerrainHeight = intersection.getWorldIntersectPoint();
-		
-		//?ᅥ?ᄋ?ᄑ?ᆨ?ᅵ?ᄃ?ᆫ ??ᆹ?ᅳ????ᄉ?ᆨ ??ᄌ???ᄋ?ᆻ?ᅥ?ᅥ ?ᅵ?ᅦ?ᄋ?ᆯ ?ᅢ?ᅮ?ᄃ??
-		m_TrackLocationSegment->reset();
+		m_TerrainHeight.set(0.0, m_ChaXPos, height);
 	}
 	else 
 	{
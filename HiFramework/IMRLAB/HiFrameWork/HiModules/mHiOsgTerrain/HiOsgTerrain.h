@@ -14,6 +14,7 @@
 
 #include <osg/Vec3>
 #include <osg/Vec3d>
+#include <osg/ref_ptr>
 
 
 namespace osg {
@@ -23,9 +24,8 @@ namespace osg {
 	class PositionAttitudeTransform;
 }
 
-namespace osgUtil {
-	class LineSegmentIntersector;
-	class IntersectionVisitor;
+namespace osgSim {
+	class TerrainHeightCache;
 }
 
 namespace HiModules {
@@ -52,8 +52,7 @@ namespace HiModules {
 		bool m_ChaCheck;
 		
 		
-		osgUtil::LineSegmentIntersector* m_TrackLocationSegment;
-		osgUtil::IntersectionVisitor* m_findTrackElevationVisitor;
+		osg::ref_ptr<osgSim::TerrainHeightCache> m_TerrainHeightCache;
 		
 		virtual bool            HandleMessage(const HiKernel::HiTelegram& msg);
 		virtual void            PreConfig();
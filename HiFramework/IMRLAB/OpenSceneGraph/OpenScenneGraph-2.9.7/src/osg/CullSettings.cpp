@@ -32,7 +32,10 @@ void CullSettings::setDefaults()
     _inheritanceMaskActionOnAttributeSetting = DISABLE_ASSOCIATED_INHERITANCE_MASK_BIT;
     _cullingMode = DEFAULT_CULLING;
     _LODScale = 1.0f;
+    _LODHysteresis = 0.0f;
     _smallFeatureCullingPixelSize = 2.0f;
+    _primitiveBudget = 0;
+    _drawableBudget = 0;
 
     _computeNearFar = COMPUTE_NEAR_FAR_USING_BOUNDING_VOLUMES;
     _nearFarRatio = 0.0005f;
@@ -43,6 +46,7 @@ void CullSettings::setDefaults()
     _cullMask = 0xffffffff;
     _cullMaskLeft = 0xffffffff;
     _cullMaskRight = 0xffffffff;
+    _numCullThreads = 0;
 
     // override during testing
     //_computeNearFar = COMPUTE_NEAR_FAR_USING_PRIMITIVES;
@@ -57,7 +61,10 @@ void CullSettings::setCullSettings(const CullSettings& rhs)
     _computeNearFar = rhs._computeNearFar;
     _cullingMode = rhs._cullingMode;
     _LODScale = rhs._LODScale;
+    _LODHysteresis = rhs._LODHysteresis;
     _smallFeatureCullingPixelSize = rhs._smallFeatureCullingPixelSize;
+    _primitiveBudget = rhs._primitiveBudget;
+    _drawableBudget = rhs._drawableBudget;
 
     _clampProjectionMatrixCallback = rhs._clampProjectionMatrixCallback;
     _nearFarRatio = rhs._nearFarRatio;
@@ -69,6 +76,8 @@ void CullSettings::setCullSettings(const CullSettings& rhs)
     _cullMask = rhs._cullMask;
     _cullMaskLeft = rhs._cullMaskLeft;
     _cullMaskRight =  rhs._cullMaskRight;
+
+    _numCullThreads = rhs._numCullThreads;
 }
 
 
@@ -85,13 +94,24 @@ void CullSettings::inheritCullSettings(const CullSettings& settings, unsigned in
     if (inheritanceMask & CULL_MASK_RIGHT) _cullMaskRight = settings._cullMaskRight;
     if (inheritanceMask & CULLING_MODE) _cullingMode = settings._cullingMode;
     if (inheritanceMask & LOD_SCALE) _LODScale = settings._LODScale;
+    if (inheritanceMask & LOD_HYSTERESIS) _LODHysteresis = settings._LODHysteresis;
     if (inheritanceMask & SMALL_FEATURE_CULLING_PIXEL_SIZE) _smallFeatureCullingPixelSize = settings._smallFeatureCullingPixelSize;
+    if (inheritanceMask & CULLING_BUDGET)
+    {
+        _primitiveBudget = settings._primitiveBudget;
+        _drawableBudget = settings._drawableBudget;
+    }
     if (inheritanceMask & CLAMP_PROJECTION_MATRIX_CALLBACK) _clampProjectionMatrixCallback = settings._clampProjectionMatrixCallback;
+    if (inheritanceMask & NUM_CULL_THREADS) _numCullThreads = settings._numCullThreads;
 }
 
 
 static ApplicationUsageProxy ApplicationUsageProxyCullSettings_e0(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_COMPUTE_NEAR_FAR_MODE <mode>","DO_NOT_COMPUTE_NEAR_FAR | COMPUTE_NEAR_FAR_USING_BOUNDING_VOLUMES | COMPUTE_NEAR_FAR_USING_PRIMITIVES");
 static ApplicationUsageProxy ApplicationUsageProxyCullSettings_e1(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_NEAR_FAR_RATIO <float>","Set the ratio between near and far planes - must greater than 0.0 but less than 1.0.");
+static ApplicationUsageProxy ApplicationUsageProxyCullSettings_e2(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_NUM_CULL_THREADS <int>","Set the number of threads the cull traversal of each camera is split across, 0 or 1 culls serially.");
+static ApplicationUsageProxy ApplicationUsageProxyCullSettings_e3(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_LOD_HYSTERESIS <float>","Set the fraction of a LOD's range band the range has to move beyond before the LOD's children are selected afresh.");
+static ApplicationUsageProxy ApplicationUsageProxyCullSettings_e4(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_PRIMITIVE_BUDGET <int>","Enable BUDGET_CULLING and set the most primitives each camera's cull traversal may pass on to be drawn.");
+static ApplicationUsageProxy ApplicationUsageProxyCullSettings_e5(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DRAWABLE_BUDGET <int>","Enable BUDGET_CULLING and set the most drawables each camera's cull traversal may pass on to be drawn.");
 
 void CullSettings::readEnvironmentalVariables()
 {
@@ -115,6 +135,36 @@ void CullSettings::readEnvironmentalVariables()
 
         OSG_NOTIFY(osg::INFO)<<"Set near/far ratio to "<<_nearFarRatio<<std::endl;
     }
+
+    if ((ptr = getenv("OSG_NUM_CULL_THREADS")) != 0)
+    {
+        _numCullThreads = atoi(ptr);
+
+        OSG_NOTIFY(osg::INFO)<<"Set number of cull threads to "<<_numCullThreads<<std::endl;
+    }
+
+    if ((ptr = getenv("OSG_LOD_HYSTERESIS")) != 0)
+    {
+        _LODHysteresis = osg::asciiToFloat(ptr);
+
+        OSG_NOTIFY(osg::INFO)<<"Set LOD hysteresis to "<<_LODHysteresis<<std::endl;
+    }
+
+    if ((ptr = getenv("OSG_PRIMITIVE_BUDGET")) != 0)
+    {
+        _primitiveBudget = atoi(ptr);
+        _cullingMode |= BUDGET_CULLING;
+
+        OSG_NOTIFY(osg::INFO)<<"Set primitive budget to "<<_primitiveBudget<<std::endl;
+    }
+
+    if ((ptr = getenv("OSG_DRAWABLE_BUDGET")) != 0)
+    {
+        _drawableBudget = atoi(ptr);
+        _cullingMode |= BUDGET_CULLING;
+
+        OSG_NOTIFY(osg::INFO)<<"Set drawable budget to "<<_drawableBudget<<std::endl;
+    }
     
 }
 
@@ -156,7 +206,10 @@ void CullSettings::write(std::ostream& out)
     out<<"    _computeNearFar = "<<_computeNearFar<<std::endl;
     out<<"    _cullingMode = "<<_cullingMode<<std::endl;
     out<<"    _LODScale = "<<_LODScale<<std::endl;
+    out<<"    _LODHysteresis = "<<_LODHysteresis<<std::endl;
     out<<"    _smallFeatureCullingPixelSize = "<<_smallFeatureCullingPixelSize<<std::endl;
+    out<<"    _primitiveBudget = "<<_primitiveBudget<<std::endl;
+    out<<"    _drawableBudget = "<<_drawableBudget<<std::endl;
     out<<"    _clampProjectionMatrixCallback = "<<_clampProjectionMatrixCallback.get()<<std::endl;
     out<<"    _nearFarRatio = "<<_nearFarRatio<<std::endl;
     out<<"    _impostorActive = "<<_impostorActive<<std::endl;
@@ -166,6 +219,7 @@ void CullSettings::write(std::ostream& out)
     out<<"    _cullMask = "<<_cullMask<<std::endl;
     out<<"    _cullMaskLeft = "<<_cullMaskLeft<<std::endl;
     out<<"    _cullMaskRight = "<<_cullMaskRight<<std::endl;
+    out<<"    _numCullThreads = "<<_numCullThreads<<std::endl;
     
     out<<"{"<<std::endl;
 }
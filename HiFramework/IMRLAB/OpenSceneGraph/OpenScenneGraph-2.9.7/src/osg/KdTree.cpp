@@ -15,13 +15,161 @@
 #include <osg/Geode>
 #include <osg/TriangleIndexFunctor>
 #include <osg/Timer>
+#include <osg/ApplicationUsage>
 
 #include <osg/io_utils>
 
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
+#include <algorithm>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+    #define OSG_KDTREE_USE_SSE2
+    #include <emmintrin.h>
+#endif
+
 using namespace osg;
 
 //#define VERBOSE_OUTPUT
 
+static ApplicationUsageProxy KdTree_e0(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_NUM_KDTREE_BUILD_THREADS <int>","Set the number of threads each KdTree, and the KdTrees of each Geode, are built with, 0 or 1 builds serially.");
+static ApplicationUsageProxy KdTree_e1(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_KDTREE_SPLIT_METHOD <mode>","SPATIAL_MEDIAN | SURFACE_AREA_HEURISTIC, SURFACE_AREA_HEURISTIC builds KdTrees that intersect faster but take longer to build.");
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// BuildThreadPool - the threads shared by all the KdTree builds, which help the
+// building threads by running the tasks they queue.
+
+namespace
+{
+
+    // the fewest triangles in a subtree worth building as a separate task, and the most SAH bins.
+    const unsigned int MIN_TASK_NUM_TRIANGLES = 4096;
+    const unsigned int MAX_NUM_SAH_BINS = 64;
+
+    // the relative costs of traversing a node and of intersecting a triangle, used by the surface area heuristic.
+    const float TRAVERSAL_COST = 1.0f;
+    const float INTERSECTION_COST = 1.0f;
+
+    struct BuildTask
+    {
+        BuildTask(): _done(false) {}
+
+        virtual ~BuildTask() {}
+
+        virtual void run() = 0;
+
+        bool _done;
+    };
+
+    class BuildThreadPool
+    {
+        public:
+
+            BuildThreadPool():
+                _done(false) {}
+
+            ~BuildThreadPool()
+            {
+                {
+                    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                    _done = true;
+                    _condition.broadcast();
+                }
+
+                for(Threads::iterator itr = _threads.begin();
+                    itr != _threads.end();
+                    ++itr)
+                {
+                    (*itr)->join();
+                    delete *itr;
+                }
+            }
+
+            /** Start threads until there are enough to help numThreads-1 building threads.*/
+            void reserveThreads(unsigned int numThreads)
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                while (_threads.size()+1<numThreads && !_done)
+                {
+                    BuildThread* thread = new BuildThread(this);
+                    if (thread->start()!=0) { delete thread; break; }
+                    _threads.push_back(thread);
+                }
+            }
+
+            /** Queue task to be run by whichever thread gets to it first, its _done is set once it has been run.*/
+            void add(BuildTask* task)
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                _tasks.push_back(task);
+                _condition.broadcast();
+            }
+
+            /** Run queued tasks until task is done.*/
+            void wait(BuildTask* task) { runTasks(task); }
+
+        protected:
+
+            class BuildThread : public OpenThreads::Thread
+            {
+                public:
+
+                    BuildThread(BuildThreadPool* pool):
+                        _pool(pool) {}
+
+                    virtual void run() { _pool->runTasks(0); }
+
+                protected:
+
+                    BuildThreadPool* _pool;
+            };
+
+            typedef std::vector<BuildTask*>     Tasks;
+            typedef std::vector<BuildThread*>   Threads;
+
+            /** Run queued tasks, the most recently queued first, until task is done, or the pool is stopped if task is null.*/
+            void runTasks(BuildTask* task)
+            {
+                _mutex.lock();
+                while (task ? !task->_done : !_done)
+                {
+                    if (_tasks.empty())
+                    {
+                        _condition.wait(&_mutex);
+                        continue;
+                    }
+
+                    BuildTask* next = _tasks.back();
+                    _tasks.pop_back();
+
+                    _mutex.unlock();
+                    next->run();
+                    _mutex.lock();
+
+                    next->_done = true;
+                    _condition.broadcast();
+                }
+                _mutex.unlock();
+            }
+
+            OpenThreads::Mutex      _mutex;
+            OpenThreads::Condition  _condition;
+            Tasks                   _tasks;
+            Threads                 _threads;
+            bool                    _done;
+    };
+
+    BuildThreadPool s_buildThreadPool;
+
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // BuildKdTree Declarartion - class used for building an single KdTree
@@ -29,9 +177,11 @@ using namespace osg;
 struct BuildKdTree
 {
     BuildKdTree(KdTree& kdTree):
-        _kdTree(kdTree) {}
+        _kdTree(kdTree),
+        _threadPool(0) {}
 
     typedef std::vector< osg::Vec3 >            CenterList;
+    typedef std::vector< osg::BoundingBox >     BoundList;
     typedef std::vector< unsigned int >           Indices;
     typedef std::vector< unsigned int >         AxisStack;
 
@@ -41,12 +191,35 @@ struct BuildKdTree
 
     int divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int nodeIndex, unsigned int level);
 
+    // the bound of a range of triangles, and of their centers.
+    struct Bounds
+    {
+        osg::BoundingBox bb;
+        osg::BoundingBox centerBB;
+    };
+
+    /** Build the subtree of the triangles _primitiveIndices[begin,end), with the given bounds, into nodes with the
+      * surface area heuristic, returning the index of its root.*/
+    int divideSAH(const KdTree::BuildOptions& options, KdTree::KdNodeList& nodes, unsigned int begin, unsigned int end,
+                  const Bounds& bounds, unsigned int level);
+
+    /** Partition _primitiveIndices[begin,end) at the cheapest split along the longest axis of their centers' bound,
+      * returning the start of the second part and the bounds of both parts, or end if it is cheaper to leave them in
+      * a leaf.*/
+    unsigned int partitionSAH(const KdTree::BuildOptions& options, unsigned int begin, unsigned int end,
+                              const Bounds& bounds, Bounds& firstBounds, Bounds& secondBounds);
+
+    /** Append the nodes of a subtree built separately to nodes, returning the index of its root.*/
+    int splice(KdTree::KdNodeList& nodes, const KdTree::KdNodeList& subtree);
+
     KdTree&             _kdTree;
 
     osg::BoundingBox    _bb;
     AxisStack           _axisStack;
     Indices             _primitiveIndices;
     CenterList          _centers;
+    BoundList           _bounds;
+    BuildThreadPool*    _threadPool;
 
 protected:
 
@@ -60,12 +233,19 @@ protected:
 struct TriangleIndicesCollector
 {
     TriangleIndicesCollector():
-        _buildKdTree(0)
+        _buildKdTree(0),
+        _firstPrimitiveIndex(0),
+        _trianglesPerPrimitive(1),
+        _triangleNum(0)
     {
     }
 
     inline void operator () (unsigned int p0, unsigned int p1, unsigned int p2)
     {
+        // the primitive is counted before degenerate triangles are discarded, so that it matches the source geometry
+        unsigned int primitiveIndex = _firstPrimitiveIndex + _triangleNum/_trianglesPerPrimitive;
+        ++_triangleNum;
+
         const osg::Vec3& v0 = (*(_buildKdTree->_kdTree.getVertices()))[p0];
         const osg::Vec3& v1 = (*(_buildKdTree->_kdTree.getVertices()))[p1];
         const osg::Vec3& v2 = (*(_buildKdTree->_kdTree.getVertices()))[p2];
@@ -78,6 +258,7 @@ struct TriangleIndicesCollector
         }
 
         unsigned int i = _buildKdTree->_kdTree.addTriangle(KdTree::Triangle(p0,p1,p2));
+        _buildKdTree->_kdTree.getPrimitiveIndices().push_back(primitiveIndex);
         
         osg::BoundingBox bb;
         bb.expandBy(v0);
@@ -85,12 +266,80 @@ struct TriangleIndicesCollector
         bb.expandBy(v2);
 
         _buildKdTree->_centers.push_back(bb.center());
+        _buildKdTree->_bounds.push_back(bb);
         _buildKdTree->_primitiveIndices.push_back(i);
         
     }
     
     BuildKdTree* _buildKdTree;
 
+    unsigned int _firstPrimitiveIndex;
+    unsigned int _trianglesPerPrimitive;
+    unsigned int _triangleNum;
+};
+
+/** TriangleIndexFunctor that also keeps count of the primitives of each primitive set, points and lines included, in
+  * the way a PrimitiveFunctor counts them, so that each triangle can be given the index of the primitive it came from.*/
+class TriangleIndicesCollectorFunctor : public osg::TriangleIndexFunctor<TriangleIndicesCollector>
+{
+public:
+
+    virtual void drawArrays(GLenum mode,GLint first,GLsizei count)
+    {
+        beginPrimitiveSet(mode);
+        osg::TriangleIndexFunctor<TriangleIndicesCollector>::drawArrays(mode, first, count);
+        endPrimitiveSet(mode, count);
+    }
+
+    virtual void drawElements(GLenum mode,GLsizei count,const GLubyte* indices)
+    {
+        beginPrimitiveSet(mode);
+        osg::TriangleIndexFunctor<TriangleIndicesCollector>::drawElements(mode, count, indices);
+        endPrimitiveSet(mode, count);
+    }
+
+    virtual void drawElements(GLenum mode,GLsizei count,const GLushort* indices)
+    {
+        beginPrimitiveSet(mode);
+        osg::TriangleIndexFunctor<TriangleIndicesCollector>::drawElements(mode, count, indices);
+        endPrimitiveSet(mode, count);
+    }
+
+    virtual void drawElements(GLenum mode,GLsizei count,const GLuint* indices)
+    {
+        beginPrimitiveSet(mode);
+        osg::TriangleIndexFunctor<TriangleIndicesCollector>::drawElements(mode, count, indices);
+        endPrimitiveSet(mode, count);
+    }
+
+protected:
+
+    void beginPrimitiveSet(GLenum mode)
+    {
+        _trianglesPerPrimitive = (mode==GL_QUADS || mode==GL_QUAD_STRIP) ? 2 : 1;
+        _triangleNum = 0;
+    }
+
+    void endPrimitiveSet(GLenum mode, GLsizei count)
+    {
+        if (count<=0) return;
+
+        unsigned int n = static_cast<unsigned int>(count);
+        switch(mode)
+        {
+            case(GL_POINTS):            _firstPrimitiveIndex += n; break;
+            case(GL_LINES):             _firstPrimitiveIndex += n/2; break;
+            case(GL_LINE_STRIP):        _firstPrimitiveIndex += n-1; break;
+            case(GL_LINE_LOOP):         _firstPrimitiveIndex += n; break;
+            case(GL_TRIANGLES):         _firstPrimitiveIndex += n/3; break;
+            case(GL_TRIANGLE_STRIP):
+            case(GL_TRIANGLE_FAN):
+            case(GL_POLYGON):           if (n>2) _firstPrimitiveIndex += n-2; break;
+            case(GL_QUADS):             _firstPrimitiveIndex += n/4; break;
+            case(GL_QUAD_STRIP):        if (n>2) _firstPrimitiveIndex += (n-2)/2; break;
+            default:                    break;
+        }
+    }
 };
 
 
@@ -121,38 +370,62 @@ bool BuildKdTree::build(KdTree::BuildOptions& options, osg::Geometry* geometry)
 
     _kdTree.getNodes().reserve(estimatedSize*5);
     
-    computeDivisions(options);
-
     options._numVerticesProcessed += vertices->size();
 
     unsigned int estimatedNumTriangles = vertices->size()*2;
     _primitiveIndices.reserve(estimatedNumTriangles);
     _centers.reserve(estimatedNumTriangles);
+    _bounds.reserve(estimatedNumTriangles);
 
     _kdTree.getTriangles().reserve(estimatedNumTriangles);
+    _kdTree.getPrimitiveIndices().reserve(estimatedNumTriangles);
 
-    osg::TriangleIndexFunctor<TriangleIndicesCollector> collectTriangleIndices;
+    TriangleIndicesCollectorFunctor collectTriangleIndices;
     collectTriangleIndices._buildKdTree = this;
     geometry->accept(collectTriangleIndices);
 
-    _primitiveIndices.reserve(vertices->size());
+    int nodeNum = 0;
+    if (options._splitMethod==KdTree::BuildOptions::SURFACE_AREA_HEURISTIC)
+    {
+        if (options._numThreads>1)
+        {
+            s_buildThreadPool.reserveThreads(options._numThreads);
+            _threadPool = &s_buildThreadPool;
+        }
+
+        Bounds bounds;
+        for(unsigned int i=0; i<_primitiveIndices.size(); ++i)
+        {
+            bounds.bb.expandBy(_bounds[i]);
+            bounds.centerBB.expandBy(_centers[i]);
+        }
+
+        nodeNum = divideSAH(options, _kdTree.getNodes(), 0, _primitiveIndices.size(), bounds, 0);
+    }
+    else
+    {
+        computeDivisions(options);
 
-    KdTree::KdNode node(-1, _primitiveIndices.size());
-    node.bb = _bb;
+        KdTree::KdNode node(-1, _primitiveIndices.size());
+        node.bb = _bb;
 
-    int nodeNum = _kdTree.addNode(node);
+        nodeNum = _kdTree.addNode(node);
 
-    osg::BoundingBox bb = _bb;
-    nodeNum = divide(options, bb, nodeNum, 0);
+        osg::BoundingBox bb = _bb;
+        nodeNum = divide(options, bb, nodeNum, 0);
+    }
     
     // now reorder the triangle list so that it's in order as per the primitiveIndex list.
     KdTree::TriangleList triangleList(_kdTree.getTriangles().size());
+    KdTree::PrimitiveIndexList primitiveIndexList(_kdTree.getPrimitiveIndices().size());
     for(unsigned int i=0; i<_primitiveIndices.size(); ++i)
     {
         triangleList[i] = _kdTree.getTriangle(_primitiveIndices[i]);
+        primitiveIndexList[i] = _kdTree.getPrimitiveIndices()[_primitiveIndices[i]];
     }
     
     _kdTree.getTriangles().swap(triangleList);
+    _kdTree.getPrimitiveIndices().swap(primitiveIndexList);
     
     
 #ifdef VERBOSE_OUTPUT    
@@ -731,6 +1004,706 @@ bool IntersectKdTree::intersectAndClip(osg::Vec3& s, osg::Vec3& e, const osg::Bo
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// IntersectKdTreeBatch - traverses a KdTree with a batch of line segments at once,
+// grouped into packets of segments that are tested against each box and triangle together.
+//
+struct IntersectKdTreeBatch
+{
+    enum { PACKET_SIZE = 4 };
+
+    struct ActivePacket
+    {
+        ActivePacket(unsigned int p, unsigned int m):
+            packet(p),
+            mask(m) {}
+
+        unsigned int packet;
+        unsigned int mask;      // a bit for each segment of the packet still to be tested.
+    };
+
+    typedef std::vector<ActivePacket>   ActivePackets;
+    typedef std::vector<ActivePackets>  ActivePacketsList;
+
+    IntersectKdTreeBatch(const osg::Vec3Array& vertices,
+                         const KdTree::KdNodeList& nodes,
+                         const KdTree::TriangleList& triangles,
+                         unsigned int numSegments, const osg::Vec3d* starts, const osg::Vec3d* ends,
+                         KdTree::LineSegmentIntersection* nearest);
+
+    /** Intersect the segments in _active[level], which all enter the node, with the node's triangles.*/
+    void intersect(int nodeIndex, unsigned int level);
+
+    /** Return the mask of the packet's segments that enter bb before their nearest intersection.*/
+    unsigned int clip(const ActivePacket& ap, const osg::BoundingBox& bb) const;
+
+    void intersect(const KdTree::Triangle& tri, unsigned int triangleIndex, const ActivePacket& ap);
+
+    void addIntersection(unsigned int lane, const KdTree::Triangle& tri, unsigned int triangleIndex, float t, float u, float v);
+
+    const osg::Vec3Array&               _vertices;
+    const KdTree::KdNodeList&           _kdNodes;
+    const KdTree::TriangleList&         _triangles;
+    KdTree::LineSegmentIntersection*    _nearest;
+
+    // the segments an axis at a time, PACKET_SIZE to a packet: start points, unit directions, inverse directions,
+    // lengths, and the distances to their nearest intersections so far.
+    std::vector<float>                  _data;
+    float*                              _sx;
+    float*                              _sy;
+    float*                              _sz;
+    float*                              _dx;
+    float*                              _dy;
+    float*                              _dz;
+    float*                              _ix;
+    float*                              _iy;
+    float*                              _iz;
+    float*                              _length;
+    float*                              _nearestDistance;
+    std::vector<unsigned int>           _segments;      // the index of each lane's segment.
+
+    ActivePacketsList                   _active;        // _active[i] holds the packets entering the node at depth i.
+    bool                                _hit;
+
+protected:
+
+    IntersectKdTreeBatch& operator = (const IntersectKdTreeBatch&) { return *this; }
+};
+
+namespace
+{
+    // spread the bottom 10 bits of x out to every third bit.
+    inline unsigned int spreadBits(unsigned int x)
+    {
+        x &= 0x3ff;
+        x = (x | (x<<16)) & 0x030000ff;
+        x = (x | (x<<8)) & 0x0300f00f;
+        x = (x | (x<<4)) & 0x030c30c3;
+        x = (x | (x<<2)) & 0x09249249;
+        return x;
+    }
+
+#ifdef OSG_KDTREE_USE_SSE2
+    inline void clipAxis(__m128& tmin, __m128& tmax, const float* s, const float* inv, float bbMin, float bbMax)
+    {
+        __m128 sv = _mm_loadu_ps(s);
+        __m128 iv = _mm_loadu_ps(inv);
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bbMin), sv), iv);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bbMax), sv), iv);
+        tmin = _mm_max_ps(tmin, _mm_min_ps(t0, t1));
+        tmax = _mm_min_ps(tmax, _mm_max_ps(t0, t1));
+    }
+#endif
+}
+
+IntersectKdTreeBatch::IntersectKdTreeBatch(const osg::Vec3Array& vertices,
+                                           const KdTree::KdNodeList& nodes,
+                                           const KdTree::TriangleList& triangles,
+                                           unsigned int numSegments, const osg::Vec3d* starts, const osg::Vec3d* ends,
+                                           KdTree::LineSegmentIntersection* nearest):
+    _vertices(vertices),
+    _kdNodes(nodes),
+    _triangles(triangles),
+    _nearest(nearest),
+    _hit(false)
+{
+    unsigned int numPackets = (numSegments+PACKET_SIZE-1)/PACKET_SIZE;
+    unsigned int numLanes = numPackets*PACKET_SIZE;
+
+    _data.resize(numLanes*11, 0.0f);
+    _sx = &_data[0];
+    _sy = _sx + numLanes;
+    _sz = _sy + numLanes;
+    _dx = _sz + numLanes;
+    _dy = _dx + numLanes;
+    _dz = _dy + numLanes;
+    _ix = _dz + numLanes;
+    _iy = _ix + numLanes;
+    _iz = _iy + numLanes;
+    _length = _iz + numLanes;
+    _nearestDistance = _length + numLanes;
+
+    // order the segments along a Morton curve through their start points, so that each packet holds segments
+    // that start close together and so tend to visit the same nodes.
+    osg::BoundingBox bb;
+    for(unsigned int i=0; i<numSegments; ++i) bb.expandBy(starts[i]);
+
+    osg::Vec3 scale;
+    for(unsigned int axis=0; axis<3; ++axis)
+    {
+        float extent = bb._max[axis]-bb._min[axis];
+        scale[axis] = extent>0.0f ? 1023.0f/extent : 0.0f;
+    }
+
+    std::vector< std::pair<unsigned int, unsigned int> > keys(numSegments);
+    for(unsigned int i=0; i<numSegments; ++i)
+    {
+        osg::Vec3 p = (osg::Vec3(starts[i])-bb._min);
+        keys[i].first = spreadBits(static_cast<unsigned int>(p.x()*scale.x())) |
+                        (spreadBits(static_cast<unsigned int>(p.y()*scale.y()))<<1) |
+                        (spreadBits(static_cast<unsigned int>(p.z()*scale.z()))<<2);
+        keys[i].second = i;
+    }
+    std::sort(keys.begin(), keys.end());
+
+    _segments.resize(numLanes, 0);
+    for(unsigned int lane=0; lane<numSegments; ++lane)
+    {
+        unsigned int i = keys[lane].second;
+        _segments[lane] = i;
+
+        osg::Vec3 s(starts[i]);
+        osg::Vec3 d(ends[i]-starts[i]);
+        float length = d.length();
+        if (length>0.0f) d /= length;
+
+        _sx[lane] = s.x();
+        _sy[lane] = s.y();
+        _sz[lane] = s.z();
+        _dx[lane] = d.x();
+        _dy[lane] = d.y();
+        _dz[lane] = d.z();
+        _ix[lane] = d.x()!=0.0f ? 1.0f/d.x() : FLT_MAX;
+        _iy[lane] = d.y()!=0.0f ? 1.0f/d.y() : FLT_MAX;
+        _iz[lane] = d.z()!=0.0f ? 1.0f/d.z() : FLT_MAX;
+        _length[lane] = length;
+        _nearestDistance[lane] = length * static_cast<float>(osg::minimum(nearest[i].ratio, 1.0));
+    }
+
+    // the packets' segments that enter the root node, leaving out the padding of the last packet.
+    _active.resize(1);
+    ActivePackets& active = _active[0];
+    active.reserve(numPackets);
+    for(unsigned int packet=0; packet<numPackets; ++packet)
+    {
+        unsigned int mask = 0;
+        for(unsigned int k=0; k<PACKET_SIZE; ++k)
+        {
+            unsigned int lane = packet*PACKET_SIZE+k;
+            if (lane<numSegments && _length[lane]>0.0f && _nearestDistance[lane]>0.0f) mask |= (1<<k);
+        }
+
+        mask = clip(ActivePacket(packet, mask), _kdNodes[0].bb);
+        if (mask) active.push_back(ActivePacket(packet, mask));
+    }
+}
+
+unsigned int IntersectKdTreeBatch::clip(const ActivePacket& ap, const osg::BoundingBox& bb) const
+{
+    if (ap.mask==0) return 0;
+
+    unsigned int o = ap.packet*PACKET_SIZE;
+
+#ifdef OSG_KDTREE_USE_SSE2
+    __m128 tmin = _mm_setzero_ps();
+    __m128 tmax = _mm_loadu_ps(_nearestDistance+o);
+    clipAxis(tmin, tmax, _sx+o, _ix+o, bb.xMin(), bb.xMax());
+    clipAxis(tmin, tmax, _sy+o, _iy+o, bb.yMin(), bb.yMax());
+    clipAxis(tmin, tmax, _sz+o, _iz+o, bb.zMin(), bb.zMax());
+    return ap.mask & static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(tmin, tmax)));
+#else
+    unsigned int mask = 0;
+    for(unsigned int k=0; k<PACKET_SIZE; ++k)
+    {
+        if ((ap.mask & (1<<k))==0) continue;
+
+        unsigned int lane = o+k;
+        float tmin = 0.0f;
+        float tmax = _nearestDistance[lane];
+
+        const float s[3] = { _sx[lane], _sy[lane], _sz[lane] };
+        const float inv[3] = { _ix[lane], _iy[lane], _iz[lane] };
+        for(unsigned int axis=0; axis<3; ++axis)
+        {
+            float t0 = (bb._min[axis]-s[axis])*inv[axis];
+            float t1 = (bb._max[axis]-s[axis])*inv[axis];
+            tmin = osg::maximum(tmin, osg::minimum(t0, t1));
+            tmax = osg::minimum(tmax, osg::maximum(t0, t1));
+        }
+
+        if (tmin<=tmax) mask |= (1<<k);
+    }
+    return mask;
+#endif
+}
+
+void IntersectKdTreeBatch::intersect(int nodeIndex, unsigned int level)
+{
+    const KdTree::KdNode& node = _kdNodes[nodeIndex];
+    if (node.first<0)
+    {
+        int istart = -node.first-1;
+        int iend = istart + node.second;
+
+        const ActivePackets& active = _active[level];
+        for(int i=istart; i<iend; ++i)
+        {
+            const KdTree::Triangle& tri = _triangles[i];
+            for(ActivePackets::const_iterator itr = active.begin();
+                itr != active.end();
+                ++itr)
+            {
+                intersect(tri, i, *itr);
+            }
+        }
+        return;
+    }
+
+    int children[2] = { node.first, node.second };
+    if (children[0]>0 && children[1]>0)
+    {
+        // visit the nearer child first, so that its intersections cut short the search of the other.
+        const ActivePacket& ap = _active[level].front();
+        unsigned int k = 0;
+        while ((ap.mask & (1<<k))==0) ++k;
+        unsigned int lane = ap.packet*PACKET_SIZE+k;
+
+        osg::Vec3 d(_dx[lane], _dy[lane], _dz[lane]);
+        if ((_kdNodes[children[0]].bb.center()-_kdNodes[children[1]].bb.center())*d > 0.0f) std::swap(children[0], children[1]);
+    }
+
+    for(unsigned int c=0; c<2; ++c)
+    {
+        int child = children[c];
+        if (child<=0) continue;
+
+        // the deeper levels may have grown _active since the last child was visited.
+        if (_active.size()<level+2) _active.resize(level+2);
+
+        const ActivePackets& active = _active[level];
+        ActivePackets& childActive = _active[level+1];
+        childActive.clear();
+
+        const osg::BoundingBox& bb = _kdNodes[child].bb;
+        for(ActivePackets::const_iterator itr = active.begin();
+            itr != active.end();
+            ++itr)
+        {
+            unsigned int mask = clip(*itr, bb);
+            if (mask) childActive.push_back(ActivePacket(itr->packet, mask));
+        }
+
+        if (!childActive.empty()) intersect(child, level+1);
+    }
+}
+
+void IntersectKdTreeBatch::intersect(const KdTree::Triangle& tri, unsigned int triangleIndex, const ActivePacket& ap)
+{
+    const osg::Vec3& v0 = _vertices[tri.p0];
+    const osg::Vec3& v1 = _vertices[tri.p1];
+    const osg::Vec3& v2 = _vertices[tri.p2];
+
+    osg::Vec3 E1 = v1 - v0;
+    osg::Vec3 E2 = v2 - v0;
+
+    const float esplison = 1e-10f;
+
+    unsigned int o = ap.packet*PACKET_SIZE;
+
+#ifdef OSG_KDTREE_USE_SSE2
+    __m128 dx = _mm_loadu_ps(_dx+o);
+    __m128 dy = _mm_loadu_ps(_dy+o);
+    __m128 dz = _mm_loadu_ps(_dz+o);
+
+    __m128 e1x = _mm_set1_ps(E1.x()), e1y = _mm_set1_ps(E1.y()), e1z = _mm_set1_ps(E1.z());
+    __m128 e2x = _mm_set1_ps(E2.x()), e2y = _mm_set1_ps(E2.y()), e2z = _mm_set1_ps(E2.z());
+
+    // P = d ^ E2
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, e1x), _mm_mul_ps(py, e1y)), _mm_mul_ps(pz, e1z));
+
+    // T = s - v0
+    __m128 tx = _mm_sub_ps(_mm_loadu_ps(_sx+o), _mm_set1_ps(v0.x()));
+    __m128 ty = _mm_sub_ps(_mm_loadu_ps(_sy+o), _mm_set1_ps(v0.y()));
+    __m128 tz = _mm_sub_ps(_mm_loadu_ps(_sz+o), _mm_set1_ps(v0.z()));
+
+    __m128 u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, tx), _mm_mul_ps(py, ty)), _mm_mul_ps(pz, tz));
+
+    // Q = T ^ E1
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+
+    __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, dx), _mm_mul_ps(qy, dy)), _mm_mul_ps(qz, dz));
+    __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, e2x), _mm_mul_ps(qy, e2y)), _mm_mul_ps(qz, e2z));
+
+    // segments near parallel to the triangle give an inf or nan here, but are already masked out by the det test.
+    __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+    __m128 valid = _mm_cmpgt_ps(absDet, _mm_set1_ps(esplison));
+
+    __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+    u = _mm_mul_ps(u, inv_det);
+    v = _mm_mul_ps(v, inv_det);
+    t = _mm_mul_ps(t, inv_det);
+
+    __m128 zero = _mm_setzero_ps();
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+    valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(t, zero));
+    valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_loadu_ps(_nearestDistance+o)));
+
+    unsigned int mask = ap.mask & static_cast<unsigned int>(_mm_movemask_ps(valid));
+    if (mask==0) return;
+
+    float ua[PACKET_SIZE], va[PACKET_SIZE], ta[PACKET_SIZE];
+    _mm_storeu_ps(ua, u);
+    _mm_storeu_ps(va, v);
+    _mm_storeu_ps(ta, t);
+
+    for(unsigned int k=0; k<PACKET_SIZE; ++k)
+    {
+        if (mask & (1<<k)) addIntersection(o+k, tri, triangleIndex, ta[k], ua[k], va[k]);
+    }
+#else
+    for(unsigned int k=0; k<PACKET_SIZE; ++k)
+    {
+        if ((ap.mask & (1<<k))==0) continue;
+
+        unsigned int lane = o+k;
+        osg::Vec3 d(_dx[lane], _dy[lane], _dz[lane]);
+
+        osg::Vec3 P = d ^ E2;
+        float det = P * E1;
+        if (det<=esplison && det>=-esplison) continue;
+
+        osg::Vec3 T = osg::Vec3(_sx[lane], _sy[lane], _sz[lane]) - v0;
+        osg::Vec3 Q = T ^ E1;
+
+        float inv_det = 1.0f/det;
+        float u = (P*T)*inv_det;
+        float v = (Q*d)*inv_det;
+        float t = (Q*E2)*inv_det;
+
+        if (u<0.0f || v<0.0f || (u+v)>1.0f) continue;
+        if (t<0.0f || t>=_nearestDistance[lane]) continue;
+
+        addIntersection(lane, tri, triangleIndex, t, u, v);
+    }
+#endif
+}
+
+void IntersectKdTreeBatch::addIntersection(unsigned int lane, const KdTree::Triangle& tri, unsigned int triangleIndex, float t, float u, float v)
+{
+    _nearestDistance[lane] = t;
+
+    const osg::Vec3& v0 = _vertices[tri.p0];
+    const osg::Vec3& v1 = _vertices[tri.p1];
+    const osg::Vec3& v2 = _vertices[tri.p2];
+
+    float r0 = 1.0f-u-v;
+    float r1 = u;
+    float r2 = v;
+
+    osg::Vec3 normal = (v1-v0)^(v2-v0);
+    normal.normalize();
+
+    KdTree::LineSegmentIntersection& intersection = _nearest[_segments[lane]];
+
+    intersection.ratio = t/_length[lane];
+    intersection.primitiveIndex = triangleIndex;
+    intersection.intersectionPoint = v0*r0 + v1*r1 + v2*r2;
+    intersection.intersectionNormal = normal;
+
+    intersection.p0 = tri.p0;
+    intersection.p1 = tri.p1;
+    intersection.p2 = tri.p2;
+    intersection.r0 = r0;
+    intersection.r1 = r1;
+    intersection.r2 = r2;
+
+    _hit = true;
+}
+
+namespace
+{
+
+    // the surface area of bb, less the factor of 2 that the heuristic doesn't need.
+    inline float halfArea(const osg::BoundingBox& bb)
+    {
+        if (!bb.valid()) return 0.0f;
+        float dx = bb.xMax()-bb.xMin();
+        float dy = bb.yMax()-bb.yMin();
+        float dz = bb.zMax()-bb.zMin();
+        return dx*dy + dy*dz + dz*dx;
+    }
+
+    // the bounds of the triangles in a bin, kept as plain min and max vectors to expand without branching.
+    struct SAHBin
+    {
+        inline void init()
+        {
+            bbMin.set(FLT_MAX, FLT_MAX, FLT_MAX);
+            bbMax.set(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+            centerMin = bbMin;
+            centerMax = bbMax;
+            count = 0;
+        }
+
+        inline void add(const osg::BoundingBox& bb, const osg::Vec3& center)
+        {
+            for(unsigned int i=0; i<3; ++i)
+            {
+                bbMin[i] = osg::minimum(bbMin[i], bb._min[i]);
+                bbMax[i] = osg::maximum(bbMax[i], bb._max[i]);
+                centerMin[i] = osg::minimum(centerMin[i], center[i]);
+                centerMax[i] = osg::maximum(centerMax[i], center[i]);
+            }
+            ++count;
+        }
+
+        osg::Vec3       bbMin;
+        osg::Vec3       bbMax;
+        osg::Vec3       centerMin;
+        osg::Vec3       centerMax;
+        unsigned int    count;
+    };
+
+    // the bin of a triangle by its center along an axis, shared by the binning and the partition so they agree exactly.
+    struct SAHBinOf
+    {
+        SAHBinOf(const BuildKdTree::CenterList& centers, unsigned int axis, float min, float scale, unsigned int numBins):
+            _centers(centers),
+            _axis(axis),
+            _min(min),
+            _scale(scale),
+            _numBins(numBins) {}
+
+        inline unsigned int operator() (unsigned int primitiveIndex) const
+        {
+            float f = (_centers[primitiveIndex][_axis]-_min)*_scale;
+            unsigned int bin = f>0.0f ? static_cast<unsigned int>(f) : 0;
+            return bin<_numBins ? bin : _numBins-1;
+        }
+
+        const BuildKdTree::CenterList&  _centers;
+        unsigned int                    _axis;
+        float                           _min;
+        float                           _scale;
+        unsigned int                    _numBins;
+    };
+
+    struct SAHInFirstPart
+    {
+        SAHInFirstPart(const SAHBinOf& binOf, unsigned int lastBin):
+            _binOf(binOf),
+            _lastBin(lastBin) {}
+
+        inline bool operator() (unsigned int primitiveIndex) const { return _binOf(primitiveIndex)<=_lastBin; }
+
+        SAHBinOf        _binOf;
+        unsigned int    _lastBin;
+    };
+
+    inline void expandBy(BuildKdTree::Bounds& bounds, const SAHBin& bin)
+    {
+        if (bin.count==0) return;
+        bounds.bb.expandBy(osg::BoundingBox(bin.bbMin, bin.bbMax));
+        bounds.centerBB.expandBy(osg::BoundingBox(bin.centerMin, bin.centerMax));
+    }
+
+    struct BuildSubtreeTask : public BuildTask
+    {
+        BuildSubtreeTask(BuildKdTree& buildKdTree, const KdTree::BuildOptions& options, unsigned int begin, unsigned int end,
+                         const BuildKdTree::Bounds& bounds, unsigned int level):
+            _buildKdTree(buildKdTree),
+            _options(options),
+            _begin(begin),
+            _end(end),
+            _bounds(bounds),
+            _level(level) {}
+
+        virtual void run() { _buildKdTree.divideSAH(_options, _nodes, _begin, _end, _bounds, _level); }
+
+        BuildKdTree&                    _buildKdTree;
+        const KdTree::BuildOptions&     _options;
+        unsigned int                    _begin;
+        unsigned int                    _end;
+        BuildKdTree::Bounds             _bounds;
+        unsigned int                    _level;
+        KdTree::KdNodeList              _nodes;
+    };
+
+}
+
+int BuildKdTree::divideSAH(const KdTree::BuildOptions& options, KdTree::KdNodeList& nodes, unsigned int begin, unsigned int end,
+                           const Bounds& bounds, unsigned int level)
+{
+    int nodeIndex = static_cast<int>(nodes.size());
+    nodes.push_back(KdTree::KdNode(-static_cast<int>(begin)-1, end-begin));
+
+    Bounds firstBounds;
+    Bounds secondBounds;
+    unsigned int split = end;
+    if (end-begin>options._targetNumTrianglesPerLeaf && level<options._maxNumLevels)
+    {
+        split = partitionSAH(options, begin, end, bounds, firstBounds, secondBounds);
+    }
+
+    if (split==end)
+    {
+        // leaf is done, the bound of its triangles is already known.
+        osg::BoundingBox bb = bounds.bb;
+        if (bb.valid())
+        {
+            float epsilon = 1e-6f;
+            bb._min.x() -= epsilon;
+            bb._min.y() -= epsilon;
+            bb._min.z() -= epsilon;
+            bb._max.x() += epsilon;
+            bb._max.y() += epsilon;
+            bb._max.z() += epsilon;
+        }
+        nodes[nodeIndex].bb = bb;
+        return nodeIndex;
+    }
+
+    int leftChildIndex = 0;
+    int rightChildIndex = 0;
+    if (split-begin>=MIN_TASK_NUM_TRIANGLES)
+    {
+        // build the first child as a separate subtree, on another thread if there are any, and splice it in after the
+        // second so that the layout of the nodes doesn't depend on the number of threads.
+        BuildSubtreeTask task(*this, options, begin, split, firstBounds, level+1);
+        if (_threadPool) _threadPool->add(&task);
+
+        rightChildIndex = divideSAH(options, nodes, split, end, secondBounds, level+1);
+
+        if (_threadPool) _threadPool->wait(&task);
+        else task.run();
+
+        leftChildIndex = splice(nodes, task._nodes);
+    }
+    else
+    {
+        leftChildIndex = divideSAH(options, nodes, begin, split, firstBounds, level+1);
+        rightChildIndex = divideSAH(options, nodes, split, end, secondBounds, level+1);
+    }
+
+    KdTree::KdNode& node = nodes[nodeIndex];
+    node.first = leftChildIndex;
+    node.second = rightChildIndex;
+    node.bb.init();
+    node.bb.expandBy(nodes[leftChildIndex].bb);
+    node.bb.expandBy(nodes[rightChildIndex].bb);
+
+    return nodeIndex;
+}
+
+unsigned int BuildKdTree::partitionSAH(const KdTree::BuildOptions& options, unsigned int begin, unsigned int end,
+                                       const Bounds& bounds, Bounds& firstBounds, Bounds& secondBounds)
+{
+    unsigned int count = end-begin;
+
+    const osg::BoundingBox& centerBB = bounds.centerBB;
+    osg::Vec3 extents = centerBB._max-centerBB._min;
+    unsigned int axis = 0;
+    if (extents[1]>extents[axis]) axis = 1;
+    if (extents[2]>extents[axis]) axis = 2;
+
+    if (extents[axis]<=0.0f)
+    {
+        // all the centers coincide, so there is nothing to choose between, just halve them.
+        unsigned int split = begin + count/2;
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            Bounds& part = i<split ? firstBounds : secondBounds;
+            part.bb.expandBy(_bounds[_primitiveIndices[i]]);
+            part.centerBB.expandBy(_centers[_primitiveIndices[i]]);
+        }
+        return split;
+    }
+
+    // small nodes don't need more bins than triangles.
+    unsigned int numBins = osg::clampBetween(osg::minimum(options._numSAHBins, count), 2u, MAX_NUM_SAH_BINS);
+    SAHBinOf binOf(_centers, axis, centerBB._min[axis], float(numBins)/extents[axis], numBins);
+
+    SAHBin bins[MAX_NUM_SAH_BINS];
+    for(unsigned int b=0; b<numBins; ++b) bins[b].init();
+
+    for(unsigned int i=begin; i<end; ++i)
+    {
+        unsigned int primitiveIndex = _primitiveIndices[i];
+        bins[binOf(primitiveIndex)].add(_bounds[primitiveIndex], _centers[primitiveIndex]);
+    }
+
+    // sweep from the last bin back to accumulate the cost of the second part of each split...
+    float secondCosts[MAX_NUM_SAH_BINS];
+    osg::BoundingBox sweepBB;
+    unsigned int sweepCount = 0;
+    for(unsigned int b=numBins-1; b>0; --b)
+    {
+        if (bins[b].count!=0)
+        {
+            sweepBB.expandBy(bins[b].bbMin);
+            sweepBB.expandBy(bins[b].bbMax);
+            sweepCount += bins[b].count;
+        }
+        secondCosts[b] = halfArea(sweepBB)*float(sweepCount);
+    }
+
+    // ... then from the first bin forward to add the cost of the first part, splitting after bin b.
+    float bestCost = FLT_MAX;
+    int bestBin = -1;
+    sweepBB.init();
+    sweepCount = 0;
+    for(unsigned int b=0; b<numBins-1; ++b)
+    {
+        if (bins[b].count==0) continue;
+        sweepBB.expandBy(bins[b].bbMin);
+        sweepBB.expandBy(bins[b].bbMax);
+        sweepCount += bins[b].count;
+        if (sweepCount==count) continue;
+
+        float cost = halfArea(sweepBB)*float(sweepCount) + secondCosts[b+1];
+        if (cost<bestCost)
+        {
+            bestCost = cost;
+            bestBin = b;
+        }
+    }
+
+    // the centers span the axis, so the first and last bins can't be empty and there is always a split to choose.
+    float area = halfArea(bounds.bb);
+    float leafCost = INTERSECTION_COST*float(count)*area;
+    float splitCost = TRAVERSAL_COST*area + INTERSECTION_COST*bestCost;
+    if (bestBin<0 || (leafCost<=splitCost && count<=4*options._targetNumTrianglesPerLeaf)) return end;
+
+    for(unsigned int b=0; b<numBins; ++b)
+    {
+        expandBy(b<=static_cast<unsigned int>(bestBin) ? firstBounds : secondBounds, bins[b]);
+    }
+
+    Indices::iterator first = _primitiveIndices.begin()+begin;
+    Indices::iterator middle = std::partition(first, _primitiveIndices.begin()+end, SAHInFirstPart(binOf, bestBin));
+
+    return begin + static_cast<unsigned int>(middle-first);
+}
+
+int BuildKdTree::splice(KdTree::KdNodeList& nodes, const KdTree::KdNodeList& subtree)
+{
+    int offset = static_cast<int>(nodes.size());
+    nodes.insert(nodes.end(), subtree.begin(), subtree.end());
+
+    for(KdTree::KdNodeList::iterator itr = nodes.begin()+offset;
+        itr != nodes.end();
+        ++itr)
+    {
+        // internal nodes have child indices to move, while leaves have triangle ranges that are already in place.
+        if (itr->first>0)
+        {
+            itr->first += offset;
+            itr->second += offset;
+        }
+    }
+
+    return offset;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // KdTree::BuildOptions
@@ -738,8 +1711,24 @@ bool IntersectKdTree::intersectAndClip(osg::Vec3& s, osg::Vec3& e, const osg::Bo
 KdTree::BuildOptions::BuildOptions():
         _numVerticesProcessed(0),
         _targetNumTrianglesPerLeaf(4),
-        _maxNumLevels(32)
+        _maxNumLevels(32),
+        _splitMethod(SPATIAL_MEDIAN),
+        _numSAHBins(16),
+        _numThreads(1)
 {
+    const char* ptr = getenv("OSG_KDTREE_SPLIT_METHOD");
+    if (ptr)
+    {
+        if (strcmp(ptr,"SURFACE_AREA_HEURISTIC")==0 || strcmp(ptr,"SAH")==0) _splitMethod = SURFACE_AREA_HEURISTIC;
+        else if (strcmp(ptr,"SPATIAL_MEDIAN")==0) _splitMethod = SPATIAL_MEDIAN;
+    }
+
+    ptr = getenv("OSG_NUM_KDTREE_BUILD_THREADS");
+    if (ptr)
+    {
+        int numThreads = atoi(ptr);
+        _numThreads = numThreads>1 ? numThreads : 1;
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -754,7 +1743,8 @@ KdTree::KdTree(const KdTree& rhs, const osg::CopyOp& copyop):
     Shape(rhs, copyop),
     _vertices(rhs._vertices),
     _kdNodes(rhs._kdNodes),
-    _triangles(rhs._triangles)
+    _triangles(rhs._triangles),
+    _primitiveIndices(rhs._primitiveIndices)
 {
 }
 
@@ -785,6 +1775,27 @@ bool KdTree::intersect(const osg::Vec3d& start, const osg::Vec3d& end, LineSegme
     return numIntersectionsBefore != intersections.size();
 }
 
+bool KdTree::intersect(unsigned int numSegments, const osg::Vec3d* starts, const osg::Vec3d* ends, LineSegmentIntersection* nearest) const
+{
+    if (_kdNodes.empty()) 
+    {
+        osg::notify(osg::NOTICE)<<"Warning: _kdTree is empty"<<std::endl;
+        return false;
+    }
+
+    if (numSegments==0) return false;
+
+    IntersectKdTreeBatch intersector(*_vertices,
+                                     _kdNodes,
+                                     _triangles,
+                                     numSegments, starts, ends,
+                                     nearest);
+
+    if (!intersector._active[0].empty()) intersector.intersect(0, 0);
+
+    return intersector._hit;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // KdTreeBuilder
@@ -801,8 +1812,29 @@ KdTreeBuilder::KdTreeBuilder(const KdTreeBuilder& rhs):
 {
 }
 
+namespace
+{
+    struct BuildGeometryTask : public BuildTask
+    {
+        BuildGeometryTask(osg::KdTree* kdTree, const KdTree::BuildOptions& options, osg::Geometry* geometry):
+            _kdTree(kdTree),
+            _options(options),
+            _geometry(geometry),
+            _result(false) {}
+
+        virtual void run() { _result = _kdTree->build(_options, _geometry); }
+
+        osg::ref_ptr<osg::KdTree>   _kdTree;
+        KdTree::BuildOptions        _options;
+        osg::Geometry*              _geometry;
+        bool                        _result;
+    };
+}
+
 void KdTreeBuilder::apply(osg::Geode& geode)
 {
+    std::vector<BuildGeometryTask> tasks;
+
     for(unsigned int i=0; i<geode.getNumDrawables(); ++i)
     {            
 
@@ -814,10 +1846,31 @@ void KdTreeBuilder::apply(osg::Geode& geode)
 
             osg::ref_ptr<osg::KdTree> kdTree = dynamic_cast<osg::KdTree*>(_kdTreePrototype->cloneType());
 
-            if (kdTree->build(_buildOptions, geom))
-            {
-                geom->setShape(kdTree.get());
-            }
+            tasks.push_back(BuildGeometryTask(kdTree.get(), _buildOptions, geom));
+            tasks.back()._options._numVerticesProcessed = 0;
         }   
     }
+
+    if (tasks.size()>1 && _buildOptions._numThreads>1)
+    {
+        // share the geometries out across the thread pool, with the calling thread building the last.
+        s_buildThreadPool.reserveThreads(_buildOptions._numThreads);
+        for(unsigned int i=0; i+1<tasks.size(); ++i) s_buildThreadPool.add(&tasks[i]);
+        tasks.back().run();
+        for(unsigned int i=0; i+1<tasks.size(); ++i) s_buildThreadPool.wait(&tasks[i]);
+    }
+    else
+    {
+        for(unsigned int i=0; i<tasks.size(); ++i) tasks[i].run();
+    }
+
+    for(unsigned int i=0; i<tasks.size(); ++i)
+    {
+        BuildGeometryTask& task = tasks[i];
+        _buildOptions._numVerticesProcessed += task._options._numVerticesProcessed;
+        if (task._result)
+        {
+            task._geometry->setShape(task._kdTree.get());
+        }
+    }
 }
@@ -12,8 +12,10 @@
 */
 #include <osg/LOD>
 #include <osg/CullStack>
+#include <osg/Camera>
 
 #include <algorithm>
+#include <float.h>
 
 using namespace osg;
 
@@ -44,6 +46,9 @@ void LOD::traverse(NodeVisitor& nv)
             break;
         case(NodeVisitor::TRAVERSE_ACTIVE_CHILDREN):
         {
+            // only the cull traversal reuses the selection of the last frame, other traversals may view from elsewhere.
+            osg::CullStack* cullStack = nv.getVisitorType()==NodeVisitor::CULL_VISITOR ? dynamic_cast<osg::CullStack*>(&nv) : 0;
+
             float required_range = 0;
             if (_rangeMode==DISTANCE_FROM_EYE_POINT)
             {
@@ -51,7 +56,7 @@ void LOD::traverse(NodeVisitor& nv)
             }
             else
             {
-                osg::CullStack* cullStack = dynamic_cast<osg::CullStack*>(&nv);
+                if (!cullStack) cullStack = dynamic_cast<osg::CullStack*>(&nv);
                 if (cullStack && cullStack->getLODScale())
                 {
                     required_range = cullStack->clampedPixelSize(getBound()) / cullStack->getLODScale();
@@ -70,9 +75,20 @@ void LOD::traverse(NodeVisitor& nv)
             unsigned int numChildren = _children.size();
             if (_rangeList.size()<numChildren) numChildren=_rangeList.size();
 
+            bool useSelection = cullStack && useRangeSelection(nv, cullStack->getLODHysteresis());
+            unsigned int selection = 0;
+            if (useSelection)
+            {
+                bool skipped;
+                selection = selectRanges(cullStack->getLODSelectionID(), required_range, cullStack->getLODHysteresis(), skipped);
+                cullStack->countLODEvaluation(skipped);
+            }
+
             for(unsigned int i=0;i<numChildren;++i)
             {    
-                if (_rangeList[i].first<=required_range && required_range<_rangeList[i].second)
+                bool active = useSelection ? (selection & (1u<<i))!=0 :
+                                             (_rangeList[i].first<=required_range && required_range<_rangeList[i].second);
+                if (active)
                 {
                     _children[i]->accept(nv);
                 }
@@ -84,6 +100,84 @@ void LOD::traverse(NodeVisitor& nv)
     }
 }
 
+bool LOD::useRangeSelection(const NodeVisitor& nv, float hysteresis) const
+{
+    // a LOD reached along several paths is seen at a different range along each, so has no one selection to reuse.
+    return hysteresis>0.0f &&
+           nv.getVisitorType()==NodeVisitor::CULL_VISITOR &&
+           _rangeList.size()<=MAX_NUM_SELECTION_RANGES &&
+           hasUniqueParentalPath();
+}
+
+bool LOD::hasUniqueParentalPath() const
+{
+    const Node* node = this;
+    while(node->getNumParents()==1)
+    {
+        node = node->getParent(0);
+    }
+
+    // several top level cameras sharing a subgraph are each culled by their own traversal, so only see it once.
+    for(unsigned int i=0; i<node->getNumParents(); ++i)
+    {
+        const Camera* camera = dynamic_cast<const Camera*>(node->getParent(i));
+        if (!camera || camera->getNumParents()!=0) return false;
+    }
+    return true;
+}
+
+static inline float rangeLimit(const LOD::RangeList& rangeList, unsigned int limit, float noLimit)
+{
+    if (limit>=2*rangeList.size()) return noLimit;
+    return (limit&1) ? rangeList[limit/2].second : rangeList[limit/2].first;
+}
+
+unsigned int LOD::selectRanges(unsigned int selectionID, float requiredRange, float hysteresis, bool& skipped)
+{
+    // only reuse the selection of the same traversal, with hysteresis another camera's would hold where this one's wouldn't.
+    OpenThreads::Atomic& slot = _selections[selectionID%NUM_SELECTIONS];
+    unsigned int tag = SELECTION_VALID | (((selectionID/NUM_SELECTIONS)&SELECTION_TAG_BITS)<<SELECTION_TAG_SHIFT);
+
+    unsigned int selection = slot;
+    if ((selection & (SELECTION_VALID|(SELECTION_TAG_BITS<<SELECTION_TAG_SHIFT)))==tag)
+    {
+        float rangeMin = rangeLimit(_rangeList, (selection>>SELECTION_MIN_SHIFT)&SELECTION_LIMIT_BITS, -FLT_MAX);
+        float rangeMax = rangeLimit(_rangeList, (selection>>SELECTION_MAX_SHIFT)&SELECTION_LIMIT_BITS, FLT_MAX);
+        if (requiredRange>=rangeMin-hysteresis*fabsf(rangeMin) &&
+            requiredRange<rangeMax+hysteresis*fabsf(rangeMax))
+        {
+            skipped = true;
+            return selection & SELECTION_MASK_BITS;
+        }
+    }
+
+    // the ranges containing requiredRange only change at one of their limits, so hold between the nearest limits either side of it.
+    unsigned int mask = 0;
+    unsigned int minLimit = SELECTION_NO_LIMIT;
+    unsigned int maxLimit = SELECTION_NO_LIMIT;
+    float rangeMin = -FLT_MAX;
+    float rangeMax = FLT_MAX;
+    for(unsigned int limit=0; limit<2*_rangeList.size(); ++limit)
+    {
+        float value = rangeLimit(_rangeList, limit, 0.0f);
+        if (value<=requiredRange)
+        {
+            if (value>rangeMin) { rangeMin = value; minLimit = limit; }
+        }
+        else if (value<rangeMax) { rangeMax = value; maxLimit = limit; }
+    }
+
+    for(unsigned int i=0;i<_rangeList.size();++i)
+    {
+        if (_rangeList[i].first<=requiredRange && requiredRange<_rangeList[i].second) mask |= (1u<<i);
+    }
+
+    slot.exchange(tag | (maxLimit<<SELECTION_MAX_SHIFT) | (minLimit<<SELECTION_MIN_SHIFT) | mask);
+
+    skipped = false;
+    return mask;
+}
+
 BoundingSphere LOD::computeBound() const
 {
     if (_centerMode==USER_DEFINED_CENTER && _radius>=0.0f)
@@ -106,6 +200,7 @@ bool LOD::addChild( Node *child )
             float maxRange = !_rangeList.empty() ? _rangeList.back().second : 0.0f;
 
             _rangeList.resize(_children.size(),MinMaxPair(maxRange,maxRange));
+            dirtyRangeSelection();
         }
 
         return true;
@@ -121,6 +216,7 @@ bool LOD::addChild(Node *child, float min, float max)
         if (_children.size()>_rangeList.size()) _rangeList.resize(_children.size(),MinMaxPair(min,min));
         _rangeList[_children.size()-1].first = min;
         _rangeList[_children.size()-1].second = max;
+        dirtyRangeSelection();
         return true;
     }
     return false;
@@ -129,6 +225,7 @@ bool LOD::addChild(Node *child, float min, float max)
 bool LOD::removeChildren( unsigned int pos,unsigned int numChildrenToRemove)
 {
     if (pos<_rangeList.size()) _rangeList.erase(_rangeList.begin()+pos, osg::minimum(_rangeList.begin()+(pos+numChildrenToRemove), _rangeList.end()) );
+    dirtyRangeSelection();
 
     return Group::removeChildren(pos,numChildrenToRemove);
 }
@@ -138,4 +235,5 @@ void LOD::setRange(unsigned int childNo, float min,float max)
     if (childNo>=_rangeList.size()) _rangeList.resize(childNo+1,MinMaxPair(min,min));
     _rangeList[childNo].first=min;
     _rangeList[childNo].second=max;
+    dirtyRangeSelection();
 }
@@ -392,6 +392,10 @@ void Node::setCullingActive(bool active)
 
     // set the cullingActive itself.
     _cullingActive = active;
+
+    // parents that cull their children through a hierarchy of their bounds, such as SpatialGroup,
+    // pick up the change when their bound is recomputed.
+    dirtyBound();
 }
 
 void Node::setNumChildrenWithCullingDisabled(unsigned int num)
@@ -137,6 +137,9 @@ void PagedLOD::traverse(NodeVisitor& nv)
             break;
         case(NodeVisitor::TRAVERSE_ACTIVE_CHILDREN):
         {
+            // only the cull traversal reuses the selection of the last frame, other traversals may view from elsewhere.
+            osg::CullStack* cullStack = nv.getVisitorType()==NodeVisitor::CULL_VISITOR ? dynamic_cast<osg::CullStack*>(&nv) : 0;
+
             float required_range = 0;
             if (_rangeMode==DISTANCE_FROM_EYE_POINT)
             {
@@ -144,7 +147,7 @@ void PagedLOD::traverse(NodeVisitor& nv)
             }
             else
             {
-                osg::CullStack* cullStack = dynamic_cast<osg::CullStack*>(&nv);
+                if (!cullStack) cullStack = dynamic_cast<osg::CullStack*>(&nv);
                 if (cullStack && cullStack->getLODScale()>0.0f)
                 {
                     required_range = cullStack->clampedPixelSize(getBound()) / cullStack->getLODScale();
@@ -160,11 +163,23 @@ void PagedLOD::traverse(NodeVisitor& nv)
                 }
             }
 
+            // with hysteresis the selection, and so any request for the next child, holds while the range hovers around a limit.
+            bool useSelection = cullStack && useRangeSelection(nv, cullStack->getLODHysteresis());
+            unsigned int selection = 0;
+            if (useSelection)
+            {
+                bool skipped;
+                selection = selectRanges(cullStack->getLODSelectionID(), required_range, cullStack->getLODHysteresis(), skipped);
+                cullStack->countLODEvaluation(skipped);
+            }
+
             int lastChildTraversed = -1;
             bool needToLoadChild = false;
             for(unsigned int i=0;i<_rangeList.size();++i)
             {
-                if (_rangeList[i].first<=required_range && required_range<_rangeList[i].second)
+                bool active = useSelection ? (selection & (1u<<i))!=0 :
+                                             (_rangeList[i].first<=required_range && required_range<_rangeList[i].second);
+                if (active)
                 {
                     if (i<_children.size())
                     {
@@ -280,6 +295,7 @@ bool PagedLOD::removeChildren( unsigned int pos,unsigned int numChildrenToRemove
 {
     if (pos<_rangeList.size()) _rangeList.erase(_rangeList.begin()+pos, osg::minimum(_rangeList.begin()+(pos+numChildrenToRemove), _rangeList.end()) );
     if (pos<_perRangeDataList.size()) _perRangeDataList.erase(_perRangeDataList.begin()+pos, osg::minimum(_perRangeDataList.begin()+ (pos+numChildrenToRemove), _perRangeDataList.end()) );
+    dirtyRangeSelection();
 
     return Group::removeChildren(pos,numChildrenToRemove);
 }
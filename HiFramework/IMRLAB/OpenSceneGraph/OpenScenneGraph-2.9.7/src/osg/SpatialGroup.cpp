@@ -0,0 +1,321 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+#include <osg/SpatialGroup>
+#include <osg/CullStack>
+#include <osg/Transform>
+#include <osg/Camera>
+#include <osg/ClearNode>
+#include <osg/ClipNode>
+#include <osg/LightSource>
+#include <osg/Projection>
+#include <osg/TexGenNode>
+
+#include <algorithm>
+
+using namespace osg;
+
+namespace
+{
+    /** Return true if the child is of a type the cull traversal culls by its bound, rather than always visiting it as
+      * it does the positional state and nested cameras.*/
+    inline bool isCullableType(const Node& child)
+    {
+        return !dynamic_cast<const Camera*>(&child) &&
+               !dynamic_cast<const LightSource*>(&child) &&
+               !dynamic_cast<const ClipNode*>(&child) &&
+               !dynamic_cast<const TexGenNode*>(&child) &&
+               !dynamic_cast<const Projection*>(&child) &&
+               !dynamic_cast<const ClearNode*>(&child);
+    }
+
+    /** Return true if a child of a cullable type can currently be culled by its bound in the SpatialGroup's coordinate frame.*/
+    inline bool isCullable(const Node& child)
+    {
+        const Transform* transform = child.asTransform();
+        return child.isCullingActive() && (!transform || transform->getReferenceFrame()==Transform::RELATIVE_RF);
+    }
+
+    inline float surfaceArea(const BoundingBox& bb)
+    {
+        if (!bb.valid()) return 0.0f;
+        float dx = bb.xMax()-bb.xMin(), dy = bb.yMax()-bb.yMin(), dz = bb.zMax()-bb.zMin();
+        return 2.0f*(dx*dy + dy*dz + dz*dx);
+    }
+
+    struct LessCenter
+    {
+        LessCenter(const NodeList& children, unsigned int axis): _children(children), _axis(axis) {}
+
+        inline bool operator() (unsigned int lhs, unsigned int rhs) const
+        {
+            return _children[lhs]->getBound().center()[_axis] < _children[rhs]->getBound().center()[_axis];
+        }
+
+        const NodeList& _children;
+        unsigned int    _axis;
+    };
+}
+
+SpatialGroup::SpatialGroup():
+    _maximumNumChildrenPerCell(4),
+    _hierarchyDirty(true),
+    _hierarchyRefitRequired(false)
+{
+    // the hierarchy is brought up to date in the update traversal.
+    setNumChildrenRequiringUpdateTraversal(1);
+}
+
+SpatialGroup::SpatialGroup(const SpatialGroup& group,const CopyOp& copyop):
+    Group(group,copyop),
+    _maximumNumChildrenPerCell(group._maximumNumChildrenPerCell),
+    _hierarchyDirty(true),
+    _hierarchyRefitRequired(false)
+{
+    setNumChildrenRequiringUpdateTraversal(getNumChildrenRequiringUpdateTraversal()+1);
+}
+
+void SpatialGroup::traverse(NodeVisitor& nv)
+{
+    if (nv.getVisitorType()==NodeVisitor::UPDATE_VISITOR)
+    {
+        Group::traverse(nv);
+
+        // after the children's update callbacks have moved them, and before the cull traversals read the hierarchy.
+        getHierarchy();
+        return;
+    }
+
+    CullStack* cs = dynamic_cast<CullStack*>(&nv);
+    if (!cs)
+    {
+        Group::traverse(nv);
+        return;
+    }
+
+    ref_ptr<const Hierarchy> hierarchy = getHierarchy();
+
+    for(ChildIndexList::const_iterator itr=hierarchy->unculledChildIndices.begin();
+        itr!=hierarchy->unculledChildIndices.end();
+        ++itr)
+    {
+        _children[*itr]->accept(nv);
+    }
+
+    if (!hierarchy->cells.empty()) traverseCell(nv, *cs, *hierarchy, 0);
+}
+
+void SpatialGroup::traverseCell(NodeVisitor& nv, CullStack& cs, const Hierarchy& hierarchy, int cellNum)
+{
+    const Cell& cell = hierarchy.cells[cellNum];
+    const BoundingBox& bb = cell.bb;
+    if (cs.isCulled(bb)) return;
+
+    // small feature cull the cell on its bounding sphere, as the children would be were they in a Group of their own.
+    CullingSet& cullingSet = cs.getCurrentCullingSet();
+    if (cullingSet.getCullingMask() & CullingSet::SMALL_FEATURE_CULLING)
+    {
+        BoundingSphere bs(bb);
+        if (((bs.center()*cullingSet.getPixelSizeVector())*cullingSet.getSmallFeatureCullingPixelSize())>bs.radius()) return;
+    }
+
+    // as CullVisitor::apply(Group&), so that the planes the cell is wholly inside aren't tested again below it.
+    cs.pushCurrentMask();
+
+    if (cell.first<0)
+    {
+        unsigned int begin = static_cast<unsigned int>(-cell.first-1);
+        unsigned int end = begin+static_cast<unsigned int>(cell.second);
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            // cull on the copies of the bounds so that culled children aren't touched at all.
+            if (!cs.isCulled(hierarchy.cellChildBounds[i])) _children[hierarchy.cellChildIndices[i]]->accept(nv);
+        }
+    }
+    else
+    {
+        traverseCell(nv, cs, hierarchy, cell.first);
+        traverseCell(nv, cs, hierarchy, cell.second);
+    }
+
+    cs.popCurrentMask();
+}
+
+bool SpatialGroup::setChild( unsigned  int i, Node* node )
+{
+    if (!Group::setChild(i, node)) return false;
+
+    dirtyHierarchy();
+    return true;
+}
+
+void SpatialGroup::childRemoved(unsigned int, unsigned int)
+{
+    dirtyHierarchy();
+}
+
+void SpatialGroup::childInserted(unsigned int)
+{
+    dirtyHierarchy();
+}
+
+BoundingSphere SpatialGroup::computeBound() const
+{
+    // the bound is only recomputed once it's been dirtied, by a child moving or having its culling changed.
+    _hierarchyRefitRequired = true;
+
+    return Group::computeBound();
+}
+
+ref_ptr<const SpatialGroup::Hierarchy> SpatialGroup::getHierarchy() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_hierarchyMutex);
+
+    // computing the bound flags the hierarchy for refitting when any of the children have moved.
+    getBound();
+
+    if (!_hierarchyDirty && _hierarchy.valid() && _hierarchyRefitRequired)
+    {
+        _hierarchy = refitHierarchy(*_hierarchy);
+        _hierarchyRefitRequired = false;
+        if (!_hierarchy) _hierarchyDirty = true;
+    }
+
+    if (_hierarchyDirty || !_hierarchy)
+    {
+        _hierarchy = buildHierarchy();
+        _hierarchyDirty = false;
+        _hierarchyRefitRequired = false;
+    }
+
+    return _hierarchy;
+}
+
+SpatialGroup::Hierarchy* SpatialGroup::buildHierarchy() const
+{
+    Hierarchy* hierarchy = new Hierarchy;
+
+    for(unsigned int i=0; i<_children.size(); ++i)
+    {
+        if (isCullableType(*_children[i]) && isCullable(*_children[i])) hierarchy->cellChildIndices.push_back(i);
+        else hierarchy->unculledChildIndices.push_back(i);
+    }
+
+    if (hierarchy->cellChildIndices.empty()) return hierarchy;
+
+    hierarchy->cells.reserve(2*(hierarchy->cellChildIndices.size()/_maximumNumChildrenPerCell)+1);
+    buildCell(*hierarchy, 0, hierarchy->cellChildIndices.size());
+
+    hierarchy->cellChildBounds.reserve(hierarchy->cellChildIndices.size());
+    for(ChildIndexList::const_iterator itr=hierarchy->cellChildIndices.begin();
+        itr!=hierarchy->cellChildIndices.end();
+        ++itr)
+    {
+        hierarchy->cellChildBounds.push_back(_children[*itr]->getBound());
+    }
+
+    for(CellList::const_iterator itr=hierarchy->cells.begin();
+        itr!=hierarchy->cells.end();
+        ++itr)
+    {
+        hierarchy->builtSurfaceArea += surfaceArea(itr->bb);
+    }
+
+    return hierarchy;
+}
+
+int SpatialGroup::buildCell(Hierarchy& hierarchy, unsigned int begin, unsigned int end) const
+{
+    CellList& cells = hierarchy.cells;
+    ChildIndexList& cellChildIndices = hierarchy.cellChildIndices;
+
+    int cellNum = static_cast<int>(cells.size());
+    cells.push_back(Cell());
+
+    BoundingBox bb;
+    BoundingBox centers;
+    for(unsigned int i=begin; i<end; ++i)
+    {
+        const BoundingSphere& bs = _children[cellChildIndices[i]]->getBound();
+        bb.expandBy(bs);
+        centers.expandBy(bs.center());
+    }
+    cells[cellNum].bb = bb;
+
+    if (end-begin<=_maximumNumChildrenPerCell)
+    {
+        cells[cellNum].first = -static_cast<int>(begin)-1;
+        cells[cellNum].second = static_cast<int>(end-begin);
+        return cellNum;
+    }
+
+    // split at the median of the children's centres along the widest axis.
+    Vec3 extents(centers.xMax()-centers.xMin(), centers.yMax()-centers.yMin(), centers.zMax()-centers.zMin());
+    unsigned int axis = 0;
+    if (extents.y()>extents[axis]) axis = 1;
+    if (extents.z()>extents[axis]) axis = 2;
+
+    unsigned int mid = (begin+end)/2;
+    std::nth_element(cellChildIndices.begin()+begin, cellChildIndices.begin()+mid, cellChildIndices.begin()+end, LessCenter(_children, axis));
+
+    int left = buildCell(hierarchy, begin, mid);
+    int right = buildCell(hierarchy, mid, end);
+    cells[cellNum].first = left;
+    cells[cellNum].second = right;
+    return cellNum;
+}
+
+SpatialGroup::Hierarchy* SpatialGroup::refitHierarchy(const Hierarchy& hierarchy) const
+{
+    for(ChildIndexList::const_iterator itr=hierarchy.unculledChildIndices.begin();
+        itr!=hierarchy.unculledChildIndices.end();
+        ++itr)
+    {
+        if (*itr>=_children.size() || (isCullable(*_children[*itr]) && isCullableType(*_children[*itr]))) return 0;
+    }
+
+    // refit a copy, leaving the published hierarchy untouched for traversals in other threads.
+    ref_ptr<Hierarchy> refitted = new Hierarchy(hierarchy);
+
+    // sub cells are stored after their parents so refit from the back.
+    float totalSurfaceArea = 0.0f;
+    for(CellList::reverse_iterator itr=refitted->cells.rbegin();
+        itr!=refitted->cells.rend();
+        ++itr)
+    {
+        Cell& cell = *itr;
+        cell.bb.init();
+        if (cell.first<0)
+        {
+            unsigned int begin = static_cast<unsigned int>(-cell.first-1);
+            unsigned int end = begin+static_cast<unsigned int>(cell.second);
+            for(unsigned int i=begin; i<end; ++i)
+            {
+                unsigned int childNum = refitted->cellChildIndices[i];
+                if (childNum>=_children.size() || !isCullable(*_children[childNum])) return 0;
+                refitted->cellChildBounds[i] = _children[childNum]->getBound();
+                cell.bb.expandBy(refitted->cellChildBounds[i]);
+            }
+        }
+        else
+        {
+            cell.bb.expandBy(refitted->cells[cell.first].bb);
+            cell.bb.expandBy(refitted->cells[cell.second].bb);
+        }
+        totalSurfaceArea += surfaceArea(cell.bb);
+    }
+
+    // rebuild once the children have moved enough for the refitted cells to overlap a lot more than they did.
+    if (totalSurfaceArea>refitted->builtSurfaceArea*2.0f) return 0;
+
+    return refitted.release();
+}
@@ -0,0 +1,219 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgDB/BatchFileWriter>
+#include <osgDB/Registry>
+
+#include <osg/Notify>
+
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
+using namespace osgDB;
+
+class BatchFileWriter::WriterThread : public OpenThreads::Thread
+{
+    public:
+
+        WriterThread(BatchFileWriter* writer): _writer(writer) {}
+
+        virtual void run()
+        {
+            for(;;)
+            {
+                WriteRequest request;
+                {
+                    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_writer->_mutex);
+                    while (_writer->_requests.empty() && !_writer->_done)
+                    {
+                        _writer->_requestAdded.wait(&(_writer->_mutex));
+                    }
+                    if (_writer->_requests.empty()) return;
+
+                    request = _writer->_requests.front();
+                    _writer->_requests.pop_front();
+                }
+
+                _writer->write(request);
+            }
+        }
+
+    protected:
+
+        // not a ref_ptr, the writer joins its threads before it is deleted.
+        BatchFileWriter* _writer;
+};
+
+BatchFileWriter::BatchFileWriter(unsigned int numThreads, unsigned int maxNumPendingFiles):
+    _maximumNumPendingFiles(maxNumPendingFiles),
+    _numPendingFiles(0),
+    _numFilesWritten(0),
+    _done(false)
+{
+    if (numThreads==0)
+    {
+        int numProcessors = OpenThreads::GetNumberOfProcessors();
+        numThreads = numProcessors>0 ? static_cast<unsigned int>(numProcessors) : 1;
+    }
+
+    if (_maximumNumPendingFiles==0) _maximumNumPendingFiles = numThreads*2;
+
+    for(unsigned int i=0; i<numThreads; ++i)
+    {
+        WriterThread* thread = new WriterThread(this);
+        if (thread->start()==0) _threads.push_back(thread);
+        else delete thread;
+    }
+
+    OSG_NOTIFY(osg::INFO)<<"BatchFileWriter started "<<_threads.size()<<" threads, maximum pending files "<<_maximumNumPendingFiles<<std::endl;
+}
+
+BatchFileWriter::~BatchFileWriter()
+{
+    waitForCompletion();
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        _done = true;
+        _requestAdded.broadcast();
+    }
+
+    for(WriterThreads::iterator itr = _threads.begin();
+        itr != _threads.end();
+        ++itr)
+    {
+        (*itr)->join();
+        delete *itr;
+    }
+}
+
+BatchFileWriter* BatchFileWriter::getBatchFileWriter(const Options* options)
+{
+    if (!options) return 0;
+    return static_cast<BatchFileWriter*>(const_cast<void*>(options->getPluginData(getPluginDataName())));
+}
+
+void BatchFileWriter::writeObjectFile(const osg::Object& object, const std::string& fileName, const Options* options)
+{
+    add(WRITE_OBJECT, object, fileName, options);
+}
+
+void BatchFileWriter::writeImageFile(const osg::Image& image, const std::string& fileName, const Options* options)
+{
+    add(WRITE_IMAGE, image, fileName, options);
+}
+
+void BatchFileWriter::writeNodeFile(const osg::Node& node, const std::string& fileName, const Options* options)
+{
+    add(WRITE_NODE, node, fileName, options);
+}
+
+bool BatchFileWriter::isWriterThread() const
+{
+    OpenThreads::Thread* currentThread = OpenThreads::Thread::CurrentThread();
+    if (!currentThread) return false;
+
+    for(WriterThreads::const_iterator itr = _threads.begin();
+        itr != _threads.end();
+        ++itr)
+    {
+        if (*itr==currentThread) return true;
+    }
+    return false;
+}
+
+void BatchFileWriter::add(WriteType type, const osg::Object& object, const std::string& fileName, const Options* options)
+{
+    WriteRequest request;
+    request.type = type;
+    request.object = &object;
+    request.fileName = fileName;
+
+    // attach this writer to a copy of the options so the plugins can queue the files they reference on it.
+    if (!options) options = Registry::instance()->getOptions();
+    osg::ref_ptr<Options> localOptions = options ? options->cloneOptions() : new Options;
+    localOptions->setPluginData(getPluginDataName(), this);
+    request.options = localOptions.get();
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    if (_numPendingFiles>=_maximumNumPendingFiles || _threads.empty())
+    {
+        if (isWriterThread() || _threads.empty())
+        {
+            // waiting here could leave every worker waiting on the others, so write on the calling thread.
+            ++_numPendingFiles;
+            _mutex.unlock();
+            write(request);
+            _mutex.lock();
+            return;
+        }
+
+        while (_numPendingFiles>=_maximumNumPendingFiles)
+        {
+            _requestCompleted.wait(&_mutex);
+        }
+    }
+
+    ++_numPendingFiles;
+    _requests.push_back(request);
+    _requestAdded.signal();
+}
+
+void BatchFileWriter::write(const WriteRequest& request)
+{
+    ReaderWriter::WriteResult wr;
+    switch(request.type)
+    {
+        case(WRITE_OBJECT):
+            wr = Registry::instance()->writeObject(*request.object, request.fileName, request.options.get());
+            break;
+        case(WRITE_IMAGE):
+            wr = Registry::instance()->writeImage(*static_cast<const osg::Image*>(request.object.get()), request.fileName, request.options.get());
+            break;
+        case(WRITE_NODE):
+            wr = Registry::instance()->writeNode(*static_cast<const osg::Node*>(request.object.get()), request.fileName, request.options.get());
+            break;
+    }
+
+    if (wr.error()) OSG_NOTIFY(osg::WARN) << "Error writing file " << request.fileName << ": " << wr.message() << std::endl;
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    if (wr.success()) ++_numFilesWritten;
+    else _failedFiles.push_back(request.fileName);
+
+    --_numPendingFiles;
+    _requestCompleted.broadcast();
+}
+
+bool BatchFileWriter::waitForCompletion()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    while (_numPendingFiles>0)
+    {
+        _requestCompleted.wait(&_mutex);
+    }
+    return _failedFiles.empty();
+}
+
+unsigned int BatchFileWriter::getNumFilesWritten() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    return _numFilesWritten;
+}
+
+BatchFileWriter::FileNameList BatchFileWriter::getFailedFiles() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    return _failedFiles;
+}
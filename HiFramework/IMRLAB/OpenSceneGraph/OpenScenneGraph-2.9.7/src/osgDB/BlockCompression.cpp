@@ -0,0 +1,699 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgDB/BlockCompression>
+
+#include <osg/Math>
+#include <osg/Notify>
+#include <osg/ApplicationUsage>
+
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace osgDB;
+
+static osg::ApplicationUsageProxy BlockCompression_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_COMPRESSION_THREADS <int>","Set the number of threads used to compress and decompress block compressed .ive and .osgb files.");
+
+namespace
+{
+
+const unsigned int CONTAINER_VERSION = 1;
+
+// Largest block accepted when reading, guards the allocations against corrupt headers.
+const unsigned int MAXIMUM_BLOCK_SIZE = 64*1024*1024;
+
+unsigned int s_defaultNumThreads = 0;
+
+inline void appendUInt(std::string& dst, unsigned int value)
+{
+    char bytes[4];
+    bytes[0] = static_cast<char>(value & 0xff);
+    bytes[1] = static_cast<char>((value >> 8) & 0xff);
+    bytes[2] = static_cast<char>((value >> 16) & 0xff);
+    bytes[3] = static_cast<char>((value >> 24) & 0xff);
+    dst.append(bytes, 4);
+}
+
+inline unsigned int getUInt(const char* src)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(src);
+    return static_cast<unsigned int>(bytes[0]) |
+           (static_cast<unsigned int>(bytes[1]) << 8) |
+           (static_cast<unsigned int>(bytes[2]) << 16) |
+           (static_cast<unsigned int>(bytes[3]) << 24);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// LZ4 block format, greedy single hash table matcher. Favours decompression
+// speed over ratio, typically several times faster to decode than zlib.
+//
+const unsigned int LZ4_MINMATCH = 4;
+const unsigned int LZ4_LASTLITERALS = 5;
+const unsigned int LZ4_MFLIMIT = 12;
+const unsigned int LZ4_HASH_LOG = 14;
+const unsigned int LZ4_MAX_DISTANCE = 65535;
+
+inline unsigned int read32(const unsigned char* ptr)
+{
+    unsigned int value;
+    memcpy(&value, ptr, 4);
+    return value;
+}
+
+inline unsigned int lz4Hash(unsigned int sequence)
+{
+    return (sequence * 2654435761u) >> (32-LZ4_HASH_LOG);
+}
+
+inline void lz4AppendLength(std::string& dst, unsigned int length)
+{
+    while (length>=255)
+    {
+        dst.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    dst.push_back(static_cast<char>(length));
+}
+
+void lz4AppendSequence(std::string& dst, const unsigned char* literals, unsigned int numLiterals, unsigned int offset, unsigned int matchLength, bool lastSequence)
+{
+    std::string::size_type tokenPos = dst.size();
+    unsigned char token = static_cast<unsigned char>((numLiterals>=15 ? 15 : numLiterals) << 4);
+    dst.push_back(0);
+    if (numLiterals>=15) lz4AppendLength(dst, numLiterals-15);
+    dst.append(reinterpret_cast<const char*>(literals), numLiterals);
+
+    if (!lastSequence)
+    {
+        dst.push_back(static_cast<char>(offset & 0xff));
+        dst.push_back(static_cast<char>(offset >> 8));
+
+        unsigned int length = matchLength-LZ4_MINMATCH;
+        token |= static_cast<unsigned char>(length>=15 ? 15 : length);
+        if (length>=15) lz4AppendLength(dst, length-15);
+    }
+
+    dst[tokenPos] = static_cast<char>(token);
+}
+
+void lz4Compress(const unsigned char* src, unsigned int srcSize, std::string& dst)
+{
+    dst.clear();
+    dst.reserve(srcSize + srcSize/255 + 16);
+
+    const unsigned char* ip = src;
+    const unsigned char* anchor = src;
+    const unsigned char* iend = src + srcSize;
+
+    if (srcSize>LZ4_MFLIMIT)
+    {
+        const unsigned char* mflimit = iend - LZ4_MFLIMIT;
+        const unsigned char* matchlimit = iend - LZ4_LASTLITERALS;
+
+        std::vector<unsigned int> hashTable(1<<LZ4_HASH_LOG, 0);
+        unsigned int numMisses = 0;
+
+        ++ip;
+        while (ip<mflimit)
+        {
+            unsigned int sequence = read32(ip);
+            unsigned int& entry = hashTable[lz4Hash(sequence)];
+            const unsigned char* ref = src + entry;
+            entry = static_cast<unsigned int>(ip-src);
+
+            if (ref>=ip || static_cast<unsigned int>(ip-ref)>LZ4_MAX_DISTANCE || read32(ref)!=sequence)
+            {
+                // step over incompressible data progressively faster.
+                ip += 1 + (numMisses++ >> 6);
+                continue;
+            }
+            numMisses = 0;
+
+            while (ip>anchor && ref>src && ip[-1]==ref[-1]) { --ip; --ref; }
+
+            const unsigned char* matchEnd = ip + LZ4_MINMATCH;
+            const unsigned char* refEnd = ref + LZ4_MINMATCH;
+            while (matchEnd<matchlimit && *matchEnd==*refEnd) { ++matchEnd; ++refEnd; }
+
+            lz4AppendSequence(dst, anchor, static_cast<unsigned int>(ip-anchor), static_cast<unsigned int>(ip-ref), static_cast<unsigned int>(matchEnd-ip), false);
+
+            ip = matchEnd;
+            anchor = ip;
+        }
+    }
+
+    lz4AppendSequence(dst, anchor, static_cast<unsigned int>(iend-anchor), 0, 0, true);
+}
+
+inline bool lz4ReadLength(const unsigned char*& ip, const unsigned char* iend, unsigned int& length)
+{
+    unsigned char s;
+    do
+    {
+        if (ip>=iend) return false;
+        s = *ip++;
+        length += s;
+    } while (s==255);
+    return true;
+}
+
+bool lz4Decompress(const unsigned char* src, unsigned int srcSize, unsigned char* dst, unsigned int dstSize)
+{
+    const unsigned char* ip = src;
+    const unsigned char* iend = src + srcSize;
+    unsigned char* op = dst;
+    unsigned char* oend = dst + dstSize;
+
+    while (ip<iend)
+    {
+        unsigned int token = *ip++;
+
+        unsigned int numLiterals = token >> 4;
+        if (numLiterals==15 && !lz4ReadLength(ip, iend, numLiterals)) return false;
+        if (numLiterals>static_cast<unsigned int>(iend-ip) || numLiterals>static_cast<unsigned int>(oend-op)) return false;
+        memcpy(op, ip, numLiterals);
+        op += numLiterals;
+        ip += numLiterals;
+
+        // the last sequence has no match.
+        if (ip>=iend) break;
+
+        if (iend-ip<2) return false;
+        unsigned int offset = static_cast<unsigned int>(ip[0]) | (static_cast<unsigned int>(ip[1]) << 8);
+        ip += 2;
+        if (offset==0 || offset>static_cast<unsigned int>(op-dst)) return false;
+
+        unsigned int matchLength = token & 15;
+        if (matchLength==15 && !lz4ReadLength(ip, iend, matchLength)) return false;
+        matchLength += LZ4_MINMATCH;
+        if (matchLength>static_cast<unsigned int>(oend-op)) return false;
+
+        const unsigned char* match = op - offset;
+        if (offset>=matchLength)
+        {
+            memcpy(op, match, matchLength);
+            op += matchLength;
+        }
+        else
+        {
+            // overlapping match repeats the last offset bytes.
+            for(unsigned int i=0; i<matchLength; ++i) *op++ = *match++;
+        }
+    }
+
+    return op==oend;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// Parallel compression of the blocks of a buffer
+//
+struct CompressBlocks
+{
+    CompressBlocks(BlockCompression::Codec codec, const char* data, unsigned int size, unsigned int blockSize):
+        _codec(codec),
+        _data(data),
+        _size(size),
+        _blockSize(blockSize),
+        _nextBlock(0),
+        _failed(false)
+    {
+        unsigned int numBlocks = (size+blockSize-1)/blockSize;
+        _blocks.resize(numBlocks);
+    }
+
+    unsigned int getNumBlocks() const { return static_cast<unsigned int>(_blocks.size()); }
+
+    void run()
+    {
+        for(;;)
+        {
+            unsigned int blockNum;
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                if (_nextBlock>=_blocks.size() || _failed) return;
+                blockNum = _nextBlock++;
+            }
+
+            unsigned int offset = blockNum*_blockSize;
+            unsigned int blockSize = osg::minimum(_blockSize, _size-offset);
+            std::string& block = _blocks[blockNum];
+            if (!BlockCompression::compressBlock(_codec, _data+offset, blockSize, block))
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                _failed = true;
+                return;
+            }
+
+            // keep blocks that don't shrink uncompressed.
+            if (block.size()>=blockSize) block.assign(_data+offset, blockSize);
+        }
+    }
+
+    BlockCompression::Codec     _codec;
+    const char*                 _data;
+    unsigned int                _size;
+    unsigned int                _blockSize;
+    OpenThreads::Mutex          _mutex;
+    unsigned int                _nextBlock;
+    bool                        _failed;
+    std::vector<std::string>    _blocks;
+};
+
+class CompressThread : public OpenThreads::Thread
+{
+    public:
+        CompressThread(CompressBlocks& compressBlocks): _compressBlocks(compressBlocks) {}
+        virtual void run() { _compressBlocks.run(); }
+    protected:
+        CompressBlocks& _compressBlocks;
+};
+
+// Reads from a prefix already pulled off the stream before carrying on with the stream itself.
+struct PrefixedReader
+{
+    PrefixedReader(const char* prefix, unsigned int prefixSize, std::istream& fin):
+        _prefix(prefix),
+        _prefixSize(prefixSize),
+        _fin(fin) {}
+
+    bool read(char* data, unsigned int size)
+    {
+        unsigned int fromPrefix = osg::minimum(size, _prefixSize);
+        if (fromPrefix>0)
+        {
+            memcpy(data, _prefix, fromPrefix);
+            _prefix += fromPrefix;
+            _prefixSize -= fromPrefix;
+            data += fromPrefix;
+            size -= fromPrefix;
+        }
+        if (size==0) return true;
+
+        _fin.read(data, size);
+        return static_cast<unsigned int>(_fin.gcount())==size;
+    }
+
+    const char*     _prefix;
+    unsigned int    _prefixSize;
+    std::istream&   _fin;
+};
+
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// BlockCompression
+//
+bool BlockCompression::isCodecSupported(Codec codec)
+{
+    switch(codec)
+    {
+        case(STORED): return true;
+        case(LZ4): return true;
+#ifdef USE_ZLIB
+        case(ZLIB): return true;
+#endif
+        default: return false;
+    }
+}
+
+void BlockCompression::setDefaultNumThreads(unsigned int numThreads)
+{
+    s_defaultNumThreads = numThreads;
+}
+
+unsigned int BlockCompression::getDefaultNumThreads()
+{
+    if (s_defaultNumThreads==0)
+    {
+        const char* str = getenv("OSG_COMPRESSION_THREADS");
+        int numThreads = str ? atoi(str) : 0;
+        if (numThreads<=0) numThreads = OpenThreads::GetNumberOfProcessors();
+        s_defaultNumThreads = numThreads>0 ? static_cast<unsigned int>(numThreads) : 1;
+    }
+    return s_defaultNumThreads;
+}
+
+bool BlockCompression::isBlockCompressed(const char* data, unsigned int size)
+{
+    return size>=4 && memcmp(data, "OSGB", 4)==0;
+}
+
+bool BlockCompression::compressBlock(Codec codec, const char* src, unsigned int srcSize, std::string& dst)
+{
+    switch(codec)
+    {
+        case(STORED):
+            dst.assign(src, srcSize);
+            return true;
+        case(LZ4):
+            lz4Compress(reinterpret_cast<const unsigned char*>(src), srcSize, dst);
+            return true;
+#ifdef USE_ZLIB
+        case(ZLIB):
+        {
+            uLongf dstSize = compressBound(srcSize);
+            dst.resize(dstSize);
+            if (compress2(reinterpret_cast<Bytef*>(&dst[0]), &dstSize, reinterpret_cast<const Bytef*>(src), srcSize, 6)!=Z_OK) return false;
+            dst.resize(dstSize);
+            return true;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+bool BlockCompression::decompressBlock(Codec codec, const char* src, unsigned int srcSize, char* dst, unsigned int dstSize)
+{
+    // blocks that didn't compress are stored as is.
+    if (srcSize==dstSize)
+    {
+        memcpy(dst, src, dstSize);
+        return true;
+    }
+
+    switch(codec)
+    {
+        case(LZ4):
+            return lz4Decompress(reinterpret_cast<const unsigned char*>(src), srcSize, reinterpret_cast<unsigned char*>(dst), dstSize);
+#ifdef USE_ZLIB
+        case(ZLIB):
+        {
+            uLongf size = dstSize;
+            return uncompress(reinterpret_cast<Bytef*>(dst), &size, reinterpret_cast<const Bytef*>(src), srcSize)==Z_OK && size==dstSize;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+bool BlockCompression::compress(std::ostream& fout, const char* data, unsigned int size, Codec codec, unsigned int blockSize, unsigned int numThreads)
+{
+    if (!isCodecSupported(codec))
+    {
+        OSG_NOTIFY(osg::WARN)<<"BlockCompression::compress() codec "<<codec<<" not supported in this build."<<std::endl;
+        return false;
+    }
+
+    if (blockSize==0) blockSize = DEFAULT_BLOCK_SIZE;
+    if (numThreads==0) numThreads = getDefaultNumThreads();
+
+    CompressBlocks compressBlocks(codec, data, size, blockSize);
+
+    // the calling thread compresses blocks alongside the extra threads.
+    std::vector<CompressThread*> threads;
+    unsigned int numExtraThreads = osg::minimum(numThreads, compressBlocks.getNumBlocks())-1;
+    if (compressBlocks.getNumBlocks()==0) numExtraThreads = 0;
+    for(unsigned int i=0; i<numExtraThreads; ++i)
+    {
+        CompressThread* thread = new CompressThread(compressBlocks);
+        if (thread->start()==0) threads.push_back(thread);
+        else delete thread;
+    }
+
+    compressBlocks.run();
+
+    for(std::vector<CompressThread*>::iterator itr = threads.begin();
+        itr != threads.end();
+        ++itr)
+    {
+        (*itr)->join();
+        delete *itr;
+    }
+
+    if (compressBlocks._failed) return false;
+
+    std::string header;
+    header.reserve(HEADER_SIZE + 4*compressBlocks.getNumBlocks());
+    header.append("OSGB", 4);
+    appendUInt(header, CONTAINER_VERSION);
+    appendUInt(header, codec);
+    appendUInt(header, blockSize);
+    appendUInt(header, size);
+    appendUInt(header, compressBlocks.getNumBlocks());
+    for(unsigned int i=0; i<compressBlocks.getNumBlocks(); ++i)
+    {
+        appendUInt(header, static_cast<unsigned int>(compressBlocks._blocks[i].size()));
+    }
+
+    fout.write(header.data(), header.size());
+    for(unsigned int i=0; i<compressBlocks.getNumBlocks(); ++i)
+    {
+        const std::string& block = compressBlocks._blocks[i];
+        fout.write(block.data(), block.size());
+    }
+
+    return !fout.fail();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// BlockDecompressor
+//
+class BlockDecompressor::WorkerThread : public OpenThreads::Thread
+{
+    public:
+
+        WorkerThread(BlockDecompressor* decompressor): _decompressor(decompressor) {}
+
+        virtual void run()
+        {
+            unsigned int blockNum;
+            while (_decompressor->claimBlock(blockNum))
+            {
+                _decompressor->decompressClaimedBlock(blockNum);
+            }
+        }
+
+    protected:
+
+        // not a ref_ptr, the decompressor joins its threads before it is deleted.
+        BlockDecompressor* _decompressor;
+};
+
+BlockDecompressor::BlockDecompressor():
+    _codec(BlockCompression::STORED),
+    _blockSize(0),
+    _dataPtr(0),
+    _nextBlock(0),
+    _numContiguousBlocks(0),
+    _failed(false),
+    _cancelled(false)
+{
+}
+
+BlockDecompressor::~BlockDecompressor()
+{
+    stopThreads();
+}
+
+void BlockDecompressor::stopThreads()
+{
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        _cancelled = true;
+    }
+
+    for(WorkerThreads::iterator itr = _threads.begin();
+        itr != _threads.end();
+        ++itr)
+    {
+        (*itr)->join();
+        delete *itr;
+    }
+    _threads.clear();
+}
+
+bool BlockDecompressor::open(std::istream& fin, unsigned int numThreads)
+{
+    return open(0, 0, fin, numThreads);
+}
+
+bool BlockDecompressor::open(const char* prefix, unsigned int prefixSize, std::istream& fin, unsigned int numThreads)
+{
+    PrefixedReader reader(prefix, prefixSize, fin);
+
+    char header[BlockCompression::HEADER_SIZE];
+    if (!reader.read(header, BlockCompression::HEADER_SIZE) || !BlockCompression::isBlockCompressed(header, BlockCompression::HEADER_SIZE))
+    {
+        OSG_NOTIFY(osg::WARN)<<"BlockDecompressor::open() not a block compressed stream."<<std::endl;
+        return false;
+    }
+
+    unsigned int version = getUInt(header+4);
+    _codec = static_cast<BlockCompression::Codec>(getUInt(header+8));
+    _blockSize = getUInt(header+12);
+    unsigned int uncompressedSize = getUInt(header+16);
+    unsigned int numBlocks = getUInt(header+20);
+
+    if (version>CONTAINER_VERSION || !BlockCompression::isCodecSupported(_codec))
+    {
+        OSG_NOTIFY(osg::WARN)<<"BlockDecompressor::open() unsupported version "<<version<<" or codec "<<_codec<<std::endl;
+        return false;
+    }
+
+    if (_blockSize==0 || _blockSize>MAXIMUM_BLOCK_SIZE ||
+        numBlocks!=(uncompressedSize/_blockSize + ((uncompressedSize%_blockSize)!=0 ? 1 : 0)))
+    {
+        OSG_NOTIFY(osg::WARN)<<"BlockDecompressor::open() corrupt block table."<<std::endl;
+        return false;
+    }
+
+    std::string sizes(numBlocks*4, 0);
+    if (numBlocks>0 && !reader.read(&sizes[0], numBlocks*4)) return false;
+
+    _compressedOffsets.resize(numBlocks+1);
+    _compressedOffsets[0] = 0;
+    for(unsigned int i=0; i<numBlocks; ++i)
+    {
+        unsigned int compressedSize = getUInt(sizes.data()+i*4);
+        if (compressedSize>MAXIMUM_BLOCK_SIZE*2) return false;
+        _compressedOffsets[i+1] = _compressedOffsets[i] + compressedSize;
+    }
+
+    _compressed.resize(_compressedOffsets[numBlocks]);
+    if (!_compressed.empty() && !reader.read(&_compressed[0], static_cast<unsigned int>(_compressed.size())))
+    {
+        OSG_NOTIFY(osg::WARN)<<"BlockDecompressor::open() stream truncated."<<std::endl;
+        return false;
+    }
+
+    _data.resize(uncompressedSize);
+
+    // the non-const operator[] of a copy-on-write string writes to it, so the threads mustn't call it themselves.
+    _dataPtr = _data.empty() ? 0 : &_data[0];
+    _blockStates.assign(numBlocks, PENDING);
+    _nextBlock = 0;
+    _numContiguousBlocks = 0;
+    _failed = false;
+    _cancelled = false;
+
+    // the thread consuming the data decompresses blocks too, so only start extra threads when there's work for them.
+    if (numThreads==0) numThreads = BlockCompression::getDefaultNumThreads();
+    unsigned int numExtraThreads = numBlocks>1 ? osg::minimum(numThreads, numBlocks)-1 : 0;
+    for(unsigned int i=0; i<numExtraThreads; ++i)
+    {
+        WorkerThread* thread = new WorkerThread(this);
+        if (thread->start()==0) _threads.push_back(thread);
+        else delete thread;
+    }
+
+    return true;
+}
+
+bool BlockDecompressor::claimBlock(unsigned int& blockNum)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    if (_cancelled || _failed || _nextBlock>=_blockStates.size()) return false;
+
+    blockNum = _nextBlock++;
+    _blockStates[blockNum] = DECOMPRESSING;
+    return true;
+}
+
+void BlockDecompressor::decompressClaimedBlock(unsigned int blockNum)
+{
+    unsigned int offset = blockNum*_blockSize;
+    unsigned int size = osg::minimum(_blockSize, static_cast<unsigned int>(_data.size())-offset);
+    const char* src = _compressed.data() + _compressedOffsets[blockNum];
+    unsigned int srcSize = _compressedOffsets[blockNum+1]-_compressedOffsets[blockNum];
+
+    // each thread writes only its own block of _data, through _dataPtr, as _data is never resized while blocks are outstanding.
+    bool result = BlockCompression::decompressBlock(_codec, src, srcSize, _dataPtr+offset, size);
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    _blockStates[blockNum] = result ? DONE : FAILED;
+    if (!result)
+    {
+        OSG_NOTIFY(osg::WARN)<<"BlockDecompressor failed to decompress block "<<blockNum<<std::endl;
+        _failed = true;
+    }
+
+    while (_numContiguousBlocks<_blockStates.size() && _blockStates[_numContiguousBlocks]==DONE)
+    {
+        ++_numContiguousBlocks;
+    }
+
+    _blockDone.broadcast();
+}
+
+unsigned int BlockDecompressor::waitForData(unsigned int endOffset)
+{
+    unsigned int totalSize = static_cast<unsigned int>(_data.size());
+    if (endOffset>totalSize) endOffset = totalSize;
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    for(;;)
+    {
+        unsigned int available = osg::minimum(_numContiguousBlocks*_blockSize, totalSize);
+        if (available>=endOffset || _failed) return available;
+
+        if (_nextBlock<_blockStates.size())
+        {
+            // help out rather than wait.
+            unsigned int blockNum = _nextBlock++;
+            _blockStates[blockNum] = DECOMPRESSING;
+
+            _mutex.unlock();
+            decompressClaimedBlock(blockNum);
+            _mutex.lock();
+        }
+        else
+        {
+            _blockDone.wait(&_mutex);
+        }
+    }
+}
+
+bool BlockDecompressor::finish()
+{
+    unsigned int totalSize = static_cast<unsigned int>(_data.size());
+    bool result = waitForData(totalSize)>=totalSize;
+
+    // waitForData() returns as soon as a block fails, wait for the blocks still in flight before the threads go.
+    stopThreads();
+
+    return result;
+}
+
+bool BlockDecompressor::takeData(std::string& data)
+{
+    if (!finish()) return false;
+
+    data.swap(_data);
+    _data.clear();
+    _dataPtr = 0;
+    _compressed.clear();
+    _blockStates.clear();
+    _nextBlock = 0;
+    _numContiguousBlocks = 0;
+    return true;
+}
+
+bool BlockDecompressor::failed() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    return _failed;
+}
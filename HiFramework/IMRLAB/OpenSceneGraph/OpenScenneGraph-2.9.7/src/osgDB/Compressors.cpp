@@ -16,6 +16,7 @@
 #include <osgDB/Registry>
 #include <osgDB/Registry>
 #include <osgDB/ObjectWrapper>
+#include <osgDB/BlockCompression>
 #include <sstream>
 
 using namespace osgDB;
@@ -174,3 +175,92 @@ public:
 REGISTER_COMPRESSOR( "zlib", ZLibCompressor )
 
 #endif
+
+// Stream buffer handing out the data of a BlockDecompressor as each block is decompressed
+class BlockDecompressorStreamBuf : public std::streambuf
+{
+public:
+    BlockDecompressorStreamBuf( BlockDecompressor* decompressor ) : _decompressor(decompressor) {}
+    
+protected:
+    virtual int_type underflow()
+    {
+        if ( gptr()<egptr() ) return traits_type::to_int_type( *gptr() );
+        if ( !_decompressor ) return traits_type::eof();
+        
+        unsigned int offset = gptr() ? (unsigned int)(gptr()-eback()) : 0;
+        unsigned int available = _decompressor->waitForData( offset+1 );
+        if ( available<=offset ) return traits_type::eof();
+        
+        char* data = const_cast<char*>( _decompressor->getData() );
+        setg( data, data+offset, data+available );
+        return traits_type::to_int_type( *gptr() );
+    }
+    
+    osg::ref_ptr<BlockDecompressor> _decompressor;
+};
+
+class BlockDecompressorStream : public std::istream
+{
+public:
+    BlockDecompressorStream( BlockDecompressor* decompressor )
+    :   std::istream(0), _streamBuf(decompressor) { rdbuf(&_streamBuf); }
+    
+protected:
+    BlockDecompressorStreamBuf _streamBuf;
+};
+
+// Compressors writing independently compressed blocks, see osgDB::BlockCompression.
+// The blocks are compressed and decompressed on several threads, and reading starts with the first block.
+class BlockCompressor : public BaseCompressor
+{
+public:
+    BlockCompressor( BlockCompression::Codec codec ) : _codec(codec) {}
+    
+    virtual bool compress( std::ostream& fout, const std::string& src )
+    {
+        return BlockCompression::compress( fout, src.data(), src.size(), _codec );
+    }
+    
+    virtual bool decompress( std::istream& fin, std::string& target )
+    {
+        osg::ref_ptr<BlockDecompressor> decompressor = new BlockDecompressor;
+        if ( !decompressor->open(fin) ) return false;
+        return decompressor->takeData( target );
+    }
+    
+    virtual std::istream* createDecompressionStream( std::istream& fin )
+    {
+        osg::ref_ptr<BlockDecompressor> decompressor = new BlockDecompressor;
+        if ( !decompressor->open(fin) )
+        {
+            BlockDecompressorStream* stream = new BlockDecompressorStream(0);
+            stream->setstate( std::ios::failbit );
+            return stream;
+        }
+        return new BlockDecompressorStream( decompressor.get() );
+    }
+    
+protected:
+    BlockCompression::Codec _codec;
+};
+
+class LZ4BlockCompressor : public BlockCompressor
+{
+public:
+    LZ4BlockCompressor() : BlockCompressor(BlockCompression::LZ4) {}
+};
+
+REGISTER_COMPRESSOR( "lz4", LZ4BlockCompressor )
+
+#ifdef USE_ZLIB
+
+class ZLibBlockCompressor : public BlockCompressor
+{
+public:
+    ZLibBlockCompressor() : BlockCompressor(BlockCompression::ZLIB) {}
+};
+
+REGISTER_COMPRESSOR( "zlib_blocks", ZLibBlockCompressor )
+
+#endif
@@ -0,0 +1,556 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgDB/ObjectCache>
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Image>
+#include <osg/NodeVisitor>
+#include <osg/Notify>
+#include <osg/Texture>
+
+#include <set>
+
+using namespace osgDB;
+
+namespace
+{
+
+// Adds up the size of the data buffers reachable from a subgraph, counting shared buffers once.
+class ComputeSizeVisitor : public osg::NodeVisitor
+{
+public:
+
+    ComputeSizeVisitor():
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _sizeInBytes(0) {}
+
+    virtual void apply(osg::Node& node)
+    {
+        apply(node.getStateSet());
+        traverse(node);
+    }
+
+    virtual void apply(osg::Geode& geode)
+    {
+        apply(geode.getStateSet());
+
+        for(unsigned int i=0; i<geode.getNumDrawables(); ++i)
+        {
+            osg::Drawable* drawable = geode.getDrawable(i);
+            apply(drawable->getStateSet());
+
+            osg::Geometry* geometry = drawable->asGeometry();
+            if (geometry) apply(*geometry);
+        }
+    }
+
+    void apply(osg::Geometry& geometry)
+    {
+        apply(geometry.getVertexArray());
+        apply(geometry.getNormalArray());
+        apply(geometry.getColorArray());
+        apply(geometry.getSecondaryColorArray());
+        apply(geometry.getFogCoordArray());
+
+        for(unsigned int i=0; i<geometry.getNumTexCoordArrays(); ++i)
+        {
+            apply(geometry.getTexCoordArray(i));
+        }
+
+        for(unsigned int i=0; i<geometry.getNumVertexAttribArrays(); ++i)
+        {
+            apply(geometry.getVertexAttribArray(i));
+        }
+
+        for(unsigned int i=0; i<geometry.getNumPrimitiveSets(); ++i)
+        {
+            apply(geometry.getPrimitiveSet(i));
+        }
+    }
+
+    void apply(osg::StateSet* stateset)
+    {
+        if (!stateset) return;
+
+        const osg::StateSet::TextureAttributeList& tal = stateset->getTextureAttributeList();
+        for(osg::StateSet::TextureAttributeList::const_iterator titr=tal.begin();
+            titr!=tal.end();
+            ++titr)
+        {
+            for(osg::StateSet::AttributeList::const_iterator aitr=titr->begin();
+                aitr!=titr->end();
+                ++aitr)
+            {
+                osg::Texture* texture = aitr->second.first->asTexture();
+                if (!texture) continue;
+
+                for(unsigned int i=0; i<texture->getNumImages(); ++i)
+                {
+                    apply(texture->getImage(i));
+                }
+            }
+        }
+    }
+
+    void apply(const osg::BufferData* bufferData)
+    {
+        if (bufferData && _visited.insert(bufferData).second)
+        {
+            _sizeInBytes += bufferData->getTotalDataSize();
+        }
+    }
+
+    std::size_t                         _sizeInBytes;
+    std::set<const osg::BufferData*>    _visited;
+};
+
+}
+
+ObjectCache::ObjectCache(unsigned int numShards):
+    _maximumSizeInBytes(0),
+    _sizeInBytes(0)
+{
+    if (numShards==0) numShards = 1;
+
+    for(unsigned int i=0; i<numShards; ++i)
+    {
+        _shards.push_back(new Shard);
+    }
+}
+
+ObjectCache::~ObjectCache()
+{
+    for(Shards::iterator itr=_shards.begin();
+        itr!=_shards.end();
+        ++itr)
+    {
+        delete *itr;
+    }
+}
+
+ObjectCache::Shard& ObjectCache::getShard(const std::string& fileName) const
+{
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    for(std::string::const_iterator itr=fileName.begin();
+        itr!=fileName.end();
+        ++itr)
+    {
+        hash ^= static_cast<unsigned char>(*itr);
+        hash *= 16777619u;
+    }
+    return *_shards[hash % _shards.size()];
+}
+
+void ObjectCache::setMaximumSizeInBytes(std::size_t size)
+{
+    _maximumSizeInBytes = size;
+
+    if (_maximumSizeInBytes==0) return;
+
+    // objects added while there was no maximum haven't been sized yet.
+    for(Shards::iterator sitr=_shards.begin();
+        sitr!=_shards.end();
+        ++sitr)
+    {
+        Shard& shard = **sitr;
+
+        typedef std::vector< std::pair<std::string, osg::ref_ptr<osg::Object> > > UnsizedEntries;
+        UnsizedEntries unsizedEntries;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+            for(EntryMap::iterator itr=shard.entries.begin();
+                itr!=shard.entries.end();
+                ++itr)
+            {
+                if (!itr->second.sizeComputed) unsizedEntries.push_back(UnsizedEntries::value_type(itr->first, itr->second.object));
+            }
+        }
+
+        for(UnsizedEntries::iterator uitr=unsizedEntries.begin();
+            uitr!=unsizedEntries.end();
+            ++uitr)
+        {
+            // size the object outside the lock, then only store it if the entry hasn't been replaced in the meantime.
+            std::size_t sizeInBytes = computeSizeInBytes(uitr->second.get());
+
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+            EntryMap::iterator itr = shard.entries.find(uitr->first);
+            if (itr!=shard.entries.end() && !itr->second.sizeComputed && itr->second.object==uitr->second)
+            {
+                itr->second.sizeInBytes = sizeInBytes;
+                itr->second.sizeComputed = true;
+                shard.sizeInBytes += sizeInBytes;
+                adjustSizeInBytes(sizeInBytes, 0);
+            }
+        }
+    }
+
+    evict();
+}
+
+std::size_t ObjectCache::getSizeInBytes() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_sizeMutex);
+    return _sizeInBytes;
+}
+
+void ObjectCache::adjustSizeInBytes(std::size_t added, std::size_t removed)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_sizeMutex);
+    _sizeInBytes = _sizeInBytes + added - removed;
+}
+
+void ObjectCache::eraseEntry(Shard& shard, EntryMap::iterator itr, ObjectList& releasedObjects)
+{
+    releasedObjects.push_back(itr->second.object);
+    shard.sizeInBytes -= itr->second.sizeInBytes;
+    adjustSizeInBytes(0, itr->second.sizeInBytes);
+    shard.lruList.erase(itr->second.lruItr);
+    shard.entries.erase(itr);
+}
+
+ObjectCache::EntryMap::iterator ObjectCache::findLeastRecentlyUsedUnpinned(Shard& shard)
+{
+    for(LRUList::reverse_iterator litr=shard.lruList.rbegin();
+        litr!=shard.lruList.rend();
+        ++litr)
+    {
+        EntryMap::iterator eitr = shard.entries.find(*litr);
+        if (!eitr->second.pinned) return eitr;
+    }
+    return shard.entries.end();
+}
+
+void ObjectCache::evict()
+{
+    if (_maximumSizeInBytes==0) return;
+
+    // one thread evicts at a time, so that two threads don't both pick the same oldest entry and evict more than needed.
+    OpenThreads::ScopedLock<OpenThreads::Mutex> evictLock(_evictMutex);
+
+    while(getSizeInBytes()>_maximumSizeInBytes)
+    {
+        // each shard's list is in least recently used order, so the oldest entry in the cache is the oldest of the shards' tails.
+        Shard* oldestShard = 0;
+        unsigned int oldestLastUsed = 0;
+
+        for(Shards::iterator sitr=_shards.begin();
+            sitr!=_shards.end();
+            ++sitr)
+        {
+            Shard& shard = **sitr;
+
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+            EntryMap::iterator eitr = findLeastRecentlyUsedUnpinned(shard);
+            // compare the difference rather than the counts themselves so that the order survives the counter wrapping.
+            if (eitr!=shard.entries.end() && (!oldestShard || static_cast<int>(eitr->second.lastUsed - oldestLastUsed)<0))
+            {
+                oldestShard = &shard;
+                oldestLastUsed = eitr->second.lastUsed;
+            }
+        }
+
+        // everything left is pinned.
+        if (!oldestShard) break;
+
+        // released objects are unreferenced after the shard mutex is released.
+        ObjectList releasedObjects;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(oldestShard->mutex);
+
+        // the shard may have changed since it was scanned, in which case its current tail is evicted, which is still a good candidate.
+        EntryMap::iterator eitr = findLeastRecentlyUsedUnpinned(*oldestShard);
+        if (eitr==oldestShard->entries.end()) continue;
+
+        OSG_NOTIFY(osg::INFO)<<"ObjectCache : evicting "<<eitr->first<<std::endl;
+
+        eraseEntry(*oldestShard, eitr, releasedObjects);
+
+        ++oldestShard->numEvictions;
+    }
+}
+
+void ObjectCache::addEntryToObjectCache(const std::string& filename, osg::Object* object, double timestamp)
+{
+    // size the object before taking the lock, it may traverse a large subgraph, and don't bother when there is no maximum.
+    bool sizeComputed = _maximumSizeInBytes!=0;
+    std::size_t sizeInBytes = sizeComputed ? computeSizeInBytes(object) : 0;
+
+    Shard& shard = getShard(filename);
+
+    // released objects are unreferenced after the shard mutex is released, so that deleting them doesn't block other threads.
+    ObjectList releasedObjects;
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+        EntryMap::iterator itr = shard.entries.find(filename);
+        if (itr!=shard.entries.end())
+        {
+            releasedObjects.push_back(itr->second.object);
+            shard.sizeInBytes -= itr->second.sizeInBytes;
+            adjustSizeInBytes(0, itr->second.sizeInBytes);
+            shard.lruList.erase(itr->second.lruItr);
+        }
+        else
+        {
+            itr = shard.entries.insert(EntryMap::value_type(filename, Entry())).first;
+        }
+
+        Entry& entry = itr->second;
+        entry.object = object;
+        entry.timestamp = timestamp;
+        entry.lastUsed = ++_useCount;
+        entry.sizeInBytes = sizeInBytes;
+        entry.sizeComputed = sizeComputed;
+        entry.lruItr = shard.lruList.insert(shard.lruList.begin(), filename);
+
+        shard.sizeInBytes += sizeInBytes;
+        adjustSizeInBytes(sizeInBytes, 0);
+    }
+
+    evict();
+}
+
+osg::Object* ObjectCache::getFromObjectCache(const std::string& fileName)
+{
+    return getRefFromObjectCache(fileName).get();
+}
+
+osg::ref_ptr<osg::Object> ObjectCache::getRefFromObjectCache(const std::string& fileName)
+{
+    Shard& shard = getShard(fileName);
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+    EntryMap::iterator itr = shard.entries.find(fileName);
+    if (itr==shard.entries.end())
+    {
+        ++shard.numMisses;
+        return 0;
+    }
+
+    ++shard.numHits;
+
+    // move to the most recently used end.
+    shard.lruList.splice(shard.lruList.begin(), shard.lruList, itr->second.lruItr);
+    itr->second.lastUsed = ++_useCount;
+
+    return itr->second.object;
+}
+
+void ObjectCache::removeFromObjectCache(const std::string& fileName)
+{
+    Shard& shard = getShard(fileName);
+
+    ObjectList releasedObjects;
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+    EntryMap::iterator itr = shard.entries.find(fileName);
+    if (itr!=shard.entries.end()) eraseEntry(shard, itr, releasedObjects);
+}
+
+bool ObjectCache::setPinned(const std::string& fileName, bool pinned)
+{
+    Shard& shard = getShard(fileName);
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+        EntryMap::iterator itr = shard.entries.find(fileName);
+        if (itr==shard.entries.end()) return false;
+
+        itr->second.pinned = pinned;
+    }
+
+    // unpinning may leave the cache over its maximum size.
+    if (!pinned) evict();
+
+    return true;
+}
+
+bool ObjectCache::getPinned(const std::string& fileName) const
+{
+    Shard& shard = getShard(fileName);
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+    EntryMap::const_iterator itr = shard.entries.find(fileName);
+    return itr!=shard.entries.end() && itr->second.pinned;
+}
+
+void ObjectCache::updateTimeStampOfObjectsInCacheWithExternalReferences(double referenceTime)
+{
+    for(Shards::iterator sitr=_shards.begin();
+        sitr!=_shards.end();
+        ++sitr)
+    {
+        Shard& shard = **sitr;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+        // look for objects with external references and update their time stamp.
+        for(EntryMap::iterator itr=shard.entries.begin();
+            itr!=shard.entries.end();
+            ++itr)
+        {
+            // if ref count is greater the 1 the object has an external reference.
+            if (itr->second.object->referenceCount()>1)
+            {
+                // so update it time stamp.
+                itr->second.timestamp = referenceTime;
+            }
+        }
+    }
+}
+
+void ObjectCache::removeExpiredObjectsInCache(double expiryTime)
+{
+    for(Shards::iterator sitr=_shards.begin();
+        sitr!=_shards.end();
+        ++sitr)
+    {
+        Shard& shard = **sitr;
+
+        ObjectList releasedObjects;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+        for(EntryMap::iterator itr=shard.entries.begin();
+            itr!=shard.entries.end();)
+        {
+            if (itr->second.timestamp<=expiryTime && !itr->second.pinned)
+            {
+                eraseEntry(shard, itr++, releasedObjects);
+                ++shard.numExpired;
+            }
+            else
+            {
+                ++itr;
+            }
+        }
+    }
+}
+
+void ObjectCache::clear()
+{
+    for(Shards::iterator sitr=_shards.begin();
+        sitr!=_shards.end();
+        ++sitr)
+    {
+        Shard& shard = **sitr;
+
+        EntryMap entries;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+            entries.swap(shard.entries);
+            shard.lruList.clear();
+            adjustSizeInBytes(0, shard.sizeInBytes);
+            shard.sizeInBytes = 0;
+        }
+    }
+}
+
+void ObjectCache::releaseGLObjects(osg::State* state)
+{
+    for(Shards::iterator sitr=_shards.begin();
+        sitr!=_shards.end();
+        ++sitr)
+    {
+        Shard& shard = **sitr;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+        for(EntryMap::iterator itr=shard.entries.begin();
+            itr!=shard.entries.end();
+            ++itr)
+        {
+            itr->second.object->releaseGLObjects(state);
+        }
+    }
+}
+
+std::size_t ObjectCache::computeSizeInBytes(const osg::Object* object) const
+{
+    if (!object) return 0;
+
+    const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+    if (image) return image->getTotalSizeInBytesIncludingMipmaps();
+
+    const osg::Node* node = dynamic_cast<const osg::Node*>(object);
+    if (node)
+    {
+        // the visitor only reads the subgraph.
+        ComputeSizeVisitor csv;
+        const_cast<osg::Node*>(node)->accept(csv);
+        return csv._sizeInBytes;
+    }
+
+    const osg::BufferData* bufferData = dynamic_cast<const osg::BufferData*>(object);
+    if (bufferData) return bufferData->getTotalDataSize();
+
+    return 0;
+}
+
+ObjectCache::Statistics ObjectCache::getStatistics() const
+{
+    Statistics stats;
+
+    for(Shards::const_iterator sitr=_shards.begin();
+        sitr!=_shards.end();
+        ++sitr)
+    {
+        const Shard& shard = **sitr;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+        stats.numHits += shard.numHits;
+        stats.numMisses += shard.numMisses;
+        stats.numEvictions += shard.numEvictions;
+        stats.numExpired += shard.numExpired;
+        stats.numObjects += static_cast<unsigned int>(shard.entries.size());
+        stats.sizeInBytes += shard.sizeInBytes;
+
+        for(EntryMap::const_iterator itr=shard.entries.begin();
+            itr!=shard.entries.end();
+            ++itr)
+        {
+            if (itr->second.pinned) ++stats.numPinnedObjects;
+        }
+    }
+
+    return stats;
+}
+
+void ObjectCache::resetStatistics()
+{
+    for(Shards::iterator sitr=_shards.begin();
+        sitr!=_shards.end();
+        ++sitr)
+    {
+        Shard& shard = **sitr;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard.mutex);
+
+        shard.numHits = 0;
+        shard.numMisses = 0;
+        shard.numEvictions = 0;
+        shard.numExpired = 0;
+    }
+}
@@ -147,7 +147,10 @@ DataInputStream::DataInputStream(std::istream* istream, const osgDB::ReaderWrite
     _verboseOutput = false;
 
     _istream = istream;
-    _owns_istream = false;
+    _bufferPtr = 0;
+    _bufferEnd = 0;
+    _bufferIsComplete = false;
+    _failed = false;
     _peeking = false;
     _peekValue = 0;
     _byteswap = 0;
@@ -186,23 +189,43 @@ DataInputStream::DataInputStream(std::istream* istream, const osgDB::ReaderWrite
     {
         int compressionLevel = readInt();
         
-        if (compressionLevel>0)
+        if (compressionLevel==2)
+        {
+            OSG_NOTIFY(osg::INFO)<<"block compressed ive stream"<<std::endl;
+            
+            // the blocks are decompressed on worker threads while parsing starts on the first of them.
+            _blockDecompressor = new osgDB::BlockDecompressor;
+            if (!_blockDecompressor->open(_bufferPtr, static_cast<unsigned int>(_bufferEnd-_bufferPtr), *istream))
+            {
+                throwException("Error in uncompressing .ive");
+                return;
+            }
+            
+            _bufferPtr = _bufferEnd = _blockDecompressor->getData();
+        }
+        else if (compressionLevel>0)
         {
             OSG_NOTIFY(osg::INFO)<<"compressed ive stream"<<std::endl;
             
             unsigned int maxSize = readUInt();
             
+            // reading the header may have pulled the start of the compressed data into the read buffer, so
+            // inflate that followed by the rest of the istream, then parse the inflated data in place.
+            std::string compressed(_bufferPtr, _bufferEnd);
+            std::istringstream compressedStart(compressed);
             std::string data;
-            data.reserve(maxSize);
+            data.resize(maxSize);
             
-            if (!uncompress(*istream, data))
+            if (!uncompress(compressedStart, *istream, data))
             {
                 throwException("Error in uncompressing .ive");
                 return;
             }
             
-            _istream = new std::stringstream(data);
-            _owns_istream = true;
+            _buffer.swap(data);
+            _bufferPtr = _buffer.data();
+            _bufferEnd = _bufferPtr + _buffer.size();
+            _bufferIsComplete = true;
         }
         else
         {
@@ -213,7 +236,133 @@ DataInputStream::DataInputStream(std::istream* istream, const osgDB::ReaderWrite
 
 DataInputStream::~DataInputStream()
 {
-    if (_owns_istream) delete _istream;
+}
+
+namespace
+{
+
+// Byte swap whole arrays with plain integer shifts on aligned copies, a form compilers turn into vector
+// shuffles, rather than calling osg::swapBytes per element.
+inline void swapBytesArray2(char* data, unsigned int numElements)
+{
+    for(unsigned int i=0; i<numElements; ++i, data+=2)
+    {
+        unsigned short v;
+        memcpy(&v, data, 2);
+        v = static_cast<unsigned short>((v>>8) | (v<<8));
+        memcpy(data, &v, 2);
+    }
+}
+
+inline void swapBytesArray4(char* data, unsigned int numElements)
+{
+    for(unsigned int i=0; i<numElements; ++i, data+=4)
+    {
+        unsigned int v;
+        memcpy(&v, data, 4);
+        v = (v>>24) | ((v>>8)&0x0000ff00u) | ((v<<8)&0x00ff0000u) | (v<<24);
+        memcpy(data, &v, 4);
+    }
+}
+
+inline void swapBytesArray8(char* data, unsigned int numElements)
+{
+    for(unsigned int i=0; i<numElements; ++i, data+=8)
+    {
+        unsigned int lo, hi;
+        memcpy(&lo, data, 4);
+        memcpy(&hi, data+4, 4);
+        lo = (lo>>24) | ((lo>>8)&0x0000ff00u) | ((lo<<8)&0x00ff0000u) | (lo<<24);
+        hi = (hi>>24) | ((hi>>8)&0x0000ff00u) | ((hi<<8)&0x00ff0000u) | (hi<<24);
+        memcpy(data, &hi, 4);
+        memcpy(data+4, &lo, 4);
+    }
+}
+
+}
+
+bool DataInputStream::readDataSlow(char* data, unsigned int size)
+{
+    // use up what is left in the buffer.
+    unsigned int available = static_cast<unsigned int>(_bufferEnd-_bufferPtr);
+    if (available>0)
+    {
+        memcpy(data, _bufferPtr, available);
+        _bufferPtr += available;
+        data += available;
+        size -= available;
+    }
+
+    if (_blockDecompressor.valid())
+    {
+        const char* data_start = _blockDecompressor->getData();
+        unsigned int offset = static_cast<unsigned int>(_bufferPtr-data_start);
+        _bufferEnd = data_start + _blockDecompressor->waitForData(offset+size);
+
+        if (size>static_cast<unsigned int>(_bufferEnd-_bufferPtr))
+        {
+            _bufferPtr = _bufferEnd;
+            _failed = true;
+            return false;
+        }
+
+        memcpy(data, _bufferPtr, size);
+        _bufferPtr += size;
+        return true;
+    }
+
+    if (_bufferIsComplete || !_istream)
+    {
+        _failed = true;
+        return false;
+    }
+
+    // large reads go straight into the destination, small ones refill the buffer.
+    const unsigned int blockSize = 65536;
+    if (size>=blockSize)
+    {
+        _istream->read(data, size);
+        if (static_cast<unsigned int>(_istream->gcount())!=size)
+        {
+            _failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    _buffer.resize(blockSize);
+    _istream->read(&_buffer[0], blockSize);
+    unsigned int numRead = static_cast<unsigned int>(_istream->gcount());
+    _bufferPtr = _buffer.data();
+    _bufferEnd = _bufferPtr + numRead;
+
+    if (numRead<size)
+    {
+        _bufferPtr = _bufferEnd;
+        _failed = true;
+        return false;
+    }
+
+    memcpy(data, _bufferPtr, size);
+    _bufferPtr += size;
+    return true;
+}
+
+bool DataInputStream::readArrayData(void* data, unsigned int numElements, unsigned int elementSize)
+{
+    if (!readData(static_cast<char*>(data), numElements*elementSize)) return false;
+
+    if (_byteswap)
+    {
+        switch(elementSize)
+        {
+            case 2: swapBytesArray2(static_cast<char*>(data), numElements); break;
+            case 4: swapBytesArray4(static_cast<char*>(data), numElements); break;
+            case 8: swapBytesArray8(static_cast<char*>(data), numElements); break;
+            default: break;
+        }
+    }
+    return true;
 }
 
 #ifdef USE_ZLIB
@@ -221,15 +370,19 @@ DataInputStream::~DataInputStream()
 #include <zlib.h>
 
 bool DataInputStream::uncompress(std::istream& fin, std::string& destination) const
+{
+    std::istringstream empty;
+    return uncompress(empty, fin, destination);
+}
+
+bool DataInputStream::uncompress(std::istream& fin_start, std::istream& fin, std::string& destination) const
 {
     //#define CHUNK 16384
     #define CHUNK 32768
 
     int ret;
-    unsigned have;
     z_stream strm;
     unsigned char in[CHUNK];
-    unsigned char out[CHUNK];
     
     /* allocate inflate state */
     strm.zalloc = Z_NULL;
@@ -246,11 +399,19 @@ bool DataInputStream::uncompress(std::istream& fin, std::string& destination) co
         return ret != 0;
     }
     
+    // inflate directly into the destination, which the caller sizes to the expected uncompressed size.
+    std::string::size_type size = 0;
+    if (destination.size()<CHUNK) destination.resize(CHUNK);
+
     /* decompress until deflate stream ends or end of file */
     do {
-        //strm.avail_in = fin.readsome((char*)in, CHUNK);
-        fin.read((char *)in, CHUNK);
-        strm.avail_in = fin.gcount();
+        fin_start.read((char *)in, CHUNK);
+        strm.avail_in = fin_start.gcount();
+        if (strm.avail_in == 0)
+        {
+            fin.read((char *)in, CHUNK);
+            strm.avail_in = fin.gcount();
+        }
         
         if (strm.avail_in == 0)
         {
@@ -260,8 +421,10 @@ bool DataInputStream::uncompress(std::istream& fin, std::string& destination) co
 
         /* run inflate() on input until output buffer not full */
         do {
-            strm.avail_out = CHUNK;
-            strm.next_out = out;
+            if (size==destination.size()) destination.resize(destination.size()*2);
+
+            strm.avail_out = static_cast<uInt>(destination.size()-size);
+            strm.next_out = (Bytef*)&destination[size];
             ret = inflate(&strm, Z_NO_FLUSH);
 
             switch (ret) {
@@ -271,9 +434,7 @@ bool DataInputStream::uncompress(std::istream& fin, std::string& destination) co
                 (void)inflateEnd(&strm);
                 return false;
             }
-            have = CHUNK - strm.avail_out;
-
-            destination.append((char*)out, have);
+            size = destination.size() - strm.avail_out;
             
         } while (strm.avail_out == 0);
 
@@ -282,6 +443,8 @@ bool DataInputStream::uncompress(std::istream& fin, std::string& destination) co
 
     /* clean up and return */
     (void)inflateEnd(&strm);
+
+    destination.resize(size);
     
     return ret == Z_STREAM_END ? true : false;
 }
@@ -290,13 +453,16 @@ bool DataInputStream::uncompress(std::istream& fin, std::string& destination) co
 {
     return false;
 }
+
+bool DataInputStream::uncompress(std::istream& fin_start, std::istream& fin, std::string& destination) const
+{
+    return false;
+}
 #endif
 
 bool DataInputStream::readBool(){
     char c;
-    _istream->read(&c, CHARSIZE);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readData(&c, CHARSIZE))
         throwException("DataInputStream::readBool(): Failed to read boolean value.");
 
     if (_verboseOutput) std::cout<<"read/writeBool() ["<<(int)c<<"]"<<std::endl;
@@ -306,9 +472,7 @@ bool DataInputStream::readBool(){
 
 char DataInputStream::readChar(){
     char c;
-    _istream->read(&c, CHARSIZE);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readData(&c, CHARSIZE))
         throwException("DataInputStream::readChar(): Failed to read char value.");
 
     if (_verboseOutput) std::cout<<"read/writeChar() ["<<(int)c<<"]"<<std::endl;
@@ -318,9 +482,7 @@ char DataInputStream::readChar(){
 
 unsigned char DataInputStream::readUChar(){
     unsigned char c;
-    _istream->read((char*)&c, CHARSIZE);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readData((char*)&c, CHARSIZE))
         throwException("DataInputStream::readUChar(): Failed to read unsigned char value.");
 
     if (_verboseOutput) std::cout<<"read/writeUChar() ["<<(int)c<<"]"<<std::endl;
@@ -330,8 +492,7 @@ unsigned char DataInputStream::readUChar(){
 
 unsigned short DataInputStream::readUShort(){
     unsigned short s;
-    _istream->read((char*)&s, SHORTSIZE);
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readData((char*)&s, SHORTSIZE))
         throwException("DataInputStream::readUShort(): Failed to read unsigned short value.");
 
     if (_verboseOutput) std::cout<<"read/writeUShort() ["<<s<<"]"<<std::endl;
@@ -343,9 +504,7 @@ unsigned short DataInputStream::readUShort(){
 
 unsigned int DataInputStream::readUInt(){
     unsigned int s;
-    _istream->read((char*)&s, INTSIZE);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readData((char*)&s, INTSIZE))
         throwException("DataInputStream::readUInt(): Failed to read unsigned int value.");
 
     if (_byteswap) osg::swapBytes((char *)&s,INTSIZE) ;
@@ -361,7 +520,7 @@ int DataInputStream::readInt(){
         return _peekValue;
     }
     int i;
-    _istream->read((char*)&i, INTSIZE);
+    readData((char*)&i, INTSIZE);
 
     // comment out for time being as this check seems to eroneously cause a
     // premature exit when reading .ive files under OSX!#?:!
@@ -393,8 +552,7 @@ int DataInputStream::peekInt(){
 
 float DataInputStream::readFloat(){
     float f;
-    _istream->read((char*)&f, FLOATSIZE);
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readData((char*)&f, FLOATSIZE))
         throwException("DataInputStream::readFloat(): Failed to read float value.");
 
     if (_byteswap) osg::swapBytes((char *)&f,FLOATSIZE) ;
@@ -405,8 +563,7 @@ float DataInputStream::readFloat(){
 
 long DataInputStream::readLong(){
     long l;
-    _istream->read((char*)&l, LONGSIZE);
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readData((char*)&l, LONGSIZE))
         throwException("DataInputStream::readLong(): Failed to read long value.");
 
     if (_byteswap) osg::swapBytes((char *)&l,LONGSIZE) ;
@@ -417,8 +574,7 @@ long DataInputStream::readLong(){
 
 unsigned long DataInputStream::readULong(){
     unsigned long l;
-    _istream->read((char*)&l, LONGSIZE);
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readData((char*)&l, LONGSIZE))
         throwException("DataInputStream::readULong(): Failed to read unsigned long value.");
 
     if (_byteswap) osg::swapBytes((char *)&l,LONGSIZE) ;
@@ -431,8 +587,7 @@ unsigned long DataInputStream::readULong(){
 double DataInputStream::readDouble()
 {
     double d;
-    _istream->read((char*)&d, DOUBLESIZE);
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readData((char*)&d, DOUBLESIZE))
         throwException("DataInputStream::readDouble(): Failed to read double value.");
 
     if (_byteswap) osg::swapBytes((char *)&d,DOUBLESIZE) ;
@@ -447,7 +602,7 @@ std::string DataInputStream::readString()
     if (size != 0)
     {
         s.resize(size);
-        _istream->read((char*)s.c_str(), size);
+        readData(&s[0], size);
         //if (_istream->rdstate() & _istream->failbit)
         //   throwException("DataInputStream::readString(): Failed to read string value.");
 
@@ -459,8 +614,7 @@ std::string DataInputStream::readString()
 
 void DataInputStream::readCharArray(char* data, int size)
 {
-    _istream->read(data, size);
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readData(data, size))
         throwException("DataInputStream::readCharArray(): Failed to read char value.");
 
     if (_verboseOutput) std::cout<<"read/writeCharArray() ["<<data<<"]"<<std::endl;
@@ -637,9 +791,7 @@ osg::IntArray* DataInputStream::readIntArray()
     
     osg::ref_ptr<osg::IntArray> a = new osg::IntArray(size);
 
-    _istream->read((char*)&((*a)[0]), INTSIZE*size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size, INTSIZE))
     {
         throwException("DataInputStream::readIntArray(): Failed to read Int array.");
         return 0;
@@ -647,10 +799,6 @@ osg::IntArray* DataInputStream::readIntArray()
 
     if (_verboseOutput) std::cout<<"read/writeIntArray() ["<<size<<"]"<<std::endl;
 
-    if (_byteswap) {
-       for (int  i = 0 ; i < size ; i++ ) osg::swapBytes((char *)&((*a)[i]),INTSIZE) ;
-    }
-
     return a.release();
 }
 
@@ -659,12 +807,10 @@ osg::UByteArray* DataInputStream::readUByteArray()
     int size = readInt();
     if (size == 0)
         return NULL;
-
+    
     osg::ref_ptr<osg::UByteArray> a = new osg::UByteArray(size);
 
-    _istream->read((char*)&((*a)[0]), CHARSIZE*size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size, CHARSIZE))
     {
         throwException("DataInputStream::readUByteArray(): Failed to read UByte array.");
         return 0;
@@ -683,9 +829,7 @@ osg::UShortArray* DataInputStream::readUShortArray()
     
     osg::ref_ptr<osg::UShortArray> a = new osg::UShortArray(size);
 
-    _istream->read((char*)&((*a)[0]), SHORTSIZE*size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size, SHORTSIZE))
     {
         throwException("DataInputStream::readUShortArray(): Failed to read UShort array.");
         return 0;
@@ -693,11 +837,6 @@ osg::UShortArray* DataInputStream::readUShortArray()
 
     if (_verboseOutput) std::cout<<"read/writeUShortArray() ["<<size<<"]"<<std::endl;
 
-    if (_byteswap)
-    {
-        for (int i = 0 ; i < size ; i++ )
-            osg::swapBytes((char *)&((*a)[i]),SHORTSIZE) ;
-    }
     return a.release();
 }
 
@@ -709,9 +848,7 @@ osg::UIntArray* DataInputStream::readUIntArray()
     
     osg::ref_ptr<osg::UIntArray> a = new osg::UIntArray(size);
 
-    _istream->read((char*)&((*a)[0]), INTSIZE*size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size, INTSIZE))
     {
         throwException("DataInputStream::readUIntArray(): Failed to read UInt array.");
         return 0;
@@ -719,11 +856,6 @@ osg::UIntArray* DataInputStream::readUIntArray()
 
     if (_verboseOutput) std::cout<<"read/writeUIntArray() ["<<size<<"]"<<std::endl;
 
-    if (_byteswap)
-    {
-        for (int i = 0 ; i < size ; i++ )
-            osg::swapBytes((char *)&((*a)[i]),INTSIZE) ;
-    }
     return a.release();
 }
 
@@ -735,9 +867,7 @@ osg::Vec4ubArray* DataInputStream::readVec4ubArray()
     
     osg::ref_ptr<osg::Vec4ubArray> a = new osg::Vec4ubArray(size);
 
-    _istream->read((char*)&((*a)[0]), INTSIZE*size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size*4, CHARSIZE))
     {
         throwException("DataInputStream::readVec4ubArray(): Failed to read Vec4ub array.");
         return 0;
@@ -778,10 +908,12 @@ bool DataInputStream::readPackedFloatArray(osg::FloatArray* a)
             float byteMultiplier = 255.0f/(maxValue-minValue);
             float byteInvMultiplier = 1.0f/byteMultiplier;
 
+            std::vector<unsigned char> byte_values(size);
+            readArrayData(&byte_values[0], size, CHARSIZE);
+
             for(int i=0; i<size; ++i)
             {
-                unsigned char byte_value = readUChar();
-                float value = minValue + float(byte_value)*byteInvMultiplier;
+                float value = minValue + float(byte_values[i])*byteInvMultiplier;
                 (*a)[i] = value;
             }
         }
@@ -793,23 +925,22 @@ bool DataInputStream::readPackedFloatArray(osg::FloatArray* a)
             float shortMultiplier = 65535.0f/(maxValue-minValue);
             float shortInvMultiplier = 1.0f/shortMultiplier;
 
+            std::vector<unsigned short> short_values(size);
+            readArrayData(&short_values[0], size, SHORTSIZE);
+
             for(int i=0; i<size; ++i)
             {
-                unsigned short short_value = readUShort();
-                float value = minValue + float(short_value)*shortInvMultiplier;
+                float value = minValue + float(short_values[i])*shortInvMultiplier;
                 (*a)[i] = value;
             }
         }
         else
         {
-            for(int i=0; i<size; ++i)
-            {
-                (*a)[i] = readFloat();
-            }
+            readArrayData(&((*a)[0]), size, FLOATSIZE);
         }        
     }
     
-    if (_istream->rdstate() & _istream->failbit)
+    if (failed())
     {
         throwException("DataInputStream::readFloatArray(): Failed to read float array.");
         return false;
@@ -826,12 +957,10 @@ osg::FloatArray* DataInputStream::readFloatArray()
     int size = readInt();
     if (size == 0)
         return NULL;
-
+    
     osg::ref_ptr<osg::FloatArray> a = new osg::FloatArray(size);
 
-    _istream->read((char*)&((*a)[0]), FLOATSIZE*size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size, FLOATSIZE))
     {
         throwException("DataInputStream::readFloatArray(): Failed to read float array.");
         return 0;
@@ -839,11 +968,6 @@ osg::FloatArray* DataInputStream::readFloatArray()
 
     if (_verboseOutput) std::cout<<"read/writeFloatArray() ["<<size<<"]"<<std::endl;
 
-    if (_byteswap)
-    {
-        for (int i = 0 ; i < size ; i++ )
-            osg::swapBytes((char *)&((*a)[i]),FLOATSIZE) ;
-    }
     return a.release();
 }
 
@@ -852,12 +976,10 @@ osg::Vec2Array* DataInputStream::readVec2Array()
     int size = readInt();
     if (size == 0)
         return NULL;
-
+    
     osg::ref_ptr<osg::Vec2Array> a = new osg::Vec2Array(size);
 
-    _istream->read((char*)&((*a)[0]), FLOATSIZE*2*size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size*2, FLOATSIZE))
     {
         throwException("DataInputStream::readVec2Array(): Failed to read Vec2 array.");
         return 0;
@@ -865,14 +987,6 @@ osg::Vec2Array* DataInputStream::readVec2Array()
 
     if (_verboseOutput) std::cout<<"read/writeVec2Array() ["<<size<<"]"<<std::endl;
 
-    if (_byteswap)
-    {
-       float *ptr = (float*)&((*a)[0]) ;
-       for (int i = 0 ; i < size*2 ; i++ )
-       {
-          osg::swapBytes((char *)&(ptr[i]), FLOATSIZE) ;
-       }
-    }
     return a.release();
 }
 
@@ -884,9 +998,7 @@ osg::Vec3Array* DataInputStream::readVec3Array()
     
     osg::ref_ptr<osg::Vec3Array> a = new osg::Vec3Array(size);
 
-    _istream->read((char*)&((*a)[0]), FLOATSIZE*3*size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size*3, FLOATSIZE))
     {
         throwException("DataInputStream::readVec3Array(): Failed to read Vec3 array.");
         return 0;
@@ -894,28 +1006,18 @@ osg::Vec3Array* DataInputStream::readVec3Array()
 
     if (_verboseOutput) std::cout<<"read/writeVec3Array() ["<<size<<"]"<<std::endl;
 
-
-    if (_byteswap)
-    {
-       float *ptr = (float*)&((*a)[0]) ;
-       for (int i = 0 ; i < size*3 ; i++ )
-       {
-          osg::swapBytes((char *)&(ptr[i]),FLOATSIZE) ;
-       }
-    }
     return a.release();
 }
 
-osg::Vec4Array* DataInputStream::readVec4Array(){
+osg::Vec4Array* DataInputStream::readVec4Array()
+{
     int size = readInt();
     if (size == 0)
         return NULL;
     
     osg::ref_ptr<osg::Vec4Array> a = new osg::Vec4Array(size);
 
-    _istream->read((char*)&((*a)[0]), FLOATSIZE*4*size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size*4, FLOATSIZE))
     {
         throwException("DataInputStream::readVec4Array(): Failed to read Vec4 array.");
         return 0;
@@ -923,12 +1025,6 @@ osg::Vec4Array* DataInputStream::readVec4Array(){
 
     if (_verboseOutput) std::cout<<"read/writeVec4Array() ["<<size<<"]"<<std::endl;
 
-    if (_byteswap) {
-       float *ptr = (float*)&((*a)[0]) ;
-       for (int i = 0 ; i < size*4 ; i++ ) {
-          osg::swapBytes((char *)&(ptr[i]),FLOATSIZE) ;
-       }
-    }
     return a.release();
 }
 
@@ -940,9 +1036,7 @@ osg::Vec2bArray* DataInputStream::readVec2bArray()
     
     osg::ref_ptr<osg::Vec2bArray> a = new osg::Vec2bArray(size);
 
-    _istream->read((char*)&((*a)[0]), CHARSIZE * 2 * size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size*2, CHARSIZE))
     {
         throwException("DataInputStream::readVec2bArray(): Failed to read Vec2b array.");
         return 0;
@@ -961,9 +1055,7 @@ osg::Vec3bArray* DataInputStream::readVec3bArray()
     
     osg::ref_ptr<osg::Vec3bArray> a = new osg::Vec3bArray(size);
 
-    _istream->read((char*)&((*a)[0]), CHARSIZE * 3 * size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size*3, CHARSIZE))
     {
         throwException("DataInputStream::readVec3bArray(): Failed to read Vec3b array.");
         return 0;
@@ -982,9 +1074,7 @@ osg::Vec4bArray* DataInputStream::readVec4bArray()
     
     osg::ref_ptr<osg::Vec4bArray> a = new osg::Vec4bArray(size);
 
-    _istream->read((char*)&((*a)[0]), CHARSIZE * 4 * size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size*4, CHARSIZE))
     {
         throwException("DataInputStream::readVec4bArray(): Failed to read Vec4b array.");
         return 0;
@@ -1003,9 +1093,7 @@ osg::Vec2sArray* DataInputStream::readVec2sArray()
     
     osg::ref_ptr<osg::Vec2sArray> a = new osg::Vec2sArray(size);
 
-    _istream->read((char*)&((*a)[0]), SHORTSIZE * 2 * size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size*2, SHORTSIZE))
     {
         throwException("DataInputStream::readVec2sArray(): Failed to read Vec2s array.");
         return 0;
@@ -1013,15 +1101,6 @@ osg::Vec2sArray* DataInputStream::readVec2sArray()
 
     if (_verboseOutput) std::cout<<"read/writeVec2sArray() ["<<size<<"]"<<std::endl;
 
-    if (_byteswap)
-    {
-       short *ptr = (short*)&((*a)[0]) ;
-       for (int i = 0 ; i < size*2 ; i++ )
-       {
-          osg::swapBytes((char *)&(ptr[i]), SHORTSIZE) ;
-       }
-    }
-
     return a.release();
 }
 
@@ -1033,9 +1112,7 @@ osg::Vec3sArray* DataInputStream::readVec3sArray()
     
     osg::ref_ptr<osg::Vec3sArray> a = new osg::Vec3sArray(size);
 
-    _istream->read((char*)&((*a)[0]), SHORTSIZE * 3 * size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size*3, SHORTSIZE))
     {
         throwException("DataInputStream::readVec3sArray(): Failed to read Vec3s array.");
         return 0;
@@ -1043,16 +1120,6 @@ osg::Vec3sArray* DataInputStream::readVec3sArray()
 
     if (_verboseOutput) std::cout<<"read/writeVec3sArray() ["<<size<<"]"<<std::endl;
 
-
-    if (_byteswap)
-    {
-       short *ptr = (short*)&((*a)[0]) ;
-       for (int i = 0 ; i < size*3 ; i++ )
-       {
-          osg::swapBytes((char *)&(ptr[i]), SHORTSIZE) ;
-       }
-    }
-
     return a.release();
 }
 
@@ -1064,9 +1131,7 @@ osg::Vec4sArray* DataInputStream::readVec4sArray()
     
     osg::ref_ptr<osg::Vec4sArray> a = new osg::Vec4sArray(size);
 
-    _istream->read((char*)&((*a)[0]), SHORTSIZE * 4 * size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size*4, SHORTSIZE))
     {
         throwException("DataInputStream::readVec4sArray(): Failed to read Vec4s array.");
         return 0;
@@ -1074,15 +1139,6 @@ osg::Vec4sArray* DataInputStream::readVec4sArray()
 
     if (_verboseOutput) std::cout<<"read/writeVec4sArray() ["<<size<<"]"<<std::endl;
 
-    if (_byteswap)
-    {
-       short *ptr = (short*)&((*a)[0]) ;
-       for (int i = 0 ; i < size*4 ; i++ )
-       {
-          osg::swapBytes((char *)&(ptr[i]), SHORTSIZE) ;
-       }
-    }
-
     return a.release();
 }
 
@@ -1091,12 +1147,10 @@ osg::Vec2dArray* DataInputStream::readVec2dArray()
     int size = readInt();
     if (size == 0)
         return NULL;
-
+    
     osg::ref_ptr<osg::Vec2dArray> a = new osg::Vec2dArray(size);
 
-    _istream->read((char*)&((*a)[0]), DOUBLESIZE*2*size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size*2, DOUBLESIZE))
     {
         throwException("DataInputStream::readVec2dArray(): Failed to read Vec2d array.");
         return 0;
@@ -1104,14 +1158,6 @@ osg::Vec2dArray* DataInputStream::readVec2dArray()
 
     if (_verboseOutput) std::cout<<"read/writeVec2dArray() ["<<size<<"]"<<std::endl;
 
-    if (_byteswap)
-    {
-       double *ptr = (double*)&((*a)[0]) ;
-       for (int i = 0 ; i < size*2 ; i++ )
-       {
-          osg::swapBytes((char *)&(ptr[i]), DOUBLESIZE) ;
-       }
-    }
     return a.release();
 }
 
@@ -1123,9 +1169,7 @@ osg::Vec3dArray* DataInputStream::readVec3dArray()
     
     osg::ref_ptr<osg::Vec3dArray> a = new osg::Vec3dArray(size);
 
-    _istream->read((char*)&((*a)[0]), DOUBLESIZE*3*size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size*3, DOUBLESIZE))
     {
         throwException("DataInputStream::readVec3dArray(): Failed to read Vec3d array.");
         return 0;
@@ -1133,28 +1177,18 @@ osg::Vec3dArray* DataInputStream::readVec3dArray()
 
     if (_verboseOutput) std::cout<<"read/writeVec3dArray() ["<<size<<"]"<<std::endl;
 
-
-    if (_byteswap)
-    {
-       double *ptr = (double*)&((*a)[0]) ;
-       for (int i = 0 ; i < size*3 ; i++ )
-       {
-          osg::swapBytes((char *)&(ptr[i]),DOUBLESIZE) ;
-       }
-    }
     return a.release();
 }
 
-osg::Vec4dArray* DataInputStream::readVec4dArray(){
+osg::Vec4dArray* DataInputStream::readVec4dArray()
+{
     int size = readInt();
     if (size == 0)
         return NULL;
     
     osg::ref_ptr<osg::Vec4dArray> a = new osg::Vec4dArray(size);
 
-    _istream->read((char*)&((*a)[0]), DOUBLESIZE*4*size);
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(&((*a)[0]), size*4, DOUBLESIZE))
     {
         throwException("DataInputStream::readVec4dArray(): Failed to read Vec4d array.");
         return 0;
@@ -1162,27 +1196,14 @@ osg::Vec4dArray* DataInputStream::readVec4dArray(){
 
     if (_verboseOutput) std::cout<<"read/writeVec4dArray() ["<<size<<"]"<<std::endl;
 
-    if (_byteswap) {
-       double *ptr = (double*)&((*a)[0]) ;
-       for (int i = 0 ; i < size*4 ; i++ ) {
-          osg::swapBytes((char *)&(ptr[i]),DOUBLESIZE) ;
-       }
-    }
     return a.release();
 }
 
 osg::Matrixf DataInputStream::readMatrixf()
 {
+    // the matrix is stored row by row, the same order as Matrixf's own storage.
     osg::Matrixf mat;
-    for(int r=0;r<4;r++)
-    {
-        for(int c=0;c<4;c++)
-        {
-            mat(r,c) = readFloat();
-        }
-    }
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(mat.ptr(), 16, FLOATSIZE))
     {
         throwException("DataInputStream::readMatrix(): Failed to read Matrix array.");
         return osg::Matrixf();
@@ -1196,16 +1217,9 @@ osg::Matrixf DataInputStream::readMatrixf()
 
 osg::Matrixd DataInputStream::readMatrixd()
 {
+    // the matrix is stored row by row, the same order as Matrixd's own storage.
     osg::Matrixd mat;
-    for(int r=0;r<4;r++)
-    {
-        for(int c=0;c<4;c++)
-        {
-            mat(r,c) = readDouble();
-        }
-    }
-
-    if (_istream->rdstate() & _istream->failbit)
+    if (!readArrayData(mat.ptr(), 16, DOUBLESIZE))
     {
         throwException("DataInputStream::readMatrix(): Failed to read Matrix array.");
         return osg::Matrixd();
@@ -1682,6 +1696,11 @@ osg::Shape* DataInputStream::readShape()
         shape = new osg::HeightField();
         ((HeightField*)(shape.get()))->read(this);
     }
+    else if(shapeTypeID == IVEKDTREE)
+    {
+        shape = new osg::KdTree();
+        ((KdTree*)(shape.get()))->read(this);
+    }
     else
         throwException("Unknown shape shapeTypeIDentification in Shape::read()");
 
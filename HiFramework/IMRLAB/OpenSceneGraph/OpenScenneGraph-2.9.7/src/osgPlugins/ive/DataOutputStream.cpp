@@ -130,9 +130,17 @@
 #include <osgDB/FileNameUtils>
 #include <osgDB/fstream>
 #include <osgDB/WriteFile>
+#include <osgDB/BatchFileWriter>
+
+#include <osg/ProxyNode>
+#include <osg/Texture>
+
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Thread>
 
 #include <stdlib.h>
 #include <sstream>
+#include <set>
 
 using namespace ive;
 
@@ -151,9 +159,12 @@ DataOutputStream::DataOutputStream(std::ostream * ostream, const osgDB::ReaderWr
     _outputTextureFiles = false;
     _textureFileNameNumber = 0;
 
+    _includeKdTrees = true;
+
     _options = options;
 
     _compressionLevel = 0;
+    _blockCodec = osgDB::BlockCompression::ZLIB;
 
     if (options) _filename = options->getPluginStringData("filename");
 
@@ -190,7 +201,17 @@ DataOutputStream::DataOutputStream(std::ostream * ostream, const osgDB::ReaderWr
         setOutputTextureFiles(optionsString.find("OutputTextureFiles")!=std::string::npos);
         OSG_NOTIFY(osg::DEBUG_INFO) << "ive::DataOutputStream.setOutputTextureFiles()=" << getOutputTextureFiles() << std::endl;
 
+        setIncludeKdTrees(optionsString.find("noKdTreesInIVEFile")==std::string::npos);
+        OSG_NOTIFY(osg::DEBUG_INFO) << "ive::DataOutputStream.setIncludeKdTrees()=" << getIncludeKdTrees() << std::endl;
+
         _compressionLevel =  (optionsString.find("compressed")!=std::string::npos) ? 1 : 0;
+        if (optionsString.find("compressBlocksLZ4")!=std::string::npos) {
+            _compressionLevel = 2;
+            _blockCodec = osgDB::BlockCompression::LZ4;
+        } else if (optionsString.find("compressBlocks")!=std::string::npos) {
+            _compressionLevel = 2;
+            _blockCodec = osgDB::BlockCompression::ZLIB;
+        }
         OSG_NOTIFY(osg::DEBUG_INFO) << "ive::DataOutputStream._compressionLevel=" << _compressionLevel << std::endl;
 
         std::string::size_type terrainErrorPos = optionsString.find("TerrainMaximumErrorToSizeRatio=");
@@ -217,13 +238,19 @@ DataOutputStream::DataOutputStream(std::ostream * ostream, const osgDB::ReaderWr
     }
 
     #ifndef USE_ZLIB
-    if (_compressionLevel>0)
+    if (_compressionLevel==1)
     {
         OSG_NOTIFY(osg::NOTICE) << "Compression not supported in this .ive version." << std::endl;
         _compressionLevel = 0;
     }
     #endif
 
+    if (_compressionLevel==2 && !osgDB::BlockCompression::isCodecSupported(_blockCodec))
+    {
+        OSG_NOTIFY(osg::NOTICE) << "Block compression codec not supported, using LZ4." << std::endl;
+        _blockCodec = osgDB::BlockCompression::LZ4;
+    }
+
     _output_ostream = _ostream = ostream;
 
     if(!_ostream)
@@ -246,7 +273,14 @@ DataOutputStream::DataOutputStream(std::ostream * ostream, const osgDB::ReaderWr
 
 DataOutputStream::~DataOutputStream()
 {
-    if (_compressionLevel>0)
+    if (_compressionLevel==2)
+    {
+        _ostream = _output_ostream;
+
+        std::string compressionString(_compressionStream.str());
+        osgDB::BlockCompression::compress(*_output_ostream, compressionString.data(), compressionString.size(), _blockCodec);
+    }
+    else if (_compressionLevel>0)
     { 
         _ostream = _output_ostream;
 
@@ -1264,6 +1298,8 @@ void DataOutputStream::writeShape(const osg::Shape* shape)
             ((ive::Capsule*)(shape))->write(this);
         else if(dynamic_cast<const osg::HeightField*>(shape))
             ((ive::HeightField*)(shape))->write(this);
+        else if(dynamic_cast<const osg::KdTree*>(shape))
+            ((ive::KdTree*)(shape))->write(this);
         else
         {
             throwException("Unknown shape in DataOutputStream::writeShape()");
@@ -1474,7 +1510,7 @@ void DataOutputStream::writeImage(IncludeImageMode mode, osg::Image *image)
                     { // synthesize a new faux filename
                         fileName = getTextureFileNameForOutput();
                     }
-                    osgDB::writeImageFile(*image, fileName);
+                    writeExternalImageFile(*image, fileName);
                 }
                 writeString(fileName);
             }
@@ -1528,39 +1564,27 @@ void DataOutputStream::writeImage(IncludeImageMode mode, osg::Image *image)
         case IMAGE_COMPRESS_DATA:
             if(image)
             {
-                //Get ReaderWriter for jpeg images
+                // use the result of precompressImages() when there is one.
+                CompressedImage localCompressedImage;
+                CompressedImageMap::const_iterator itr = _compressedImageMap.find(image);
+                const CompressedImage& compressedImage = (itr!=_compressedImageMap.end()) ? itr->second : localCompressedImage;
+                if (itr==_compressedImageMap.end()) compressImage(image, localCompressedImage);
 
-                std::string extension = "png";
-                if (image->getPixelFormat()==GL_RGB) extension = "jpg";
-
-                osgDB::ReaderWriter* writer = osgDB::Registry::instance()->getReaderWriterForExtension(extension);
-
-                if(writer)
-                {
-                    //Attempt to write the image to an output stream.
-                    //The reason this isn't performed directly on the internal _ostream
-                    //is because the writer might perform seek operations which could
-                    //corrupt the output stream.
-                    std::stringstream outputStream;
-                    osgDB::ReaderWriter::WriteResult wr;
-                    wr = writer->writeImage(*image,outputStream,_options.get());
+                if(compressedImage.success) {
 
-                    if(wr.success()) {
+                    //Write file format. Do this for two reasons:
+                    // 1 - Same code can be used to read in as with IMAGE_INCLUDE_FILE mode
+                    // 2 - Maybe in future version user can specify which format to use
+                    writeString(std::string(".")+compressedImage.extension); //Need to add dot so osgDB::getFileExtension will work
 
-                        //Write file format. Do this for two reasons:
-                        // 1 - Same code can be used to read in as with IMAGE_INCLUDE_FILE mode
-                        // 2 - Maybe in future version user can specify which format to use
-                        writeString(std::string(".")+extension); //Need to add dot so osgDB::getFileExtension will work
-
-                        //Write size of stream
-                        int size = outputStream.tellp();
-                        writeInt(size);
+                    //Write size of stream
+                    int size = compressedImage.data.size();
+                    writeInt(size);
 
-                        //Write stream
-                        writeCharArray(outputStream.str().c_str(),size);
+                    //Write stream
+                    writeCharArray(compressedImage.data.c_str(),size);
 
-                        return;
-                    }
+                    return;
                 }
             }
             //Image compression failed, write blank data
@@ -1908,3 +1932,186 @@ bool DataOutputStream::getExternalFileWritten(const std::string& filename) const
     if (itr != _externalFileWritten.end()) return itr->second;
     return false;
 }
+
+void DataOutputStream::writeExternalNodeFile(const osg::Node& node, const std::string& filename)
+{
+    osgDB::BatchFileWriter* batchFileWriter = osgDB::BatchFileWriter::getBatchFileWriter(_options.get());
+    if (batchFileWriter) batchFileWriter->writeNodeFile(node, filename);
+    else osgDB::writeNodeFile(node, filename);
+}
+
+void DataOutputStream::writeExternalImageFile(const osg::Image& image, const std::string& filename)
+{
+    osgDB::BatchFileWriter* batchFileWriter = osgDB::BatchFileWriter::getBatchFileWriter(_options.get());
+    if (batchFileWriter) batchFileWriter->writeImageFile(image, filename);
+    else osgDB::writeImageFile(image, filename);
+}
+
+bool DataOutputStream::compressImage(const osg::Image* image, CompressedImage& compressedImage) const
+{
+    //Get ReaderWriter for jpeg images
+
+    compressedImage.extension = "png";
+    if (image->getPixelFormat()==GL_RGB) compressedImage.extension = "jpg";
+
+    osgDB::ReaderWriter* writer = osgDB::Registry::instance()->getReaderWriterForExtension(compressedImage.extension);
+    if (!writer) return false;
+
+    //Attempt to write the image to an output stream.
+    //The reason this isn't performed directly on the internal _ostream
+    //is because the writer might perform seek operations which could
+    //corrupt the output stream.
+    std::stringstream outputStream;
+    osgDB::ReaderWriter::WriteResult wr;
+    wr = writer->writeImage(*image,outputStream,_options.get());
+    if (!wr.success()) return false;
+
+    compressedImage.data = outputStream.str();
+    compressedImage.data.resize(outputStream.tellp());
+    compressedImage.success = true;
+    return true;
+}
+
+namespace
+{
+
+// Collects the images that will be written inline, not following ProxyNode children written to their own files.
+class CollectImagesVisitor : public osg::NodeVisitor
+{
+public:
+    CollectImagesVisitor(bool includeExternalReferences):
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _includeExternalReferences(includeExternalReferences) {}
+
+    virtual void apply(osg::Node& node)
+    {
+        apply(node.getStateSet());
+        traverse(node);
+    }
+
+    virtual void apply(osg::Geode& geode)
+    {
+        apply(geode.getStateSet());
+        for(unsigned int i=0; i<geode.getNumDrawables(); ++i)
+        {
+            apply(geode.getDrawable(i)->getStateSet());
+        }
+        traverse(geode);
+    }
+
+    virtual void apply(osg::ProxyNode& proxyNode)
+    {
+        apply(proxyNode.getStateSet());
+        for(unsigned int i=0; i<proxyNode.getNumChildren(); ++i)
+        {
+            if (_includeExternalReferences || i>=proxyNode.getNumFileNames() || proxyNode.getFileName(i).empty())
+            {
+                proxyNode.getChild(i)->accept(*this);
+            }
+        }
+    }
+
+    void apply(osg::StateSet* stateset)
+    {
+        if (!stateset || !_statesets.insert(stateset).second) return;
+
+        const osg::StateSet::TextureAttributeList& tal = stateset->getTextureAttributeList();
+        for(unsigned int unit=0; unit<tal.size(); ++unit)
+        {
+            const osg::Texture* texture = dynamic_cast<const osg::Texture*>(stateset->getTextureAttribute(unit, osg::StateAttribute::TEXTURE));
+            if (!texture) continue;
+            for(unsigned int i=0; i<texture->getNumImages(); ++i)
+            {
+                const osg::Image* image = texture->getImage(i);
+                if (image && _imageSet.insert(image).second) _images.push_back(image);
+            }
+        }
+    }
+
+    bool                            _includeExternalReferences;
+    std::set<const osg::StateSet*>  _statesets;
+    std::set<const osg::Image*>     _imageSet;
+    std::vector<const osg::Image*>  _images;
+};
+
+typedef std::vector<const osg::Image*> ImageList;
+typedef std::vector<DataOutputStream::CompressedImage*> CompressedImageList;
+
+// Pulls images off the list with an atomic counter, each thread writes only to its own entries of the results.
+void compressImages(const DataOutputStream* out, const ImageList& images, CompressedImageList& results, OpenThreads::Atomic& nextImage)
+{
+    for(unsigned int i = ++nextImage - 1; i<images.size(); i = ++nextImage - 1)
+    {
+        out->compressImage(images[i], *results[i]);
+    }
+}
+
+class ImageCompressThread : public OpenThreads::Thread
+{
+public:
+    ImageCompressThread(const DataOutputStream* out, const ImageList& images, CompressedImageList& results, OpenThreads::Atomic& nextImage):
+        _out(out), _images(images), _results(results), _nextImage(nextImage) {}
+
+    virtual void run() { compressImages(_out, _images, _results, _nextImage); }
+
+    const DataOutputStream*     _out;
+    const ImageList&            _images;
+    CompressedImageList&        _results;
+    OpenThreads::Atomic&        _nextImage;
+};
+
+}
+
+void DataOutputStream::precompressImages(const osg::Node* node)
+{
+    // files being written by a BatchFileWriter already keep the processors busy.
+    if (!node || osgDB::BatchFileWriter::getBatchFileWriter(_options.get())) return;
+
+    CollectImagesVisitor civ(getIncludeExternalReferences());
+    const_cast<osg::Node*>(node)->accept(civ);
+
+    ImageList images;
+    for(std::vector<const osg::Image*>::iterator itr = civ._images.begin();
+        itr != civ._images.end();
+        ++itr)
+    {
+        if (getIncludeImageMode(*itr)==IMAGE_COMPRESS_DATA && !dynamic_cast<const osg::ImageSequence*>(*itr))
+        {
+            images.push_back(*itr);
+        }
+    }
+    if (images.size()<2) return;
+
+    CompressedImageList results;
+    for(ImageList::iterator itr = images.begin();
+        itr != images.end();
+        ++itr)
+    {
+        results.push_back(&_compressedImageMap[*itr]);
+    }
+
+    int numProcessors = OpenThreads::GetNumberOfProcessors();
+    unsigned int numThreads = osg::minimum(static_cast<unsigned int>(numProcessors>0 ? numProcessors : 1), static_cast<unsigned int>(images.size()));
+
+    OSG_NOTIFY(osg::INFO)<<"DataOutputStream::precompressImages() "<<images.size()<<" images on "<<numThreads<<" threads"<<std::endl;
+
+    // the calling thread does its share alongside the extra threads.
+    OpenThreads::Atomic nextImage;
+    std::vector<ImageCompressThread*> threads;
+    for(unsigned int i=1; i<numThreads; ++i)
+    {
+        ImageCompressThread* thread = new ImageCompressThread(this, images, results, nextImage);
+        if (thread->start()==0) threads.push_back(thread);
+        else delete thread;
+    }
+
+    compressImages(this, images, results, nextImage);
+
+    for(std::vector<ImageCompressThread*>::iterator itr = threads.begin();
+        itr != threads.end();
+        ++itr)
+    {
+        (*itr)->join();
+        delete *itr;
+    }
+}
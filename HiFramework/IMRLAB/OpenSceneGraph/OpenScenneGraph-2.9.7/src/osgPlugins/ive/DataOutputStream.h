@@ -17,6 +17,7 @@
 #include <osg/Shape>
 #include <osg/Uniform>
 #include <osgDB/ReaderWriter>
+#include <osgDB/BlockCompression>
 
 //#include <osgTerrain/TerrainTile>
 //#include <osgVolume/VolumeTile>
@@ -134,6 +135,10 @@ public:
     void setOutputTextureFiles(bool flag) { _outputTextureFiles = flag; }
     bool getOutputTextureFiles() const { return _outputTextureFiles; }
 
+    // Set and get if the KdTrees of Geometry are written, so that they needn't be rebuilt when read
+    void setIncludeKdTrees(bool flag) { _includeKdTrees = flag; }
+    bool getIncludeKdTrees() const { return _includeKdTrees; }
+
     // support code for OutputTextureFiles
     virtual std::string getTextureFileNameForOutput();
     void setFileName(std::string newFileName) {_filename = newFileName;}
@@ -151,6 +156,26 @@ public:
     void setExternalFileWritten(const std::string& filename, bool hasBeenWritten=true);
     bool getExternalFileWritten(const std::string& filename) const;
 
+    /** Write a file referenced by this one, queued on the osgDB::BatchFileWriter writing this file when there is one.*/
+    void writeExternalNodeFile(const osg::Node& node, const std::string& filename);
+    void writeExternalImageFile(const osg::Image& image, const std::string& filename);
+
+    /** Compress the images under node that will be written with IMAGE_COMPRESS_DATA on several threads,
+      * so that writeImage() only has to copy the results into the stream.*/
+    void precompressImages(const osg::Node* node);
+
+    struct CompressedImage
+    {
+        CompressedImage(): success(false) {}
+
+        std::string extension;
+        std::string data;
+        bool        success;
+    };
+
+    /** Compress the image to the png, or jpg for RGB, file format as written with IMAGE_COMPRESS_DATA.*/
+    bool compressImage(const osg::Image* image, CompressedImage& compressedImage) const;
+
     void throwException(const std::string& message) { _exception = new Exception(message); }
     void throwException(Exception* exception) { _exception = exception; }
     const Exception* getException() const { return _exception.get(); }
@@ -162,7 +187,8 @@ public:
     std::string _filename; // not necessary, but optional for use in texture export
     
     std::stringstream _compressionStream;
-    int _compressionLevel;
+    int _compressionLevel;  // 0 : none, 1 : single zlib stream, 2 : osgDB::BlockCompression container of _blockCodec blocks
+    osgDB::BlockCompression::Codec _blockCodec;
 
      // Container to map stateset uniques to their respective stateset.
     typedef std::map<const osg::StateSet*,int>          StateSetMap;
@@ -203,11 +229,17 @@ public:
     bool _outputTextureFiles;
     unsigned int _textureFileNameNumber;
 
+    bool _includeKdTrees;
+
     osg::ref_ptr<const osgDB::ReaderWriter::Options> _options;
 
     typedef std::map<std::string, bool> ExternalFileWrittenMap;
     ExternalFileWrittenMap _externalFileWritten;
 
+
+    typedef std::map<const osg::Image*, CompressedImage> CompressedImageMap;
+    CompressedImageMap _compressedImageMap;
+
     osg::ref_ptr<Exception> _exception;
 };
 
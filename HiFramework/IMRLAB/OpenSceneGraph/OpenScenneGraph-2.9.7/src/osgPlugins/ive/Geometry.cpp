@@ -20,6 +20,7 @@
 #include "DrawElementsUByte.h"
 #include "DrawElementsUShort.h"
 #include "DrawElementsUInt.h"
+#include "Shape.h"
 
 using namespace ive;
 
@@ -164,6 +165,19 @@ void Geometry::write(DataOutputStream* out){
             out->writeArray(arrayData.indices.get());
         }
     }
+
+    // Write KdTree if any, so that it needn't be rebuilt when read
+    if ( out->getVersion() >= VERSION_0044 )
+    {
+        osg::KdTree* kdTree = dynamic_cast<osg::KdTree*>(getShape());
+        bool writeKdTree = kdTree!=0 && out->getIncludeKdTrees() &&
+                           kdTree->getVertices()!=0 && kdTree->getVertices()==getVertexArray();
+        out->writeBool(writeKdTree);
+        if (writeKdTree)
+        {
+            out->writeShape(kdTree);
+        }
+    }
 }
 
 void Geometry::read(DataInputStream* in){
@@ -312,6 +326,27 @@ void Geometry::read(DataInputStream* in){
                 setVertexAttribIndices(i, static_cast<osg::IndexArray*>(in->readArray()));
         }
 
+        // Read KdTree if any, only using it if it fits the vertices read, otherwise leaving it to be rebuilt
+        if ( in->getVersion() >= VERSION_0044 )
+        {
+            if(in->readBool())
+            {
+                ive::KdTree* kdTree = static_cast<ive::KdTree*>(dynamic_cast<osg::KdTree*>(in->readShape()));
+                if (in->getException()) return;
+
+                osg::Vec3Array* vertices = dynamic_cast<osg::Vec3Array*>(getVertexArray());
+                if (kdTree && kdTree->isCompatible(vertices))
+                {
+                    kdTree->setVertices(vertices);
+                    setShape(kdTree);
+                }
+                else
+                {
+                    osg::notify(osg::INFO)<<"Geometry::read(): Discarding KdTree that doesn't fit the Geometry's vertices."<<std::endl;
+                }
+            }
+        }
+
     }
     else{
         in_THROW_EXCEPTION("Geometry::read(): Expected Geometry identification.");
@@ -89,6 +89,9 @@ void Node::write(DataOutputStream* out){
         {
             ((ive::VolumePropertyAdjustmentCallback*)pac)->write(out);
         }
+#else
+        // Node::read() always expects the flag, whether or not the callback is supported.
+        out->writeBool(false);
 #endif
     }
 
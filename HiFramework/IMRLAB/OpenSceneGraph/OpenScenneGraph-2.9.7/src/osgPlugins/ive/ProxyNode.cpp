@@ -122,7 +122,7 @@ void ProxyNode::write(DataOutputStream* out)
                     {
                         if (!out->getExternalFileWritten(getFileName(i)))
                         {
-                            osgDB::writeNodeFile(*getChild(i), getFileName(i));
+                            out->writeExternalNodeFile(*getChild(i), getFileName(i));
                             out->setExternalFileWritten(getFileName(i), true);
                         }
                     }
@@ -131,7 +131,7 @@ void ProxyNode::write(DataOutputStream* out)
                         std::string ivename = writeDirectory + osgDB::getStrippedName(getFileName(i)) +".ive";
                         if (!out->getExternalFileWritten(ivename))
                         {
-                            osgDB::writeNodeFile(*getChild(i), ivename);
+                            out->writeExternalNodeFile(*getChild(i), ivename);
                             out->setExternalFileWritten(ivename, true);
                         }
                     }
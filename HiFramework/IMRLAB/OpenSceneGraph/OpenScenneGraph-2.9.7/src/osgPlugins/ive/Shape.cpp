@@ -361,15 +361,8 @@ void HeightField::read(DataInputStream* in)
         setBorderWidth(in->readUInt());
     
         unsigned int size = in->readUInt();
-        in->_istream->read((char*)&(getHeightList()[0]), FLOATSIZE*size);
-        if (in->_istream->rdstate() & in->_istream->failbit)
+        if (size!=0 && !in->readArrayData(&(getHeightList()[0]), size, FLOATSIZE))
             in_THROW_EXCEPTION("HeightField::read(): Failed to read height array.");
-        if (in->_byteswap) {
-           float *ptr = (float*)&(getHeightList()[0]) ;
-           for (unsigned int i = 0 ; i < size ; i++ ) {
-              osg::swapBytes((char *)&(ptr[i]),FLOATSIZE) ;
-           }
-        }
 
     }
     else
@@ -378,3 +371,178 @@ void HeightField::read(DataInputStream* in)
     }
 }
 
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  KdTree
+//
+void KdTree::write(DataOutputStream* out)
+{
+    // Write KdTree's identification.
+    out->writeInt(IVEKDTREE);
+    // If the osg class is inherited by any other class we should also write this to file.
+    osg::Object*  obj = dynamic_cast<osg::Object*>(this);
+    if(obj)
+    {
+        ((ive::Object*)(obj))->write(out);
+    }
+    else
+        out_THROW_EXCEPTION("KdTree::write(): Could not cast this osg::KdTree to an osg::Object.");
+
+    // Write KdTree's properties, the vertices being those of the Geometry it is written with.
+    unsigned int numNodes = _kdNodes.size();
+    out->writeUInt(numNodes);
+    for(unsigned int i = 0; i < numNodes; i++)
+    {
+        const KdNode& node = _kdNodes[i];
+        out->writeFloat(node.bb.xMin());
+        out->writeFloat(node.bb.yMin());
+        out->writeFloat(node.bb.zMin());
+        out->writeFloat(node.bb.xMax());
+        out->writeFloat(node.bb.yMax());
+        out->writeFloat(node.bb.zMax());
+        out->writeInt(node.first);
+        out->writeInt(node.second);
+    }
+
+    unsigned int numTriangles = _triangles.size();
+    out->writeUInt(numTriangles);
+    for(unsigned int i = 0; i < numTriangles; i++)
+    {
+        const Triangle& tri = _triangles[i];
+        out->writeUInt(tri.p0);
+        out->writeUInt(tri.p1);
+        out->writeUInt(tri.p2);
+    }
+
+    if ( out->getVersion() >= VERSION_0045 )
+    {
+        // Write the index of the primitive each triangle came from, if known.
+        unsigned int numPrimitiveIndices = hasPrimitiveIndices() ? _primitiveIndices.size() : 0;
+        out->writeUInt(numPrimitiveIndices);
+        for(unsigned int i = 0; i < numPrimitiveIndices; i++)
+        {
+            out->writeUInt(_primitiveIndices[i]);
+        }
+    }
+}
+
+void KdTree::read(DataInputStream* in)
+{
+    // Peek on KdTree's identification.
+    int id = in->peekInt();
+    if(id == IVEKDTREE)
+    {
+        // Read KdTree's identification.
+        id = in->readInt();
+        // If the osg class is inherited by any other class we should also read this from file.
+        osg::Object*  obj = dynamic_cast<osg::Object*>(this);
+        if(obj)
+        {
+            ((ive::Object*)(obj))->read(in);
+        }
+        else
+            in_THROW_EXCEPTION("KdTree::read(): Could not cast this osg::KdTree to an osg::Object.");
+
+        // Read KdTree's properties. Where the nodes and triangles are laid out in memory just as they are in the
+        // file, all 4 byte values, they are copied straight out of the read buffer rather than value by value.
+        unsigned int numNodes = in->readUInt();
+        _kdNodes.resize(numNodes);
+        if (numNodes!=0)
+        {
+            if (sizeof(KdNode)==8*FLOATSIZE && sizeof(osg::BoundingBox::value_type)==FLOATSIZE && sizeof(value_type)==INTSIZE)
+            {
+                if (!in->readArrayData(&(_kdNodes[0]), numNodes*8, FLOATSIZE))
+                    in_THROW_EXCEPTION("KdTree::read(): Failed to read node array.");
+            }
+            else
+            {
+                for(unsigned int i = 0; i < numNodes; i++)
+                {
+                    KdNode& node = _kdNodes[i];
+                    node.bb.xMin() = in->readFloat();
+                    node.bb.yMin() = in->readFloat();
+                    node.bb.zMin() = in->readFloat();
+                    node.bb.xMax() = in->readFloat();
+                    node.bb.yMax() = in->readFloat();
+                    node.bb.zMax() = in->readFloat();
+                    node.first = in->readInt();
+                    node.second = in->readInt();
+                }
+            }
+        }
+
+        unsigned int numTriangles = in->readUInt();
+        _triangles.resize(numTriangles);
+        if (numTriangles!=0)
+        {
+            if (sizeof(Triangle)==3*INTSIZE)
+            {
+                if (!in->readArrayData(&(_triangles[0]), numTriangles*3, INTSIZE))
+                    in_THROW_EXCEPTION("KdTree::read(): Failed to read triangle array.");
+            }
+            else
+            {
+                for(unsigned int i = 0; i < numTriangles; i++)
+                {
+                    Triangle& tri = _triangles[i];
+                    tri.p0 = in->readUInt();
+                    tri.p1 = in->readUInt();
+                    tri.p2 = in->readUInt();
+                }
+            }
+        }
+
+        _primitiveIndices.clear();
+        if ( in->getVersion() >= VERSION_0045 )
+        {
+            unsigned int numPrimitiveIndices = in->readUInt();
+            _primitiveIndices.resize(numPrimitiveIndices);
+            if (numPrimitiveIndices!=0)
+            {
+                if (!in->readArrayData(&(_primitiveIndices[0]), numPrimitiveIndices, INTSIZE))
+                    in_THROW_EXCEPTION("KdTree::read(): Failed to read primitive index array.");
+            }
+        }
+    }
+    else
+    {
+        in_THROW_EXCEPTION("KdTree::read(): Expected KdTree identification.");
+    }
+}
+
+bool KdTree::isCompatible(const osg::Vec3Array* vertices) const
+{
+    if (!vertices || _kdNodes.empty()) return false;
+
+    // the children of each node follow it, as the KdTree is built, so a traversal can't loop.
+    int numNodes = static_cast<int>(_kdNodes.size());
+    int numTriangles = static_cast<int>(_triangles.size());
+    for(int i = 0; i < numNodes; i++)
+    {
+        const KdNode& node = _kdNodes[i];
+        if (node.first<0)
+        {
+            int istart = -(node.first+1);
+            if (node.second<0 || node.second>numTriangles-istart) return false;
+        }
+        else
+        {
+            if (node.first!=0 && (node.first<=i || node.first>=numNodes)) return false;
+            if (node.second!=0 && (node.second<=i || node.second>=numNodes)) return false;
+        }
+    }
+
+    unsigned int numVertices = vertices->size();
+    for(TriangleList::const_iterator itr = _triangles.begin();
+        itr != _triangles.end();
+        ++itr)
+    {
+        if (itr->p0>=numVertices || itr->p1>=numVertices || itr->p2>=numVertices) return false;
+    }
+
+    // primitive indices are optional, but if present there must be one per triangle.
+    if (!_primitiveIndices.empty() && _primitiveIndices.size()!=_triangles.size()) return false;
+
+    return true;
+}
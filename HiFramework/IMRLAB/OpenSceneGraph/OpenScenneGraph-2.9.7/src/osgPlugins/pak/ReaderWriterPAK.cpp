@@ -0,0 +1,87 @@
+#include <osg/Notify>
+
+#include <osgDB/Registry>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+
+#include "PAK_Archive.h"
+
+class ReaderWriterPAK : public osgDB::ReaderWriter
+{
+public:
+    ReaderWriterPAK()
+    {
+        supportsExtension("pak","OpenSceneGraph packed archive format");
+
+        supportsOption("compressed","Export option, use zlib compression on the entries written to the archive where it reduces their size");
+        supportsOption("alignment=<n>","Export option, align the start of each entry in a newly created archive to n bytes, default 16");
+    }
+
+    virtual const char* className() const { return "PAK Archive"; }
+
+    virtual bool acceptsExtension(const std::string& extension) const
+    {
+        return osgDB::equalCaseInsensitive(extension,"pak");
+    }
+
+    virtual ReadResult openArchive(const std::string& file,ArchiveStatus status, unsigned int /*indexBlockSize*/, const Options* options) const
+    {
+        std::string ext = osgDB::getLowerCaseFileExtension(file);
+        if (!acceptsExtension(ext)) return ReadResult::FILE_NOT_HANDLED;
+
+        std::string fileName = osgDB::findDataFile( file, options );
+        if (fileName.empty())
+        {
+            if (status==READ) return ReadResult::FILE_NOT_FOUND;
+            fileName = file;
+        }
+
+        osg::ref_ptr<PAKArchive> archive = new PAKArchive;
+        if (!archive->open(fileName, status, options))
+        {
+            return ReadResult(ReadResult::FILE_NOT_HANDLED);
+        }
+
+        return archive.get();
+    }
+
+    virtual ReadResult readImage(const std::string& file,const Options* options) const
+    {
+        ReadResult result = openArchive(file,osgDB::Archive::READ, 4096, options);
+
+        if (!result.validArchive()) return result;
+
+        osg::ref_ptr<osgDB::Archive> archive = result.getArchive();
+
+        osg::ref_ptr<osgDB::ReaderWriter::Options> local_options = options ? static_cast<osgDB::ReaderWriter::Options*>(options->clone(osg::CopyOp::SHALLOW_COPY)) : new osgDB::ReaderWriter::Options;
+        local_options->setDatabasePath(file);
+
+        return archive->readImage(archive->getMasterFileName(),local_options.get());
+    }
+
+    virtual ReadResult readNode(const std::string& file,const Options* options) const
+    {
+        ReadResult result = openArchive(file,osgDB::Archive::READ, 4096, options);
+
+        if (!result.validArchive()) return result;
+
+        osg::ref_ptr<osgDB::Archive> archive = result.getArchive();
+
+        osg::ref_ptr<osgDB::ReaderWriter::Options> local_options = options ? static_cast<osgDB::ReaderWriter::Options*>(options->clone(osg::CopyOp::SHALLOW_COPY)) : new osgDB::ReaderWriter::Options;
+        local_options->setDatabasePath(file);
+
+        ReadResult result_2 = archive->readNode(archive->getMasterFileName(),local_options.get());
+
+        if (!options || (options->getObjectCacheHint() & osgDB::ReaderWriter::Options::CACHE_ARCHIVES))
+        {
+            // register the archive so that it is cached for future use.
+            osgDB::Registry::instance()->addToArchiveCache(file, archive.get());
+        }
+
+        return result_2;
+    }
+};
+
+// now register with Registry to instantiate the above
+// reader/writer.
+REGISTER_OSGPLUGIN(pak, ReaderWriterPAK)
@@ -15,11 +15,13 @@
 #include <osgSim/HeightAboveTerrain>
 
 #include <osg/Notify>
-#include <osgUtil/LineSegmentIntersector>
+
+#include "IntersectionThreadPool.h"
 
 using namespace osgSim;
 
-HeightAboveTerrain::HeightAboveTerrain()
+HeightAboveTerrain::HeightAboveTerrain():
+    _numThreads(IntersectionThreadPool::getDefaultNumThreads())
 {
     _lowestHeight = -1000.0;
     
@@ -38,75 +40,121 @@ unsigned int HeightAboveTerrain::addPoint(const osg::Vec3d& point)
     return index;
 }
 
+void HeightAboveTerrain::computeLineSegment(unsigned int i, osg::EllipsoidModel* em, osg::Vec3d& start, osg::Vec3d& end, double& height) const
+{
+    start = _HATList[i]._point;
+
+    if (em)
+    {
+        osg::Vec3d upVector = em->computeLocalUpVector(start.x(), start.y(), start.z());
+
+        double latitude, longitude;
+        em->convertXYZToLatLongHeight(start.x(), start.y(), start.z(), latitude, longitude, height);
+        end = start - upVector * (height - _lowestHeight);
+
+        osg::notify(osg::INFO)<<"lat = "<<latitude<<" longitude = "<<longitude<<" height = "<<height<<std::endl;
+    }
+    else
+    {
+        osg::Vec3d upVector (0.0, 0.0, 1.0);
+
+        height = start.z();
+        end = start - upVector * (height - _lowestHeight);
+    }
+}
+
+void HeightAboveTerrain::addLineSegments(osgUtil::LineSegmentBatchIntersector& intersector, osg::EllipsoidModel* em, unsigned int begin, unsigned int end)
+{
+    for(unsigned int index = begin; index<end; ++index)
+    {
+        osg::Vec3d segmentStart, segmentEnd;
+        computeLineSegment(index, em, segmentStart, segmentEnd, _HATList[index]._hat);
+
+        intersector.addLineSegment(segmentStart, segmentEnd);
+    }
+}
+
+void HeightAboveTerrain::getIntersections(const osgUtil::LineSegmentBatchIntersector& intersector, unsigned int begin)
+{
+    for(unsigned int i = 0; i<intersector.getNumLineSegments(); ++i)
+    {
+        if (intersector.hasIntersection(i))
+        {
+            const osgUtil::LineSegmentBatchIntersector::Intersection& intersection = intersector.getIntersection(i);
+            osg::Vec3d intersectionPoint = intersection.matrix.valid() ? intersection.localIntersectionPoint * (*intersection.matrix) :
+                                           intersection.localIntersectionPoint;
+            _HATList[begin+i]._hat = (_HATList[begin+i]._point - intersectionPoint).length();
+        }
+    }
+}
+
 void HeightAboveTerrain::computeIntersections(osg::Node* scene, osg::Node::NodeMask traversalMask)
 {
     osg::CoordinateSystemNode* csn = dynamic_cast<osg::CoordinateSystemNode*>(scene);
     osg::EllipsoidModel* em = csn ? csn->getEllipsoidModel() : 0;
 
-    osg::ref_ptr<osgUtil::IntersectorGroup> intersectorGroup = new osgUtil::IntersectorGroup();
+    unsigned int numPoints = _HATList.size();
+    unsigned int numThreads = osg::minimum(_numThreads, numPoints);
 
-    for(HATList::iterator itr = _HATList.begin();
-        itr != _HATList.end();
-        ++itr)
+    if (numThreads<=1)
     {
-        if (em)
-        {
-        
-            osg::Vec3d start = itr->_point;
-            osg::Vec3d upVector = em->computeLocalUpVector(start.x(), start.y(), start.z());
+        // intersect all the points' segments with a single traversal, only the nearest intersection of each is needed.
+        osg::ref_ptr<osgUtil::LineSegmentBatchIntersector> intersector = new osgUtil::LineSegmentBatchIntersector();
+        addLineSegments(*intersector, em, 0, numPoints);
 
-            double latitude, longitude, height;
-            em->convertXYZToLatLongHeight(start.x(), start.y(), start.z(), latitude, longitude, height);
-            osg::Vec3d end = start - upVector * (height - _lowestHeight);            
-            
-            itr->_hat = height;
+        _intersectionVisitor.reset();
+        _intersectionVisitor.setTraversalMask(traversalMask);
+        _intersectionVisitor.setIntersector( intersector.get() );
 
-            osg::notify(osg::NOTICE)<<"lat = "<<latitude<<" longitude = "<<longitude<<" height = "<<height<<std::endl;
+        scene->accept(_intersectionVisitor);
 
-            osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector = new osgUtil::LineSegmentIntersector(start, end);
-            intersectorGroup->addIntersector( intersector.get() );
-        }
-        else
-        {
-            osg::Vec3d start = itr->_point;
-            osg::Vec3d upVector (0.0, 0.0, 1.0);
-            
-            double height = start.z();
-            osg::Vec3d end = start - upVector * (height - _lowestHeight);            
+        getIntersections(*intersector, 0);
+        return;
+    }
 
-            itr->_hat = height;
+    // compute the bounds before the threads share the scene graph.
+    scene->getBound();
 
-            osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector = new osgUtil::LineSegmentIntersector( start, end);
-            intersectorGroup->addIntersector( intersector.get() );
-        }
+    // divide the points into a few parts per thread, each intersected with a single traversal, so that threads that
+    // finish their parts early take on more.
+    unsigned int numParts = osg::minimum(numThreads*4, numPoints);
+    IntersectionThreadPool::Intersectors intersectors;
+    for(unsigned int part = 0; part<numParts; ++part)
+    {
+        osg::ref_ptr<osgUtil::LineSegmentBatchIntersector> intersector = new osgUtil::LineSegmentBatchIntersector();
+        addLineSegments(*intersector, em, (numPoints*part)/numParts, (numPoints*(part+1))/numParts);
+        intersectors.push_back(intersector.get());
     }
-    
-    _intersectionVisitor.reset();
-    _intersectionVisitor.setTraversalMask(traversalMask);
-    _intersectionVisitor.setIntersector( intersectorGroup.get() );
-    
-    scene->accept(_intersectionVisitor);
-    
-    unsigned int index = 0;
-    osgUtil::IntersectorGroup::Intersectors& intersectors = intersectorGroup->getIntersectors();
-    for(osgUtil::IntersectorGroup::Intersectors::iterator intersector_itr = intersectors.begin();
-        intersector_itr != intersectors.end();
-        ++intersector_itr, ++index)
+
+    IntersectionThreadPool::intersect(scene, intersectors, _dcrc.get(), traversalMask, numThreads);
+
+    // gather the results in the order of the points, whichever threads found them.
+    for(unsigned int part = 0; part<numParts; ++part)
     {
-        osgUtil::LineSegmentIntersector* lsi = dynamic_cast<osgUtil::LineSegmentIntersector*>(intersector_itr->get());
-        if (lsi)
-        {
-            osgUtil::LineSegmentIntersector::Intersections& intersections = lsi->getIntersections();
-            if (!intersections.empty())
-            {
-                const osgUtil::LineSegmentIntersector::Intersection& intersection = *intersections.begin();
-                osg::Vec3d intersectionPoint = intersection.matrix.valid() ? intersection.localIntersectionPoint * (*intersection.matrix) :
-                                               intersection.localIntersectionPoint;
-                _HATList[index]._hat = (_HATList[index]._point - intersectionPoint).length();
-            }
-        }
+        getIntersections(static_cast<osgUtil::LineSegmentBatchIntersector&>(*intersectors[part]), (numPoints*part)/numParts);
     }
-    
+}
+
+void HeightAboveTerrain::prefetch(osg::Node* scene, osg::Node::NodeMask traversalMask)
+{
+    if (!_dcrc) return;
+
+    osg::CoordinateSystemNode* csn = dynamic_cast<osg::CoordinateSystemNode*>(scene);
+    osg::EllipsoidModel* em = csn ? csn->getEllipsoidModel() : 0;
+
+    osg::ref_ptr<osgUtil::LineSegmentBatchIntersector> intersector = new osgUtil::LineSegmentBatchIntersector();
+    for(unsigned int index = 0; index<_HATList.size(); ++index)
+    {
+        osg::Vec3d start, end;
+        double height;
+        computeLineSegment(index, em, start, end, height);
+        intersector->addLineSegment(start, end);
+    }
+
+    osgUtil::IntersectionVisitor iv(intersector.get(), _dcrc->getPrefetchReadCallback());
+    iv.setTraversalMask(traversalMask);
+
+    scene->accept(iv);
 }
 
 double HeightAboveTerrain::computeHeightAboveTerrain(osg::Node* scene, const osg::Vec3d& point, osg::Node::NodeMask traversalMask)
@@ -11,6 +11,7 @@
  * OpenSceneGraph Public License for more details.
 */
 #include <osg/Transform>
+#include <osg/CoordinateSystemNode>
 #include <osg/Projection>
 #include <osg/Geode>
 #include <osg/LOD>
@@ -30,8 +31,15 @@
 
 #include <osgUtil/CullVisitor>
 
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
 #include <float.h>
+#include <limits.h>
 #include <algorithm>
+#include <typeinfo>
 
 #include <osg/Timer>
 
@@ -51,7 +59,9 @@ CullVisitor::CullVisitor():
     _computed_znear(FLT_MAX),
     _computed_zfar(-FLT_MAX),
     _currentReuseRenderLeafIndex(0),
-    _numberOfEncloseOverrideRenderBinDetails(0)
+    _numberOfEncloseOverrideRenderBinDetails(0),
+    _numDrawablesCulledByBudget(0),
+    _numPrimitivesCulledByBudget(0)
 {
 }
 
@@ -63,7 +73,9 @@ CullVisitor::CullVisitor(const CullVisitor& rhs):
     _computed_znear(FLT_MAX),
     _computed_zfar(-FLT_MAX),
     _currentReuseRenderLeafIndex(0),
-    _numberOfEncloseOverrideRenderBinDetails(0)
+    _numberOfEncloseOverrideRenderBinDetails(0),
+    _numDrawablesCulledByBudget(0),
+    _numPrimitivesCulledByBudget(0)
 {
 }
 
@@ -127,6 +139,10 @@ void CullVisitor::reset()
     _currentReuseRenderLeafIndex = 0;
 
     _nearPlaneCandidateMap.clear();
+
+    _budgetLeaves.clear();
+    _numDrawablesCulledByBudget = 0;
+    _numPrimitivesCulledByBudget = 0;
 }
 
 float CullVisitor::getDistanceToEyePoint(const Vec3& pos, bool withLODScale) const
@@ -155,6 +171,116 @@ float CullVisitor::getDistanceFromEyePoint(const osg::Vec3& pos, bool withLODSca
     else return dist;
 }
 
+namespace
+{
+    // the number of primitives a drawable draws, taking a drawable other than a Geometry as one.
+    unsigned int numPrimitives(const osg::Drawable& drawable)
+    {
+        const osg::Geometry* geometry = drawable.asGeometry();
+        if (!geometry) return 1;
+
+        unsigned int num = 0;
+        for(unsigned int i=0; i<geometry->getNumPrimitiveSets(); ++i)
+        {
+            num += geometry->getPrimitiveSet(i)->getNumPrimitives();
+        }
+        return num;
+    }
+
+    struct GreaterContributionFunctor
+    {
+        template<class T>
+        bool operator() (const T& lhs, const T& rhs) const { return lhs._contribution>rhs._contribution; }
+    };
+
+    struct LessParentFunctor
+    {
+        bool operator() (const RenderLeaf* lhs, const RenderLeaf* rhs) const
+        {
+            return lhs->_parent<rhs->_parent || (lhs->_parent==rhs->_parent && lhs<rhs);
+        }
+    };
+
+    struct IsInSortedListFunctor
+    {
+        IsInSortedListFunctor(RenderLeaf** begin, RenderLeaf** end): _begin(begin), _end(end) {}
+
+        bool operator() (const osg::ref_ptr<RenderLeaf>& leaf) const
+        {
+            return std::binary_search(_begin, _end, leaf.get(), LessParentFunctor());
+        }
+
+        RenderLeaf**    _begin;
+        RenderLeaf**    _end;
+    };
+}
+
+void CullVisitor::cullToBudget()
+{
+    _numDrawablesCulledByBudget = 0;
+    _numPrimitivesCulledByBudget = 0;
+
+    if (_budgetLeaves.empty()) return;
+
+    unsigned int primitiveBudget = getPrimitiveBudget()>0 ? getPrimitiveBudget() : UINT_MAX;
+    unsigned int drawableBudget = getDrawableBudget()>0 ? getDrawableBudget() : UINT_MAX;
+
+    unsigned int totalNumPrimitives = 0;
+    for(BudgetLeafList::const_iterator itr = _budgetLeaves.begin();
+        itr != _budgetLeaves.end();
+        ++itr)
+    {
+        totalNumPrimitives += itr->_numPrimitives;
+    }
+
+    if (totalNumPrimitives<=primitiveBudget && _budgetLeaves.size()<=drawableBudget)
+    {
+        _budgetLeaves.clear();
+        return;
+    }
+
+    // keep the leaves that contribute most until one would break either budget, dropping it and the rest.
+    std::sort(_budgetLeaves.begin(), _budgetLeaves.end(), GreaterContributionFunctor());
+
+    unsigned int numKept = 0;
+    unsigned int numPrimitivesKept = 0;
+    while (numKept<_budgetLeaves.size() && numKept<drawableBudget &&
+           numPrimitivesKept+_budgetLeaves[numKept]._numPrimitives<=primitiveBudget)
+    {
+        numPrimitivesKept += _budgetLeaves[numKept]._numPrimitives;
+        ++numKept;
+    }
+
+    _numDrawablesCulledByBudget = static_cast<unsigned int>(_budgetLeaves.size())-numKept;
+    _numPrimitivesCulledByBudget = totalNumPrimitives-numPrimitivesKept;
+
+    // remove the dropped leaves from their StateGraph's, a StateGraph at a time.
+    std::vector<RenderLeaf*> dropped;
+    dropped.reserve(_numDrawablesCulledByBudget);
+    for(unsigned int i=numKept; i<_budgetLeaves.size(); ++i)
+    {
+        dropped.push_back(_budgetLeaves[i]._leaf);
+    }
+    std::sort(dropped.begin(), dropped.end(), LessParentFunctor());
+
+    for(std::vector<RenderLeaf*>::iterator itr = dropped.begin();
+        itr != dropped.end();)
+    {
+        StateGraph* sg = (*itr)->_parent;
+        std::vector<RenderLeaf*>::iterator end = itr;
+        while (end!=dropped.end() && (*end)->_parent==sg) ++end;
+
+        sg->_leaves.erase(std::remove_if(sg->_leaves.begin(), sg->_leaves.end(), IsInSortedListFunctor(&(*itr), &(*itr)+(end-itr))),
+                          sg->_leaves.end());
+        sg->_averageDistance = FLT_MAX;
+        sg->_minimumDistance = FLT_MAX;
+
+        itr = end;
+    }
+
+    _budgetLeaves.clear();
+}
+
 void CullVisitor::computeNearPlane()
 {
     if (!_nearPlaneCandidateMap.empty())
@@ -719,7 +845,28 @@ void CullVisitor::apply(Geode& node)
     handle_cull_callbacks_and_traverse(node);
 
     RefMatrix& matrix = *getModelViewMatrix();
-    for(unsigned int i=0;i<node.getNumDrawables();++i)
+
+    const bool budgetCulling = (getCullingMode() & BUDGET_CULLING) && (getPrimitiveBudget()>0 || getDrawableBudget()>0);
+
+    // cull the drawables' bounding boxes against the frustum in one batch. The results are appended to the
+    // lists, and removed again at the end, so that a cull callback traversing another subgraph can use them too.
+    const unsigned int numDrawables = node.getNumDrawables();
+    const unsigned int cullResultsStart = static_cast<unsigned int>(_drawableCullResults.size());
+    const bool cullDrawables = node.isCullingActive() && numDrawables>0;
+    if (cullDrawables)
+    {
+        _drawableBoundingBoxes.resize(cullResultsStart+numDrawables);
+        _drawableCullResults.resize(cullResultsStart+numDrawables);
+        _drawableFrustumMasks.resize(cullResultsStart+numDrawables);
+        for(unsigned int i=0;i<numDrawables;++i)
+        {
+            _drawableBoundingBoxes[cullResultsStart+i] = node.getDrawable(i)->getBound();
+        }
+        isCulled(&_drawableBoundingBoxes[cullResultsStart], numDrawables,
+                 &_drawableCullResults[cullResultsStart], &_drawableFrustumMasks[cullResultsStart]);
+    }
+
+    for(unsigned int i=0;i<numDrawables;++i)
     {
         Drawable* drawable = node.getDrawable(i);
         const BoundingBox &bb =drawable->getBound();
@@ -732,7 +879,13 @@ void CullVisitor::apply(Geode& node)
         
         //else
         {
-            if (node.isCullingActive() && isCulled(bb)) continue;
+            if (cullDrawables)
+            {
+                if (_drawableCullResults[cullResultsStart+i]) continue;
+
+                // the near plane computation uses the planes the drawable still intersects.
+                getCurrentCullingSet().getFrustum().setResultMask(_drawableFrustumMasks[cullResultsStart+i]);
+            }
         }
 
 
@@ -784,6 +937,16 @@ void CullVisitor::apply(Geode& node)
         else
         {        
             addDrawableAndDepth(drawable,&matrix,depth);
+
+            if (budgetCulling)
+            {
+                float pixelSize = bb.valid() ? clampedPixelSize(bb.center(),bb.radius()) : 0.0f;
+                BudgetLeaf budgetLeaf;
+                budgetLeaf._leaf = _currentStateGraph->_leaves.back().get();
+                budgetLeaf._numPrimitives = numPrimitives(*drawable);
+                budgetLeaf._contribution = pixelSize*pixelSize/static_cast<float>(osg::maximum(budgetLeaf._numPrimitives,1u));
+                _budgetLeaves.push_back(budgetLeaf);
+            }
         }
 
         for(unsigned int i=0;i< numPopStateSetRequired; ++i)
@@ -793,6 +956,13 @@ void CullVisitor::apply(Geode& node)
 
     }
 
+    if (cullDrawables)
+    {
+        _drawableBoundingBoxes.resize(cullResultsStart);
+        _drawableCullResults.resize(cullResultsStart);
+        _drawableFrustumMasks.resize(cullResultsStart);
+    }
+
     // pop the node's state off the geostate stack.    
     if (node_state) popStateSet();
 
@@ -984,9 +1154,9 @@ void CullVisitor::apply(Transform& node)
     StateSet* node_state = node.getStateSet();
     if (node_state) pushStateSet(node_state);
 
-    ref_ptr<RefMatrix> matrix = createOrReuseMatrix(*getModelViewMatrix());
+    RefMatrix* matrix = createOrReuseMatrix(*getModelViewMatrix());
     node.computeLocalToWorldMatrix(*matrix,this);
-    pushModelViewMatrix(matrix.get(), node.getReferenceFrame());
+    pushModelViewMatrix(matrix, node.getReferenceFrame());
     
     handle_cull_callbacks_and_traverse(node);
 
@@ -1022,8 +1192,8 @@ void CullVisitor::apply(Projection& node)
     _computed_zfar = -FLT_MAX;
 
 
-    ref_ptr<RefMatrix> matrix = createOrReuseMatrix(node.getMatrix());
-    pushProjectionMatrix(matrix.get());
+    RefMatrix* matrix = createOrReuseMatrix(node.getMatrix());
+    pushProjectionMatrix(matrix);
     
     //OSG_NOTIFY(osg::INFO)<<"Push projection "<<*matrix<<std::endl;
     
@@ -1403,9 +1573,13 @@ void CullVisitor::apply(osg::OccluderNode& node)
     // list, if so disable the appropriate ShadowOccluderVolume
     disableAndPushOccludersCurrentMask(_nodePath);
     
+    // likewise the subgraph has been rasterized into the SoftwareOcclusionBuffer, so mustn't be tested against it.
+    const osg::RefMatrix* softwareOcclusionProjection = _softwareOcclusionProjection;
+    _softwareOcclusionProjection = 0;
 
     if (isCulled(node))
     {
+        _softwareOcclusionProjection = softwareOcclusionProjection;
         popOccludersCurrentMask(_nodePath);
         return;
     }
@@ -1427,6 +1601,8 @@ void CullVisitor::apply(osg::OccluderNode& node)
     // pop the culling mode.
     popCurrentMask();
 
+    _softwareOcclusionProjection = softwareOcclusionProjection;
+
     // pop the current mask for the disabled occluder
     popOccludersCurrentMask(_nodePath);
 }
@@ -1463,3 +1639,433 @@ void CullVisitor::apply(osg::OcclusionQueryNode& node)
     popCurrentMask();
 }
 
+
+/** Thread pool and per task state of CullVisitor::traverseInParallel(). The worker threads each own a clone of the
+  * CullVisitor, so keep their own RenderLeaf and matrix pools from frame to frame, while each task culls into its own
+  * StateGraph and RenderStage fragment which are merged into the parent CullVisitor's once all the tasks are done.*/
+class CullVisitor::ParallelCull : public osg::Referenced
+{
+    public:
+
+        ParallelCull(const CullVisitor& cv, unsigned int numThreads);
+
+        unsigned int getNumThreads() const { return static_cast<unsigned int>(_cullVisitors.size()); }
+
+        void traverse(CullVisitor& cv, osg::Group& group);
+
+    protected:
+
+        virtual ~ParallelCull();
+
+        class CullThread : public OpenThreads::Thread
+        {
+            public:
+
+                CullThread(ParallelCull* parallelCull, CullVisitor* cv):
+                    _parallelCull(parallelCull),
+                    _cv(cv) {}
+
+                virtual void run()
+                {
+                    unsigned int frameNumber = 0;
+                    for(;;)
+                    {
+                        {
+                            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_parallelCull->_mutex);
+                            while (_parallelCull->_frameNumber==frameNumber && !_parallelCull->_done)
+                            {
+                                _parallelCull->_tasksReady.wait(&(_parallelCull->_mutex));
+                            }
+                            if (_parallelCull->_done) return;
+                            frameNumber = _parallelCull->_frameNumber;
+                        }
+
+                        _parallelCull->cullTasks(_cv);
+                    }
+                }
+
+            protected:
+
+                // not ref_ptr's, the ParallelCull joins its threads before it is deleted.
+                ParallelCull*   _parallelCull;
+                CullVisitor*    _cv;
+        };
+
+        friend class CullThread;
+
+        struct Item
+        {
+            Item(osg::Node* node, unsigned int nodePathIndex): _node(node), _nodePathIndex(nodePathIndex) {}
+
+            osg::Node*      _node;
+            unsigned int    _nodePathIndex;
+        };
+
+        struct Task
+        {
+            Task(): _begin(0), _end(0), _numRenderLeaves(0) {}
+
+            unsigned int                _begin;
+            unsigned int                _end;
+            osg::ref_ptr<StateGraph>    _stateGraph;
+            osg::ref_ptr<RenderStage>   _renderStage;
+            unsigned int                _numRenderLeaves;
+        };
+
+        typedef std::vector<Item>                               ItemList;
+        typedef std::vector<osg::NodePath>                      NodePathList;
+        typedef std::vector<Task>                               TaskList;
+        typedef std::vector<const osg::StateSet*>               StateSetList;
+        typedef std::vector< osg::ref_ptr<CullVisitor> >        CullVisitorList;
+        typedef std::vector<CullThread*>                        CullThreads;
+
+        /** Return true if node is a Group that CullVisitor::apply(Group&) would cull, and can be culled here and replaced by its children.*/
+        static bool isSplittable(const osg::Node& node)
+        {
+            return (typeid(node)==typeid(osg::Group) || typeid(node)==typeid(osg::CoordinateSystemNode)) &&
+                   node.getStateSet()==0 &&
+                   node.getCullCallback()==0 &&
+                   node.asGroup()->getNumChildren()>0;
+        }
+
+        void collectItems(CullVisitor& cv, osg::Group& group);
+
+        void setUpCullVisitor(CullVisitor& cv, CullVisitor& worker);
+
+        void cullTasks(CullVisitor* worker);
+
+        void cullTask(CullVisitor* worker, Task& task);
+
+        ItemList                    _items;
+        ItemList                    _splitItems;
+        NodePathList                _nodePaths;         // only the first _numNodePaths are in use, the rest are kept for reuse.
+        unsigned int                _numNodePaths;
+        TaskList                    _tasks;
+        StateSetList                _stateSets;
+        unsigned int                _startRenderLeafNumber;
+
+        CullVisitorList             _cullVisitors;      // _cullVisitors[0] is used by the calling thread.
+        CullThreads                 _threads;
+
+        OpenThreads::Mutex          _mutex;
+        OpenThreads::Condition      _tasksReady;
+        OpenThreads::Condition      _tasksDone;
+        unsigned int                _frameNumber;
+        unsigned int                _numTasks;
+        unsigned int                _nextTask;
+        unsigned int                _numTasksDone;
+        bool                        _done;
+};
+
+CullVisitor::ParallelCull::ParallelCull(const CullVisitor& cv, unsigned int numThreads):
+    _numNodePaths(0),
+    _startRenderLeafNumber(0),
+    _frameNumber(0),
+    _numTasks(0),
+    _nextTask(0),
+    _numTasksDone(0),
+    _done(false)
+{
+    // the drawables and state sets are referenced from several threads at once.
+    osg::Referenced::setThreadSafeReferenceCounting(true);
+
+    for(unsigned int i=0; i<numThreads; ++i)
+    {
+        _cullVisitors.push_back(cv.clone());
+    }
+
+    for(unsigned int i=1; i<numThreads; ++i)
+    {
+        CullThread* thread = new CullThread(this, _cullVisitors[i].get());
+        if (thread->start()==0) _threads.push_back(thread);
+        else delete thread;
+    }
+
+    OSG_NOTIFY(osg::INFO)<<"CullVisitor started "<<_threads.size()<<" parallel cull threads"<<std::endl;
+}
+
+CullVisitor::ParallelCull::~ParallelCull()
+{
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        _done = true;
+        _tasksReady.broadcast();
+    }
+
+    for(CullThreads::iterator itr = _threads.begin();
+        itr != _threads.end();
+        ++itr)
+    {
+        (*itr)->join();
+        delete *itr;
+    }
+}
+
+void CullVisitor::ParallelCull::collectItems(CullVisitor& cv, osg::Group& group)
+{
+    _items.clear();
+
+    if (_nodePaths.empty()) _nodePaths.resize(1);
+    _nodePaths[0] = cv.getNodePath();
+    _numNodePaths = 1;
+    for(unsigned int i=0; i<group.getNumChildren(); ++i)
+    {
+        _items.push_back(Item(group.getChild(i), 0));
+    }
+
+    // replace the plain Group's by their children, a level at a time, until there are a few subgraphs per thread.
+    const unsigned int minNumItems = getNumThreads()*4;
+    const unsigned int maxNumLevels = 8;
+
+    ItemList& items = _splitItems;
+    for(unsigned int level=0; level<maxNumLevels && _items.size()<minNumItems; ++level)
+    {
+        bool split = false;
+        items.clear();
+        for(ItemList::iterator itr=_items.begin();
+            itr!=_items.end();
+            ++itr)
+        {
+            osg::Node& node = *(itr->_node);
+            if (!isSplittable(node))
+            {
+                items.push_back(*itr);
+                continue;
+            }
+
+            split = true;
+
+            // as CullVisitor::apply(Group&), less pushing the culling mask so the children are tested against all planes.
+            if (!cv.validNodeMask(node) || cv.isCulled(node)) continue;
+
+            unsigned int nodePathIndex = _numNodePaths++;
+            if (_nodePaths.size()<_numNodePaths) _nodePaths.resize(_numNodePaths);
+            _nodePaths[nodePathIndex] = _nodePaths[itr->_nodePathIndex];
+            _nodePaths[nodePathIndex].push_back(&node);
+
+            osg::Group& childGroup = *(node.asGroup());
+            for(unsigned int i=0; i<childGroup.getNumChildren(); ++i)
+            {
+                items.push_back(Item(childGroup.getChild(i), nodePathIndex));
+            }
+        }
+        _items.swap(items);
+
+        if (!split) break;
+    }
+}
+
+void CullVisitor::ParallelCull::setUpCullVisitor(CullVisitor& cv, CullVisitor& worker)
+{
+    worker.reset();
+
+    worker.setTraversalMode(cv.getTraversalMode());
+    worker.setTraversalMask(cv.getTraversalMask());
+    worker.setNodeMaskOverride(cv.getNodeMaskOverride());
+    worker.setTraversalNumber(cv.getTraversalNumber());
+    worker.setFrameStamp(const_cast<osg::FrameStamp*>(cv.getFrameStamp()));
+    worker.setDatabaseRequestHandler(cv.getDatabaseRequestHandler());
+    worker.setImageRequestHandler(cv.getImageRequestHandler());
+    worker.setUserData(cv.getUserData());
+    worker.setRenderInfo(cv.getRenderInfo());
+
+    // copy the matrix, viewport and culling stacks, and the cull settings, keeping the worker's own pool of matrices.
+    osg::CullStack::MatrixList reuseMatrixList;
+    reuseMatrixList.swap(worker._reuseMatrixList);
+    osg::ref_ptr<osg::RefMatrix> identity = worker._identity;
+
+    static_cast<osg::CullStack&>(worker) = cv;
+
+    worker._reuseMatrixList.swap(reuseMatrixList);
+    worker._currentReuseMatrixIndex = 0;
+    worker._identity = identity;
+    worker._back_modelviewCullingStack = worker._index_modelviewCullingStack>0 ?
+        &(worker._modelviewCullingStack[worker._index_modelviewCullingStack-1]) : 0;
+    worker._numLODEvaluations = 0;
+    worker._numLODEvaluationsSkipped = 0;
+}
+
+void CullVisitor::ParallelCull::cullTasks(CullVisitor* worker)
+{
+    for(;;)
+    {
+        unsigned int taskNum;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            if (_nextTask>=_numTasks) return;
+            taskNum = _nextTask++;
+        }
+
+        cullTask(worker, _tasks[taskNum]);
+
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            if (++_numTasksDone==_numTasks) _tasksDone.broadcast();
+        }
+    }
+}
+
+void CullVisitor::ParallelCull::cullTask(CullVisitor* worker, Task& task)
+{
+    worker->setStateGraph(task._stateGraph.get());
+    worker->setRenderStage(task._renderStage.get());
+
+    for(StateSetList::iterator itr=_stateSets.begin();
+        itr!=_stateSets.end();
+        ++itr)
+    {
+        worker->pushStateSet(*itr);
+    }
+
+    worker->_traversalNumber = _startRenderLeafNumber;
+
+    unsigned int nodePathIndex = _numNodePaths;
+    for(unsigned int i=task._begin; i<task._end; ++i)
+    {
+        const Item& item = _items[i];
+        if (item._nodePathIndex!=nodePathIndex)
+        {
+            nodePathIndex = item._nodePathIndex;
+            worker->_nodePath = _nodePaths[nodePathIndex];
+        }
+        item._node->accept(*worker);
+    }
+
+    for(unsigned int i=0; i<_stateSets.size(); ++i)
+    {
+        worker->popStateSet();
+    }
+
+    worker->computeNearPlane();
+
+    task._numRenderLeaves = worker->_traversalNumber - _startRenderLeafNumber;
+}
+
+void CullVisitor::ParallelCull::traverse(CullVisitor& cv, osg::Group& group)
+{
+    collectItems(cv, group);
+
+    if (_items.size()<2)
+    {
+        // not enough to share out, cull what is left here.
+        osg::NodePath nodePath = cv._nodePath;
+        for(ItemList::iterator itr=_items.begin();
+            itr!=_items.end();
+            ++itr)
+        {
+            cv._nodePath = _nodePaths[itr->_nodePathIndex];
+            itr->_node->accept(cv);
+        }
+        cv._nodePath = nodePath;
+        return;
+    }
+
+    // the StateSet's pushed so far, which each task pushes onto its own StateGraph in turn.
+    _stateSets.clear();
+    for(StateGraph* sg = cv._currentStateGraph; sg && sg->_parent; sg = sg->_parent)
+    {
+        _stateSets.push_back(sg->getStateSet());
+    }
+    std::reverse(_stateSets.begin(), _stateSets.end());
+
+    _startRenderLeafNumber = cv._traversalNumber;
+
+    RenderStage* renderStage = cv.getCurrentRenderStage();
+
+    // share the subgraphs out in traversal order, a few tasks per thread to even out the load.
+    unsigned int numTasks = osg::minimum(static_cast<unsigned int>(_items.size()), getNumThreads()*4);
+    if (_tasks.size()<numTasks) _tasks.resize(numTasks);
+    for(unsigned int i=0; i<numTasks; ++i)
+    {
+        Task& task = _tasks[i];
+        task._begin = static_cast<unsigned int>((static_cast<unsigned long long>(_items.size())*i)/numTasks);
+        task._end = static_cast<unsigned int>((static_cast<unsigned long long>(_items.size())*(i+1))/numTasks);
+        task._numRenderLeaves = 0;
+
+        if (!task._stateGraph.valid()) task._stateGraph = new StateGraph;
+        if (!task._renderStage.valid()) task._renderStage = new RenderStage;
+
+        task._renderStage->reset();
+        task._renderStage->setCamera(renderStage->getCamera());
+        task._renderStage->setViewport(renderStage->getViewport());
+    }
+
+    for(CullVisitorList::iterator itr=_cullVisitors.begin();
+        itr!=_cullVisitors.end();
+        ++itr)
+    {
+        setUpCullVisitor(cv, **itr);
+    }
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        _numTasks = numTasks;
+        _nextTask = 0;
+        _numTasksDone = 0;
+        ++_frameNumber;
+        _tasksReady.broadcast();
+    }
+
+    cullTasks(_cullVisitors[0].get());
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        while (_numTasksDone<_numTasks)
+        {
+            _tasksDone.wait(&_mutex);
+        }
+    }
+
+    // merge the tasks in traversal order, numbering their RenderLeaf's on from the previous task's.
+    unsigned int renderLeafNumber = _startRenderLeafNumber;
+    for(unsigned int i=0; i<numTasks; ++i)
+    {
+        Task& task = _tasks[i];
+
+        // prune while the leaves are still in place, keeping the task's StateGraph's in use to be reused next frame.
+        task._stateGraph->prune(StateGraph::DEFAULT_MAX_NUM_FRAMES_EMPTY);
+
+        renderStage->merge(task._renderStage.get(), cv.getRootStateGraph(), task._stateGraph.get(), renderLeafNumber - _startRenderLeafNumber);
+        renderLeafNumber += task._numRenderLeaves;
+
+        task._renderStage->reset();
+    }
+    cv._traversalNumber = renderLeafNumber;
+
+    for(CullVisitorList::iterator itr=_cullVisitors.begin();
+        itr!=_cullVisitors.end();
+        ++itr)
+    {
+        CullVisitor& worker = **itr;
+        if (worker._computed_znear<cv._computed_znear) cv._computed_znear = worker._computed_znear;
+        if (worker._computed_zfar>cv._computed_zfar) cv._computed_zfar = worker._computed_zfar;
+        cv._numLODEvaluations += worker._numLODEvaluations;
+        cv._numLODEvaluationsSkipped += worker._numLODEvaluationsSkipped;
+
+        cv._budgetLeaves.insert(cv._budgetLeaves.end(), worker._budgetLeaves.begin(), worker._budgetLeaves.end());
+        worker._budgetLeaves.clear();
+
+        worker._nodePath.clear();
+    }
+}
+
+void CullVisitor::traverseInParallel(osg::Group& group)
+{
+    unsigned int numThreads = getNumCullThreads();
+    if (numThreads<2)
+    {
+        _parallelCull = 0;
+        traverse(group);
+        return;
+    }
+
+    if (!_parallelCull.valid() || _parallelCull->getNumThreads()!=numThreads)
+    {
+        _parallelCull = new ParallelCull(*this, numThreads);
+
+        // as the viewer does for its scenes when threading, the subgraph is referenced from all the threads at once.
+        group.setThreadSafeRefUnref(true);
+    }
+
+    _parallelCull->traverse(*this, group);
+}
@@ -18,9 +18,15 @@
 #include <osg/Notify>
 #include <osg/io_utils>
 #include <osg/TriangleFunctor>
+#include <osg/TriangleIndexFunctor>
 #include <osg/KdTree>
 #include <osg/Timer>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+    #define OSG_LINESEGMENTINTERSECTOR_USE_SSE2
+    #include <emmintrin.h>
+#endif
+
 using namespace osgUtil;
 
 namespace LineSegmentIntersectorUtils
@@ -28,7 +34,8 @@ namespace LineSegmentIntersectorUtils
 
     struct TriangleIntersection
     {
-        TriangleIntersection(unsigned int index, const osg::Vec3& normal, float r1, const osg::Vec3* v1, float r2, const osg::Vec3* v2, float r3, const osg::Vec3* v3):
+        TriangleIntersection(float ratio, unsigned int index, const osg::Vec3& normal, float r1, const osg::Vec3* v1, float r2, const osg::Vec3* v2, float r3, const osg::Vec3* v3):
+            _ratio(ratio),
             _index(index),
             _normal(normal),
             _r1(r1),
@@ -38,21 +45,19 @@ namespace LineSegmentIntersectorUtils
             _r3(r3),
             _v3(v3) {}
 
+        float               _ratio;
         unsigned int        _index;
-        const osg::Vec3     _normal;
+        osg::Vec3           _normal;
         float               _r1;
         const osg::Vec3*    _v1;        
         float               _r2;
         const osg::Vec3*    _v2;        
         float               _r3;
         const osg::Vec3*    _v3;
-        
-    protected:
-    
-        TriangleIntersection& operator = (const TriangleIntersection&) { return *this; }
     };
 
-    typedef std::multimap<float,TriangleIntersection> TriangleIntersections;
+    // the intersections are sorted as they are inserted into the LineSegmentIntersector, so are just collected here.
+    typedef std::vector<TriangleIntersection> TriangleIntersections;
 
     struct TriangleIntersector
     {
@@ -185,11 +190,11 @@ namespace LineSegmentIntersectorUtils
 
             if (treatVertexDataAsTemporary)
             {
-                _intersections.insert(std::pair<const float,TriangleIntersection>(r,TriangleIntersection(_index-1,normal,r1,0,r2,0,r3,0)));
+                _intersections.push_back(TriangleIntersection(r,_index-1,normal,r1,0,r2,0,r3,0));
             }
             else
             {
-                _intersections.insert(std::pair<const float,TriangleIntersection>(r,TriangleIntersection(_index-1,normal,r1,&v1,r2,&v2,r3,&v3)));
+                _intersections.push_back(TriangleIntersection(r,_index-1,normal,r1,&v1,r2,&v2,r3,&v3));
             }
             _hit = true;
 
@@ -197,6 +202,225 @@ namespace LineSegmentIntersectorUtils
 
     };
 
+    /** Intersects a line segment with the triangles of a Geometry with an osg::Vec3Array vertex array, used with
+      * osg::TriangleIndexFunctor so that the triangles' vertex indices are read straight from the primitive sets, in the
+      * same order, and so with the same primitive indices, as TriangleFunctor gives. The triangles are gathered into
+      * blocks of four that are each tested against the segment at once with the Moller-Trumbore test, their vertices
+      * loaded and transposed to be held one component at a time.*/
+    struct TriangleBatchIntersector
+    {
+        enum { BLOCK_SIZE = 4 };
+
+        struct Hit
+        {
+            float           ratio;
+            unsigned int    index;
+            unsigned int    p0, p1, p2;
+            float           u, v;
+        };
+
+        typedef std::vector<Hit> Hits;
+
+        const osg::Vec3*    _vertices;
+        unsigned int        _numVertices;
+
+        float               _s[3];
+        float               _d[3];
+
+        unsigned int        _index;
+        unsigned int        _numInBlock;
+        unsigned int        _p[3][BLOCK_SIZE];
+        unsigned int        _blockIndex[BLOCK_SIZE];
+
+        Hits                _hits;
+
+        TriangleBatchIntersector():
+            _vertices(0),
+            _numVertices(0),
+            _index(0),
+            _numInBlock(0) {}
+
+        void set(const osg::Vec3d& start, const osg::Vec3d& end, const osg::Vec3Array& vertices)
+        {
+            _vertices = &vertices.front();
+            _numVertices = vertices.size();
+
+            // the direction is left unnormalized so that the distance along it is the ratio along the segment.
+            for(unsigned int axis=0; axis<3; ++axis)
+            {
+                _s[axis] = start[axis];
+                _d[axis] = end[axis]-start[axis];
+            }
+
+            _index = 0;
+            _numInBlock = 0;
+            _hits.clear();
+        }
+
+        inline void operator () (unsigned int p0, unsigned int p1, unsigned int p2)
+        {
+            unsigned int index = _index++;
+
+            if (p0>=_numVertices || p1>=_numVertices || p2>=_numVertices) return;
+
+            unsigned int k = _numInBlock;
+            _p[0][k] = p0;
+            _p[1][k] = p1;
+            _p[2][k] = p2;
+            _blockIndex[k] = index;
+
+            if (++_numInBlock==BLOCK_SIZE) flush();
+        }
+
+        /** Test the triangles gathered since the last block was tested, to be called once all the triangles have been passed in.*/
+        void flush()
+        {
+            if (_numInBlock==0) return;
+
+            // pad out the block by repeating its first triangle, masked out below.
+            for(unsigned int k=_numInBlock; k<BLOCK_SIZE; ++k)
+            {
+                _p[0][k] = _p[0][0];
+                _p[1][k] = _p[1][0];
+                _p[2][k] = _p[2][0];
+            }
+
+            float u[BLOCK_SIZE], v[BLOCK_SIZE], t[BLOCK_SIZE];
+            unsigned int mask = intersectBlock(u, v, t) & ((1u<<_numInBlock)-1);
+
+            for(unsigned int k=0; mask!=0; ++k, mask>>=1)
+            {
+                if ((mask & 1)==0) continue;
+
+                Hit hit;
+                hit.ratio = t[k];
+                hit.index = _blockIndex[k];
+                hit.p0 = _p[0][k];
+                hit.p1 = _p[1][k];
+                hit.p2 = _p[2][k];
+                hit.u = u[k];
+                hit.v = v[k];
+                _hits.push_back(hit);
+            }
+
+            _numInBlock = 0;
+        }
+
+#ifdef OSG_LINESEGMENTINTERSECTOR_USE_SSE2
+        inline __m128 loadVertex(unsigned int i) const
+        {
+            // loading a vertex as four floats would read past the end of the array for its last vertex.
+            const float* v = _vertices[i].ptr();
+            return (i+1<_numVertices) ? _mm_loadu_ps(v) : _mm_set_ps(0.0f, v[2], v[1], v[0]);
+        }
+
+        inline void loadVertices(const unsigned int* p, __m128& x, __m128& y, __m128& z) const
+        {
+            __m128 r0 = loadVertex(p[0]);
+            __m128 r1 = loadVertex(p[1]);
+            __m128 r2 = loadVertex(p[2]);
+            __m128 r3 = loadVertex(p[3]);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            x = r0;
+            y = r1;
+            z = r2;
+        }
+#endif
+
+        /** Test the segment against the block's four triangles, returning a mask of those hit, and for them the
+          * barycentric coordinates of the hit along their edges from their first vertex and its ratio along the segment.*/
+        unsigned int intersectBlock(float* u, float* v, float* t) const
+        {
+#ifdef OSG_LINESEGMENTINTERSECTOR_USE_SSE2
+            __m128 v0x, v0y, v0z, e1x, e1y, e1z, e2x, e2y, e2z;
+            loadVertices(_p[0], v0x, v0y, v0z);
+            loadVertices(_p[1], e1x, e1y, e1z);
+            loadVertices(_p[2], e2x, e2y, e2z);
+            e1x = _mm_sub_ps(e1x, v0x); e1y = _mm_sub_ps(e1y, v0y); e1z = _mm_sub_ps(e1z, v0z);
+            e2x = _mm_sub_ps(e2x, v0x); e2y = _mm_sub_ps(e2y, v0y); e2z = _mm_sub_ps(e2z, v0z);
+
+            __m128 dx = _mm_set1_ps(_d[0]), dy = _mm_set1_ps(_d[1]), dz = _mm_set1_ps(_d[2]);
+
+            // P = d ^ e2
+            __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+            __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+            __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+            __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+
+            // rather than divide through by the determinant, compare against its magnitude after flipping the signs
+            // of the numerators by its sign, leaving the division for the triangles that are hit.
+            __m128 signMask = _mm_set1_ps(-0.0f);
+            __m128 detSign = _mm_and_ps(det, signMask);
+            __m128 absDet = _mm_andnot_ps(signMask, det);
+
+            // T = s - v0
+            __m128 tx = _mm_sub_ps(_mm_set1_ps(_s[0]), v0x);
+            __m128 ty = _mm_sub_ps(_mm_set1_ps(_s[1]), v0y);
+            __m128 tz = _mm_sub_ps(_mm_set1_ps(_s[2]), v0z);
+
+            __m128 uv = _mm_xor_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), detSign);
+
+            // Q = T ^ e1
+            __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+            __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+            __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+
+            __m128 vv = _mm_xor_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), detSign);
+            __m128 tv = _mm_xor_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), detSign);
+
+            __m128 zero = _mm_setzero_ps();
+            __m128 hit = _mm_cmpgt_ps(absDet, zero);
+            hit = _mm_and_ps(hit, _mm_cmpge_ps(uv, zero));
+            hit = _mm_and_ps(hit, _mm_cmpge_ps(vv, zero));
+            hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(uv, vv), absDet));
+            hit = _mm_and_ps(hit, _mm_cmpge_ps(tv, zero));
+            hit = _mm_and_ps(hit, _mm_cmple_ps(tv, absDet));
+
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_ps(hit));
+            if (mask)
+            {
+                __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), absDet);
+                _mm_storeu_ps(u, _mm_mul_ps(uv, inv_det));
+                _mm_storeu_ps(v, _mm_mul_ps(vv, inv_det));
+                _mm_storeu_ps(t, _mm_mul_ps(tv, inv_det));
+            }
+            return mask;
+#else
+            osg::Vec3 d(_d[0], _d[1], _d[2]);
+            osg::Vec3 s(_s[0], _s[1], _s[2]);
+
+            unsigned int mask = 0;
+            for(unsigned int k=0; k<BLOCK_SIZE; ++k)
+            {
+                const osg::Vec3& v0 = _vertices[_p[0][k]];
+                osg::Vec3 e1 = _vertices[_p[1][k]]-v0;
+                osg::Vec3 e2 = _vertices[_p[2][k]]-v0;
+
+                osg::Vec3 P = d ^ e2;
+                float det = e1 * P;
+                if (det==0.0f) continue;
+
+                float inv_det = 1.0f/det;
+
+                osg::Vec3 T = s-v0;
+                u[k] = (T * P) * inv_det;
+                if (u[k]<0.0f) continue;
+
+                osg::Vec3 Q = T ^ e1;
+                v[k] = (d * Q) * inv_det;
+                if (v[k]<0.0f || u[k]+v[k]>1.0f) continue;
+
+                t[k] = (e2 * Q) * inv_det;
+                if (t[k]<0.0f || t[k]>1.0f) continue;
+
+                mask |= (1<<k);
+            }
+            return mask;
+#endif
+        }
+    };
+
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -279,6 +503,12 @@ bool LineSegmentIntersector::enter(const osg::Node& node)
     return !node.isCullingActive() || intersects( node.getBound() );
 }
 
+bool LineSegmentIntersector::enterBoundingBox(const osg::BoundingBox& bb)
+{
+    osg::Vec3d s(_start), e(_end);
+    return intersectAndClip(s, e, bb);
+}
+
 void LineSegmentIntersector::leave()
 {
     // do nothing
@@ -352,27 +582,77 @@ void LineSegmentIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Dr
         return;
     }
 
+    // without a KdTree every triangle has to be tested, so for the usual Geometry read its triangles' vertex indices
+    // straight from its primitive sets and test them in blocks.
+    osg::Geometry* geometry = drawable->asGeometry();
+    osg::Vec3Array* vertices = geometry ? dynamic_cast<osg::Vec3Array*>(geometry->getVertexArray()) : 0;
+    if (vertices && !vertices->empty() && !geometry->getVertexIndices())
+    {
+        osg::TriangleIndexFunctor<LineSegmentIntersectorUtils::TriangleBatchIntersector> tbi;
+        tbi.set(s, e, *vertices);
+        drawable->accept(tbi);
+        tbi.flush();
+
+        for(LineSegmentIntersectorUtils::TriangleBatchIntersector::Hits::iterator hitr = tbi._hits.begin();
+            hitr != tbi._hits.end();
+            ++hitr)
+        {
+            const LineSegmentIntersectorUtils::TriangleBatchIntersector::Hit& triHit = *hitr;
+
+            // get ratio in s,e range
+            double ratio = triHit.ratio;
+
+            // remap ratio into _start, _end range
+            double remap_ratio = ((s-_start).length() + ratio * (e-s).length() )/(_end-_start).length();
+
+            Intersection hit;
+            hit.ratio = remap_ratio;
+            hit.matrix = iv.getModelMatrix();
+            hit.nodePath = iv.getNodePath();
+            hit.drawable = drawable;
+            hit.primitiveIndex = triHit.index;
+
+            hit.localIntersectionPoint = _start*(1.0-remap_ratio) + _end*remap_ratio;
+
+            const osg::Vec3& v0 = (*vertices)[triHit.p0];
+            osg::Vec3 normal = ((*vertices)[triHit.p1]-v0)^((*vertices)[triHit.p2]-v0);
+            normal.normalize();
+            hit.localIntersectionNormal = normal;
+
+            hit.indexList.reserve(3);
+            hit.ratioList.reserve(3);
+            hit.indexList.push_back(triHit.p0);
+            hit.ratioList.push_back(1.0-triHit.u-triHit.v);
+            hit.indexList.push_back(triHit.p1);
+            hit.ratioList.push_back(triHit.u);
+            hit.indexList.push_back(triHit.p2);
+            hit.ratioList.push_back(triHit.v);
+
+            insertIntersection(hit);
+        }
+
+        return;
+    }
+
     osg::TriangleFunctor<LineSegmentIntersectorUtils::TriangleIntersector> ti;
     ti.set(s,e);
     drawable->accept(ti);
 
     if (ti._hit)
     {
-        osg::Geometry* geometry = drawable->asGeometry();
-
         for(LineSegmentIntersectorUtils::TriangleIntersections::iterator thitr = ti._intersections.begin();
             thitr != ti._intersections.end();
             ++thitr)
         {
 
+            LineSegmentIntersectorUtils::TriangleIntersection& triHit = *thitr;
+
             // get ratio in s,e range
-            double ratio = thitr->first;
+            double ratio = triHit._ratio;
 
             // remap ratio into _start, _end range
             double remap_ratio = ((s-_start).length() + ratio * (e-s).length() )/(_end-_start).length();
 
-            LineSegmentIntersectorUtils::TriangleIntersection& triHit = thitr->second;
-
             Intersection hit;
             hit.ratio = remap_ratio;
             hit.matrix = iv.getModelMatrix();
@@ -386,27 +666,23 @@ void LineSegmentIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Dr
 
             hit.localIntersectionNormal = triHit._normal;
 
-            if (geometry)
+            if (vertices)
             {
-                osg::Vec3Array* vertices = dynamic_cast<osg::Vec3Array*>(geometry->getVertexArray());
-                if (vertices)
+                osg::Vec3* first = &(vertices->front());
+                if (triHit._v1)
+                {
+                    hit.indexList.push_back(triHit._v1-first);
+                    hit.ratioList.push_back(triHit._r1);
+                }
+                if (triHit._v2)
+                {
+                    hit.indexList.push_back(triHit._v2-first);
+                    hit.ratioList.push_back(triHit._r2);
+                }
+                if (triHit._v3)
                 {
-                    osg::Vec3* first = &(vertices->front());
-                    if (triHit._v1)
-                    {
-                        hit.indexList.push_back(triHit._v1-first);
-                        hit.ratioList.push_back(triHit._r1);
-                    }
-                    if (triHit._v2)
-                    {
-                        hit.indexList.push_back(triHit._v2-first);
-                        hit.ratioList.push_back(triHit._r2);
-                    }
-                    if (triHit._v3)
-                    {
-                        hit.indexList.push_back(triHit._v3-first);
-                        hit.ratioList.push_back(triHit._r3);
-                    }
+                    hit.indexList.push_back(triHit._v3-first);
+                    hit.ratioList.push_back(triHit._r3);
                 }
             }
             
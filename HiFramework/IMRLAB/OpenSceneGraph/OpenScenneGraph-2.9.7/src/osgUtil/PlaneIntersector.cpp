@@ -18,6 +18,7 @@
 #include <osg/Notify>
 #include <osg/io_utils>
 #include <osg/TriangleFunctor>
+#include <osg/KdTree>
 
 using namespace osgUtil;
 
@@ -559,6 +560,35 @@ namespace PlaneIntersectorUtils
 
     };
 
+    // traverses a KdTree, skipping the nodes the plane doesn't cut or that are outside the bounding polytope,
+    // and passes the triangles of the leaves reached on to a TriangleIntersector.
+    struct KdTreeIntersector
+    {
+        KdTreeIntersector(TriangleIntersector& ti, const osg::Plane& plane, const osg::Polytope& polytope):
+            _ti(ti),
+            _plane(plane),
+            _polytope(polytope) {}
+
+        inline bool enter(const osg::BoundingBox& bb)
+        {
+            if (_plane.intersect(bb)!=0) return false;
+            if (!_polytope.contains(bb)) return false;
+            _polytope.pushCurrentMask();
+            return true;
+        }
+
+        inline void leave() { _polytope.popCurrentMask(); }
+
+        inline void intersect(unsigned int, const osg::Vec3& v1, const osg::Vec3& v2, const osg::Vec3& v3)
+        {
+            _ti(v1, v2, v3, false);
+        }
+
+        TriangleIntersector&    _ti;
+        osg::Plane              _plane;
+        osg::Polytope           _polytope;
+    };
+
 }
 
 
@@ -639,6 +669,11 @@ bool PlaneIntersector::enter(const osg::Node& node)
            ( _plane.intersect(node.getBound())==0 && _polytope.contains(node.getBound()) );
 }
 
+bool PlaneIntersector::enterBoundingBox(const osg::BoundingBox& bb)
+{
+    return _plane.intersect(bb)==0 && _polytope.contains(bb);
+}
+
 
 void PlaneIntersector::leave()
 {
@@ -657,7 +692,17 @@ void PlaneIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Drawable
 
     osg::TriangleFunctor<PlaneIntersectorUtils::TriangleIntersector> ti;
     ti.set(_plane, _polytope, iv.getModelMatrix(), _recordHeightsAsAttributes, _em.get());
-    drawable->accept(ti);
+
+    osg::KdTree* kdTree = iv.getUseKdTreeWhenAvailable() ? dynamic_cast<osg::KdTree*>(drawable->getShape()) : 0;
+    if (kdTree && !kdTree->getNodes().empty())
+    {
+        PlaneIntersectorUtils::KdTreeIntersector kdTreeIntersector(ti, _plane, _polytope);
+        kdTree->intersect(kdTreeIntersector, kdTree->getNode(0));
+    }
+    else
+    {
+        drawable->accept(ti);
+    }
 
     ti._polylineConnector.consolidatePolylineLists();
 
@@ -15,6 +15,7 @@
 #include <osgUtil/PolytopeIntersector>
 
 #include <osg/Geometry>
+#include <osg/KdTree>
 #include <osg/Notify>
 #include <osg/io_utils>
 #include <osg/TemplatePrimitiveFunctor>
@@ -432,6 +433,57 @@ namespace PolytopeIntersectorUtils
         CandList_t _candidates;
     }; // class PolytopePrimitiveIntersector
 
+    /// traverses a KdTree, skipping the nodes outside the polytope, and passes the triangles of the leaves
+    /// reached on to a PolytopePrimitiveIntersector
+    class PolytopeKdTreeIntersector {
+    public:
+
+        PolytopeKdTreeIntersector(PolytopePrimitiveIntersector& intersector, const osg::Polytope& polytope,
+                                  const osg::KdTree::PrimitiveIndexList& primitiveIndices) :
+            _intersector(intersector), _polytope(polytope), _primitiveIndices(primitiveIndices) {}
+
+        bool enter(const osg::BoundingBox& bb)
+        {
+            if (!_polytope.contains(bb)) return false;
+            _polytope.pushCurrentMask();
+            return true;
+        }
+
+        void leave() { _polytope.popCurrentMask(); }
+
+        void intersect(unsigned int triangleIndex, const osg::Vec3& v1, const osg::Vec3& v2, const osg::Vec3& v3)
+        {
+            // the KdTree's triangles are reordered into its leaves, so report the index of the primitive each came
+            // from, as the geometry is counted without the KdTree. _index is incremented before it is used.
+            _intersector._index = _primitiveIndices[triangleIndex];
+            _intersector(v1, v2, v3, false);
+        }
+
+    private:
+        PolytopePrimitiveIntersector& _intersector;
+        osg::Polytope _polytope;
+        const osg::KdTree::PrimitiveIndexList& _primitiveIndices;
+    }; // class PolytopeKdTreeIntersector
+
+    /// return true if the geometry has no points or lines, so that its KdTree holds all of its primitives
+    bool hasOnlySurfaces(const osg::Geometry& geometry)
+    {
+        for (unsigned int i=0; i<geometry.getNumPrimitiveSets(); ++i)
+        {
+            switch(geometry.getPrimitiveSet(i)->getMode())
+            {
+                case(osg::PrimitiveSet::POINTS):
+                case(osg::PrimitiveSet::LINES):
+                case(osg::PrimitiveSet::LINE_STRIP):
+                case(osg::PrimitiveSet::LINE_LOOP):
+                    return false;
+                default:
+                    break;
+            }
+        }
+        return true;
+    }
+
 } // namespace PolytopeIntersectorUtils
 
 
@@ -537,6 +589,11 @@ bool PolytopeIntersector::enter(const osg::Node& node)
     return !node.isCullingActive() || _polytope.contains( node.getBound() );
 }
 
+bool PolytopeIntersector::enterBoundingBox(const osg::BoundingBox& bb)
+{
+    return _polytope.contains(bb);
+}
+
 
 void PolytopeIntersector::leave()
 {
@@ -552,7 +609,19 @@ void PolytopeIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Drawa
     func.setPolytope( _polytope, _referencePlane );
     func.setDimensionMask( _dimensionMask );
 
-    drawable->accept(func);
+    // the KdTree only holds triangles, so can only be used if no points or lines are wanted or there are none,
+    // and only if it knows which primitive each triangle came from.
+    osg::KdTree* kdTree = iv.getUseKdTreeWhenAvailable() ? dynamic_cast<osg::KdTree*>(drawable->getShape()) : 0;
+    if (kdTree && !kdTree->getNodes().empty() && kdTree->hasPrimitiveIndices() && drawable->asGeometry() && (_dimensionMask & DimTwo) &&
+        ((_dimensionMask & (DimZero|DimOne))==0 || PolytopeIntersectorUtils::hasOnlySurfaces(*drawable->asGeometry())))
+    {
+        PolytopeIntersectorUtils::PolytopeKdTreeIntersector kdTreeIntersector(func, _polytope, kdTree->getPrimitiveIndices());
+        kdTree->intersect(kdTreeIntersector, kdTree->getNode(0));
+    }
+    else
+    {
+        drawable->accept(func);
+    }
 
     if (func.intersections.empty()) return;
 
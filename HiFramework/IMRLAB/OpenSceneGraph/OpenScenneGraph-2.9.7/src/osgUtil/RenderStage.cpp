@@ -205,6 +205,82 @@ void RenderStage::addPostRenderStage(RenderStage* rs, int order)
     }
 }
 
+void RenderStage::merge(RenderBin* bin, StateGraph* rootStateGraph, StateGraph* binRootStateGraph, unsigned int traversalNumberOffset)
+{
+    RenderBin::merge(bin, rootStateGraph, binRootStateGraph, traversalNumberOffset);
+
+    RenderStage* stage = dynamic_cast<RenderStage*>(bin);
+    if (!stage || stage==this) return;
+
+    if (stage->_renderStageLighting.valid())
+    {
+        PositionalStateContainer::AttrMatrixList& attrList = stage->_renderStageLighting->getAttrMatrixList();
+        for(PositionalStateContainer::AttrMatrixList::iterator itr=attrList.begin();
+            itr!=attrList.end();
+            ++itr)
+        {
+            addPositionedAttribute(itr->second.get(), itr->first.get());
+        }
+
+        PositionalStateContainer::TexUnitAttrMatrixListMap& texAttrListMap = stage->_renderStageLighting->getTexUnitAttrMatrixListMap();
+        for(PositionalStateContainer::TexUnitAttrMatrixListMap::iterator titr=texAttrListMap.begin();
+            titr!=texAttrListMap.end();
+            ++titr)
+        {
+            for(PositionalStateContainer::AttrMatrixList::iterator itr=titr->second.begin();
+                itr!=titr->second.end();
+                ++itr)
+            {
+                addPositionedTextureAttribute(titr->first, itr->second.get(), itr->first.get());
+            }
+        }
+
+        stage->_renderStageLighting->reset();
+    }
+
+    for(RenderStageList::iterator pre_itr = stage->_preRenderList.begin();
+        pre_itr != stage->_preRenderList.end();
+        ++pre_itr)
+    {
+        pre_itr->second->mergeStateGraphs(rootStateGraph, binRootStateGraph, traversalNumberOffset);
+        addPreRenderStage(pre_itr->second.get(), pre_itr->first);
+    }
+    stage->_preRenderList.clear();
+
+    for(RenderStageList::iterator post_itr = stage->_postRenderList.begin();
+        post_itr != stage->_postRenderList.end();
+        ++post_itr)
+    {
+        post_itr->second->mergeStateGraphs(rootStateGraph, binRootStateGraph, traversalNumberOffset);
+        addPostRenderStage(post_itr->second.get(), post_itr->first);
+    }
+    stage->_postRenderList.clear();
+}
+
+void RenderStage::mergeStateGraphs(StateGraph* rootStateGraph, StateGraph* binRootStateGraph, unsigned int traversalNumberOffset)
+{
+    osg::ref_ptr<RenderBin> contents = new RenderBin;
+    contents->getStateGraphList().swap(_stateGraphList);
+    contents->getRenderBinList().swap(_bins);
+    _renderLeafList.clear();
+
+    RenderBin::merge(contents.get(), rootStateGraph, binRootStateGraph, traversalNumberOffset);
+
+    for(RenderStageList::iterator pre_itr = _preRenderList.begin();
+        pre_itr != _preRenderList.end();
+        ++pre_itr)
+    {
+        pre_itr->second->mergeStateGraphs(rootStateGraph, binRootStateGraph, traversalNumberOffset);
+    }
+
+    for(RenderStageList::iterator post_itr = _postRenderList.begin();
+        post_itr != _postRenderList.end();
+        ++post_itr)
+    {
+        post_itr->second->mergeStateGraphs(rootStateGraph, binRootStateGraph, traversalNumberOffset);
+    }
+}
+
 void RenderStage::drawPreRenderStages(osg::RenderInfo& renderInfo,RenderLeaf*& previous)
 {
     if (_preRenderList.empty()) return;
@@ -859,8 +859,7 @@ bool SceneView::cullStage(const osg::Matrixd& projection,const osg::Matrixd& mod
 
     if (!_camera || !viewport) return false;
 
-    osg::ref_ptr<RefMatrix> proj = new osg::RefMatrix(projection);
-    osg::ref_ptr<RefMatrix> mv = new osg::RefMatrix(modelview);
+    bool softwareOcclusion = false;
 
     // collect any occluder in the view frustum.
     if (_camera->containsOccluderNodes())
@@ -876,6 +875,14 @@ bool SceneView::cullStage(const osg::Matrixd& projection,const osg::Matrixd& mod
         
         _collectOccludersVisitor->setFrameStamp(_frameStamp.get());
 
+        softwareOcclusion = (getCullingMode() & osg::CullSettings::SOFTWARE_OCCLUSION_CULLING)!=0;
+        if (softwareOcclusion)
+        {
+            if (!_softwareOcclusionBuffer) _softwareOcclusionBuffer = new osg::SoftwareOcclusionBuffer;
+            _softwareOcclusionBuffer->clear(*viewport);
+        }
+        _collectOccludersVisitor->setSoftwareOcclusionBuffer(softwareOcclusion ? _softwareOcclusionBuffer.get() : 0);
+
         // use the frame number for the traversal number.
         if (_frameStamp.valid())
         {
@@ -883,8 +890,8 @@ bool SceneView::cullStage(const osg::Matrixd& projection,const osg::Matrixd& mod
         }
 
         _collectOccludersVisitor->pushViewport(viewport);
-        _collectOccludersVisitor->pushProjectionMatrix(proj.get());
-        _collectOccludersVisitor->pushModelViewMatrix(mv.get(),osg::Transform::ABSOLUTE_RF);
+        _collectOccludersVisitor->pushProjectionMatrix(_collectOccludersVisitor->createOrReuseMatrix(projection));
+        _collectOccludersVisitor->pushModelViewMatrix(_collectOccludersVisitor->createOrReuseMatrix(modelview),osg::Transform::ABSOLUTE_RF);
 
         // traverse the scene graph to search for occluder in there new positions.
         _collectOccludersVisitor->traverse(*_camera);
@@ -893,6 +900,12 @@ bool SceneView::cullStage(const osg::Matrixd& projection,const osg::Matrixd& mod
         _collectOccludersVisitor->popProjectionMatrix();
         _collectOccludersVisitor->popViewport();
         
+        if (softwareOcclusion)
+        {
+            _softwareOcclusionBuffer->finish();
+            _collectOccludersVisitor->setSoftwareOcclusionBuffer(0);
+        }
+
         // sort the occluder from largest occluder volume to smallest.
         _collectOccludersVisitor->removeOccludedOccluders();
         
@@ -932,6 +945,10 @@ bool SceneView::cullStage(const osg::Matrixd& projection,const osg::Matrixd& mod
     // achieves a certain amount of frame cohereancy of memory allocation.
     rendergraph->clean();
 
+    // take the matrices from the cull visitor's pool, now that the reset has released the last frame's references to them.
+    osg::ref_ptr<RefMatrix> proj = cullVisitor->createOrReuseMatrix(projection);
+    osg::ref_ptr<RefMatrix> mv = cullVisitor->createOrReuseMatrix(modelview);
+
     renderStage->setViewport(viewport);
     renderStage->setClearColor(_camera->getClearColor());
     renderStage->setClearDepth(_camera->getClearDepth());
@@ -968,16 +985,21 @@ bool SceneView::cullStage(const osg::Matrixd& projection,const osg::Matrixd& mod
     cullVisitor->pushProjectionMatrix(proj.get());
     cullVisitor->pushModelViewMatrix(mv.get(),osg::Transform::ABSOLUTE_RF);
 
+    // test against the software occluders only where the projection is the one they were rasterized with.
+    if (softwareOcclusion) cullVisitor->setSoftwareOcclusionBuffer(_softwareOcclusionBuffer.get(), proj.get());
+
     // traverse the scene graph to generate the rendergraph.    
     // If the camera has a cullCallback execute the callback which has the  
     // requirement that it must traverse the camera's children.
     {
        osg::NodeCallback* callback = _camera->getCullCallback();
        if (callback) (*callback)(_camera.get(), cullVisitor);
-       else cullVisitor->traverse(*_camera);
+       else cullVisitor->traverseInParallel(*_camera);
     }
 
 
+    if (softwareOcclusion) cullVisitor->setSoftwareOcclusionBuffer(0);
+
     cullVisitor->popModelViewMatrix();
     cullVisitor->popProjectionMatrix();
     cullVisitor->popViewport();
@@ -985,16 +1007,17 @@ bool SceneView::cullStage(const osg::Matrixd& projection,const osg::Matrixd& mod
     if (_localStateSet.valid()) cullVisitor->popStateSet();
     if (_secondaryStateSet.valid()) cullVisitor->popStateSet();
     if (_globalStateSet.valid()) cullVisitor->popStateSet();
-    
+
+    if (getCullingMode() & osg::CullSettings::BUDGET_CULLING) cullVisitor->cullToBudget();
 
     renderStage->sort();
 
-    // prune out any empty StateGraph children.
+    // prune out any StateGraph children that have been empty for a while.
     // note, this would be not required if the rendergraph had been
     // reset at the start of each frame (see top of this method) but
     // a clean has been used instead to try to minimize the amount of
     // allocation and deleteing of the StateGraph nodes.
-    rendergraph->prune();
+    rendergraph->prune(StateGraph::DEFAULT_MAX_NUM_FRAMES_EMPTY);
     
     // set the number of dynamic objects in the scene.    
     _dynamicObjectCount += renderStage->computeNumberOfDynamicRenderLeaves();
@@ -91,6 +91,8 @@ void CompositeViewer::constructorInit()
     _updateVisitor = new osgUtil::UpdateVisitor;
     _updateVisitor->setFrameStamp(_frameStamp.get());
 
+    _boundUpdater = new osgUtil::BoundUpdater;
+
     setViewerStats(new osg::Stats("CompsiteViewer"));
 }
 
@@ -1104,6 +1106,25 @@ void CompositeViewer::updateTraversal()
 
     }
 
+    // recompute the bounds dirtied by the update in one pass, rather than on demand during the cull traversal.
+    unsigned int numNodeBoundsRecomputed = 0;
+    unsigned int numDrawableBoundsRecomputed = 0;
+    if (_boundUpdater.valid())
+    {
+        for(Scenes::iterator sitr = scenes.begin();
+            sitr != scenes.end();
+            ++sitr)
+        {
+            Scene* scene = *sitr;
+            if (scene->getSceneData())
+            {
+                _boundUpdater->updateBounds(*(scene->getSceneData()));
+                numNodeBoundsRecomputed += _boundUpdater->getNumNodesRecomputed();
+                numDrawableBoundsRecomputed += _boundUpdater->getNumDrawablesRecomputed();
+            }
+        }
+    }
+
     if (getViewerStats() && getViewerStats()->collectStats("update"))
     {
         double endUpdateTraversal = osg::Timer::instance()->delta_s(_startTick, osg::Timer::instance()->tick());
@@ -1112,6 +1133,12 @@ void CompositeViewer::updateTraversal()
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal begin time", beginUpdateTraversal);
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal end time", endUpdateTraversal);
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal time taken", endUpdateTraversal-beginUpdateTraversal);
+
+        if (_boundUpdater.valid())
+        {
+            getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Number of node bounds recomputed", static_cast<double>(numNodeBoundsRecomputed));
+            getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Number of drawable bounds recomputed", static_cast<double>(numDrawableBoundsRecomputed));
+        }
     }
 
 }
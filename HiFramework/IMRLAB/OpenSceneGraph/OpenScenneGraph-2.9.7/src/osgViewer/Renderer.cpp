@@ -383,6 +383,15 @@ void Renderer::cull()
             stats->setAttribute(frameNumber, "Visible number of materials", static_cast<double>(sceneStats.nummat));
             stats->setAttribute(frameNumber, "Visible number of impostors", static_cast<double>(sceneStats.nimpostor));
 
+            osgUtil::CullVisitor* cullVisitor = sceneView->getCullVisitor();
+            if (cullVisitor)
+            {
+                stats->setAttribute(frameNumber, "Number of LOD evaluations", static_cast<double>(cullVisitor->getNumLODEvaluations()));
+                stats->setAttribute(frameNumber, "Number of LOD evaluations skipped", static_cast<double>(cullVisitor->getNumLODEvaluationsSkipped()));
+                stats->setAttribute(frameNumber, "Number of drawables culled by budget", static_cast<double>(cullVisitor->getNumDrawablesCulledByBudget()));
+                stats->setAttribute(frameNumber, "Number of primitives culled by budget", static_cast<double>(cullVisitor->getNumPrimitivesCulledByBudget()));
+            }
+
             osgUtil::Statistics::PrimitiveCountMap& pcm = sceneStats.getPrimitiveCountMap();
             stats->setAttribute(frameNumber, "Visible number of GL_POINTS", static_cast<double>(pcm[GL_POINTS]));
             stats->setAttribute(frameNumber, "Visible number of GL_LINES", static_cast<double>(pcm[GL_LINES]));
@@ -600,6 +609,15 @@ void Renderer::cull_draw()
         stats->setAttribute(frameNumber, "Visible depth", static_cast<double>(sceneStats.depth));
         stats->setAttribute(frameNumber, "Visible number of materials", static_cast<double>(sceneStats.nummat));
         stats->setAttribute(frameNumber, "Visible number of impostors", static_cast<double>(sceneStats.nimpostor));
+
+        osgUtil::CullVisitor* cullVisitor = sceneView->getCullVisitor();
+        if (cullVisitor)
+        {
+            stats->setAttribute(frameNumber, "Number of LOD evaluations", static_cast<double>(cullVisitor->getNumLODEvaluations()));
+            stats->setAttribute(frameNumber, "Number of LOD evaluations skipped", static_cast<double>(cullVisitor->getNumLODEvaluationsSkipped()));
+            stats->setAttribute(frameNumber, "Number of drawables culled by budget", static_cast<double>(cullVisitor->getNumDrawablesCulledByBudget()));
+            stats->setAttribute(frameNumber, "Number of primitives culled by budget", static_cast<double>(cullVisitor->getNumPrimitivesCulledByBudget()));
+        }
     }
 
 #if 0
@@ -204,6 +204,8 @@ void Viewer::constructorInit()
     _updateVisitor = new osgUtil::UpdateVisitor;
     _updateVisitor->setFrameStamp(_frameStamp.get());
 
+    _boundUpdater = new osgUtil::BoundUpdater;
+
     setViewerStats(new osg::Stats("Viewer"));
 }
 
@@ -267,6 +269,7 @@ void Viewer::take(View& rhs)
         _eventVisitor = rhs_viewer->_eventVisitor;
         _updateOperations = rhs_viewer->_updateOperations;
         _updateVisitor = rhs_viewer->_updateVisitor;
+        _boundUpdater = rhs_viewer->_boundUpdater;
         _realizeOperation = rhs_viewer->_realizeOperation;
         _currentContext = rhs_viewer->_currentContext;
 
@@ -280,6 +283,7 @@ void Viewer::take(View& rhs)
         rhs_viewer->_eventVisitor = 0;
         rhs_viewer->_updateOperations = 0;
         rhs_viewer->_updateVisitor = 0;
+        rhs_viewer->_boundUpdater = 0;
         rhs_viewer->_realizeOperation = 0;
         rhs_viewer->_currentContext = 0;
     }
@@ -984,6 +988,12 @@ void Viewer::updateTraversal()
         _updateVisitor->setTraversalMode(tm);
     }
 
+    // recompute the bounds dirtied by the update in one pass, rather than on demand during the cull traversal.
+    if (_boundUpdater.valid() && _scene->getSceneData())
+    {
+        _boundUpdater->updateBounds(*(_scene->getSceneData()));
+    }
+
     if (_cameraManipulator.valid())
     {
         setFusionDistance( getCameraManipulator()->getFusionDistanceMode(),
@@ -1002,6 +1012,12 @@ void Viewer::updateTraversal()
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal begin time", beginUpdateTraversal);
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal end time", endUpdateTraversal);
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal time taken", endUpdateTraversal-beginUpdateTraversal);
+
+        if (_boundUpdater.valid())
+        {
+            getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Number of node bounds recomputed", static_cast<double>(_boundUpdater->getNumNodesRecomputed()));
+            getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Number of drawable bounds recomputed", static_cast<double>(_boundUpdater->getNumDrawablesRecomputed()));
+        }
     }
 }
 
@@ -12,6 +12,7 @@
 */
 #include <osg/CollectOccludersVisitor>
 #include <osg/Transform>
+#include <osg/Geode>
 #include <osg/Switch>
 #include <osg/LOD>
 #include <osg/OccluderNode>
@@ -33,6 +34,7 @@ CollectOccludersVisitor::CollectOccludersVisitor():
     _minimumShadowOccluderVolume = 0.005f;
     _maximumNumberOfActiveOccluders = 10;
     _createDrawables = false;
+    _numRasterizingOccluderNodes = 0;
     
 }
 
@@ -44,6 +46,7 @@ void CollectOccludersVisitor::reset()
 {
     CullStack::reset();
     _occluderSet.clear();
+    _numRasterizingOccluderNodes = 0;
 }
 
 float CollectOccludersVisitor::getDistanceToEyePoint(const Vec3& pos, bool withLODScale) const
@@ -80,6 +83,18 @@ void CollectOccludersVisitor::apply(osg::Node& node)
     popCurrentMask();
 }
 
+void CollectOccludersVisitor::apply(osg::Geode& node)
+{
+    if (_numRasterizingOccluderNodes==0 || isCulled(node)) return;
+
+    const Matrix& mvpw = *getMVPW();
+    for(unsigned int i=0; i<node.getNumDrawables(); ++i)
+    {
+        const Drawable* drawable = node.getDrawable(i);
+        if (drawable && !isCulled(drawable->getBound())) _softwareOcclusionBuffer->rasterize(*drawable, mvpw);
+    }
+}
+
 void CollectOccludersVisitor::apply(osg::Transform& node)
 {
     if (isCulled(node)) return;
@@ -87,9 +102,9 @@ void CollectOccludersVisitor::apply(osg::Transform& node)
     // push the culling mode.
     pushCurrentMask();
 
-    ref_ptr<osg::RefMatrix> matrix = createOrReuseMatrix(*getModelViewMatrix());
+    osg::RefMatrix* matrix = createOrReuseMatrix(*getModelViewMatrix());
     node.computeLocalToWorldMatrix(*matrix,this);
-    pushModelViewMatrix(matrix.get(), node.getReferenceFrame());
+    pushModelViewMatrix(matrix, node.getReferenceFrame());
     
     handle_cull_callbacks_and_traverse(node);
 
@@ -106,8 +121,8 @@ void CollectOccludersVisitor::apply(osg::Projection& node)
     // push the culling mode.
     pushCurrentMask();
 
-    ref_ptr<osg::RefMatrix> matrix = createOrReuseMatrix(node.getMatrix());
-    pushProjectionMatrix(matrix.get());
+    osg::RefMatrix* matrix = createOrReuseMatrix(node.getMatrix());
+    pushProjectionMatrix(matrix);
     
     handle_cull_callbacks_and_traverse(node);
 
@@ -178,8 +193,21 @@ void CollectOccludersVisitor::apply(osg::OccluderNode& node)
         }
     }
 
+    bool rasterize = _softwareOcclusionBuffer.valid();
+    if (rasterize)
+    {
+        // a polygon with holes can't be rasterized as one, leave it to the subgraph.
+        if (node.getOccluder() && node.getOccluder()->getHoleList().empty())
+        {
+            _softwareOcclusionBuffer->rasterize(node.getOccluder()->getOccluder(), *getMVPW());
+        }
+        ++_numRasterizingOccluderNodes;
+    }
+
     handle_cull_callbacks_and_traverse(node);
 
+    if (rasterize) --_numRasterizingOccluderNodes;
+
     // pop the culling mode.
     popCurrentMask();
     
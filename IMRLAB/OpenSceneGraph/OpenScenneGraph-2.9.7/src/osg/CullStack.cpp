@@ -16,8 +16,16 @@
 #include <osg/Notify>
 #include <osg/io_utils>
 
+#include <OpenThreads/Atomic>
+
 using namespace osg;
 
+namespace
+{
+    // 0 is never handed out, it marks a LOD without a selection.
+    OpenThreads::Atomic s_lodSelectionID;
+}
+
 CullStack::CullStack()
 {
     _frustumVolume=-1.0f;
@@ -28,6 +36,12 @@ CullStack::CullStack()
 
     _index_modelviewCullingStack = 0;
     _back_modelviewCullingStack = 0;
+
+    _softwareOcclusionProjection = 0;
+
+    _numLODEvaluations = 0;
+    _numLODEvaluationsSkipped = 0;
+    _lodSelectionID = ++s_lodSelectionID;
     
     _referenceViewPoints.push_back(osg::Vec3(0.0f,0.0f,0.0f));
 }
@@ -43,6 +57,12 @@ CullStack::CullStack(const CullStack& cs):
 
     _index_modelviewCullingStack = 0;
     _back_modelviewCullingStack = 0;
+
+    _softwareOcclusionProjection = 0;
+
+    _numLODEvaluations = 0;
+    _numLODEvaluationsSkipped = 0;
+    _lodSelectionID = ++s_lodSelectionID;
     
     _referenceViewPoints.push_back(osg::Vec3(0.0f,0.0f,0.0f));
 }
@@ -86,6 +106,9 @@ void CullStack::reset()
     _bbCornerNear = (~_bbCornerFar)&7;
     
     _currentReuseMatrixIndex=0;
+
+    _numLODEvaluations = 0;
+    _numLODEvaluationsSkipped = 0;
 }
 
 
@@ -25,6 +25,47 @@ CullingSet::~CullingSet()
 {
 }
 
+void CullingSet::isCulled(const BoundingBox* boxes, unsigned int numBoxes, unsigned char* culled, Polytope::ClippingMask* frustumMasks)
+{
+    if (_mask&VIEW_FRUSTUM_CULLING)
+    {
+        // is it outside the view frustum...
+        _frustum.contains(boxes, numBoxes, culled, frustumMasks);
+        for(unsigned int i=0; i<numBoxes; ++i)
+        {
+            culled[i] = culled[i] ? 0 : 1;
+        }
+    }
+    else
+    {
+        for(unsigned int i=0; i<numBoxes; ++i)
+        {
+            culled[i] = 0;
+            if (frustumMasks) frustumMasks[i] = _frustum.getResultMask();
+        }
+    }
+
+    if ((_mask&SHADOW_OCCLUSION_CULLING) && !_occluderList.empty())
+    {
+        // is it in one of the shadow occluder volumes.
+        for(unsigned int i=0; i<numBoxes; ++i)
+        {
+            if (culled[i]) continue;
+
+            for(OccluderList::iterator itr=_occluderList.begin();
+                itr!=_occluderList.end();
+                ++itr)
+            {
+                if (itr->contains(boxes[i]))
+                {
+                    culled[i] = 1;
+                    break;
+                }
+            }
+        }
+    }
+}
+
 void CullingSet::disableAndPushOccludersCurrentMask(NodePath& nodePath)
 {
     for(OccluderList::iterator itr=_occluderList.begin();
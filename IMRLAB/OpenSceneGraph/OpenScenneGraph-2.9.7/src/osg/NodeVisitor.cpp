@@ -28,6 +28,7 @@
 #include <osg/Projection>
 #include <osg/ProxyNode>
 #include <osg/Sequence>
+#include <osg/SpatialGroup>
 #include <osg/Switch>
 #include <osg/TexGenNode>
 #include <osg/Transform>
@@ -175,3 +176,8 @@ void NodeVisitor::apply(OcclusionQueryNode& node)
 { 
     apply(static_cast<Group&>(node));
 }
+
+void NodeVisitor::apply(SpatialGroup& node)
+{
+    apply(static_cast<Group&>(node));
+}
@@ -0,0 +1,184 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield 
+ *
+ * This library is open source and may be redistributed and/or modified under  
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or 
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the 
+ * OpenSceneGraph Public License for more details.
+*/
+#include <osg/Polytope>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+    #define OSG_POLYTOPE_USE_SSE2
+    #include <emmintrin.h>
+#endif
+
+using namespace osg;
+
+namespace
+{
+    typedef Plane::value_type value_type;
+
+    static const unsigned int BLOCK_SIZE = 4;
+
+    // A plane with the corners it tests against pre-selected, as Plane::intersect(bb) does.
+    struct BlockPlane
+    {
+        value_type              n[4];
+        bool                    upper[3];       // use the max of the axis for the upper corner.
+        Polytope::ClippingMask  selector;
+    };
+
+    // The corners of a block of boxes laid out an axis at a time, in the precision of the planes,
+    // so that the distances are computed exactly as Plane::distance() computes them.
+    struct BoxBlock
+    {
+        value_type  min[3][BLOCK_SIZE];
+        value_type  max[3][BLOCK_SIZE];
+    };
+
+    // Set the bits of the boxes that are wholly above and wholly below the plane.
+    inline void intersect(const BlockPlane& plane, const BoxBlock& block, unsigned int& aboveBits, unsigned int& belowBits)
+    {
+        const value_type* ux = plane.upper[0] ? block.max[0] : block.min[0];
+        const value_type* uy = plane.upper[1] ? block.max[1] : block.min[1];
+        const value_type* uz = plane.upper[2] ? block.max[2] : block.min[2];
+        const value_type* lx = plane.upper[0] ? block.min[0] : block.max[0];
+        const value_type* ly = plane.upper[1] ? block.min[1] : block.max[1];
+        const value_type* lz = plane.upper[2] ? block.min[2] : block.max[2];
+
+#if defined(OSG_POLYTOPE_USE_SSE2) && !defined(OSG_USE_FLOAT_PLANE)
+        const __m128d a = _mm_set1_pd(plane.n[0]);
+        const __m128d b = _mm_set1_pd(plane.n[1]);
+        const __m128d c = _mm_set1_pd(plane.n[2]);
+        const __m128d d = _mm_set1_pd(plane.n[3]);
+        const __m128d zero = _mm_setzero_pd();
+
+        aboveBits = 0;
+        belowBits = 0;
+        for(unsigned int i=0; i<BLOCK_SIZE; i+=2)
+        {
+            __m128d lower = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(a, _mm_loadu_pd(lx+i)),
+                                                             _mm_mul_pd(b, _mm_loadu_pd(ly+i))),
+                                                  _mm_mul_pd(c, _mm_loadu_pd(lz+i))),
+                                       d);
+            __m128d upper = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(a, _mm_loadu_pd(ux+i)),
+                                                             _mm_mul_pd(b, _mm_loadu_pd(uy+i))),
+                                                  _mm_mul_pd(c, _mm_loadu_pd(uz+i))),
+                                       d);
+            aboveBits |= static_cast<unsigned int>(_mm_movemask_pd(_mm_cmpgt_pd(lower, zero))) << i;
+            belowBits |= static_cast<unsigned int>(_mm_movemask_pd(_mm_cmplt_pd(upper, zero))) << i;
+        }
+#elif defined(OSG_POLYTOPE_USE_SSE2)
+        const __m128 a = _mm_set1_ps(plane.n[0]);
+        const __m128 b = _mm_set1_ps(plane.n[1]);
+        const __m128 c = _mm_set1_ps(plane.n[2]);
+        const __m128 d = _mm_set1_ps(plane.n[3]);
+        const __m128 zero = _mm_setzero_ps();
+
+        __m128 lower = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_loadu_ps(lx)),
+                                                        _mm_mul_ps(b, _mm_loadu_ps(ly))),
+                                             _mm_mul_ps(c, _mm_loadu_ps(lz))),
+                                  d);
+        __m128 upper = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_loadu_ps(ux)),
+                                                        _mm_mul_ps(b, _mm_loadu_ps(uy))),
+                                             _mm_mul_ps(c, _mm_loadu_ps(uz))),
+                                  d);
+        aboveBits = static_cast<unsigned int>(_mm_movemask_ps(_mm_cmpgt_ps(lower, zero)));
+        belowBits = static_cast<unsigned int>(_mm_movemask_ps(_mm_cmplt_ps(upper, zero)));
+#else
+        aboveBits = 0;
+        belowBits = 0;
+        for(unsigned int i=0; i<BLOCK_SIZE; ++i)
+        {
+            value_type lower = plane.n[0]*lx[i] + plane.n[1]*ly[i] + plane.n[2]*lz[i] + plane.n[3];
+            value_type upper = plane.n[0]*ux[i] + plane.n[1]*uy[i] + plane.n[2]*uz[i] + plane.n[3];
+            if (lower>0.0) aboveBits |= (1<<i);
+            if (upper<0.0) belowBits |= (1<<i);
+        }
+#endif
+    }
+}
+
+unsigned int Polytope::contains(const BoundingBox* boxes, unsigned int numBoxes, unsigned char* results, ClippingMask* resultMasks) const
+{
+    const ClippingMask currentMask = _maskStack.back();
+    if (!currentMask)
+    {
+        for(unsigned int i=0; i<numBoxes; ++i)
+        {
+            results[i] = 1;
+            if (resultMasks) resultMasks[i] = 0;
+        }
+        return numBoxes;
+    }
+
+    // collect the planes of the current mask, at most one per bit of the mask.
+    BlockPlane planes[sizeof(ClippingMask)*8];
+    unsigned int numPlanes = 0;
+    ClippingMask selector_mask = 0x1;
+    for(PlaneList::const_iterator itr=_planeList.begin();
+        itr!=_planeList.end() && selector_mask!=0;
+        ++itr, selector_mask <<= 1)
+    {
+        if (currentMask&selector_mask)
+        {
+            BlockPlane& plane = planes[numPlanes++];
+            for(unsigned int i=0; i<4; ++i) plane.n[i] = (*itr)[i];
+            for(unsigned int i=0; i<3; ++i) plane.upper[i] = (*itr)[i]>=0.0;
+            plane.selector = selector_mask;
+        }
+    }
+
+    unsigned int numContained = 0;
+    BoxBlock block;
+    for(unsigned int base=0; base<numBoxes; base+=BLOCK_SIZE)
+    {
+        const unsigned int blockSize = (numBoxes-base)<BLOCK_SIZE ? (numBoxes-base) : BLOCK_SIZE;
+        const unsigned int blockBits = (1u<<blockSize)-1;
+
+        // the unused lanes of the last block repeat its last box.
+        for(unsigned int i=0; i<BLOCK_SIZE; ++i)
+        {
+            const BoundingBox& bb = boxes[base + (i<blockSize ? i : blockSize-1)];
+            for(unsigned int axis=0; axis<3; ++axis)
+            {
+                block.min[axis][i] = bb._min[axis];
+                block.max[axis][i] = bb._max[axis];
+            }
+        }
+
+        ClippingMask masks[BLOCK_SIZE];
+        for(unsigned int i=0; i<BLOCK_SIZE; ++i) masks[i] = currentMask;
+
+        unsigned int outsideBits = 0;
+        for(unsigned int p=0; p<numPlanes && outsideBits!=blockBits; ++p)
+        {
+            unsigned int aboveBits, belowBits;
+            intersect(planes[p], block, aboveBits, belowBits);
+
+            // boxes above the plane need no further checks against it, as in contains(bb).
+            unsigned int removeBits = aboveBits & ~outsideBits & blockBits;
+            for(unsigned int i=0; removeBits!=0; ++i, removeBits >>= 1)
+            {
+                if (removeBits&1) masks[i] ^= planes[p].selector;
+            }
+
+            outsideBits |= belowBits & ~aboveBits & blockBits;
+        }
+
+        for(unsigned int i=0; i<blockSize; ++i)
+        {
+            bool contained = (outsideBits & (1u<<i))==0;
+            results[base+i] = contained ? 1 : 0;
+            if (resultMasks) resultMasks[base+i] = masks[i];
+            if (contained) ++numContained;
+        }
+    }
+
+    return numContained;
+}
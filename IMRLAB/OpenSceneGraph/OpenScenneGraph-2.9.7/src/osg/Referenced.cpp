@@ -106,7 +106,10 @@ struct InitGlobalMutexes
 static InitGlobalMutexes s_initGlobalMutexes;
 
 
-#if !defined(_OSG_REFERENCED_USE_ATOMIC_OPERATIONS)
+#if defined(_OSG_REFERENCED_USE_ATOMIC_OPERATIONS)
+// initialized as a constant so that objects constructed during static initialization are thread safe too.
+static bool s_useThreadSafeReferenceCounting = true;
+#else
 static bool s_useThreadSafeReferenceCounting = getenv("OSG_THREAD_SAFE_REF_UNREF")!=0;
 #endif
 // static std::auto_ptr<DeleteHandler> s_deleteHandler(0);
@@ -116,18 +119,12 @@ static ApplicationUsageProxy Referenced_e0(ApplicationUsage::ENVIRONMENTAL_VARIA
 
 void Referenced::setThreadSafeReferenceCounting(bool enableThreadSafeReferenceCounting)
 {
-#if !defined(_OSG_REFERENCED_USE_ATOMIC_OPERATIONS)
     s_useThreadSafeReferenceCounting = enableThreadSafeReferenceCounting;
-#endif
 }
 
 bool Referenced::getThreadSafeReferenceCounting()
 {
-#if defined(_OSG_REFERENCED_USE_ATOMIC_OPERATIONS)
-    return true;
-#else
     return s_useThreadSafeReferenceCounting;
-#endif
 }
 
 
@@ -153,7 +150,8 @@ static int s_numObjects = 0;
 Referenced::Referenced():
 #if defined(_OSG_REFERENCED_USE_ATOMIC_OPERATIONS)
     _observerSet(0),
-    _refCount(0)
+    _refCount(0),
+    _threadSafeRefUnref(s_useThreadSafeReferenceCounting)
 #else
     _refMutex(0),
     _refCount(0),
@@ -180,7 +178,8 @@ Referenced::Referenced():
 Referenced::Referenced(bool threadSafeRefUnref):
 #if defined(_OSG_REFERENCED_USE_ATOMIC_OPERATIONS)
     _observerSet(0),
-    _refCount(0)
+    _refCount(0),
+    _threadSafeRefUnref(threadSafeRefUnref)
 #else
     _refMutex(0),
     _refCount(0),
@@ -206,7 +205,8 @@ Referenced::Referenced(bool threadSafeRefUnref):
 Referenced::Referenced(const Referenced&):
 #if defined(_OSG_REFERENCED_USE_ATOMIC_OPERATIONS)
     _observerSet(0),
-    _refCount(0)
+    _refCount(0),
+    _threadSafeRefUnref(s_useThreadSafeReferenceCounting)
 #else
     _refMutex(0),
     _refCount(0),
@@ -321,7 +321,9 @@ void Referenced::signalObserversAndDelete(bool signalUnreferened, bool signalDel
 
 void Referenced::setThreadSafeRefUnref(bool threadSafe)
 {
-#if !defined(_OSG_REFERENCED_USE_ATOMIC_OPERATIONS)
+#if defined(_OSG_REFERENCED_USE_ATOMIC_OPERATIONS)
+    _threadSafeRefUnref = threadSafe;
+#else
     if (threadSafe)
     {
         if (!_refMutex)
@@ -346,7 +348,7 @@ void Referenced::setThreadSafeRefUnref(bool threadSafe)
 void Referenced::unref_nodelete() const
 {
 #if defined(_OSG_REFERENCED_USE_ATOMIC_OPERATIONS)
-    bool needUnreferencedSignal = ((--_refCount) == 0);
+    bool needUnreferencedSignal = _threadSafeRefUnref ? ((--_refCount) == 0) : (_refCount.decrementUnsynchronized() == 0);
 #else
     bool needUnreferencedSignal = false;
     if (_refMutex)
@@ -0,0 +1,310 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+#include <osg/SoftwareOcclusionBuffer>
+#include <osg/ConvexPlanarPolygon>
+#include <osg/Drawable>
+#include <osg/TriangleFunctor>
+
+#include <float.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+    #define OSG_SOFTWAREOCCLUSIONBUFFER_USE_SSE2
+    #include <emmintrin.h>
+#endif
+
+using namespace osg;
+
+namespace
+{
+    inline Vec4 transformToWindow(const Vec3& v, const Matrix& m)
+    {
+        return Vec4(v.x()*m(0,0)+v.y()*m(1,0)+v.z()*m(2,0)+m(3,0),
+                    v.x()*m(0,1)+v.y()*m(1,1)+v.z()*m(2,1)+m(3,1),
+                    v.x()*m(0,2)+v.y()*m(1,2)+v.z()*m(2,2)+m(3,2),
+                    v.x()*m(0,3)+v.y()*m(1,3)+v.z()*m(2,3)+m(3,3));
+    }
+
+    struct RasterizeTriangleOperator
+    {
+        RasterizeTriangleOperator(): _buffer(0), _mvpw(0) {}
+
+        inline void operator() (const Vec3& v1, const Vec3& v2, const Vec3& v3, bool)
+        {
+            _buffer->rasterizeTriangle(v1, v2, v3, *_mvpw);
+        }
+
+        SoftwareOcclusionBuffer*    _buffer;
+        const Matrix*               _mvpw;
+    };
+
+    /** Return true if every depth in row[begin..end] is nearer than depth.*/
+    inline bool rowOccluded(const float* row, unsigned int begin, unsigned int end, float depth)
+    {
+        unsigned int x = begin;
+#if defined(OSG_SOFTWAREOCCLUSIONBUFFER_USE_SSE2)
+        const __m128 d = _mm_set1_ps(depth);
+        for(; x+4<=end+1; x+=4)
+        {
+            if (_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(row+x), d))!=0xf) return false;
+        }
+#endif
+        for(; x<=end; ++x)
+        {
+            if (!(row[x]<depth)) return false;
+        }
+        return true;
+    }
+}
+
+SoftwareOcclusionBuffer::SoftwareOcclusionBuffer(unsigned int width, unsigned int height):
+    _width(width),
+    _height(height),
+    _bufferWidth(0),
+    _bufferHeight(0),
+    _numTilesX(0),
+    _numTilesY(0),
+    _xOffset(0.0f),
+    _yOffset(0.0f),
+    _xScale(1.0f),
+    _yScale(1.0f),
+    _numTrianglesRasterized(0)
+{
+}
+
+SoftwareOcclusionBuffer::~SoftwareOcclusionBuffer()
+{
+}
+
+void SoftwareOcclusionBuffer::clear(const Viewport& viewport)
+{
+    _bufferWidth = _width>0 ? _width : 1;
+    _bufferHeight = _height>0 ? _height : 1;
+    _numTilesX = (_bufferWidth+TILE_SIZE-1)/TILE_SIZE;
+    _numTilesY = (_bufferHeight+TILE_SIZE-1)/TILE_SIZE;
+
+    _depths.assign(_bufferWidth*_bufferHeight, FLT_MAX);
+    _tileMaxDepths.assign(_numTilesX*_numTilesY, FLT_MAX);
+
+    _xOffset = viewport.x();
+    _yOffset = viewport.y();
+    _xScale = viewport.width()>0.0 ? static_cast<float>(_bufferWidth/viewport.width()) : 0.0f;
+    _yScale = viewport.height()>0.0 ? static_cast<float>(_bufferHeight/viewport.height()) : 0.0f;
+
+    _numTrianglesRasterized = 0;
+}
+
+void SoftwareOcclusionBuffer::rasterizeTriangle(const Vec3& v1, const Vec3& v2, const Vec3& v3, const Matrix& mvpw)
+{
+    rasterizeClipTriangle(transformToWindow(v1, mvpw), transformToWindow(v2, mvpw), transformToWindow(v3, mvpw));
+}
+
+void SoftwareOcclusionBuffer::rasterize(const Drawable& drawable, const Matrix& mvpw)
+{
+    TriangleFunctor<RasterizeTriangleOperator> functor;
+    functor._buffer = this;
+    functor._mvpw = &mvpw;
+    drawable.accept(functor);
+}
+
+void SoftwareOcclusionBuffer::rasterize(const ConvexPlanarPolygon& polygon, const Matrix& mvpw)
+{
+    const ConvexPlanarPolygon::VertexList& vertices = polygon.getVertexList();
+    for(unsigned int i=2; i<vertices.size(); ++i)
+    {
+        rasterizeTriangle(vertices[0], vertices[i-1], vertices[i], mvpw);
+    }
+}
+
+void SoftwareOcclusionBuffer::rasterizeClipTriangle(const Vec4& v1, const Vec4& v2, const Vec4& v3)
+{
+    if (_depths.empty()) return;
+
+    // clip to the near plane, where the window depth is 0.
+    const Vec4 input[3] = { v1, v2, v3 };
+    Vec4 clipped[4];
+    unsigned int numClipped = 0;
+    for(unsigned int i=0; i<3; ++i)
+    {
+        const Vec4& current = input[i];
+        const Vec4& next = input[(i+1)%3];
+        if (current.z()>=0.0f) clipped[numClipped++] = current;
+        if ((current.z()>=0.0f)!=(next.z()>=0.0f))
+        {
+            float r = current.z()/(current.z()-next.z());
+            clipped[numClipped++] = current + (next-current)*r;
+        }
+    }
+    if (numClipped<3) return;
+
+    Vec3 projected[4];
+    for(unsigned int i=0; i<numClipped; ++i)
+    {
+        const Vec4& v = clipped[i];
+        if (v.w()<=0.0f) return;
+
+        float inverse_w = 1.0f/v.w();
+        projected[i].set((v.x()*inverse_w - _xOffset)*_xScale,
+                         (v.y()*inverse_w - _yOffset)*_yScale,
+                         v.z()*inverse_w);
+    }
+
+    rasterizeBufferTriangle(projected[0], projected[1], projected[2]);
+    if (numClipped==4) rasterizeBufferTriangle(projected[0], projected[2], projected[3]);
+}
+
+void SoftwareOcclusionBuffer::rasterizeBufferTriangle(const Vec3& p1, const Vec3& p2, const Vec3& p3)
+{
+    double x1 = p1.x(), y1 = p1.y(), z1 = p1.z();
+    double x2 = p2.x(), y2 = p2.y(), z2 = p2.z();
+    double x3 = p3.x(), y3 = p3.y(), z3 = p3.z();
+
+    double area = (x2-x1)*(y3-y1) - (x3-x1)*(y2-y1);
+    if (!(area!=0.0) || osg::isNaN(area)) return;
+    if (area<0.0)
+    {
+        std::swap(x2, x3); std::swap(y2, y3); std::swap(z2, z3);
+        area = -area;
+    }
+
+    // the pixels whose centres lie within the triangle's bounds.
+    double minX = osg::maximum(osg::minimum(x1, osg::minimum(x2, x3))-0.5, 0.0);
+    double maxX = osg::minimum(osg::maximum(x1, osg::maximum(x2, x3))-0.5, static_cast<double>(_bufferWidth-1));
+    double minY = osg::maximum(osg::minimum(y1, osg::minimum(y2, y3))-0.5, 0.0);
+    double maxY = osg::minimum(osg::maximum(y1, osg::maximum(y2, y3))-0.5, static_cast<double>(_bufferHeight-1));
+    if (minX>maxX || minY>maxY) return;
+
+    int beginX = static_cast<int>(ceil(minX)), endX = static_cast<int>(floor(maxX));
+    int beginY = static_cast<int>(ceil(minY)), endY = static_cast<int>(floor(maxY));
+
+    ++_numTrianglesRasterized;
+
+    // depth plane, window depth is linear in window x and y.
+    double dzdx = ((z2-z1)*(y3-y1) - (z3-z1)*(y2-y1))/area;
+    double dzdy = ((x2-x1)*(z3-z1) - (x3-x1)*(z2-z1))/area;
+
+    // write the furthest depth of the triangle across each pixel rather than the depth at its centre.
+    double pixelDepthRange = 0.5*(fabs(dzdx)+fabs(dzdy));
+    double maxZ = osg::maximum(z1, osg::maximum(z2, z3));
+
+    for(int y=beginY; y<=endY; ++y)
+    {
+        double py = y+0.5;
+        double px = beginX+0.5;
+
+        // edge functions, all positive inside the anticlockwise triangle.
+        double e1 = (x2-x1)*(py-y1) - (y2-y1)*(px-x1);
+        double e2 = (x3-x2)*(py-y2) - (y3-y2)*(px-x2);
+        double e3 = (x1-x3)*(py-y3) - (y1-y3)*(px-x3);
+        double z = z1 + dzdx*(px-x1) + dzdy*(py-y1);
+
+        float* row = &_depths[y*_bufferWidth];
+        for(int x=beginX; x<=endX; ++x)
+        {
+            if (e1>=0.0 && e2>=0.0 && e3>=0.0)
+            {
+                float depth = static_cast<float>(osg::minimum(z+pixelDepthRange, maxZ));
+                if (depth<row[x]) row[x] = depth;
+            }
+            e1 -= (y2-y1);
+            e2 -= (y3-y2);
+            e3 -= (y1-y3);
+            z += dzdx;
+        }
+    }
+}
+
+void SoftwareOcclusionBuffer::finish()
+{
+    for(unsigned int ty=0; ty<_numTilesY; ++ty)
+    {
+        unsigned int endY = osg::minimum((ty+1)*TILE_SIZE, _bufferHeight);
+        for(unsigned int tx=0; tx<_numTilesX; ++tx)
+        {
+            unsigned int endX = osg::minimum((tx+1)*TILE_SIZE, _bufferWidth);
+            float maxDepth = 0.0f;
+            for(unsigned int y=ty*TILE_SIZE; y<endY; ++y)
+            {
+                const float* row = &_depths[y*_bufferWidth];
+                for(unsigned int x=tx*TILE_SIZE; x<endX; ++x)
+                {
+                    if (row[x]>maxDepth) maxDepth = row[x];
+                }
+            }
+            _tileMaxDepths[ty*_numTilesX+tx] = maxDepth;
+        }
+    }
+}
+
+bool SoftwareOcclusionBuffer::isOccluded(const BoundingBox& bb, const Matrix& mvpw) const
+{
+    if (empty() || !bb.valid()) return false;
+
+    float minX = FLT_MAX, maxX = -FLT_MAX;
+    float minY = FLT_MAX, maxY = -FLT_MAX;
+    float minZ = FLT_MAX;
+    for(unsigned int i=0; i<8; ++i)
+    {
+        Vec4 v = transformToWindow(bb.corner(i), mvpw);
+        if (v.z()<0.0f || v.w()<=0.0f) return false;
+
+        float inverse_w = 1.0f/v.w();
+        float x = (v.x()*inverse_w - _xOffset)*_xScale;
+        float y = (v.y()*inverse_w - _yOffset)*_yScale;
+        float z = v.z()*inverse_w;
+        if (x<minX) minX = x;
+        if (x>maxX) maxX = x;
+        if (y<minY) minY = y;
+        if (y>maxY) maxY = y;
+        if (z<minZ) minZ = z;
+    }
+
+    // leave what is outside of the viewport to the view frustum culling.
+    if (maxX<0.0f || maxY<0.0f || minX>=static_cast<float>(_bufferWidth) || minY>=static_cast<float>(_bufferHeight)) return false;
+
+    // every pixel the box's projection touches must be nearer than the box, along with the pixels around them as the
+    // occluders only cover the pixels whose centres they cover, so may be seen past in the pixels along their edges.
+    minX -= 1.0f; minY -= 1.0f;
+    maxX += 1.0f; maxY += 1.0f;
+    unsigned int beginX = minX>0.0f ? static_cast<unsigned int>(minX) : 0;
+    unsigned int beginY = minY>0.0f ? static_cast<unsigned int>(minY) : 0;
+    unsigned int endX = maxX<static_cast<float>(_bufferWidth) ? static_cast<unsigned int>(maxX) : _bufferWidth-1;
+    unsigned int endY = maxY<static_cast<float>(_bufferHeight) ? static_cast<unsigned int>(maxY) : _bufferHeight-1;
+
+    for(unsigned int ty=beginY/TILE_SIZE; ty<=endY/TILE_SIZE; ++ty)
+    {
+        unsigned int tileBeginY = osg::maximum(ty*TILE_SIZE, beginY);
+        unsigned int tileEndY = osg::minimum((ty+1)*TILE_SIZE-1, endY);
+        for(unsigned int tx=beginX/TILE_SIZE; tx<=endX/TILE_SIZE; ++tx)
+        {
+            // the whole tile is nearer than the box.
+            if (_tileMaxDepths[ty*_numTilesX+tx]<minZ) continue;
+
+            unsigned int tileBeginX = osg::maximum(tx*TILE_SIZE, beginX);
+            unsigned int tileEndX = osg::minimum((tx+1)*TILE_SIZE-1, endX);
+            for(unsigned int y=tileBeginY; y<=tileEndY; ++y)
+            {
+                if (!rowOccluded(&_depths[y*_bufferWidth], tileBeginX, tileEndX, minZ)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool SoftwareOcclusionBuffer::isOccluded(const BoundingSphere& bs, const Matrix& mvpw) const
+{
+    if (!bs.valid()) return false;
+
+    Vec3 radius(bs.radius(), bs.radius(), bs.radius());
+    return isOccluded(BoundingBox(bs.center()-radius, bs.center()+radius), mvpw);
+}
@@ -649,6 +649,15 @@ void DatabasePager::DatabaseThread::run()
 
             if (databaseRequest->_loadedModel.valid())
             {
+                // share the state of the loaded model with the subgraphs already loaded, before the compileable
+                // objects are collected so the state already shared with the scene graph isn't compiled again.
+                SharedStateManager* sharedStateManager = osgDB::Registry::instance()->getSharedStateManager();
+                if (sharedStateManager)
+                {
+                    sharedStateManager->prune();
+                    sharedStateManager->share(databaseRequest->_loadedModel.get());
+                }
+
                 databaseRequest->_loadedModel->getBound();
 
                 osg::NodePath nodePath;
@@ -1460,9 +1469,6 @@ void DatabasePager::addLoadedDataToSceneGraph(const osg::FrameStamp &frameStamp)
             // OSG_NOTIFY(osg::NOTICE)<<"Merging "<<_frameNumber-(*itr)->_frameNumberLastRequest<<std::endl;
             osg::Group* group = databaseRequest->_groupForAddingLoadedSubgraph;
 
-            if (osgDB::Registry::instance()->getSharedStateManager())
-                osgDB::Registry::instance()->getSharedStateManager()->share(databaseRequest->_loadedModel.get());
-
             registerPagedLODs(databaseRequest->_loadedModel.get(), frameStamp.getFrameNumber());
 
             osg::PagedLOD* plod = dynamic_cast<osg::PagedLOD*>(group);
@@ -24,7 +24,7 @@ using namespace osgDB;
 static std::string s_lastSchema;
 
 InputStream::InputStream( const osgDB::Options* options )
-:   _byteSwap(0), _useFloatMatrix(false), _forceReadingImage(false)
+:   _byteSwap(0), _useFloatMatrix(false), _forceReadingImage(false), _decompressionStream(0)
 {
     if ( !options ) return;
     
@@ -72,6 +72,7 @@ InputStream::InputStream( const osgDB::Options* options )
 
 InputStream::~InputStream()
 {
+    delete _decompressionStream;
 }
 
 InputStream& InputStream::operator>>( osg::Vec2b& v )
@@ -723,14 +724,31 @@ void InputStream::decompress()
     {
         osg::notify(osg::WARN) << "InputStream::decompress(): No such compressor "
                                << compressorName << std::endl;
+        throwException( "InputStream: Failed to decompress stream." );
+        return;
     }
     
-    std::string data;
-    if ( !compressor->decompress(*(_in->getStream()), data) )
+    // read straight from a streaming decompressor when the compressor provides one.
+    std::istream* decompressionStream = compressor->createDecompressionStream(*(_in->getStream()));
+    if ( !decompressionStream )
+    {
+        std::string data;
+        if ( !compressor->decompress(*(_in->getStream()), data) )
+            throwException( "InputStream: Failed to decompress stream." );
+        if ( getException() ) return;
+        
+        decompressionStream = new std::stringstream(data);
+    }
+    else if ( decompressionStream->fail() )
+    {
+        delete decompressionStream;
         throwException( "InputStream: Failed to decompress stream." );
-    if ( getException() ) return;
+        return;
+    }
     
-    _in->setStream( new std::stringstream(data) );
+    delete _decompressionStream;
+    _decompressionStream = decompressionStream;
+    _in->setStream( _decompressionStream );
     _fields.pop_back();
 }
 
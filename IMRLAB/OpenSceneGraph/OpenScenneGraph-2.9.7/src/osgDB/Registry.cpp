@@ -61,6 +61,8 @@ static osg::ApplicationUsageProxy Registry_e1(osg::ApplicationUsage::ENVIRONMENT
 #endif
 
 static osg::ApplicationUsageProxy Registry_e2(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_BUILD_KDTREES on/off","Enable/disable the automatic building of KdTrees for each loaded Geometry.");
+static osg::ApplicationUsageProxy Registry_e3(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_FIND_FILE_CACHE on/off","Enable/disable caching of data file, library file and plugin lookups.");
+static osg::ApplicationUsageProxy Registry_e4(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAX_OBJECT_CACHE_SIZE <megabytes>","Maximum size of the objects held in the Registry object cache, least recently used objects are evicted beyond it.");
 
 
 // from MimeTypes.cpp
@@ -84,6 +86,9 @@ public:
     {
         _rwUsed.insert(get());
     }
+
+    /** mark a ReaderWriter as already tried so that it is skipped.*/
+    void insert(ReaderWriter* rw) { _rwUsed.insert(rw); }
     
 
 protected:
@@ -196,6 +201,14 @@ Registry::Registry()
         OSG_NOTIFY(osg::INFO)<<"Registry : Expiry delay = "<<_expiryDelay<<std::endl;
     }
 
+    _objectCache = new ObjectCache;
+    if( (ptr = getenv("OSG_MAX_OBJECT_CACHE_SIZE")) != 0)
+    {
+        double sizeInMegabytes = osg::asciiToDouble(ptr);
+        _objectCache->setMaximumSizeInBytes(static_cast<std::size_t>(sizeInMegabytes*1024.0*1024.0));
+        OSG_NOTIFY(osg::INFO)<<"Registry : Maximum object cache size = "<<sizeInMegabytes<<"MB"<<std::endl;
+    }
+
     const char* fileCachePath = getenv("OSG_FILE_CACHE");
     if (fileCachePath)
     {
@@ -205,8 +218,17 @@ Registry::Registry()
     _createNodeFromImage = false;
     _openingLibrary = false;
 
-    // add default osga archive extension
+    _findFileCacheEnabled = false;
+    const char* findFileCache_str = getenv("OSG_FIND_FILE_CACHE");
+    if (findFileCache_str)
+    {
+        _findFileCacheEnabled = (strcmp(findFileCache_str, "on")==0 || strcmp(findFileCache_str, "ON")==0 || strcmp(findFileCache_str, "On")==0 );
+        OSG_NOTIFY(osg::INFO)<<"Registry : find file cache = "<<_findFileCacheEnabled<<std::endl;
+    }
+
+    // add default osga and pak archive extensions
     _archiveExtList.push_back("osga");
+    _archiveExtList.push_back("pak");
     
     initFilePathLists();
 
@@ -399,6 +421,7 @@ void Registry::destruct()
     // maintained after that plugin is deleted...  Robert Osfield, Jan 2004.
     clearObjectCache();
     clearArchiveCache();
+    clearFindFileCache();
     
 
     // unload all the plugin before we finally destruct.
@@ -435,9 +458,10 @@ void Registry::setDataFilePathList(const std::string& paths)
 {
     _dataFilePath.clear(); 
     convertStringPathIntoFilePathList(paths,_dataFilePath);
+    clearFindFileCache();
 }
 
-void Registry::setLibraryFilePathList(const std::string& paths) { _libraryFilePath.clear(); convertStringPathIntoFilePathList(paths,_libraryFilePath); }
+void Registry::setLibraryFilePathList(const std::string& paths) { _libraryFilePath.clear(); convertStringPathIntoFilePathList(paths,_libraryFilePath); clearFindFileCache(); }
 
 
 
@@ -500,6 +524,7 @@ void Registry::addReaderWriter(ReaderWriter* rw)
     OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(_pluginMutex);
 
     _rwList.push_back(rw);
+    _rwExtensionMap.clear();
 
 }
 
@@ -517,6 +542,7 @@ void Registry::removeReaderWriter(ReaderWriter* rw)
     {
         _rwList.erase(rwitr);
     }
+    _rwExtensionMap.clear();
 
 }
 
@@ -671,6 +697,9 @@ Registry::LoadStatus Registry::loadLibrary(const std::string& fileName)
     DynamicLibraryList::iterator ditr = getLibraryItr(fileName);
     if (ditr!=_dlList.end()) return PREVIOUSLY_LOADED;
 
+    // don't search the library paths again for a plugin that has already failed to load.
+    if (_findFileCacheEnabled && _failedLibraryList.count(fileName)!=0) return NOT_LOADED;
+
     _openingLibrary=true;
 
     DynamicLibrary* dl = DynamicLibrary::loadLibrary(fileName);
@@ -681,6 +710,9 @@ Registry::LoadStatus Registry::loadLibrary(const std::string& fileName)
         _dlList.push_back(dl);
         return LOADED;
     }
+
+    if (_findFileCacheEnabled) _failedLibraryList.insert(fileName);
+
     return NOT_LOADED;
 }
 
@@ -692,6 +724,7 @@ bool Registry::closeLibrary(const std::string& fileName)
     if (ditr!=_dlList.end())
     {
         _dlList.erase(ditr);
+        _rwExtensionMap.clear();
         return true;
     }
     return false;
@@ -702,6 +735,7 @@ void Registry::closeAllLibraries()
     // OSG_NOTIFY(osg::NOTICE)<<"Registry::closeAllLibraries()"<<std::endl;
     OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(_pluginMutex);
     _dlList.clear();
+    _rwExtensionMap.clear();
 }
 
 Registry::DynamicLibraryList::iterator Registry::getLibraryItr(const std::string& fileName)
@@ -722,20 +756,48 @@ DynamicLibrary* Registry::getLibrary(const std::string& fileName)
     else return NULL;
 }
 
-ReaderWriter* Registry::getReaderWriterForExtension(const std::string& ext)
+ReaderWriter* Registry::findReaderWriterForExtension(const std::string& ext)
 {
-    // record the existing reader writer.
-    std::set<ReaderWriter*> rwOriginal;
+    OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(_pluginMutex);
+
+    ReaderWriterExtensionMap::iterator mitr = _rwExtensionMap.find(ext);
+    if (mitr!=_rwExtensionMap.end())
+    {
+        ++_lookupCacheStats.numReaderWriterHits;
+        return mitr->second;
+    }
 
+    ++_lookupCacheStats.numReaderWriterMisses;
+
+    ReaderWriter* rw = 0;
+    for(ReaderWriterList::iterator itr=_rwList.begin();
+        itr!=_rwList.end() && !rw;
+        ++itr)
+    {
+        if((*itr)->acceptsExtension(ext)) rw = itr->get();
+    }
+
+    // record misses as well, the map is reset whenever a ReaderWriter is added or removed.
+    _rwExtensionMap[ext] = rw;
+
+    return rw;
+}
+
+ReaderWriter* Registry::getReaderWriterForExtension(const std::string& ext)
+{
     OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(_pluginMutex);
 
     // first attemt one of the installed loaders
+    ReaderWriter* rw = findReaderWriterForExtension(ext);
+    if (rw) return rw;
+
+    // record the existing reader writer.
+    std::set<ReaderWriter*> rwOriginal;
     for(ReaderWriterList::iterator itr=_rwList.begin();
         itr!=_rwList.end();
         ++itr)
     {
         rwOriginal.insert(itr->get());
-        if((*itr)->acceptsExtension(ext)) return (*itr).get();
     }
     
     // now look for a plug-in to load the file.
@@ -855,10 +917,113 @@ void Registry::addArchiveExtension(const std::string ext)
     _archiveExtList.push_back(ext);
 }
 
+void Registry::setFindFileCacheEnabled(bool enabled)
+{
+    if (_findFileCacheEnabled==enabled) return;
+
+    _findFileCacheEnabled = enabled;
+    clearFindFileCache();
+}
+
+void Registry::clearFindFileCache()
+{
+    OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> pluginLock(_pluginMutex);
+    _failedLibraryList.clear();
+    _rwExtensionMap.clear();
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_findFileCacheMutex);
+    _findFileCache.clear();
+}
+
+void Registry::invalidateFindFileCache(const std::string& fileName)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_findFileCacheMutex);
+    _findFileCache.erase(getSimpleFileName(fileName));
+}
+
+Registry::LookupCacheStats Registry::getLookupCacheStats() const
+{
+    OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> pluginLock(const_cast<Registry*>(this)->_pluginMutex);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_findFileCacheMutex);
+    return _lookupCacheStats;
+}
+
+void Registry::resetLookupCacheStats()
+{
+    OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> pluginLock(_pluginMutex);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_findFileCacheMutex);
+    _lookupCacheStats = LookupCacheStats();
+}
+
+std::string Registry::createFindFileCacheKey(char type, const std::string& fileName, const Options* options, CaseSensitivity caseSensitivity) const
+{
+    std::string key;
+    key += type;
+    key += (caseSensitivity==CASE_SENSITIVE) ? 'S' : 'I';
+    key += fileName;
+    if (options)
+    {
+        // the database paths of the options are searched first so form part of the key.
+        const FilePathList& pathList = options->getDatabasePathList();
+        for(FilePathList::const_iterator itr=pathList.begin();
+            itr!=pathList.end();
+            ++itr)
+        {
+            key += '\n';
+            key += *itr;
+        }
+    }
+    return key;
+}
+
+bool Registry::getFromFindFileCache(const std::string& fileName, const std::string& key, std::string& fileFound)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_findFileCacheMutex);
+
+    FindFileCache::iterator citr = _findFileCache.find(getSimpleFileName(fileName));
+    if (citr!=_findFileCache.end())
+    {
+        FindFileResultMap::iterator ritr = citr->second.find(key);
+        if (ritr!=citr->second.end())
+        {
+            ++_lookupCacheStats.numFindFileHits;
+            fileFound = ritr->second;
+            return true;
+        }
+    }
+
+    ++_lookupCacheStats.numFindFileMisses;
+    return false;
+}
+
+void Registry::addToFindFileCache(const std::string& fileName, const std::string& key, const std::string& fileFound)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_findFileCacheMutex);
+    _findFileCache[getSimpleFileName(fileName)][key] = fileFound;
+}
+
 std::string Registry::findDataFileImplementation(const std::string& filename, const Options* options, CaseSensitivity caseSensitivity)
 {
     if (filename.empty()) return filename;
 
+    // remote files are never cached.
+    if (!_findFileCacheEnabled || containsServerAddress(filename)) return findDataFileInPaths(filename, options, caseSensitivity);
+
+    std::string key = createFindFileCacheKey('D', filename, options, caseSensitivity);
+
+    std::string fileFound;
+    if (getFromFindFileCache(filename, key, fileFound)) return fileFound;
+
+    fileFound = findDataFileInPaths(filename, options, caseSensitivity);
+    addToFindFileCache(filename, key, fileFound);
+
+    return fileFound;
+}
+
+std::string Registry::findDataFileInPaths(const std::string& filename, const Options* options, CaseSensitivity caseSensitivity)
+{
+    if (filename.empty()) return filename;
+
     // if data file contains a server address then we can't find it in local directories so return empty string.
     if (containsServerAddress(filename)) return std::string();
 
@@ -914,6 +1079,25 @@ std::string Registry::findDataFileImplementation(const std::string& filename, co
 }
 
 std::string Registry::findLibraryFileImplementation(const std::string& filename, const Options* options, CaseSensitivity caseSensitivity)
+{
+    if (filename.empty())
+        return filename;
+
+    if (!_findFileCacheEnabled) return findLibraryFileInPaths(filename, options, caseSensitivity);
+
+    // the options aren't used when searching for libraries so leave them out of the key.
+    std::string key = createFindFileCacheKey('L', filename, 0, caseSensitivity);
+
+    std::string fileFound;
+    if (getFromFindFileCache(filename, key, fileFound)) return fileFound;
+
+    fileFound = findLibraryFileInPaths(filename, options, caseSensitivity);
+    addToFindFileCache(filename, key, fileFound);
+
+    return fileFound;
+}
+
+std::string Registry::findLibraryFileInPaths(const std::string& filename, const Options* /*options*/, CaseSensitivity caseSensitivity)
 {
     if (filename.empty())
         return filename;
@@ -980,8 +1164,25 @@ ReaderWriter::ReadResult Registry::read(const ReadFunctor& readFunctor)
     typedef std::vector<ReaderWriter::ReadResult> Results;
     Results results;
 
-    // first attempt to load the file from existing ReaderWriter's
+    // first attempt the ReaderWriter already registered for the file's extension, which
+    // avoids offering the file to every ReaderWriter in turn in the common case.
     AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    std::string ext = getLowerCaseFileExtension(readFunctor._filename);
+    if (!ext.empty())
+    {
+        ExtensionAliasMap::iterator aliasItr = _extAliasMap.find(ext);
+        ReaderWriter* rw = findReaderWriterForExtension(aliasItr!=_extAliasMap.end() ? aliasItr->second : ext);
+        if (rw)
+        {
+            ReaderWriter::ReadResult rr = readFunctor.doRead(*rw);
+            if (readFunctor.isValid(rr)) return rr;
+            else results.push_back(rr);
+
+            itr.insert(rw);
+        }
+    }
+
+    // then attempt to load the file from the rest of the existing ReaderWriter's
     for(;itr.valid();++itr)
     {
         ReaderWriter::ReadResult rr = readFunctor.doRead(*itr);
@@ -1120,12 +1321,11 @@ ReaderWriter::ReadResult Registry::readImplementation(const ReadFunctor& readFun
     {
         // search for entry in the object cache.
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-            ObjectCache::iterator oitr=_objectCache.find(file);
-            if (oitr!=_objectCache.end())
+            osg::ref_ptr<osg::Object> object = _objectCache->getRefFromObjectCache(file);
+            if (object.valid())
             {
                 OSG_NOTIFY(INFO)<<"returning cached instanced of "<<file<<std::endl;
-                if (readFunctor.isValid(oitr->second.first.get())) return ReaderWriter::ReadResult(oitr->second.first.get(), ReaderWriter::ReadResult::FILE_LOADED_FROM_CACHE);
+                if (readFunctor.isValid(object.get())) return ReaderWriter::ReadResult(object.get(), ReaderWriter::ReadResult::FILE_LOADED_FROM_CACHE);
                 else return ReaderWriter::ReadResult("Error file does not contain an osg::Object");
             }
         }
@@ -1187,7 +1387,7 @@ ReaderWriter::WriteResult Registry::writeObjectImplementation(const Object& obj,
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeObject(obj,fileName,options);
-        if (rr.success()) return rr;
+        if (rr.success()) { invalidateFindFileCache(fileName); return rr; }
         else results.push_back(rr);
     }
 
@@ -1198,7 +1398,7 @@ ReaderWriter::WriteResult Registry::writeObjectImplementation(const Object& obj,
         for(;itr.valid();++itr)
         {
             ReaderWriter::WriteResult rr = itr->writeObject(obj,fileName,options);
-            if (rr.success()) return rr;
+            if (rr.success()) { invalidateFindFileCache(fileName); return rr; }
             else results.push_back(rr);
         }
     }
@@ -1239,7 +1439,7 @@ ReaderWriter::WriteResult Registry::writeImageImplementation(const Image& image,
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeImage(image,fileName,options);
-        if (rr.success()) return rr;
+        if (rr.success()) { invalidateFindFileCache(fileName); return rr; }
         else results.push_back(rr);
     }
 
@@ -1252,7 +1452,7 @@ ReaderWriter::WriteResult Registry::writeImageImplementation(const Image& image,
         for(;itr.valid();++itr)
         {
             ReaderWriter::WriteResult rr = itr->writeImage(image,fileName,options);
-            if (rr.success()) return rr;
+            if (rr.success()) { invalidateFindFileCache(fileName); return rr; }
             else results.push_back(rr);
         }
     }
@@ -1292,7 +1492,7 @@ ReaderWriter::WriteResult Registry::writeHeightFieldImplementation(const HeightF
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeHeightField(HeightField,fileName,options);
-        if (rr.success()) return rr;
+        if (rr.success()) { invalidateFindFileCache(fileName); return rr; }
         else results.push_back(rr);
     }
 
@@ -1305,7 +1505,7 @@ ReaderWriter::WriteResult Registry::writeHeightFieldImplementation(const HeightF
         for(;itr.valid();++itr)
         {
             ReaderWriter::WriteResult rr = itr->writeHeightField(HeightField,fileName,options);
-            if (rr.success()) return rr;
+            if (rr.success()) { invalidateFindFileCache(fileName); return rr; }
             else results.push_back(rr);
         }
     }
@@ -1357,7 +1557,7 @@ ReaderWriter::WriteResult Registry::writeNodeImplementation(const Node& node,con
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeNode(node,fileName,options);
-        if (rr.success()) return rr;
+        if (rr.success()) { invalidateFindFileCache(fileName); return rr; }
         else results.push_back(rr);
     }
 
@@ -1373,7 +1573,7 @@ ReaderWriter::WriteResult Registry::writeNodeImplementation(const Node& node,con
         {
             ReaderWriter::WriteResult rr = itr->writeNode(node,fileName,options);
     
-            if (rr.success()) return rr;
+            if (rr.success()) { invalidateFindFileCache(fileName); return rr; }
             else results.push_back(rr);
         }
     }
@@ -1412,7 +1612,7 @@ ReaderWriter::WriteResult Registry::writeShaderImplementation(const Shader& shad
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeShader(shader,fileName,options);
-        if (rr.success()) return rr;
+        if (rr.success()) { invalidateFindFileCache(fileName); return rr; }
         else results.push_back(rr);
     }
 
@@ -1425,7 +1625,7 @@ ReaderWriter::WriteResult Registry::writeShaderImplementation(const Shader& shad
         for(;itr.valid();++itr)
         {
             ReaderWriter::WriteResult rr = itr->writeShader(shader,fileName,options);
-            if (rr.success()) return rr;
+            if (rr.success()) { invalidateFindFileCache(fileName); return rr; }
             else results.push_back(rr);
         }
     }
@@ -1448,74 +1648,52 @@ ReaderWriter::WriteResult Registry::writeShaderImplementation(const Shader& shad
     return results.front();
 }
 
+void Registry::setObjectCache(ObjectCache* objectCache)
+{
+    if (!objectCache)
+    {
+        osg::notify(osg::WARN)<<"Warning: Registry::setObjectCache(0) ignored, the Registry requires an ObjectCache."<<std::endl;
+        return;
+    }
+
+    _objectCache = objectCache;
+}
+
 void Registry::addEntryToObjectCache(const std::string& filename, osg::Object* object, double timestamp)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    _objectCache[filename]=ObjectTimeStampPair(object,timestamp);
+    _objectCache->addEntryToObjectCache(filename, object, timestamp);
 }
+
 osg::Object* Registry::getFromObjectCache(const std::string& fileName)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCache::iterator itr = _objectCache.find(fileName);
-    if (itr!=_objectCache.end()) return itr->second.first.get();
-    else return 0;
+    return _objectCache->getFromObjectCache(fileName);
 }
 
-void Registry::updateTimeStampOfObjectsInCacheWithExternalReferences(const osg::FrameStamp& frameStamp)
+osg::ref_ptr<osg::Object> Registry::getRefFromObjectCache(const std::string& fileName)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
+    return _objectCache->getRefFromObjectCache(fileName);
+}
 
-    // look for objects with external references and update their time stamp.
-    for(ObjectCache::iterator itr=_objectCache.begin();
-        itr!=_objectCache.end();
-        ++itr)
-    {
-        // if ref count is greater the 1 the object has an external reference.
-        if (itr->second.first->referenceCount()>1)
-        {
-            // so update it time stamp.
-            itr->second.second = frameStamp.getReferenceTime();
-        }
-    }
+void Registry::removeFromObjectCache(const std::string& fileName)
+{
+    _objectCache->removeFromObjectCache(fileName);
+}
+
+void Registry::updateTimeStampOfObjectsInCacheWithExternalReferences(const osg::FrameStamp& frameStamp)
+{
+    _objectCache->updateTimeStampOfObjectsInCacheWithExternalReferences(frameStamp.getReferenceTime());
 }
 
 void Registry::removeExpiredObjectsInCache(const osg::FrameStamp& frameStamp)
 {
     double expiryTime = frameStamp.getReferenceTime() - _expiryDelay;
 
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
-    typedef std::vector<std::string> ObjectsToRemove;
-    ObjectsToRemove objectsToRemove;
-
-    // first collect all the expired entries in the ObjectToRemove list.
-    for(ObjectCache::iterator oitr=_objectCache.begin();
-        oitr!=_objectCache.end();
-        ++oitr)
-    {
-        if (oitr->second.second<=expiryTime)
-        {
-            // record the filename of the entry to use as key for deleting
-            // afterwards/
-            objectsToRemove.push_back(oitr->first);
-        }
-    }
-    
-    // remove the entries from the _objectCaache.
-    for(ObjectsToRemove::iterator ritr=objectsToRemove.begin();
-        ritr!=objectsToRemove.end();
-        ++ritr)
-    {
-        // std::cout<<"Removing from Registry object cache '"<<*ritr<<"'"<<std::endl;
-        _objectCache.erase(*ritr);
-    }
-        
+    _objectCache->removeExpiredObjectsInCache(expiryTime);
 }
 
 void Registry::clearObjectCache()
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    _objectCache.clear();
+    if (_objectCache.valid()) _objectCache->clear();
 }
 
 void Registry::addToArchiveCache(const std::string& fileName, osgDB::Archive* archive)
@@ -1551,15 +1729,7 @@ void Registry::clearArchiveCache()
 
 void Registry::releaseGLObjects(osg::State* state)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
-    for(ObjectCache::iterator itr = _objectCache.begin();
-        itr != _objectCache.end();
-        ++itr)
-    {
-        osg::Object* object = itr->second.first.get();
-        object->releaseGLObjects(state);
-    }
+    _objectCache->releaseGLObjects(state);
 }
 
 SharedStateManager* Registry::getOrCreateSharedStateManager()
@@ -12,10 +12,67 @@
 */
 
 #include <osg/Timer>
+#include <osg/ImageStream>
+#include <osg/Material>
+#include <osg/Texture>
 #include <osgDB/SharedStateManager>
 
+#include <string.h>
+#include <vector>
+
 using namespace osgDB;
 
+namespace
+{
+    inline unsigned int hashCombine(unsigned int seed, unsigned int value)
+    {
+        return seed ^ (value + 0x9e3779b9 + (seed<<6) + (seed>>2));
+    }
+
+    inline unsigned int hashFloat(unsigned int seed, float value)
+    {
+        unsigned int bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return hashCombine(seed, bits);
+    }
+
+    inline unsigned int hashVec4(unsigned int seed, const osg::Vec4& v)
+    {
+        for(unsigned int i=0; i<4; ++i) seed = hashFloat(seed, v[i]);
+        return seed;
+    }
+
+    // FNV-1a over 32 bit words, the trailing bytes taken one at a time.
+    unsigned int hashBytes(unsigned int seed, const void* data, unsigned int size)
+    {
+        const unsigned char* ptr = static_cast<const unsigned char*>(data);
+        const unsigned char* end = ptr + size;
+        unsigned int hash = seed ^ 2166136261u;
+        for(; ptr+4<=end; ptr+=4)
+        {
+            unsigned int word;
+            memcpy(&word, ptr, 4);
+            hash = (hash ^ word) * 16777619u;
+        }
+        for(; ptr<end; ++ptr)
+        {
+            hash = (hash ^ *ptr) * 16777619u;
+        }
+        return hash;
+    }
+
+    inline unsigned int hashString(unsigned int seed, const std::string& str)
+    {
+        return hashBytes(seed, str.data(), static_cast<unsigned int>(str.size()));
+    }
+
+    template<class T>
+    bool hasCallbacks(const T& object)
+    {
+        return object.getUpdateCallback()!=0 || object.getEventCallback()!=0;
+    }
+}
+
 SharedStateManager::SharedStateManager(unsigned int mode):
     osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) 
 {
@@ -39,27 +96,34 @@ void SharedStateManager::setShareMode(unsigned int mode)
 //----------------------------------------------------------------
 // SharedStateManager::prune
 //----------------------------------------------------------------
-void SharedStateManager::prune()
+namespace
 {
-    StateSetSet::iterator sitr;
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_listMutex);
-    for(sitr=_sharedStateSetList.begin(); sitr!=_sharedStateSetList.end();)
+    template<class M>
+    void pruneUnreferenced(M& sharedList)
     {
-        if ((*sitr)->referenceCount()<=1)
-            _sharedStateSetList.erase(sitr++);
-        else
-            ++sitr;
+        for(typename M::iterator itr=sharedList.begin(); itr!=sharedList.end();)
+        {
+            if (itr->second->referenceCount()<=1)
+                sharedList.erase(itr++);
+            else
+                ++itr;
+        }
     }
+}
 
-    TextureSet::iterator titr;
-    for(titr=_sharedTextureList.begin(); titr!=_sharedTextureList.end();)
-    {
-        if ((*titr)->referenceCount()<=1)
-            _sharedTextureList.erase(titr++);
-        else
-            ++titr;
-    }
+void SharedStateManager::prune()
+{
+    // share() installs the objects it finds in the registry after releasing _listMutex, so hold _shareMutex too,
+    // otherwise an object could be pruned, and deleted, between another thread finding it and installing it.
+    OpenThreads::ScopedLock<OpenThreads::Mutex> shareLock(_shareMutex);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_listMutex);
 
+    // StateSets first as they reference the textures and attributes, which reference the images.
+    pruneUnreferenced(_sharedStateSetList);
+    pruneUnreferenced(_sharedTextureList);
+    pruneUnreferenced(_sharedAttributeList);
+    pruneUnreferenced(_sharedImageList);
+    pruneUnreferenced(_sharedArrayList);
 } 
 
 
@@ -70,11 +134,16 @@ void SharedStateManager::share(osg::Node *node, OpenThreads::Mutex *mt)
 {
 //    const osg::Timer& timer = *osg::Timer::instance();
 //    osg::Timer_t start_tick = timer.tick();
-    
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_shareMutex);
+
     _mutex = mt;
-    apply(*node);
+    node->accept(*this);
     tmpSharedTextureList.clear();
     tmpSharedStateSetList.clear();
+    tmpSharedAttributeList.clear();
+    tmpSharedImageList.clear();
+    tmpSharedArrayList.clear();
     _mutex = 0;
 
 //    osg::Timer_t end_tick = timer.tick();
@@ -104,6 +173,12 @@ void SharedStateManager::apply(osg::Geode& geode)
         {
             ss = drawable->getStateSet();
             if(ss) process(ss, drawable);
+
+            if (_shareMode & SHARE_ARRAYS)
+            {
+                osg::Geometry* geometry = drawable->asGeometry();
+                if (geometry) shareArrays(geometry);
+            }
         }
     }
 }
@@ -113,36 +188,206 @@ bool SharedStateManager::isShared(osg::StateSet *ss)
     if (shareStateSet(ss->getDataVariance()))
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_listMutex);
-        return find(ss) != 0;
+        osg::StateSet* ssFromSharedList = find(ss);
+        return ssFromSharedList!=0 && ssFromSharedList!=ss;
     }
     else
         return false;
 }
 
+SharedStateManager::Statistics SharedStateManager::getStatistics() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> shareLock(const_cast<OpenThreads::Mutex&>(_shareMutex));
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_listMutex);
+
+    Statistics statistics = _statistics;
+    statistics.numStateSets = static_cast<unsigned int>(_sharedStateSetList.size());
+    statistics.numTextures = static_cast<unsigned int>(_sharedTextureList.size());
+    statistics.numAttributes = static_cast<unsigned int>(_sharedAttributeList.size());
+    statistics.numImages = static_cast<unsigned int>(_sharedImageList.size());
+    statistics.numArrays = static_cast<unsigned int>(_sharedArrayList.size());
+    return statistics;
+}
+
+void SharedStateManager::resetStatistics()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> shareLock(_shareMutex);
+    _statistics = Statistics();
+}
+
+//----------------------------------------------------------------
+// SharedStateManager::computeHash
+//----------------------------------------------------------------
+//
+// Objects that compare equal must hash equal, so only the parts
+// that compare() and isEqual() check are hashed.
+unsigned int SharedStateManager::computeHash(const osg::StateAttribute& sa)
+{
+    unsigned int hash = hashString(0, sa.className());
+    hash = hashCombine(hash, sa.getType());
+    hash = hashCombine(hash, sa.getMember());
+
+    const osg::Texture* texture = sa.asTexture();
+    if (texture)
+    {
+        hash = hashCombine(hash, texture->getWrap(osg::Texture::WRAP_S));
+        hash = hashCombine(hash, texture->getWrap(osg::Texture::WRAP_T));
+        hash = hashCombine(hash, texture->getWrap(osg::Texture::WRAP_R));
+        hash = hashCombine(hash, texture->getFilter(osg::Texture::MIN_FILTER));
+        hash = hashCombine(hash, texture->getFilter(osg::Texture::MAG_FILTER));
+        for(unsigned int i=0; i<texture->getNumImages(); ++i)
+        {
+            const osg::Image* image = texture->getImage(i);
+            if (!image) continue;
+            hash = hashCombine(hash, image->s());
+            hash = hashCombine(hash, image->t());
+            hash = hashCombine(hash, image->r());
+            hash = hashCombine(hash, image->getPixelFormat());
+            hash = hashCombine(hash, image->getDataType());
+        }
+        return hash;
+    }
+
+    const osg::Material* material = dynamic_cast<const osg::Material*>(&sa);
+    if (material)
+    {
+        hash = hashCombine(hash, material->getColorMode());
+        const osg::Material::Face faces[2] = { osg::Material::FRONT, osg::Material::BACK };
+        for(unsigned int i=0; i<2; ++i)
+        {
+            hash = hashVec4(hash, material->getAmbient(faces[i]));
+            hash = hashVec4(hash, material->getDiffuse(faces[i]));
+            hash = hashVec4(hash, material->getSpecular(faces[i]));
+            hash = hashVec4(hash, material->getEmission(faces[i]));
+            hash = hashFloat(hash, material->getShininess(faces[i]));
+        }
+    }
+
+    return hash;
+}
+
+unsigned int SharedStateManager::computeHash(const osg::StateSet& ss)
+{
+    unsigned int hash = hashCombine(0, ss.getRenderingHint());
+    hash = hashCombine(hash, ss.getRenderBinMode());
+    if (ss.getRenderBinMode()!=osg::StateSet::INHERIT_RENDERBIN_DETAILS)
+    {
+        hash = hashCombine(hash, ss.getBinNumber());
+        hash = hashString(hash, ss.getBinName());
+    }
+
+    const osg::StateSet::ModeList& modes = ss.getModeList();
+    for(osg::StateSet::ModeList::const_iterator itr = modes.begin(); itr!=modes.end(); ++itr)
+    {
+        hash = hashCombine(hash, itr->first);
+        hash = hashCombine(hash, itr->second);
+    }
+
+    const osg::StateSet::AttributeList& attributes = ss.getAttributeList();
+    for(osg::StateSet::AttributeList::const_iterator itr = attributes.begin(); itr!=attributes.end(); ++itr)
+    {
+        hash = hashCombine(hash, computeHash(*(itr->second.first)));
+        hash = hashCombine(hash, itr->second.second);
+    }
+
+    const osg::StateSet::TextureAttributeList& textureAttributes = ss.getTextureAttributeList();
+    for(unsigned int unit=0; unit<textureAttributes.size(); ++unit)
+    {
+        hash = hashCombine(hash, unit);
+        for(osg::StateSet::AttributeList::const_iterator itr = textureAttributes[unit].begin(); itr!=textureAttributes[unit].end(); ++itr)
+        {
+            hash = hashCombine(hash, computeHash(*(itr->second.first)));
+            hash = hashCombine(hash, itr->second.second);
+        }
+    }
+
+    const osg::StateSet::TextureModeList& textureModes = ss.getTextureModeList();
+    for(unsigned int unit=0; unit<textureModes.size(); ++unit)
+    {
+        hash = hashCombine(hash, unit);
+        for(osg::StateSet::ModeList::const_iterator itr = textureModes[unit].begin(); itr!=textureModes[unit].end(); ++itr)
+        {
+            hash = hashCombine(hash, itr->first);
+            hash = hashCombine(hash, itr->second);
+        }
+    }
+
+    const osg::StateSet::UniformList& uniforms = ss.getUniformList();
+    for(osg::StateSet::UniformList::const_iterator itr = uniforms.begin(); itr!=uniforms.end(); ++itr)
+    {
+        hash = hashString(hash, itr->first);
+        hash = hashCombine(hash, itr->second.first->getType());
+        hash = hashCombine(hash, itr->second.second);
+    }
+
+    return hash;
+}
+
+unsigned int SharedStateManager::computeHash(const osg::BufferData& data)
+{
+    return hashBytes(data.getTotalDataSize(), data.getDataPointer(), data.getTotalDataSize());
+}
+
+//----------------------------------------------------------------
+// SharedStateManager::isEqual
+//----------------------------------------------------------------
+bool SharedStateManager::isEqual(const osg::StateSet& lhs, const osg::StateSet& rhs)
+{
+    return lhs.getRenderingHint()==rhs.getRenderingHint() && lhs.compare(rhs, true)==0;
+}
+
+bool SharedStateManager::isEqual(const osg::Image& lhs, const osg::Image& rhs)
+{
+    return lhs.s()==rhs.s() &&
+           lhs.t()==rhs.t() &&
+           lhs.r()==rhs.r() &&
+           lhs.getInternalTextureFormat()==rhs.getInternalTextureFormat() &&
+           lhs.getPixelFormat()==rhs.getPixelFormat() &&
+           lhs.getDataType()==rhs.getDataType() &&
+           lhs.getPacking()==rhs.getPacking() &&
+           lhs.getOrigin()==rhs.getOrigin() &&
+           lhs.getMipmapLevels()==rhs.getMipmapLevels() &&
+           lhs.getTotalDataSize()==rhs.getTotalDataSize() &&
+           memcmp(lhs.getDataPointer(), rhs.getDataPointer(), lhs.getTotalDataSize())==0;
+}
+
+bool SharedStateManager::isEqual(const osg::Array& lhs, const osg::Array& rhs)
+{
+    return lhs.getType()==rhs.getType() &&
+           lhs.getDataSize()==rhs.getDataSize() &&
+           lhs.getDataType()==rhs.getDataType() &&
+           lhs.getNumElements()==rhs.getNumElements() &&
+           lhs.getTotalDataSize()==rhs.getTotalDataSize() &&
+           memcmp(lhs.getDataPointer(), rhs.getDataPointer(), lhs.getTotalDataSize())==0;
+}
+
 //----------------------------------------------------------------
 // SharedStateManager::find
 //----------------------------------------------------------------
 //
-// The find methods don't need to lock _listMutex because the thread
-// from which they are called is doing the writing to the lists.
+// The find methods require _listMutex to be held, as prune() and
+// isShared() may be called from other threads.
 osg::StateSet *SharedStateManager::find(osg::StateSet *ss)
 {
-    StateSetSet::iterator result
-        = _sharedStateSetList.find(osg::ref_ptr<osg::StateSet>(ss));
-    if (result == _sharedStateSetList.end())
-        return NULL;
-    else
-        return result->get();
+    std::pair<StateSetSet::iterator, StateSetSet::iterator> range
+        = _sharedStateSetList.equal_range(computeHash(*ss));
+    for(StateSetSet::iterator itr = range.first; itr!=range.second; ++itr)
+    {
+        if (itr->second==ss || isEqual(*(itr->second), *ss)) return itr->second.get();
+    }
+    return NULL;
 }
 
 osg::StateAttribute *SharedStateManager::find(osg::StateAttribute *sa)
 {
-    TextureSet::iterator result
-        = _sharedTextureList.find(osg::ref_ptr<osg::StateAttribute>(sa));
-    if (result == _sharedTextureList.end())
-        return NULL;
-    else
-        return result->get();
+    TextureSet& sharedList = sa->asTexture() ? _sharedTextureList : _sharedAttributeList;
+    std::pair<TextureSet::iterator, TextureSet::iterator> range
+        = sharedList.equal_range(computeHash(*sa));
+    for(TextureSet::iterator itr = range.first; itr!=range.second; ++itr)
+    {
+        if (itr->second==sa || itr->second->compare(*sa)==0) return itr->second.get();
+    }
+    return NULL;
 }
    
 
@@ -167,6 +412,63 @@ void SharedStateManager::setStateSet(osg::StateSet* ss, osg::Object* object)
 }
 
 
+//----------------------------------------------------------------
+// SharedStateManager::shareImages
+//----------------------------------------------------------------
+void SharedStateManager::shareImages(osg::StateAttribute* sa)
+{
+    osg::Texture* texture = sa->asTexture();
+    if (!texture) return;
+
+    for(unsigned int i=0; i<texture->getNumImages(); ++i)
+    {
+        osg::Image* image = texture->getImage(i);
+
+        // Only share images holding static data
+        if (!image || !image->data() ||
+            image->getDataVariance()==osg::Object::DYNAMIC ||
+            dynamic_cast<osg::ImageStream*>(image)) continue;
+
+        osg::Image* imageFromSharedList = 0;
+        ImageImageMap::iterator iitr = tmpSharedImageList.find(image);
+        if (iitr!=tmpSharedImageList.end())
+        {
+            imageFromSharedList = iitr->second;
+        }
+        else
+        {
+            // hash outside of the lock, the data may be large
+            unsigned int hash = computeHash(*image);
+
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_listMutex);
+            std::pair<ImageSet::iterator, ImageSet::iterator> range = _sharedImageList.equal_range(hash);
+            for(ImageSet::iterator itr = range.first; itr!=range.second; ++itr)
+            {
+                if (itr->second==image || isEqual(*(itr->second), *image))
+                {
+                    imageFromSharedList = itr->second.get();
+                    break;
+                }
+            }
+            if (!imageFromSharedList)
+            {
+                _sharedImageList.insert(ImageSet::value_type(hash, image));
+                imageFromSharedList = image;
+            }
+            tmpSharedImageList[image] = imageFromSharedList;
+        }
+
+        if (imageFromSharedList!=image)
+        {
+            if(_mutex) _mutex->lock();
+            texture->setImage(i, imageFromSharedList);
+            if(_mutex) _mutex->unlock();
+            ++_statistics.numImagesShared;
+        }
+    }
+}
+
+
 //----------------------------------------------------------------
 // SharedStateManager::shareTextures
 //----------------------------------------------------------------
@@ -178,30 +480,47 @@ void SharedStateManager::shareTextures(osg::StateSet* ss)
         osg::StateAttribute *texture = ss->getTextureAttribute(unit, osg::StateAttribute::TEXTURE);
 
         // Valid Texture to be shared
-        if(texture && shareTexture(texture->getDataVariance()))
+        if(texture && shareTexture(texture->getDataVariance()) && !hasCallbacks(*texture))
         {
+            const osg::StateSet::RefAttributePair* texturePair = ss->getTextureAttributePair(unit, osg::StateAttribute::TEXTURE);
+            osg::StateAttribute::OverrideValue value = texturePair->second;
+
             TextureTextureSharePairMap::iterator titr = tmpSharedTextureList.find(texture);
             if(titr==tmpSharedTextureList.end())
             {
                 // Texture is not in tmp list: 
-                // First time it appears in this file, search Texture in sharedAttributeList
-                osg::StateAttribute *textureFromSharedList = find(texture);
-                if(textureFromSharedList)
+                // First time it appears in this file. Share its images so
+                // that textures of identical images compare equal, then
+                // search Texture in sharedAttributeList
+                if (_shareMode & SHARE_IMAGES) shareImages(texture);
+
+                osg::StateAttribute *textureFromSharedList = 0;
+                {
+                    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_listMutex);
+                    textureFromSharedList = find(texture);
+
+                    // a texture already in the registry, from an earlier share() of the same subgraph, matches itself.
+                    if (!textureFromSharedList)
+                    {
+                        _sharedTextureList.insert(TextureSet::value_type(computeHash(*texture), texture));
+                    }
+                }
+
+                if(textureFromSharedList && textureFromSharedList!=texture)
                 {
                     // Texture is in sharedAttributeList: 
                     // Share now. Required to be shared all next times
                     if(_mutex) _mutex->lock();
-                    ss->setTextureAttributeAndModes(unit, textureFromSharedList, osg::StateAttribute::ON);
+                    ss->setTextureAttribute(unit, textureFromSharedList, value);
                     if(_mutex) _mutex->unlock();
                     tmpSharedTextureList[texture] = TextureSharePair(textureFromSharedList, true);
+                    ++_statistics.numTexturesShared;
                 }
                 else
                 {
-                    // Texture is not in _sharedAttributeList: 
-                    // Add to _sharedAttributeList. Not needed to be
-                    // shared all next times.
-                    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_listMutex);
-                    _sharedTextureList.insert(texture); 
+                    // Texture is not in _sharedAttributeList, or is there
+                    // itself: Added to _sharedAttributeList. Not needed to
+                    // be shared all next times.
                     tmpSharedTextureList[texture] = TextureSharePair(texture, false);            
                 }
             }
@@ -210,11 +529,134 @@ void SharedStateManager::shareTextures(osg::StateSet* ss)
                 // Texture is in tmpSharedAttributeList and share flag is on:
                 // It should be shared
                 if(_mutex) _mutex->lock();
-                ss->setTextureAttributeAndModes(unit, titr->second.first, osg::StateAttribute::ON);
+                ss->setTextureAttribute(unit, titr->second.first, value);
                 if(_mutex) _mutex->unlock();
+                ++_statistics.numTexturesShared;
+            }
+        }
+        else if (texture && (_shareMode & SHARE_IMAGES) && texture->getDataVariance()!=osg::Object::DYNAMIC)
+        {
+            shareImages(texture);
+        }
+    }
+}
+
+
+//----------------------------------------------------------------
+// SharedStateManager::shareAttributes
+//----------------------------------------------------------------
+void SharedStateManager::shareAttributes(osg::StateSet* ss)
+{
+    typedef std::vector<osg::StateSet::RefAttributePair> AttributePairList;
+    AttributePairList attributesToShare;
+
+    osg::StateSet::AttributeList& attributes = ss->getAttributeList();
+    for(osg::StateSet::AttributeList::iterator itr = attributes.begin();
+        itr != attributes.end();
+        ++itr)
+    {
+        osg::StateAttribute* sa = itr->second.first.get();
+        if (sa->getDataVariance()==osg::Object::DYNAMIC || hasCallbacks(*sa)) continue;
+
+        osg::StateAttribute* saFromSharedList = 0;
+        AttributeAttributeMap::iterator aitr = tmpSharedAttributeList.find(sa);
+        if (aitr!=tmpSharedAttributeList.end())
+        {
+            saFromSharedList = aitr->second;
+        }
+        else
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_listMutex);
+            saFromSharedList = find(sa);
+            if (!saFromSharedList)
+            {
+                _sharedAttributeList.insert(AttributeSet::value_type(computeHash(*sa), sa));
+                saFromSharedList = sa;
             }
+            tmpSharedAttributeList[sa] = saFromSharedList;
         }
+
+        if (saFromSharedList!=sa)
+        {
+            attributesToShare.push_back(osg::StateSet::RefAttributePair(saFromSharedList, itr->second.second));
+        }
+    }
+
+    // replace after the traversal, setAttribute modifies the attribute list.
+    if (attributesToShare.empty()) return;
+
+    if(_mutex) _mutex->lock();
+    for(AttributePairList::iterator itr = attributesToShare.begin();
+        itr != attributesToShare.end();
+        ++itr)
+    {
+        ss->setAttribute(itr->first.get(), itr->second);
     }
+    if(_mutex) _mutex->unlock();
+
+    _statistics.numAttributesShared += static_cast<unsigned int>(attributesToShare.size());
+}
+
+
+//----------------------------------------------------------------
+// SharedStateManager::shareArrays
+//----------------------------------------------------------------
+osg::Array* SharedStateManager::shareArray(osg::Array* array)
+{
+    if (!array || array->getDataVariance()==osg::Object::DYNAMIC || array->getTotalDataSize()==0) return array;
+
+    ArrayArrayMap::iterator aitr = tmpSharedArrayList.find(array);
+    if (aitr!=tmpSharedArrayList.end()) return aitr->second;
+
+    unsigned int hash = computeHash(*array);
+
+    osg::Array* arrayFromSharedList = 0;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_listMutex);
+        std::pair<ArraySet::iterator, ArraySet::iterator> range = _sharedArrayList.equal_range(hash);
+        for(ArraySet::iterator itr = range.first; itr!=range.second; ++itr)
+        {
+            if (itr->second==array || isEqual(*(itr->second), *array))
+            {
+                arrayFromSharedList = itr->second.get();
+                break;
+            }
+        }
+        if (!arrayFromSharedList)
+        {
+            _sharedArrayList.insert(ArraySet::value_type(hash, array));
+            arrayFromSharedList = array;
+        }
+    }
+
+    tmpSharedArrayList[array] = arrayFromSharedList;
+    if (arrayFromSharedList!=array) ++_statistics.numArraysShared;
+    return arrayFromSharedList;
+}
+
+void SharedStateManager::shareArrays(osg::Geometry* geometry)
+{
+    if (geometry->getDataVariance()==osg::Object::DYNAMIC) return;
+
+    osg::Array* vertices = shareArray(geometry->getVertexArray());
+    osg::Array* normals = shareArray(geometry->getNormalArray());
+    osg::Array* colors = shareArray(geometry->getColorArray());
+
+    std::vector<osg::Array*> texCoords(geometry->getNumTexCoordArrays());
+    for(unsigned int unit=0; unit<texCoords.size(); ++unit)
+    {
+        texCoords[unit] = shareArray(geometry->getTexCoordArray(unit));
+    }
+
+    if(_mutex) _mutex->lock();
+    if (vertices!=geometry->getVertexArray()) geometry->setVertexArray(vertices);
+    if (normals!=geometry->getNormalArray()) geometry->setNormalArray(normals);
+    if (colors!=geometry->getColorArray()) geometry->setColorArray(colors);
+    for(unsigned int unit=0; unit<texCoords.size(); ++unit)
+    {
+        if (texCoords[unit]!=geometry->getTexCoordArray(unit)) geometry->setTexCoordArray(unit, texCoords[unit]);
+    }
+    if(_mutex) _mutex->unlock();
 }
 
 
@@ -224,15 +666,31 @@ void SharedStateManager::shareTextures(osg::StateSet* ss)
 void SharedStateManager::process(osg::StateSet* ss, osg::Object* parent)
 {
     // Valid StateSet to be shared
-    if (shareStateSet(ss->getDataVariance()))
+    if (shareStateSet(ss->getDataVariance()) && !hasCallbacks(*ss))
     {
         StateSetStateSetSharePairMap::iterator sitr = tmpSharedStateSetList.find(ss);
         if (sitr==tmpSharedStateSetList.end())
         {
             // StateSet is not in tmp list: 
-            // First time it appears in this file, search StateSet in sharedObjectList
-            osg::StateSet *ssFromSharedList = find(ss);
-            if (ssFromSharedList)
+            // First time it appears in this file. Share its contents first,
+            // which leaves its hash unchanged, so that StateSets holding
+            // equivalent textures of different images compare equal. Then
+            // search StateSet in sharedObjectList
+            if (_shareMode & (SHARE_STATIC_TEXTURES | SHARE_UNSPECIFIED_TEXTURES | SHARE_DYNAMIC_TEXTURES | SHARE_IMAGES))
+            {
+                shareTextures(ss);
+            }
+            if (_shareMode & SHARE_ATTRIBUTES)
+            {
+                shareAttributes(ss);
+            }
+
+            osg::StateSet *ssFromSharedList = 0;
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_listMutex);
+                ssFromSharedList = find(ss);
+            }
+            if (ssFromSharedList && ssFromSharedList!=ss)
             {
                 // StateSet is in sharedStateSetList: 
                 // Share now. Required to be shared all next times
@@ -240,22 +698,18 @@ void SharedStateManager::process(osg::StateSet* ss, osg::Object* parent)
                 setStateSet(ssFromSharedList, parent);
                 if (_mutex) _mutex->unlock();
                 tmpSharedStateSetList[ss] = StateSetSharePair(ssFromSharedList, true);
+                ++_statistics.numStateSetsShared;
             }
             else
             {
-                // StateSet is not in sharedStateSetList: 
+                // StateSet is not in sharedStateSetList, or is there itself:
                 // Add to sharedStateSetList. Not needed to be shared all next times.
                 {
                     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_listMutex);
-                    _sharedStateSetList.insert(ss); 
+                    if (!ssFromSharedList) _sharedStateSetList.insert(StateSetSet::value_type(computeHash(*ss), ss));
                     tmpSharedStateSetList[ss]
                         = StateSetSharePair(ss, false);            
                 }
-                // Only in this case sharing textures is also required
-                if (_shareMode & (SHARE_UNSPECIFIED_TEXTURES | SHARE_UNSPECIFIED_TEXTURES | SHARE_UNSPECIFIED_TEXTURES))
-                {
-                    shareTextures(ss);
-                }
             }
         }
         else if (sitr->second.second)
@@ -265,10 +719,21 @@ void SharedStateManager::process(osg::StateSet* ss, osg::Object* parent)
             if(_mutex) _mutex->lock();
             setStateSet(sitr->second.first, parent);
             if(_mutex) _mutex->unlock();
+            ++_statistics.numStateSetsShared;
         }
     }
-    else if (_shareMode & (SHARE_UNSPECIFIED_TEXTURES | SHARE_UNSPECIFIED_TEXTURES | SHARE_UNSPECIFIED_TEXTURES))
+    else if (tmpSharedStateSetList.find(ss)==tmpSharedStateSetList.end())
     {
-        shareTextures(ss);
+        // Unshared StateSet, only its contents are shared, once.
+        tmpSharedStateSetList[ss] = StateSetSharePair(ss, false);
+
+        if (_shareMode & (SHARE_STATIC_TEXTURES | SHARE_UNSPECIFIED_TEXTURES | SHARE_DYNAMIC_TEXTURES | SHARE_IMAGES))
+        {
+            shareTextures(ss);
+        }
+        if (_shareMode & SHARE_ATTRIBUTES)
+        {
+            shareAttributes(ss);
+        }
     }
 }
@@ -4,6 +4,7 @@
 
 #include <iostream>        // for ifstream
 #include <string>
+#include <string.h>
 #include <map>
 #include <vector>
 #include <osg/Vec2>
@@ -25,6 +26,7 @@
 //#include <osgVolume/VolumeTile>
 
 #include <osgDB/ReaderWriter>
+#include <osgDB/BlockCompression>
 
 #include "IveVersion.h"
 #include "DataTypeSize.h"    
@@ -56,6 +58,9 @@ public:
     double readDouble();
     std::string readString();
     void readCharArray(char* data, int size);
+
+    /** Read numElements values of elementSize bytes straight into data, byte swapping them in one pass when required.*/
+    bool readArrayData(void* data, unsigned int numElements, unsigned int elementSize);
         
     osg::Vec2 readVec2();
     osg::Vec3 readVec3();
@@ -133,16 +138,43 @@ public:
     std::istream*       _istream;
     int                 _byteswap;
 
-    bool                _owns_istream;
-
     bool uncompress(std::istream& fin, std::string& destination) const;
 
+    /** Inflate fin_start followed by fin into destination, which should be sized to the expected uncompressed size.*/
+    bool uncompress(std::istream& fin_start, std::istream& fin, std::string& destination) const;
+
+    /** Return true if a read has run past the end of the data.*/
+    bool failed() const { return _failed; }
+
     void throwException(const std::string& message) { _exception = new Exception(message); }
     void throwException(Exception* exception) { _exception = exception; }
     const Exception* getException() const { return _exception.get(); }
     
 private:
 
+    /** Copy size bytes from the read buffer, refilling it from the istream as required.*/
+    inline bool readData(char* data, unsigned int size)
+    {
+        if (size<=static_cast<unsigned int>(_bufferEnd-_bufferPtr))
+        {
+            memcpy(data, _bufferPtr, size);
+            _bufferPtr += size;
+            return true;
+        }
+        return readDataSlow(data, size);
+    }
+
+    bool readDataSlow(char* data, unsigned int size);
+
+    /** Data is read from the istream in blocks into _buffer and the scalars and arrays copied out of it,
+      * compressed streams are inflated into _buffer in one go. Block compressed streams are read straight out of
+      * _blockDecompressor's data as its blocks are decompressed.*/
+    std::string         _buffer;
+    const char*         _bufferPtr;
+    const char*         _bufferEnd;
+    bool                _bufferIsComplete;
+    bool                _failed;
+    osg::ref_ptr<osgDB::BlockDecompressor> _blockDecompressor;
 
     int                 _version;
     bool                _peeking;
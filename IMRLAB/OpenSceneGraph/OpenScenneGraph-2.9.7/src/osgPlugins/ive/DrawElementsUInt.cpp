@@ -55,15 +55,8 @@ void DrawElementsUInt::read(DataInputStream* in)
         // Read array length and its elements.
         int size = in->readInt();
         resize(size);
-        if (size!=0) in->readCharArray((char*)&front(), size * INTSIZE);
-
-        if (in->_byteswap)
-        {
-           for (int i = 0 ; i < size ; i++ )
-           {
-                osg::swapBytes4((char*)&((*this)[i])) ;
-           }
-        }        
+        if (size!=0 && !in->readArrayData(&front(), size, INTSIZE))
+            in_THROW_EXCEPTION("DrawElementsUInt::read(): Failed to read indices.");
     }
     else{
         in_THROW_EXCEPTION("DrawElementsUInt::read(): Expected DrawElementsUInt identification.");
@@ -54,15 +54,8 @@ void DrawElementsUShort::read(DataInputStream* in){
         // Read array length and its elements.
         int size = in->readInt();
         resize(size);
-        in->readCharArray((char*)&front(), size * SHORTSIZE);
-        
-        if (in->_byteswap)
-        {
-           for (int i = 0 ; i < size ; i++ )
-           {
-              osg::swapBytes((char *)&((*this)[i]),SHORTSIZE) ;
-           }
-        }        
+        if (size!=0 && !in->readArrayData(&front(), size, SHORTSIZE))
+            in_THROW_EXCEPTION("DrawElementsUShort::read(): Failed to read indices.");
     }
     else{
         in_THROW_EXCEPTION("DrawElementsUShort::read(): Expected DrawElementsUShort identification.");
@@ -102,6 +102,7 @@ namespace ive {
 #define IVECYLINDER                     0x00002005
 #define IVECAPSULE                      0x00002006
 #define IVEHEIGHTFIELD                  0x00002007
+#define IVEKDTREE                       0x00002008
 
 // Primitive set
 #define IVEPRIMITIVESET                 0x00010000
@@ -20,6 +20,8 @@ class ReaderWriterIVE : public ReaderWriter
             supportsExtension("ive","OpenSceneGraph native binary format");
 
             supportsOption("compressed","Export option, use zlib compression to compress the data in the .ive ");
+            supportsOption("compressBlocks","Export option, compress the data in the .ive as independent zlib blocks that are compressed and decompressed on several threads");
+            supportsOption("compressBlocksLZ4","Export option, as compressBlocks but with the faster to decompress LZ4 codec");
             supportsOption("noTexturesInIVEFile","Export option");
             supportsOption("includeImageFileInIVEFile","Export option");
             supportsOption("compressImageData","Export option");
@@ -29,6 +31,7 @@ class ReaderWriterIVE : public ReaderWriter
             supportsOption("TerrainMaximumErrorToSizeRatio=value","Export option that controls error matric used to determine terrain HieghtField storage precision.");
             supportsOption("noLoadExternalReferenceFiles","Import option");
             supportsOption("OutputTextureFiles","Write out the texture images to file");
+            supportsOption("noKdTreesInIVEFile","Export option, don't write the KdTrees of Geometry, leaving them to be rebuilt when the file is read");
         }
     
         virtual const char* className() const { return "IVE Reader/Writer"; }
@@ -175,6 +178,7 @@ class ReaderWriterIVE : public ReaderWriter
         {
             ive::DataOutputStream out(&fout, options);
 
+            out.precompressImages(&node);
             out.writeNode(const_cast<osg::Node*>(&node));
 
             if ( fout.fail() ) return WriteResult::ERROR_IN_WRITING_FILE;
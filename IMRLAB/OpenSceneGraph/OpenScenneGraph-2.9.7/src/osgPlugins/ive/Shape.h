@@ -2,6 +2,7 @@
 #define IVE_HIEGHTFIELD 1
 
 #include <osg/Shape>
+#include <osg/KdTree>
 #include "ReadWrite.h"
 
 namespace ive{
@@ -42,6 +43,16 @@ public:
 	void read(DataInputStream* in);
 };
 
+class KdTree : public osg::KdTree, public ReadWrite {
+public:
+	void write(DataOutputStream* out);
+	void read(DataInputStream* in);
+
+	/** Return true if the nodes, triangles and primitive indices are consistent with each other and index into vertices, so that
+	  * a KdTree read from file can be used with the vertices of the Geometry read alongside it.*/
+	bool isCompatible(const osg::Vec3Array* vertices) const;
+};
+
 }
 
 #endif
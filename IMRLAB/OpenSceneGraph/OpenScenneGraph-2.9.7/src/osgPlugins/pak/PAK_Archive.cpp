@@ -0,0 +1,945 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osg/Notify>
+#include <osg/Endian>
+
+#include <osgDB/Registry>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/ConvertUTF>
+
+#include <OpenThreads/ScopedLock>
+
+#include <sstream>
+#include <streambuf>
+#include <string.h>
+
+#if defined(WIN32) && !defined(__CYGWIN__)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#ifdef USE_ZLIB
+    #include <zlib.h>
+#endif
+
+#include "PAK_Archive.h"
+
+using namespace osgDB;
+
+static const char PAK_MAGIC[8] = { 'O', 'S', 'G', 'P', 'A', 'K', 0, 0 };
+static const PAKArchive::uint32 PAK_ENDIAN_TAG = 0x01020304;
+static const PAKArchive::uint32 PAK_VERSION = 1;
+static const PAKArchive::uint32 PAK_NO_ENTRY = 0xffffffff;
+
+static void swapHeader(PAKArchive::Header& header)
+{
+    osg::swapBytes4((char*)&header.endianTag);
+    osg::swapBytes4((char*)&header.version);
+    osg::swapBytes4((char*)&header.alignment);
+    osg::swapBytes4((char*)&header.numEntries);
+    osg::swapBytes4((char*)&header.numBuckets);
+    osg::swapBytes4((char*)&header.masterEntry);
+    osg::swapBytes8((char*)&header.indexOffset);
+    osg::swapBytes8((char*)&header.indexSize);
+}
+
+static void swapEntry(PAKArchive::Entry& entry)
+{
+    osg::swapBytes8((char*)&entry.hash);
+    osg::swapBytes8((char*)&entry.offset);
+    osg::swapBytes8((char*)&entry.storedSize);
+    osg::swapBytes8((char*)&entry.size);
+    osg::swapBytes4((char*)&entry.nameOffset);
+    osg::swapBytes4((char*)&entry.nameLength);
+    osg::swapBytes4((char*)&entry.compression);
+}
+
+static PAKArchive::uint64 alignTo(PAKArchive::uint64 position, PAKArchive::uint32 alignment)
+{
+    if (alignment<=1) return position;
+    return ((position + alignment - 1) / alignment) * alignment;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Read only memory mapping of the archive file, falls back to reading the file into memory where
+// the platform can't map it.
+//
+class PAKArchive::MappedFile
+{
+    public:
+
+        MappedFile():
+            _data(0),
+            _size(0),
+#if defined(WIN32) && !defined(__CYGWIN__)
+            _file(INVALID_HANDLE_VALUE),
+            _mapping(NULL)
+#else
+            _fd(-1)
+#endif
+        {}
+
+        ~MappedFile() { close(); }
+
+        bool open(const std::string& filename)
+        {
+            close();
+
+#if defined(WIN32) && !defined(__CYGWIN__)
+    #ifdef OSG_USE_UTF8_FILENAME
+            _file = CreateFileW(OSGDB_STRING_TO_FILENAME(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    #else
+            _file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    #endif
+            if (_file==INVALID_HANDLE_VALUE) return false;
+
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(_file, &fileSize) || fileSize.QuadPart==0)
+            {
+                close();
+                return false;
+            }
+            _size = fileSize.QuadPart;
+
+            _mapping = CreateFileMapping(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (_mapping) _data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+            _fd = ::open(filename.c_str(), O_RDONLY);
+            if (_fd<0) return false;
+
+            struct stat fileStat;
+            if (fstat(_fd, &fileStat)!=0 || fileStat.st_size==0)
+            {
+                close();
+                return false;
+            }
+            _size = fileStat.st_size;
+
+            void* ptr = mmap(0, _size, PROT_READ, MAP_SHARED, _fd, 0);
+            if (ptr!=MAP_FAILED) _data = static_cast<const char*>(ptr);
+#endif
+
+            if (!_data)
+            {
+                OSG_NOTIFY(osg::INFO)<<"PAKArchive : unable to memory map "<<filename<<", reading it into memory instead."<<std::endl;
+
+                osgDB::ifstream fin(filename.c_str(), std::ios::in | std::ios::binary);
+                if (!fin) { close(); return false; }
+
+                _buffer.resize(_size);
+                fin.read(&_buffer[0], _size);
+                if (fin.fail()) { close(); return false; }
+
+                _data = &_buffer[0];
+            }
+
+            return true;
+        }
+
+        void close()
+        {
+#if defined(WIN32) && !defined(__CYGWIN__)
+            if (_data && _buffer.empty()) UnmapViewOfFile(_data);
+            if (_mapping) CloseHandle(_mapping);
+            if (_file!=INVALID_HANDLE_VALUE) CloseHandle(_file);
+            _mapping = NULL;
+            _file = INVALID_HANDLE_VALUE;
+#else
+            if (_data && _buffer.empty()) munmap(const_cast<char*>(_data), _size);
+            if (_fd>=0) ::close(_fd);
+            _fd = -1;
+#endif
+            _data = 0;
+            _size = 0;
+            _buffer.clear();
+        }
+
+        const char* data() const { return _data; }
+        uint64 size() const { return _size; }
+
+    protected:
+
+        const char*         _data;
+        uint64              _size;
+        std::vector<char>   _buffer;
+
+#if defined(WIN32) && !defined(__CYGWIN__)
+        HANDLE              _file;
+        HANDLE              _mapping;
+#else
+        int                 _fd;
+#endif
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// streambuf reading directly from a block of memory, so that the plugins parse the mapped archive
+// without an intermediate copy.
+//
+class MemoryStreamBuf : public std::streambuf
+{
+    public:
+
+        MemoryStreamBuf(const char* data, size_t size)
+        {
+            char* begin = const_cast<char*>(data);
+            setg(begin, begin, begin+size);
+        }
+
+    protected:
+
+        virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+        {
+            if (which & std::ios_base::out) return pos_type(off_type(-1));
+
+            char* position = 0;
+            switch(dir)
+            {
+                case(std::ios_base::beg): position = eback() + off; break;
+                case(std::ios_base::cur): position = gptr() + off; break;
+                case(std::ios_base::end): position = egptr() + off; break;
+                default: return pos_type(off_type(-1));
+            }
+
+            if (position<eback() || position>egptr()) return pos_type(off_type(-1));
+
+            setg(eback(), position, egptr());
+            return pos_type(off_type(position-eback()));
+        }
+
+        virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which)
+        {
+            return seekoff(off_type(pos), std::ios_base::beg, which);
+        }
+
+        virtual std::streamsize showmanyc()
+        {
+            return egptr()-gptr();
+        }
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// PAKArchive
+//
+PAKArchive::PAKArchive():
+    _status(READ),
+    _mappedFile(0),
+    _buckets(0),
+    _entries(0),
+    _names(0),
+    _writePosition(0)
+{
+    memset(&_header, 0, sizeof(Header));
+}
+
+PAKArchive::~PAKArchive()
+{
+    close();
+}
+
+PAKArchive::uint64 PAKArchive::hashFileName(const std::string& filename)
+{
+    uint64 hash = 14695981039346656037ULL;
+    for(std::string::const_iterator itr = filename.begin();
+        itr != filename.end();
+        ++itr)
+    {
+        hash ^= static_cast<unsigned char>(*itr);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string PAKArchive::normalizeFileName(const std::string& filename)
+{
+    std::string name = osgDB::convertFileNameToUnixStyle(filename);
+
+    std::string::size_type start = 0;
+    while(start<name.size())
+    {
+        if (name[start]=='/') ++start;
+        else if (name.compare(start, 2, "./")==0) start += 2;
+        else break;
+    }
+
+    return name.substr(start);
+}
+
+bool PAKArchive::open(const std::string& filename, ArchiveStatus status, const osgDB::ReaderWriter::Options* options)
+{
+    close();
+
+    _archiveFileName = filename;
+    _status = status;
+
+    if (status==READ)
+    {
+        _mappedFile = new MappedFile;
+        if (!_mappedFile->open(filename))
+        {
+            OSG_NOTIFY(osg::INFO)<<"PAKArchive::open("<<filename<<") : unable to open file."<<std::endl;
+            close();
+            return false;
+        }
+
+        if (_mappedFile->size()<sizeof(Header) || memcmp(_mappedFile->data(), PAK_MAGIC, sizeof(PAK_MAGIC))!=0)
+        {
+            OSG_NOTIFY(osg::WARN)<<"PAKArchive::open("<<filename<<") : not a valid archive."<<std::endl;
+            close();
+            return false;
+        }
+
+        memcpy(&_header, _mappedFile->data(), sizeof(Header));
+
+        bool byteswap = _header.endianTag!=PAK_ENDIAN_TAG;
+        if (byteswap) swapHeader(_header);
+
+        if (_header.endianTag!=PAK_ENDIAN_TAG || _header.version>PAK_VERSION ||
+            _header.indexOffset==0 || _header.indexOffset+_header.indexSize>_mappedFile->size())
+        {
+            OSG_NOTIFY(osg::WARN)<<"PAKArchive::open("<<filename<<") : archive is incomplete or of an unsupported version."<<std::endl;
+            close();
+            return false;
+        }
+
+        if (!readIndex(_mappedFile->data()+_header.indexOffset, _header.indexSize, byteswap))
+        {
+            OSG_NOTIFY(osg::WARN)<<"PAKArchive::open("<<filename<<") : corrupt index."<<std::endl;
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    // WRITE appends to an existing archive, CREATE starts a new one.
+    uint32 alignment = 16;
+    if (options)
+    {
+        std::istringstream iss(options->getOptionString());
+        std::string opt;
+        while (iss >> opt)
+        {
+            if (opt.compare(0, 10, "alignment=")==0)
+            {
+                alignment = atoi(opt.c_str()+10);
+                if (alignment==0) alignment = 1;
+            }
+        }
+    }
+
+    if (status==WRITE && osgDB::fileExists(filename))
+    {
+        _output.open(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        if (!_output)
+        {
+            OSG_NOTIFY(osg::WARN)<<"PAKArchive::open("<<filename<<") : unable to open file for writing."<<std::endl;
+            return false;
+        }
+
+        _output.read((char*)&_header, sizeof(Header));
+        if (_output.fail() || memcmp(_header.magic, PAK_MAGIC, sizeof(PAK_MAGIC))!=0 ||
+            _header.endianTag!=PAK_ENDIAN_TAG || _header.indexOffset==0)
+        {
+            OSG_NOTIFY(osg::WARN)<<"PAKArchive::open("<<filename<<") : can only append to complete archives written on a cpu of the same endianness."<<std::endl;
+            _output.close();
+            return false;
+        }
+
+        std::vector<char> index(_header.indexSize);
+        _output.seekg(_header.indexOffset);
+        if (!index.empty()) _output.read(&index[0], index.size());
+        if (_output.fail() || !readIndex(index.empty() ? 0 : &index[0], index.size(), true))
+        {
+            OSG_NOTIFY(osg::WARN)<<"PAKArchive::open("<<filename<<") : corrupt index."<<std::endl;
+            _output.close();
+            return false;
+        }
+
+        // new entries, and the new index written on close(), go after the old index, which the header keeps
+        // pointing at until the new one is complete, so that a failed append leaves the archive as it was.
+        _writePosition = _header.indexOffset + _header.indexSize;
+        return true;
+    }
+
+    _output.open(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!_output)
+    {
+        OSG_NOTIFY(osg::WARN)<<"PAKArchive::open("<<filename<<") : unable to create file."<<std::endl;
+        return false;
+    }
+
+    memset(&_header, 0, sizeof(Header));
+    memcpy(_header.magic, PAK_MAGIC, sizeof(PAK_MAGIC));
+    _header.endianTag = PAK_ENDIAN_TAG;
+    _header.version = PAK_VERSION;
+    _header.alignment = alignment;
+    _header.masterEntry = PAK_NO_ENTRY;
+
+    // the header is rewritten on close(), an indexOffset of 0 marks the archive as incomplete until then.
+    _output.write((const char*)&_header, sizeof(Header));
+    _writePosition = sizeof(Header);
+
+    return !_output.fail();
+}
+
+bool PAKArchive::readIndex(const char* indexData, uint64 indexSize, bool copy)
+{
+    uint64 bucketsSize = uint64(_header.numBuckets)*sizeof(uint32);
+    uint64 entriesSize = uint64(_header.numEntries)*sizeof(Entry);
+    if (bucketsSize+entriesSize>indexSize) return false;
+    if (_header.numBuckets!=0 && (_header.numBuckets & (_header.numBuckets-1))!=0) return false;
+    if (_header.numBuckets<=_header.numEntries && _header.numEntries!=0) return false;
+
+    uint64 namesSize = indexSize-bucketsSize-entriesSize;
+
+    bool byteswap = _header.endianTag!=PAK_ENDIAN_TAG;
+
+    if (copy || byteswap)
+    {
+        _bucketList.resize(_header.numBuckets);
+        _entryList.resize(_header.numEntries);
+        if (bucketsSize) memcpy(&_bucketList[0], indexData, bucketsSize);
+        if (entriesSize) memcpy(&_entryList[0], indexData+bucketsSize, entriesSize);
+        _nameTable.assign(indexData+bucketsSize+entriesSize, namesSize);
+
+        if (byteswap)
+        {
+            for(BucketList::iterator itr = _bucketList.begin(); itr != _bucketList.end(); ++itr) osg::swapBytes4((char*)&(*itr));
+            for(EntryList::iterator itr = _entryList.begin(); itr != _entryList.end(); ++itr) swapEntry(*itr);
+        }
+
+        _buckets = _bucketList.empty() ? 0 : &_bucketList[0];
+        _entries = _entryList.empty() ? 0 : &_entryList[0];
+        _names = _nameTable.c_str();
+    }
+    else
+    {
+        _buckets = reinterpret_cast<const uint32*>(indexData);
+        _entries = reinterpret_cast<const Entry*>(indexData+bucketsSize);
+        _names = indexData+bucketsSize+entriesSize;
+    }
+
+    uint64 dataEnd = _header.indexOffset;
+    for(uint32 i=0; i<_header.numEntries; ++i)
+    {
+        const Entry& entry = _entries[i];
+        if (uint64(entry.nameOffset)+entry.nameLength>namesSize) return false;
+        if (entry.offset+entry.storedSize>dataEnd) return false;
+    }
+
+    for(uint32 i=0; i<_header.numBuckets; ++i)
+    {
+        if (_buckets[i]>_header.numEntries) return false;
+    }
+
+    return true;
+}
+
+void PAKArchive::rebuildBuckets()
+{
+    uint32 numBuckets = 16;
+    while(numBuckets < _entryList.size()*2) numBuckets *= 2;
+
+    _bucketList.assign(numBuckets, 0);
+    for(uint32 i=0; i<_entryList.size(); ++i)
+    {
+        uint32 bucket = uint32(_entryList[i].hash & (numBuckets-1));
+        while(_bucketList[bucket]!=0) bucket = (bucket+1) & (numBuckets-1);
+        _bucketList[bucket] = i+1;
+    }
+
+    _header.numBuckets = numBuckets;
+    _header.numEntries = _entryList.size();
+    _buckets = &_bucketList[0];
+    _entries = _entryList.empty() ? 0 : &_entryList[0];
+    _names = _nameTable.c_str();
+}
+
+bool PAKArchive::writeIndex()
+{
+    rebuildBuckets();
+
+    uint64 indexOffset = alignTo(_writePosition, 8);
+
+    static const char padding[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    _output.seekp(_writePosition);
+    _output.write(padding, indexOffset-_writePosition);
+
+    if (!_bucketList.empty()) _output.write((const char*)&_bucketList[0], _bucketList.size()*sizeof(uint32));
+    if (!_entryList.empty()) _output.write((const char*)&_entryList[0], _entryList.size()*sizeof(Entry));
+    _output.write(_nameTable.c_str(), _nameTable.size());
+
+    // make sure the data and the new index are out before the header is pointed at them.
+    _output.flush();
+    if (_output.fail()) return false;
+
+    _header.indexOffset = indexOffset;
+    _header.indexSize = _bucketList.size()*sizeof(uint32) + _entryList.size()*sizeof(Entry) + _nameTable.size();
+
+    _output.seekp(0);
+    _output.write((const char*)&_header, sizeof(Header));
+    _output.flush();
+
+    return !_output.fail();
+}
+
+void PAKArchive::close()
+{
+    if (_status!=READ && _output.is_open())
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_writeMutex);
+
+        if (!writeIndex())
+        {
+            OSG_NOTIFY(osg::WARN)<<"PAKArchive::close() : error writing index of "<<_archiveFileName<<std::endl;
+        }
+        _output.close();
+    }
+
+    if (_mappedFile)
+    {
+        delete _mappedFile;
+        _mappedFile = 0;
+    }
+
+    _buckets = 0;
+    _entries = 0;
+    _names = 0;
+    _bucketList.clear();
+    _entryList.clear();
+    _nameTable.clear();
+    _writePosition = 0;
+    memset(&_header, 0, sizeof(Header));
+}
+
+PAKArchive::uint32 PAKArchive::findEntryIndex(const std::string& name, uint64 hash) const
+{
+    if (_header.numBuckets==0 || !_buckets) return PAK_NO_ENTRY;
+
+    uint32 mask = _header.numBuckets-1;
+    for(uint32 bucket = uint32(hash & mask), probes = 0;
+        _buckets[bucket]!=0 && probes<_header.numBuckets;
+        bucket = (bucket+1) & mask, ++probes)
+    {
+        const Entry& candidate = _entries[_buckets[bucket]-1];
+        if (candidate.hash==hash &&
+            candidate.nameLength==name.size() &&
+            name.compare(0, name.size(), _names+candidate.nameOffset, candidate.nameLength)==0)
+        {
+            return _buckets[bucket]-1;
+        }
+    }
+    return PAK_NO_ENTRY;
+}
+
+bool PAKArchive::findEntry(const std::string& filename, Entry& entry) const
+{
+    std::string name = normalizeFileName(filename);
+    uint64 hash = hashFileName(name);
+
+    // while writing the index lives in vectors that addFile() may reallocate.
+    OpenThreads::ScopedPointerLock<OpenThreads::Mutex> lock(_status!=READ ? &_writeMutex : 0);
+
+    uint32 index = findEntryIndex(name, hash);
+    if (index==PAK_NO_ENTRY) return false;
+
+    entry = _entries[index];
+    return true;
+}
+
+std::string PAKArchive::getEntryName(const Entry& entry) const
+{
+    return std::string(_names+entry.nameOffset, entry.nameLength);
+}
+
+bool PAKArchive::fileExists(const std::string& filename) const
+{
+    Entry entry;
+    return findEntry(filename, entry);
+}
+
+std::string PAKArchive::getMasterFileName() const
+{
+    OpenThreads::ScopedPointerLock<OpenThreads::Mutex> lock(_status!=READ ? &_writeMutex : 0);
+
+    if (_header.masterEntry>=_header.numEntries || !_entries) return std::string();
+    return getEntryName(_entries[_header.masterEntry]);
+}
+
+bool PAKArchive::getFileNames(FileNameList& fileNameList) const
+{
+    OpenThreads::ScopedPointerLock<OpenThreads::Mutex> lock(_status!=READ ? &_writeMutex : 0);
+
+    for(uint32 i=0; i<_header.numEntries; ++i)
+    {
+        fileNameList.push_back(getEntryName(_entries[i]));
+    }
+    return !fileNameList.empty();
+}
+
+bool PAKArchive::getEntryData(const std::string& filename, const char*& data, uint64& size) const
+{
+    if (_status!=READ || !_mappedFile) return false;
+
+    Entry entry;
+    if (!findEntry(filename, entry) || entry.compression!=NO_COMPRESSION) return false;
+
+    data = _mappedFile->data() + entry.offset;
+    size = entry.size;
+    return true;
+}
+
+bool PAKArchive::addFile(const std::string& filename, const char* data, uint64 size, Compression compression)
+{
+    if (_status==READ || !_output.is_open()) return false;
+
+    std::string name = normalizeFileName(filename);
+    if (name.empty()) return false;
+
+    const char* storedData = data;
+    uint64 storedSize = size;
+
+#ifdef USE_ZLIB
+    std::vector<char> compressed;
+    if (compression==ZLIB_COMPRESSION && size>0)
+    {
+        uLongf compressedSize = compressBound(size);
+        compressed.resize(compressedSize);
+        if (compress2((Bytef*)&compressed[0], &compressedSize, (const Bytef*)data, size, Z_DEFAULT_COMPRESSION)==Z_OK &&
+            compressedSize<size)
+        {
+            storedData = &compressed[0];
+            storedSize = compressedSize;
+        }
+        else
+        {
+            compression = NO_COMPRESSION;
+        }
+    }
+#else
+    compression = NO_COMPRESSION;
+#endif
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_writeMutex);
+
+    uint64 offset = alignTo(_writePosition, _header.alignment);
+
+    static const char padding[64] = { 0 };
+    _output.seekp(_writePosition);
+    for(uint64 pad = offset-_writePosition; pad>0; )
+    {
+        uint64 chunk = pad<sizeof(padding) ? pad : sizeof(padding);
+        _output.write(padding, chunk);
+        pad -= chunk;
+    }
+    if (storedSize) _output.write(storedData, storedSize);
+
+    if (_output.fail())
+    {
+        OSG_NOTIFY(osg::WARN)<<"PAKArchive::addFile("<<filename<<") : error writing to "<<_archiveFileName<<std::endl;
+        return false;
+    }
+
+    _writePosition = offset + storedSize;
+
+    Entry entry;
+    memset(&entry, 0, sizeof(Entry));
+    entry.hash = hashFileName(name);
+    entry.offset = offset;
+    entry.storedSize = storedSize;
+    entry.size = size;
+    entry.compression = compression;
+
+    // replacing an existing entry leaves its old data as unreferenced space in the archive.
+    uint32 existing = findEntryIndex(name, entry.hash);
+    if (existing!=PAK_NO_ENTRY)
+    {
+        entry.nameOffset = _entryList[existing].nameOffset;
+        entry.nameLength = _entryList[existing].nameLength;
+        _entryList[existing] = entry;
+        return true;
+    }
+
+    entry.nameOffset = _nameTable.size();
+    entry.nameLength = name.size();
+    _nameTable.append(name);
+
+    if (_header.masterEntry==PAK_NO_ENTRY) _header.masterEntry = _entryList.size();
+    _entryList.push_back(entry);
+
+    // keep the hash table at most half full so lookups while writing stay valid.
+    if (_entryList.size()*2 > _bucketList.size()) rebuildBuckets();
+    else
+    {
+        uint32 mask = _header.numBuckets-1;
+        uint32 bucket = uint32(entry.hash & mask);
+        while(_bucketList[bucket]!=0) bucket = (bucket+1) & mask;
+        _bucketList[bucket] = _entryList.size();
+        _header.numEntries = _entryList.size();
+        _entries = &_entryList[0];
+        _names = _nameTable.c_str();
+    }
+
+    return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Read functors
+//
+struct PAKArchive::ReadFunctor
+{
+    ReadFunctor(const std::string& filename, const ReaderWriter::Options* options):
+        _filename(filename),
+        _options(options) {}
+
+    virtual ~ReadFunctor() {}
+
+    std::string                     _filename;
+    const ReaderWriter::Options*    _options;
+
+    virtual ReaderWriter::ReadResult doRead(ReaderWriter& rw, std::istream& input, const ReaderWriter::Options* options) const = 0;
+};
+
+struct PAKArchive::ReadObjectFunctor : public PAKArchive::ReadFunctor
+{
+    ReadObjectFunctor(const std::string& filename, const ReaderWriter::Options* options):ReadFunctor(filename,options) {}
+    virtual ReaderWriter::ReadResult doRead(ReaderWriter& rw, std::istream& input, const ReaderWriter::Options* options) const { return rw.readObject(input, options); }
+};
+
+struct PAKArchive::ReadImageFunctor : public PAKArchive::ReadFunctor
+{
+    ReadImageFunctor(const std::string& filename, const ReaderWriter::Options* options):ReadFunctor(filename,options) {}
+    virtual ReaderWriter::ReadResult doRead(ReaderWriter& rw, std::istream& input, const ReaderWriter::Options* options) const { return rw.readImage(input, options); }
+};
+
+struct PAKArchive::ReadHeightFieldFunctor : public PAKArchive::ReadFunctor
+{
+    ReadHeightFieldFunctor(const std::string& filename, const ReaderWriter::Options* options):ReadFunctor(filename,options) {}
+    virtual ReaderWriter::ReadResult doRead(ReaderWriter& rw, std::istream& input, const ReaderWriter::Options* options) const { return rw.readHeightField(input, options); }
+};
+
+struct PAKArchive::ReadNodeFunctor : public PAKArchive::ReadFunctor
+{
+    ReadNodeFunctor(const std::string& filename, const ReaderWriter::Options* options):ReadFunctor(filename,options) {}
+    virtual ReaderWriter::ReadResult doRead(ReaderWriter& rw, std::istream& input, const ReaderWriter::Options* options) const { return rw.readNode(input, options); }
+};
+
+ReaderWriter::ReadResult PAKArchive::read(const ReadFunctor& readFunctor) const
+{
+    if (_status!=READ || !_mappedFile)
+    {
+        OSG_NOTIFY(osg::INFO)<<"PAKArchive::readObject(obj, "<<readFunctor._filename<<") failed, archive opened as write only."<<std::endl;
+        return ReadResult(ReadResult::FILE_NOT_HANDLED);
+    }
+
+    Entry entry;
+    if (!findEntry(readFunctor._filename, entry)) return ReadResult(ReadResult::FILE_NOT_FOUND);
+
+    ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension(getLowerCaseFileExtension(readFunctor._filename));
+    if (!rw)
+    {
+        OSG_NOTIFY(osg::INFO)<<"PAKArchive::readObject(obj, "<<readFunctor._filename<<") failed to find appropriate plugin to read file."<<std::endl;
+        return ReadResult(ReadResult::FILE_NOT_HANDLED);
+    }
+
+    const char* data = _mappedFile->data() + entry.offset;
+
+    std::vector<char> uncompressed;
+    if (entry.compression==ZLIB_COMPRESSION)
+    {
+#ifdef USE_ZLIB
+        uncompressed.resize(entry.size);
+        uLongf destSize = entry.size;
+        if (entry.size==0 ||
+            uncompress((Bytef*)&uncompressed[0], &destSize, (const Bytef*)data, entry.storedSize)!=Z_OK ||
+            destSize!=entry.size)
+        {
+            return ReadResult("PAKArchive : error uncompressing "+readFunctor._filename);
+        }
+        data = &uncompressed[0];
+#else
+        return ReadResult("PAKArchive : "+readFunctor._filename+" is compressed, but zlib support is not available.");
+#endif
+    }
+    else if (entry.compression!=NO_COMPRESSION)
+    {
+        return ReadResult("PAKArchive : unsupported compression in entry "+readFunctor._filename);
+    }
+
+    // set up the database path so that files referenced relative to the entry are looked up inside the archive.
+    osg::ref_ptr<ReaderWriter::Options> local_opt = readFunctor._options ?
+        static_cast<ReaderWriter::Options*>(readFunctor._options->clone(osg::CopyOp::SHALLOW_COPY)) :
+        new ReaderWriter::Options;
+
+    std::string entryPath = osgDB::getFilePath(normalizeFileName(readFunctor._filename));
+    local_opt->getDatabasePathList().push_front(entryPath.empty() ? _archiveFileName : _archiveFileName+'/'+entryPath);
+
+    MemoryStreamBuf streambuf(data, entry.size);
+    std::istream input(&streambuf);
+
+    return readFunctor.doRead(*rw, input, local_opt.get());
+}
+
+ReaderWriter::ReadResult PAKArchive::readObject(const std::string& fileName,const Options* options) const
+{
+    return read(ReadObjectFunctor(fileName, options));
+}
+
+ReaderWriter::ReadResult PAKArchive::readImage(const std::string& fileName,const Options* options) const
+{
+    return read(ReadImageFunctor(fileName, options));
+}
+
+ReaderWriter::ReadResult PAKArchive::readHeightField(const std::string& fileName,const Options* options) const
+{
+    return read(ReadHeightFieldFunctor(fileName, options));
+}
+
+ReaderWriter::ReadResult PAKArchive::readNode(const std::string& fileName,const Options* options) const
+{
+    return read(ReadNodeFunctor(fileName, options));
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Write functors
+//
+struct PAKArchive::WriteFunctor
+{
+    WriteFunctor(const std::string& filename, const ReaderWriter::Options* options):
+        _filename(filename),
+        _options(options) {}
+
+    virtual ~WriteFunctor() {}
+
+    std::string                     _filename;
+    const ReaderWriter::Options*    _options;
+
+    virtual ReaderWriter::WriteResult doWrite(ReaderWriter& rw, std::ostream& output) const = 0;
+};
+
+struct PAKArchive::WriteObjectFunctor : public PAKArchive::WriteFunctor
+{
+    WriteObjectFunctor(const osg::Object& object, const std::string& filename, const ReaderWriter::Options* options):
+        WriteFunctor(filename,options),
+        _object(object) {}
+    const osg::Object& _object;
+
+    virtual ReaderWriter::WriteResult doWrite(ReaderWriter& rw, std::ostream& output) const { return rw.writeObject(_object, output, _options); }
+};
+
+struct PAKArchive::WriteImageFunctor : public PAKArchive::WriteFunctor
+{
+    WriteImageFunctor(const osg::Image& object, const std::string& filename, const ReaderWriter::Options* options):
+        WriteFunctor(filename,options),
+        _object(object) {}
+    const osg::Image& _object;
+
+    virtual ReaderWriter::WriteResult doWrite(ReaderWriter& rw, std::ostream& output) const { return rw.writeImage(_object, output, _options); }
+};
+
+struct PAKArchive::WriteHeightFieldFunctor : public PAKArchive::WriteFunctor
+{
+    WriteHeightFieldFunctor(const osg::HeightField& object, const std::string& filename, const ReaderWriter::Options* options):
+        WriteFunctor(filename,options),
+        _object(object) {}
+    const osg::HeightField& _object;
+
+    virtual ReaderWriter::WriteResult doWrite(ReaderWriter& rw, std::ostream& output) const { return rw.writeHeightField(_object, output, _options); }
+};
+
+struct PAKArchive::WriteNodeFunctor : public PAKArchive::WriteFunctor
+{
+    WriteNodeFunctor(const osg::Node& object, const std::string& filename, const ReaderWriter::Options* options):
+        WriteFunctor(filename,options),
+        _object(object) {}
+    const osg::Node& _object;
+
+    virtual ReaderWriter::WriteResult doWrite(ReaderWriter& rw, std::ostream& output) const { return rw.writeNode(_object, output, _options); }
+};
+
+ReaderWriter::WriteResult PAKArchive::write(const WriteFunctor& writeFunctor) const
+{
+    if (_status==READ)
+    {
+        OSG_NOTIFY(osg::INFO)<<"PAKArchive::write(obj, "<<writeFunctor._filename<<") failed, archive opened as read only."<<std::endl;
+        return WriteResult(WriteResult::FILE_NOT_HANDLED);
+    }
+
+    ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension(getLowerCaseFileExtension(writeFunctor._filename));
+    if (!rw)
+    {
+        OSG_NOTIFY(osg::INFO)<<"PAKArchive::write(obj, "<<writeFunctor._filename<<") failed to find appropriate plugin to write file."<<std::endl;
+        return WriteResult(WriteResult::FILE_NOT_HANDLED);
+    }
+
+    std::ostringstream output(std::ios::out | std::ios::binary);
+    ReaderWriter::WriteResult result = writeFunctor.doWrite(*rw, output);
+    if (!result.success()) return result;
+
+    Compression compression = NO_COMPRESSION;
+    if (writeFunctor._options)
+    {
+        std::istringstream iss(writeFunctor._options->getOptionString());
+        std::string opt;
+        while (iss >> opt)
+        {
+            if (opt=="compressed") compression = ZLIB_COMPRESSION;
+        }
+    }
+
+    std::string data = output.str();
+    if (!const_cast<PAKArchive*>(this)->addFile(writeFunctor._filename, data.c_str(), data.size(), compression))
+    {
+        return WriteResult(WriteResult::ERROR_IN_WRITING_FILE);
+    }
+
+    return result;
+}
+
+ReaderWriter::WriteResult PAKArchive::writeObject(const osg::Object& obj,const std::string& fileName,const Options* options) const
+{
+    return write(WriteObjectFunctor(obj, fileName, options));
+}
+
+ReaderWriter::WriteResult PAKArchive::writeImage(const osg::Image& image,const std::string& fileName,const Options* options) const
+{
+    return write(WriteImageFunctor(image, fileName, options));
+}
+
+ReaderWriter::WriteResult PAKArchive::writeHeightField(const osg::HeightField& heightField,const std::string& fileName,const Options* options) const
+{
+    return write(WriteHeightFieldFunctor(heightField, fileName, options));
+}
+
+ReaderWriter::WriteResult PAKArchive::writeNode(const osg::Node& node,const std::string& fileName,const Options* options) const
+{
+    return write(WriteNodeFunctor(node, fileName, options));
+}
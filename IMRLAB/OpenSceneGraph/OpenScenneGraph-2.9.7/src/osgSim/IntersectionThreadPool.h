@@ -0,0 +1,43 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#ifndef OSGSIM_INTERSECTIONTHREADPOOL
+#define OSGSIM_INTERSECTIONTHREADPOOL 1
+
+#include <osgUtil/IntersectionVisitor>
+
+#include <vector>
+
+namespace osgSim {
+
+/** The threads shared by LineOfSight and HeightAboveTerrain to intersect the parts of their batches of tests in
+  * parallel, started as they are first needed.*/
+class IntersectionThreadPool
+{
+    public:
+
+        typedef std::vector< osg::ref_ptr<osgUtil::Intersector> > Intersectors;
+
+        /** Traverse scene with each of the intersectors, each with its own IntersectionVisitor, across numThreads threads,
+          * the calling thread among them, returning once they have all been traversed. The scene graph, and the subgraphs
+          * readCallback returns, must have their bounds computed, as they are shared by the threads.*/
+        static void intersect(osg::Node* scene, Intersectors& intersectors, osgUtil::IntersectionVisitor::ReadCallback* readCallback,
+                              osg::Node::NodeMask traversalMask, unsigned int numThreads);
+
+        /** Get the number of threads set by the OSG_NUM_INTERSECTION_THREADS environment variable, or 1 if not set.*/
+        static unsigned int getDefaultNumThreads();
+};
+
+}
+
+#endif
@@ -13,15 +13,209 @@
 
 #include <osgSim/LineOfSight>
 
+#include <osg/ApplicationUsage>
 #include <osg/Notify>
 #include <osgDB/ReadFile>
 #include <osgUtil/LineSegmentIntersector>
 
+#include "IntersectionThreadPool.h"
+
+#include <stdlib.h>
+
 using namespace osgSim;
 
+static osg::ApplicationUsageProxy LineOfSight_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_NUM_INTERSECTION_THREADS <int>","Set the number of threads each LineOfSight and HeightAboveTerrain divides its tests between, 0 or 1 computes them serially.");
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// IntersectionThreadPool
+//
+namespace
+{
+    class IntersectOperation : public osg::Operation
+    {
+        public:
+
+            IntersectOperation(osg::Node* scene, osgUtil::Intersector* intersector, osgUtil::IntersectionVisitor::ReadCallback* readCallback,
+                               osg::Node::NodeMask traversalMask, osg::RefBlockCount* block):
+                osg::Operation("Intersect", false),
+                _scene(scene),
+                _intersector(intersector),
+                _readCallback(readCallback),
+                _traversalMask(traversalMask),
+                _block(block) {}
+
+            virtual void operator () (osg::Object*)
+            {
+                osgUtil::IntersectionVisitor iv(_intersector.get(), _readCallback.get());
+                iv.setTraversalMask(_traversalMask);
+                _scene->accept(iv);
+
+                _block->completed();
+            }
+
+        protected:
+
+            osg::ref_ptr<osg::Node>                                     _scene;
+            osg::ref_ptr<osgUtil::Intersector>                          _intersector;
+            osg::ref_ptr<osgUtil::IntersectionVisitor::ReadCallback>    _readCallback;
+            osg::Node::NodeMask                                         _traversalMask;
+            osg::ref_ptr<osg::RefBlockCount>                            _block;
+    };
+
+    class IntersectionThreads
+    {
+        public:
+
+            ~IntersectionThreads()
+            {
+                for(Threads::iterator itr = _threads.begin();
+                    itr != _threads.end();
+                    ++itr)
+                {
+                    (*itr)->cancel();
+                }
+            }
+
+            /** Start threads until there are enough to help a calling thread with numThreads-1 others, returning their queue.*/
+            osg::OperationQueue* reserveThreads(unsigned int numThreads)
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+                if (!_operationQueue) _operationQueue = new osg::OperationQueue;
+
+                while (_threads.size()+1<numThreads)
+                {
+                    osg::ref_ptr<osg::OperationThread> thread = new osg::OperationThread;
+                    thread->setOperationQueue(_operationQueue.get());
+                    if (thread->startThread()!=0) break;
+                    _threads.push_back(thread);
+                }
+
+                return _operationQueue.get();
+            }
+
+        protected:
+
+            typedef std::vector< osg::ref_ptr<osg::OperationThread> > Threads;
+
+            OpenThreads::Mutex                  _mutex;
+            osg::ref_ptr<osg::OperationQueue>   _operationQueue;
+            Threads                             _threads;
+    };
+
+    IntersectionThreads s_intersectionThreads;
+}
+
+void IntersectionThreadPool::intersect(osg::Node* scene, Intersectors& intersectors, osgUtil::IntersectionVisitor::ReadCallback* readCallback,
+                                       osg::Node::NodeMask traversalMask, unsigned int numThreads)
+{
+    if (intersectors.empty()) return;
+
+    osg::OperationQueue* operationQueue = s_intersectionThreads.reserveThreads(numThreads);
+
+    osg::ref_ptr<osg::RefBlockCount> block = new osg::RefBlockCount(intersectors.size());
+    block->reset();
+
+    for(Intersectors::iterator itr = intersectors.begin();
+        itr != intersectors.end();
+        ++itr)
+    {
+        operationQueue->add(new IntersectOperation(scene, itr->get(), readCallback, traversalMask, block.get()));
+    }
+
+    // help the threads with the queued operations, then wait for those they are still running.
+    for(osg::ref_ptr<osg::Operation> operation = operationQueue->getNextOperation();
+        operation.valid();
+        operation = operationQueue->getNextOperation())
+    {
+        (*operation)(0);
+    }
+
+    while (block->getCurrentCount()!=0)
+    {
+        block->block();
+    }
+}
+
+unsigned int IntersectionThreadPool::getDefaultNumThreads()
+{
+    const char* ptr = getenv("OSG_NUM_INTERSECTION_THREADS");
+    int numThreads = ptr ? atoi(ptr) : 1;
+    return numThreads>1 ? static_cast<unsigned int>(numThreads) : 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// DatabaseCacheReadCallback
+//
+class DatabaseCacheReadCallback::PrefetchOperation : public osg::Operation
+{
+    public:
+
+        PrefetchOperation(DatabaseCacheReadCallback* dcrc, const std::string& filename):
+            osg::Operation("Prefetch", false),
+            _dcrc(dcrc),
+            _filename(filename) {}
+
+        virtual void operator () (osg::Object*)
+        {
+            _dcrc->readNodeFile(_filename);
+
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_dcrc->_mutex);
+            _dcrc->_filesToPrefetch.erase(_filename);
+        }
+
+    protected:
+
+        // the DatabaseCacheReadCallback removes its PrefetchOperations, and waits for those running, before it is deleted.
+        DatabaseCacheReadCallback*  _dcrc;
+        std::string                 _filename;
+};
+
+class DatabaseCacheReadCallback::PrefetchReadCallback : public osgUtil::IntersectionVisitor::ReadCallback
+{
+    public:
+
+        PrefetchReadCallback(DatabaseCacheReadCallback* dcrc):
+            _dcrc(dcrc) {}
+
+        virtual osg::ref_ptr<osg::Node> readNodeFile(const std::string& filename)
+        {
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_dcrc->_mutex);
+                osg::ref_ptr<osg::Node> node = _dcrc->getCachedNode(filename);
+                if (node.valid()) return node;
+            }
+
+            _dcrc->prefetch(filename);
+            return 0;
+        }
+
+    protected:
+
+        // owned by the DatabaseCacheReadCallback.
+        DatabaseCacheReadCallback* _dcrc;
+};
+
 DatabaseCacheReadCallback::DatabaseCacheReadCallback()
 {
     _maxNumFilesToCache = 2000;
+    _numReads = 0;
+    _numPrefetchThreads = 1;
+    _prefetchReadCallback = new PrefetchReadCallback(this);
+}
+
+DatabaseCacheReadCallback::~DatabaseCacheReadCallback()
+{
+    if (_prefetchQueue.valid()) _prefetchQueue->removeAllOperations();
+
+    for(PrefetchThreads::iterator itr = _prefetchThreads.begin();
+        itr != _prefetchThreads.end();
+        ++itr)
+    {
+        (*itr)->cancel();
+    }
 }
 
 void DatabaseCacheReadCallback::clearDatabaseCache()
@@ -32,62 +226,138 @@ void DatabaseCacheReadCallback::clearDatabaseCache()
 
 void DatabaseCacheReadCallback::pruneUnusedDatabaseCache()
 {
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    for(FileNameSceneMap::iterator itr = _filenameSceneMap.begin();
+        itr != _filenameSceneMap.end();)
+    {
+        if (itr->second.node->referenceCount()==1) _filenameSceneMap.erase(itr++);
+        else ++itr;
+    }
+}
+
+osg::Node* DatabaseCacheReadCallback::getCachedNode(const std::string& filename)
+{
+    FileNameSceneMap::iterator itr = _filenameSceneMap.find(filename);
+    if (itr == _filenameSceneMap.end()) return 0;
+
+    itr->second.lastUsed = ++_numReads;
+    return itr->second.node.get();
 }
 
-osg::Node* DatabaseCacheReadCallback::readNodeFile(const std::string& filename)
+osg::ref_ptr<osg::Node> DatabaseCacheReadCallback::readNodeFile(const std::string& filename)
 {
-    // first check to see if file is already loaded.
+    // first check to see if file is already loaded, waiting for it if another thread is loading it. The reference is
+    // taken before the lock is released, so that the subgraph isn't deleted by another thread making room in the cache.
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
-        
-        FileNameSceneMap::iterator itr = _filenameSceneMap.find(filename);
-        if (itr != _filenameSceneMap.end())
+
+        while (_filesBeingRead.count(filename)!=0)
+        {
+            _fileReadCondition.wait(&_mutex);
+        }
+
+        osg::ref_ptr<osg::Node> node = getCachedNode(filename);
+        if (node.valid())
         {
             osg::notify(osg::INFO)<<"Getting from cache "<<filename<<std::endl;
-        
-            return itr->second.get();
+
+            return node;
         }
+
+        _filesBeingRead.insert(filename);
     }
-    
+
     // now load the file.
     osg::ref_ptr<osg::Node> node = osgDB::readNodeFile(filename);
-    
+
+    // compute the bounds while only this thread has the subgraph, as it may be traversed by several at once.
+    if (node.valid()) node->getBound();
+
     // insert into the cache.
-    if (node.valid())
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
-        
-        if (_filenameSceneMap.size() < _maxNumFilesToCache)
-        {
-            osg::notify(osg::INFO)<<"Inserting into cache "<<filename<<std::endl;
 
-            _filenameSceneMap[filename] = node;
-        }
-        else
+        _filesBeingRead.erase(filename);
+        _fileReadCondition.broadcast();
+
+        if (node.valid())
         {
-            // for time being implement a crude search for a candidate to chuck out from the cache.
-            for(FileNameSceneMap::iterator itr = _filenameSceneMap.begin();
-                itr != _filenameSceneMap.end();
-                ++itr)
+            if (_filenameSceneMap.size() < _maxNumFilesToCache)
+            {
+                osg::notify(osg::INFO)<<"Inserting into cache "<<filename<<std::endl;
+            }
+            else
             {
-                if (itr->second->referenceCount()==1)
+                // chuck out the least recently used subgraph that is only referenced in the cache, so we know that the
+                // actual memory will be released, and that no other thread is about to use it.
+                FileNameSceneMap::iterator leastRecentlyUsed = _filenameSceneMap.end();
+                for(FileNameSceneMap::iterator itr = _filenameSceneMap.begin();
+                    itr != _filenameSceneMap.end();
+                    ++itr)
+                {
+                    if (itr->second.node->referenceCount()==1 &&
+                        (leastRecentlyUsed==_filenameSceneMap.end() || itr->second.lastUsed<leastRecentlyUsed->second.lastUsed))
+                    {
+                        leastRecentlyUsed = itr;
+                    }
+                }
+
+                if (leastRecentlyUsed!=_filenameSceneMap.end())
                 {
-                    osg::notify(osg::NOTICE)<<"Erasing "<<itr->first<<std::endl;
-                    // found a node which is only referenced in the cache so we can discard it
-                    // and know that the actual memory will be released.
-                    _filenameSceneMap.erase(itr);
-                    break;
+                    osg::notify(osg::NOTICE)<<"Erasing "<<leastRecentlyUsed->first<<std::endl;
+                    _filenameSceneMap.erase(leastRecentlyUsed);
                 }
+                osg::notify(osg::INFO)<<"And the replacing with "<<filename<<std::endl;
             }
-            osg::notify(osg::INFO)<<"And the replacing with "<<filename<<std::endl;
-            _filenameSceneMap[filename] = node;
+
+            CachedScene& cachedScene = _filenameSceneMap[filename];
+            cachedScene.node = node;
+            cachedScene.lastUsed = ++_numReads;
+        }
+    }
+
+    return node;
+}
+
+void DatabaseCacheReadCallback::prefetch(const std::string& filename)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    if (_filenameSceneMap.count(filename)!=0 ||
+        _filesBeingRead.count(filename)!=0 ||
+        _filesToPrefetch.count(filename)!=0) return;
+
+    if (!_prefetchQueue) _prefetchQueue = new osg::OperationQueue;
+
+    while (_prefetchThreads.size()<osg::maximum(_numPrefetchThreads, 1u))
+    {
+        osg::ref_ptr<osg::OperationThread> thread = new osg::OperationThread;
+        thread->setOperationQueue(_prefetchQueue.get());
+        if (thread->startThread()!=0)
+        {
+            osg::notify(osg::WARN)<<"Warning: DatabaseCacheReadCallback unable to start a prefetch thread."<<std::endl;
+            return;
         }
+        _prefetchThreads.push_back(thread);
     }
-    
-    return node.release();
+
+    _filesToPrefetch.insert(filename);
+    _prefetchQueue->add(new PrefetchOperation(this, filename));
+}
+
+unsigned int DatabaseCacheReadCallback::getNumFilesToPrefetch() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+    return static_cast<unsigned int>(_filesToPrefetch.size());
 }
 
-LineOfSight::LineOfSight()
+////////////////////////////////////////////////////////////////////////////////
+//
+// LineOfSight
+//
+LineOfSight::LineOfSight():
+    _numThreads(IntersectionThreadPool::getDefaultNumThreads())
 {
     setDatabaseCacheReadCallback(new DatabaseCacheReadCallback);
 }
@@ -104,26 +374,19 @@ unsigned int LineOfSight::addLOS(const osg::Vec3d& start, const osg::Vec3d& end)
     return index;
 }
 
-void LineOfSight::computeIntersections(osg::Node* scene, osg::Node::NodeMask traversalMask)
+void LineOfSight::addIntersectors(osgUtil::IntersectorGroup& group, unsigned int begin, unsigned int end) const
 {
-    osg::ref_ptr<osgUtil::IntersectorGroup> intersectorGroup = new osgUtil::IntersectorGroup();
-
-    for(LOSList::iterator itr = _LOSList.begin();
-        itr != _LOSList.end();
-        ++itr)
+    for(unsigned int index = begin; index<end; ++index)
     {
-        osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector = new osgUtil::LineSegmentIntersector(itr->_start, itr->_end);
-        intersectorGroup->addIntersector( intersector.get() );
+        osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector = new osgUtil::LineSegmentIntersector(_LOSList[index]._start, _LOSList[index]._end);
+        group.addIntersector( intersector.get() );
     }
-    
-    _intersectionVisitor.reset();
-    _intersectionVisitor.setTraversalMask(traversalMask);
-    _intersectionVisitor.setIntersector( intersectorGroup.get() );
-    
-    scene->accept(_intersectionVisitor);
-    
-    unsigned int index = 0;
-    osgUtil::IntersectorGroup::Intersectors& intersectors = intersectorGroup->getIntersectors();
+}
+
+void LineOfSight::getIntersections(osgUtil::IntersectorGroup& group, unsigned int begin)
+{
+    unsigned int index = begin;
+    osgUtil::IntersectorGroup::Intersectors& intersectors = group.getIntersectors();
     for(osgUtil::IntersectorGroup::Intersectors::iterator intersector_itr = intersectors.begin();
         intersector_itr != intersectors.end();
         ++intersector_itr, ++index)
@@ -133,9 +396,9 @@ void LineOfSight::computeIntersections(osg::Node* scene, osg::Node::NodeMask tra
         {
             Intersections& intersectionsLOS = _LOSList[index]._intersections;
             _LOSList[index]._intersections.clear();
-            
+
             osgUtil::LineSegmentIntersector::Intersections& intersections = lsi->getIntersections();
-            
+
             for(osgUtil::LineSegmentIntersector::Intersections::iterator itr = intersections.begin();
                 itr != intersections.end();
                 ++itr)
@@ -146,7 +409,61 @@ void LineOfSight::computeIntersections(osg::Node* scene, osg::Node::NodeMask tra
             }
         }
     }
-    
+}
+
+void LineOfSight::computeIntersections(osg::Node* scene, osg::Node::NodeMask traversalMask)
+{
+    unsigned int numLOS = _LOSList.size();
+    unsigned int numThreads = osg::minimum(_numThreads, numLOS);
+
+    if (numThreads<=1)
+    {
+        osg::ref_ptr<osgUtil::IntersectorGroup> intersectorGroup = new osgUtil::IntersectorGroup();
+        addIntersectors(*intersectorGroup, 0, numLOS);
+
+        _intersectionVisitor.reset();
+        _intersectionVisitor.setTraversalMask(traversalMask);
+        _intersectionVisitor.setIntersector( intersectorGroup.get() );
+
+        scene->accept(_intersectionVisitor);
+
+        getIntersections(*intersectorGroup, 0);
+        return;
+    }
+
+    // compute the bounds before the threads share the scene graph.
+    scene->getBound();
+
+    // divide the LOS tests into a few parts per thread, so that threads that finish their parts early take on more.
+    unsigned int numParts = osg::minimum(numThreads*4, numLOS);
+    IntersectionThreadPool::Intersectors intersectors;
+    for(unsigned int part = 0; part<numParts; ++part)
+    {
+        osg::ref_ptr<osgUtil::IntersectorGroup> intersectorGroup = new osgUtil::IntersectorGroup();
+        addIntersectors(*intersectorGroup, (numLOS*part)/numParts, (numLOS*(part+1))/numParts);
+        intersectors.push_back(intersectorGroup.get());
+    }
+
+    IntersectionThreadPool::intersect(scene, intersectors, _dcrc.get(), traversalMask, numThreads);
+
+    // gather the results in the order of the LOS tests, whichever threads found them.
+    for(unsigned int part = 0; part<numParts; ++part)
+    {
+        getIntersections(static_cast<osgUtil::IntersectorGroup&>(*intersectors[part]), (numLOS*part)/numParts);
+    }
+}
+
+void LineOfSight::prefetch(osg::Node* scene, osg::Node::NodeMask traversalMask)
+{
+    if (!_dcrc) return;
+
+    osg::ref_ptr<osgUtil::IntersectorGroup> intersectorGroup = new osgUtil::IntersectorGroup();
+    addIntersectors(*intersectorGroup, 0, _LOSList.size());
+
+    osgUtil::IntersectionVisitor iv(intersectorGroup.get(), _dcrc->getPrefetchReadCallback());
+    iv.setTraversalMask(traversalMask);
+
+    scene->accept(iv);
 }
 
 LineOfSight::Intersections LineOfSight::computeIntersections(osg::Node* scene, const osg::Vec3d& start, const osg::Vec3d& end, osg::Node::NodeMask traversalMask)
@@ -0,0 +1,366 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgSim/TerrainHeightCache>
+
+#include <osg/Transform>
+#include <osgUtil/LineSegmentBatchIntersector>
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+using namespace osgSim;
+
+namespace
+{
+    // the height of grid points with no terrain below them.
+    const float NO_HEIGHT = -FLT_MAX;
+
+    inline int floorToInt(double v) { return static_cast<int>(floor(v)); }
+
+    // the bound, in the coordinates matrix transforms into, of a sphere.
+    osg::BoundingBox transformBound(const osg::BoundingSphere& bs, const osg::Matrixd& matrix)
+    {
+        osg::BoundingBox bb;
+        if (!bs.valid()) return bb;
+
+        osg::BoundingBox local;
+        local.expandBy(bs);
+        for(unsigned int i=0; i<8; ++i)
+        {
+            bb.expandBy(local.corner(i) * matrix);
+        }
+        return bb;
+    }
+}
+
+class TerrainHeightCache::CollectPagedLODsVisitor : public osg::NodeVisitor
+{
+    public:
+
+        CollectPagedLODsVisitor(TerrainHeightCache& cache, const osg::Matrixd& matrix):
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+            _cache(cache),
+            _matrix(matrix) {}
+
+        virtual void apply(osg::Transform& transform)
+        {
+            osg::Matrixd previous = _matrix;
+            transform.computeLocalToWorldMatrix(_matrix, this);
+            traverse(transform);
+            _matrix = previous;
+        }
+
+        virtual void apply(osg::PagedLOD& pagedLOD)
+        {
+            _cache.track(pagedLOD, _matrix);
+            traverse(pagedLOD);
+        }
+
+    protected:
+
+        CollectPagedLODsVisitor& operator = (const CollectPagedLODsVisitor&) { return *this; }
+
+        TerrainHeightCache& _cache;
+        osg::Matrixd        _matrix;
+};
+
+TerrainHeightCache::TerrainHeightCache():
+    _spacing(1.0),
+    _tileSize(32),
+    _traversalMask(0xffffffff),
+    _numTilesSampled(0)
+{
+}
+
+TerrainHeightCache::~TerrainHeightCache()
+{
+}
+
+void TerrainHeightCache::setTerrain(osg::Node* terrain)
+{
+    _terrain = terrain;
+    _pagedLODs.clear();
+    clear();
+
+    if (_terrain.valid())
+    {
+        CollectPagedLODsVisitor collect(*this, osg::Matrixd::identity());
+        _terrain->accept(collect);
+    }
+}
+
+void TerrainHeightCache::setSpacing(double spacing)
+{
+    _spacing = spacing;
+    clear();
+}
+
+void TerrainHeightCache::setTileSize(unsigned int tileSize)
+{
+    _tileSize = tileSize>0 ? tileSize : 1;
+    clear();
+}
+
+void TerrainHeightCache::setTraversalMask(osg::Node::NodeMask traversalMask)
+{
+    _traversalMask = traversalMask;
+    clear();
+}
+
+void TerrainHeightCache::setDatabaseCacheReadCallback(DatabaseCacheReadCallback* dcrc)
+{
+    _dcrc = dcrc;
+    _intersectionVisitor.setReadCallback(dcrc);
+    clear();
+}
+
+void TerrainHeightCache::clear()
+{
+    _tiles.clear();
+}
+
+TerrainHeightCache::TileKey TerrainHeightCache::getTileKey(double x, double y) const
+{
+    double tileWidth = _spacing*double(_tileSize);
+    return TileKey(floorToInt(x/tileWidth), floorToInt(y/tileWidth));
+}
+
+bool TerrainHeightCache::getHeight(double x, double y, double& height, osg::Vec3* normal)
+{
+    osg::Vec2d point(x, y);
+    bool found = false;
+    getHeights(1, &point, &height, normal, &found);
+    return found;
+}
+
+unsigned int TerrainHeightCache::getHeights(unsigned int numPoints, const osg::Vec2d* points, double* heights, osg::Vec3* normals, bool* found)
+{
+    if (found) std::fill(found, found+numPoints, false);
+
+    if (!_terrain.valid() || numPoints==0) return 0;
+
+    // sample all the tiles that aren't cached yet at once.
+    std::vector<TileKey> missing;
+    for(unsigned int i=0; i<numPoints; ++i)
+    {
+        TileKey key = getTileKey(points[i].x(), points[i].y());
+        if (_tiles.find(key)==_tiles.end()) missing.push_back(key);
+    }
+
+    if (!missing.empty())
+    {
+        std::sort(missing.begin(), missing.end());
+        missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+        sampleTiles(missing);
+    }
+
+    // neighbouring points usually share a tile, so only look it up when it changes.
+    unsigned int rowLength = _tileSize+1;
+    unsigned int numFound = 0;
+    TileKey currentKey;
+    const Tile* tile = 0;
+    for(unsigned int i=0; i<numPoints; ++i)
+    {
+        double gx = points[i].x()/_spacing;
+        double gy = points[i].y()/_spacing;
+        int ix = floorToInt(gx);
+        int iy = floorToInt(gy);
+
+        TileKey key = getTileKey(points[i].x(), points[i].y());
+        if (!tile || key!=currentKey)
+        {
+            Tiles::const_iterator itr = _tiles.find(key);
+            if (itr==_tiles.end()) continue;
+            tile = &(itr->second);
+            currentKey = key;
+        }
+
+        // the cell's position in the tile, clamped for points right on the tile's far edge.
+        int lx = osg::clampBetween(ix - key.first*static_cast<int>(_tileSize), 0, static_cast<int>(_tileSize)-1);
+        int ly = osg::clampBetween(iy - key.second*static_cast<int>(_tileSize), 0, static_cast<int>(_tileSize)-1);
+        double fx = osg::clampBetween(gx - double(key.first*static_cast<int>(_tileSize) + lx), 0.0, 1.0);
+        double fy = osg::clampBetween(gy - double(key.second*static_cast<int>(_tileSize) + ly), 0.0, 1.0);
+
+        const float* row = &((*tile)[ly*rowLength + lx]);
+        double h00 = row[0];
+        double h10 = row[1];
+        double h01 = row[rowLength];
+        double h11 = row[rowLength+1];
+        if (h00==NO_HEIGHT || h10==NO_HEIGHT || h01==NO_HEIGHT || h11==NO_HEIGHT) continue;
+
+        heights[i] = (h00*(1.0-fx) + h10*fx)*(1.0-fy) + (h01*(1.0-fx) + h11*fx)*fy;
+
+        if (normals)
+        {
+            double dhdx = ((h10-h00)*(1.0-fy) + (h11-h01)*fy)/_spacing;
+            double dhdy = ((h01-h00)*(1.0-fx) + (h11-h10)*fx)/_spacing;
+            osg::Vec3 normal(-dhdx, -dhdy, 1.0);
+            normal.normalize();
+            normals[i] = normal;
+        }
+
+        if (found) found[i] = true;
+        ++numFound;
+    }
+
+    return numFound;
+}
+
+void TerrainHeightCache::sampleTiles(const std::vector<TileKey>& keys)
+{
+    const osg::BoundingSphere& bs = _terrain->getBound();
+    if (!bs.valid()) return;
+
+    double top = bs.center().z() + bs.radius() + 1.0;
+    double bottom = bs.center().z() - bs.radius() - 1.0;
+
+    osg::ref_ptr<osgUtil::LineSegmentBatchIntersector> intersector = new osgUtil::LineSegmentBatchIntersector();
+
+    unsigned int rowLength = _tileSize+1;
+    for(std::vector<TileKey>::const_iterator itr = keys.begin();
+        itr != keys.end();
+        ++itr)
+    {
+        int x0 = itr->first*static_cast<int>(_tileSize);
+        int y0 = itr->second*static_cast<int>(_tileSize);
+        for(unsigned int j=0; j<rowLength; ++j)
+        {
+            double y = double(y0+static_cast<int>(j))*_spacing;
+            for(unsigned int i=0; i<rowLength; ++i)
+            {
+                double x = double(x0+static_cast<int>(i))*_spacing;
+                intersector->addLineSegment(osg::Vec3d(x, y, top), osg::Vec3d(x, y, bottom));
+            }
+        }
+    }
+
+    _intersectionVisitor.reset();
+    _intersectionVisitor.setTraversalMask(_traversalMask);
+    _intersectionVisitor.setIntersector(intersector.get());
+
+    _terrain->accept(_intersectionVisitor);
+
+    unsigned int index = 0;
+    for(std::vector<TileKey>::const_iterator itr = keys.begin();
+        itr != keys.end();
+        ++itr)
+    {
+        Tile& tile = _tiles[*itr];
+        tile.resize(rowLength*rowLength);
+        for(Tile::iterator hitr = tile.begin();
+            hitr != tile.end();
+            ++hitr, ++index)
+        {
+            if (intersector->hasIntersection(index))
+            {
+                const osgUtil::LineSegmentBatchIntersector::Intersection& intersection = intersector->getIntersection(index);
+                osg::Vec3d intersectionPoint = intersection.matrix.valid() ? intersection.localIntersectionPoint * (*intersection.matrix) :
+                                               intersection.localIntersectionPoint;
+                *hitr = static_cast<float>(intersectionPoint.z());
+            }
+            else
+            {
+                *hitr = NO_HEIGHT;
+            }
+        }
+    }
+
+    _numTilesSampled += keys.size();
+}
+
+void TerrainHeightCache::track(osg::PagedLOD& pagedLOD, const osg::Matrixd& matrix)
+{
+    TrackedPagedLOD& tracked = _pagedLODs[&pagedLOD];
+    tracked.pagedLOD = &pagedLOD;
+    tracked.matrix = matrix;
+    tracked.bb = transformBound(pagedLOD.getBound(), matrix);
+    tracked.children.assign(pagedLOD.getNumChildren(), osg::observer_ptr<osg::Node>());
+    for(unsigned int i=0; i<pagedLOD.getNumChildren(); ++i)
+    {
+        tracked.children[i] = pagedLOD.getChild(i);
+    }
+}
+
+bool TerrainHeightCache::childrenChanged(const TrackedPagedLOD& tracked, const osg::PagedLOD& pagedLOD)
+{
+    if (pagedLOD.getNumChildren()!=tracked.children.size()) return true;
+
+    // a child that has been deleted leaves its observer null, even if a reloaded one now has the same address.
+    for(unsigned int i=0; i<pagedLOD.getNumChildren(); ++i)
+    {
+        if (!tracked.children[i].valid() || tracked.children[i].get()!=pagedLOD.getChild(i)) return true;
+    }
+    return false;
+}
+
+void TerrainHeightCache::update()
+{
+    typedef std::vector< osg::ref_ptr<osg::PagedLOD> > PagedLODList;
+    PagedLODList changed;
+    for(TrackedPagedLODs::iterator itr = _pagedLODs.begin();
+        itr != _pagedLODs.end();)
+    {
+        osg::ref_ptr<osg::PagedLOD> pagedLOD = itr->second.pagedLOD.lock();
+        if (!pagedLOD)
+        {
+            // deleted along with the subgraph it was in, whose PagedLOD has changed too.
+            _pagedLODs.erase(itr++);
+            continue;
+        }
+
+        if (childrenChanged(itr->second, *pagedLOD)) changed.push_back(pagedLOD);
+        ++itr;
+    }
+
+    for(PagedLODList::iterator itr = changed.begin();
+        itr != changed.end();
+        ++itr)
+    {
+        TrackedPagedLOD& tracked = _pagedLODs[itr->get()];
+        osg::Matrixd matrix = tracked.matrix;
+
+        // drop the tiles below both the old bound and the new one, which grows as children are loaded.
+        dirty(tracked.bb);
+        dirty(transformBound((*itr)->getBound(), matrix));
+
+        // track the PagedLOD again, along with any new ones in the children loaded.
+        CollectPagedLODsVisitor collect(*this, matrix);
+        (*itr)->accept(collect);
+    }
+}
+
+void TerrainHeightCache::dirty(const osg::BoundingBox& bb)
+{
+    if (!bb.valid() || _tiles.empty()) return;
+
+    // widen by a grid spacing, so the tiles that only share a row or column of grid points with bb are dropped too.
+    TileKey minKey = getTileKey(bb.xMin()-_spacing, bb.yMin()-_spacing);
+    TileKey maxKey = getTileKey(bb.xMax()+_spacing, bb.yMax()+_spacing);
+
+    for(Tiles::iterator itr = _tiles.begin();
+        itr != _tiles.end();)
+    {
+        const TileKey& key = itr->first;
+        if (key.first>=minKey.first && key.first<=maxKey.first &&
+            key.second>=minKey.second && key.second<=maxKey.second)
+        {
+            _tiles.erase(itr++);
+        }
+        else
+        {
+            ++itr;
+        }
+    }
+}
@@ -0,0 +1,286 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+#include <osgUtil/BoundUpdater>
+
+#include <osg/Geode>
+#include <osg/Group>
+#include <osg/Notify>
+
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
+#include <stdlib.h>
+
+using namespace osgUtil;
+
+namespace
+{
+    // the number of bounds each thread takes at a time, and the fewest worth sharing out across the threads.
+    const unsigned int BLOCK_SIZE = 16;
+    const unsigned int MIN_PARALLEL_BATCH_SIZE = 4*BLOCK_SIZE;
+}
+
+class BoundUpdater::UpdateThread : public OpenThreads::Thread
+{
+    public:
+
+        UpdateThread(BoundUpdater* boundUpdater):
+            _boundUpdater(boundUpdater) {}
+
+        virtual void run()
+        {
+            unsigned int batchNumber = 0;
+            for(;;)
+            {
+                {
+                    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_boundUpdater->_mutex);
+                    while (_boundUpdater->_batchNumber==batchNumber && !_boundUpdater->_done)
+                    {
+                        _boundUpdater->_batchReady.wait(&(_boundUpdater->_mutex));
+                    }
+                    if (_boundUpdater->_done) return;
+                    batchNumber = _boundUpdater->_batchNumber;
+                }
+
+                _boundUpdater->recomputeBlocks();
+            }
+        }
+
+    protected:
+
+        // not a ref_ptr, the BoundUpdater joins its threads before it is deleted.
+        BoundUpdater*   _boundUpdater;
+};
+
+BoundUpdater::BoundUpdater():
+    _numThreads(1),
+    _numNodesRecomputed(0),
+    _numDrawablesRecomputed(0),
+    _numLevels(0),
+    _batchNumber(0),
+    _batchNodes(0),
+    _batchDrawables(0),
+    _batchSize(0),
+    _nextBlock(0),
+    _numDone(0),
+    _done(false)
+{
+    const char* ptr = getenv("OSG_NUM_BOUND_UPDATE_THREADS");
+    if (ptr)
+    {
+        setNumThreads(atoi(ptr));
+
+        OSG_NOTIFY(osg::INFO)<<"Set number of bound update threads to "<<_numThreads<<std::endl;
+    }
+}
+
+BoundUpdater::~BoundUpdater()
+{
+    stopThreads();
+}
+
+void BoundUpdater::setNumThreads(unsigned int numThreads)
+{
+    if (numThreads<1) numThreads = 1;
+    if (numThreads==_numThreads) return;
+
+    stopThreads();
+    _numThreads = numThreads;
+    startThreads();
+}
+
+void BoundUpdater::startThreads()
+{
+    for(unsigned int i=1; i<_numThreads; ++i)
+    {
+        UpdateThread* thread = new UpdateThread(this);
+        if (thread->start()==0) _threads.push_back(thread);
+        else delete thread;
+    }
+}
+
+void BoundUpdater::stopThreads()
+{
+    if (_threads.empty()) return;
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        _done = true;
+        _batchReady.broadcast();
+    }
+
+    for(UpdateThreads::iterator itr = _threads.begin();
+        itr != _threads.end();
+        ++itr)
+    {
+        (*itr)->join();
+        delete *itr;
+    }
+    _threads.clear();
+
+    _done = false;
+}
+
+void BoundUpdater::updateBounds(osg::Node& node)
+{
+    _numNodesRecomputed = 0;
+    _numDrawablesRecomputed = 0;
+    _numLevels = 0;
+
+    if (!node.isBoundDirty()) return;
+
+    for(NodeQueueList::iterator itr = _nodeQueues.begin();
+        itr != _nodeQueues.end();
+        ++itr)
+    {
+        itr->clear();
+    }
+    _drawableQueue.clear();
+    _heights.clear();
+
+    _numLevels = queue(node);
+
+    // the drawables first, then the nodes from the bottom up, so that each bound only reads ones already computed.
+    _numDrawablesRecomputed = static_cast<unsigned int>(_drawableQueue.size());
+    if (!_drawableQueue.empty()) recompute(0, &_drawableQueue.front(), _numDrawablesRecomputed);
+
+    for(unsigned int i=0; i<_numLevels; ++i)
+    {
+        NodeQueue& nodes = _nodeQueues[i];
+        if (nodes.empty()) continue;
+
+        recompute(&nodes.front(), 0, static_cast<unsigned int>(nodes.size()));
+        _numNodesRecomputed += static_cast<unsigned int>(nodes.size());
+    }
+
+    _heights.clear();
+}
+
+unsigned int BoundUpdater::queue(osg::Node& node)
+{
+    if (!node.isBoundDirty()) return 0;
+
+    // a node with several parents is reached once for each of them, so has its height looked up.
+    bool shared = node.getNumParents()>1;
+    if (shared)
+    {
+        HeightMap::const_iterator itr = _heights.find(&node);
+        if (itr!=_heights.end()) return itr->second;
+    }
+
+    unsigned int height = 1;
+
+    osg::Group* group = node.asGroup();
+    if (group)
+    {
+        for(unsigned int i=0; i<group->getNumChildren(); ++i)
+        {
+            osg::Node* child = group->getChild(i);
+            if (child) height = osg::maximum(height, queue(*child)+1);
+        }
+    }
+    else
+    {
+        osg::Geode* geode = node.asGeode();
+        if (geode)
+        {
+            for(unsigned int i=0; i<geode->getNumDrawables(); ++i)
+            {
+                osg::Drawable* drawable = geode->getDrawable(i);
+                if (drawable && drawable->isBoundDirty() &&
+                    (drawable->getNumParents()<2 || _heights.insert(HeightMap::value_type(drawable, 0)).second))
+                {
+                    _drawableQueue.push_back(drawable);
+                }
+            }
+        }
+    }
+
+    if (shared) _heights[&node] = height;
+
+    if (_nodeQueues.size()<height) _nodeQueues.resize(height);
+    _nodeQueues[height-1].push_back(&node);
+
+    return height;
+}
+
+void BoundUpdater::recompute(osg::Node** nodes, osg::Drawable** drawables, unsigned int count)
+{
+    if (_threads.empty() || count<MIN_PARALLEL_BATCH_SIZE)
+    {
+        if (nodes)
+        {
+            for(unsigned int i=0; i<count; ++i) nodes[i]->getBound();
+        }
+        else
+        {
+            for(unsigned int i=0; i<count; ++i) drawables[i]->getBound();
+        }
+        return;
+    }
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        _batchNodes = nodes;
+        _batchDrawables = drawables;
+        _batchSize = count;
+        _nextBlock = 0;
+        _numDone = 0;
+        ++_batchNumber;
+        _batchReady.broadcast();
+    }
+
+    recomputeBlocks();
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        while (_numDone<_batchSize)
+        {
+            _batchDone.wait(&_mutex);
+        }
+    }
+}
+
+void BoundUpdater::recomputeBlocks()
+{
+    for(;;)
+    {
+        unsigned int begin, end;
+        osg::Node** nodes;
+        osg::Drawable** drawables;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            if (_nextBlock>=_batchSize) return;
+            begin = _nextBlock;
+            end = osg::minimum(begin+BLOCK_SIZE, _batchSize);
+            _nextBlock = end;
+            nodes = _batchNodes;
+            drawables = _batchDrawables;
+        }
+
+        if (nodes)
+        {
+            for(unsigned int i=begin; i<end; ++i) nodes[i]->getBound();
+        }
+        else
+        {
+            for(unsigned int i=begin; i<end; ++i) drawables[i]->getBound();
+        }
+
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            _numDone += end-begin;
+            if (_numDone==_batchSize) _batchDone.broadcast();
+        }
+    }
+}
@@ -19,6 +19,7 @@
 #include <osg/Transform>
 #include <osg/Projection>
 #include <osg/Camera>
+#include <osg/SpatialGroup>
 #include <osg/Geode>
 #include <osg/Billboard>
 #include <osg/Geometry>
@@ -91,13 +92,39 @@ bool IntersectorGroup::enter(const osg::Node& node)
     return true;
 }
 
+bool IntersectorGroup::enterBoundingBox(const osg::BoundingBox& bb)
+{
+    if (disabled()) return false;
+    
+    bool foundIntersections = false;
+    
+    for(Intersectors::iterator itr = _intersectors.begin();
+        itr != _intersectors.end();
+        ++itr)
+    {
+        if ((*itr)->disabled()) (*itr)->incrementDisabledCount();
+        else if ((*itr)->enterBoundingBox(bb)) foundIntersections = true;
+        else (*itr)->incrementDisabledCount();
+    }
+    
+    if (!foundIntersections) 
+    {
+        leave();
+        return false;
+    }
+    
+    return true;
+}
+
 void IntersectorGroup::leave()
 {
     for(Intersectors::iterator itr = _intersectors.begin();
         itr != _intersectors.end();
         ++itr)
     {
+        // mirror enter(), members that entered the node leave it, the rest were disabled by it.
         if ((*itr)->disabled()) (*itr)->decrementDisabledCount();
+        else (*itr)->leave();
     }
 }
 
@@ -223,6 +250,49 @@ void IntersectionVisitor::apply(osg::Group& group)
     leave();
 }
 
+void IntersectionVisitor::apply(osg::SpatialGroup& group)
+{
+    if (!enter(group)) return;
+
+    // hold on to the hierarchy, another thread may replace the group's while it's being traversed.
+    osg::ref_ptr<const osg::SpatialGroup::Hierarchy> hierarchy = group.getHierarchy();
+
+    for(osg::SpatialGroup::ChildIndexList::const_iterator itr = hierarchy->unculledChildIndices.begin();
+        itr != hierarchy->unculledChildIndices.end();
+        ++itr)
+    {
+        group.getChild(*itr)->accept(*this);
+    }
+
+    if (!hierarchy->cells.empty()) traverseCell(group, *hierarchy, 0);
+
+    leave();
+}
+
+void IntersectionVisitor::traverseCell(osg::SpatialGroup& group, const osg::SpatialGroup::Hierarchy& hierarchy, int cellNum)
+{
+    const osg::SpatialGroup::Cell& cell = hierarchy.cells[cellNum];
+    if (!enter(cell.bb)) return;
+
+    if (cell.first<0)
+    {
+        const osg::SpatialGroup::ChildIndexList& cellChildIndices = hierarchy.cellChildIndices;
+        unsigned int begin = static_cast<unsigned int>(-cell.first-1);
+        unsigned int end = begin+static_cast<unsigned int>(cell.second);
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            group.getChild(cellChildIndices[i])->accept(*this);
+        }
+    }
+    else
+    {
+        traverseCell(group, hierarchy, cell.first);
+        traverseCell(group, hierarchy, cell.second);
+    }
+
+    leave();
+}
+
 void IntersectionVisitor::apply(osg::Geode& geode)
 {
     // osg::notify(osg::NOTICE)<<"apply(Geode&)"<<std::endl;
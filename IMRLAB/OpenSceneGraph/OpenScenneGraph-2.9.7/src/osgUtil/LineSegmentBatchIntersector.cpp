@@ -0,0 +1,509 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgUtil/LineSegmentBatchIntersector>
+
+#include <osg/Geometry>
+#include <osg/TriangleFunctor>
+
+#include <algorithm>
+
+using namespace osgUtil;
+
+namespace LineSegmentBatchIntersectorUtils
+{
+    // the stack entry of a node that isn't culled above any that are, which all the segments enter.
+    const unsigned int ALL_SEGMENTS = ~0u;
+
+    /** Intersects each triangle of a drawable without a KdTree with all the segments reaching the drawable, keeping the
+      * nearest intersection of each segment.*/
+    struct TriangleBatchIntersector
+    {
+        struct Hit
+        {
+            Hit():
+                index(0),
+                r1(0.0f), r2(0.0f), r3(0.0f),
+                v1(0), v2(0), v3(0),
+                hit(false) {}
+
+            unsigned int        index;
+            osg::Vec3           normal;
+            float               r1;
+            float               r2;
+            float               r3;
+            const osg::Vec3*    v1;
+            const osg::Vec3*    v2;
+            const osg::Vec3*    v3;
+            bool                hit;
+        };
+
+        std::vector<osg::Vec3>  _s;
+        std::vector<osg::Vec3>  _d;
+        std::vector<float>      _length;
+        std::vector<float>      _nearest;
+        std::vector<Hit>        _hits;
+        unsigned int            _index;
+
+        TriangleBatchIntersector():
+            _index(0) {}
+
+        void set(unsigned int numSegments, const osg::Vec3d* starts, const osg::Vec3d* ends, const double* nearestRatios)
+        {
+            _s.resize(numSegments);
+            _d.resize(numSegments);
+            _length.resize(numSegments);
+            _nearest.resize(numSegments);
+            _hits.assign(numSegments, Hit());
+            _index = 0;
+
+            for(unsigned int i=0; i<numSegments; ++i)
+            {
+                _s[i] = starts[i];
+                _d[i] = ends[i]-starts[i];
+                _length[i] = _d[i].length();
+                if (_length[i]>0.0f) _d[i] /= _length[i];
+                _nearest[i] = _length[i]*static_cast<float>(nearestRatios[i]);
+            }
+        }
+
+        inline void operator () (const osg::Vec3& v1,const osg::Vec3& v2,const osg::Vec3& v3, bool treatVertexDataAsTemporary)
+        {
+            ++_index;
+
+            if (v1==v2 || v2==v3 || v1==v3) return;
+
+            osg::Vec3 E1 = v2 - v1;
+            osg::Vec3 E2 = v3 - v1;
+
+            const float esplison = 1e-10f;
+            for(unsigned int i=0; i<_s.size(); ++i)
+            {
+                osg::Vec3 P = _d[i] ^ E2;
+                float det = P * E1;
+                if (det<=esplison && det>=-esplison) continue;
+
+                osg::Vec3 T = _s[i] - v1;
+                osg::Vec3 Q = T ^ E1;
+
+                float inv_det = 1.0f/det;
+                float u = (P*T)*inv_det;
+                float v = (Q*_d[i])*inv_det;
+                if (u<0.0f || v<0.0f || (u+v)>1.0f) continue;
+
+                float t = (Q*E2)*inv_det;
+                if (t<0.0f || t>=_nearest[i]) continue;
+
+                _nearest[i] = t;
+
+                Hit& hit = _hits[i];
+                hit.index = _index-1;
+                hit.normal = E1^E2;
+                hit.normal.normalize();
+                hit.r1 = 1.0f-u-v;
+                hit.r2 = u;
+                hit.r3 = v;
+                hit.v1 = treatVertexDataAsTemporary ? 0 : &v1;
+                hit.v2 = treatVertexDataAsTemporary ? 0 : &v2;
+                hit.v3 = treatVertexDataAsTemporary ? 0 : &v3;
+                hit.hit = true;
+            }
+        }
+    };
+
+    // does the segment from s to s+d*maxRatio pass within the sphere.
+    inline bool intersects(const osg::Vec3d& s, const osg::Vec3d& d, double maxRatio, const osg::BoundingSphere& bs)
+    {
+        osg::Vec3d sc = osg::Vec3d(bs._center) - s;
+        double a = d.length2();
+        double t = a>0.0 ? (sc*d)/a : 0.0;
+        if (t<0.0) t = 0.0;
+        else if (t>maxRatio) t = maxRatio;
+
+        return (sc - d*t).length2() <= static_cast<double>(bs._radius)*static_cast<double>(bs._radius);
+    }
+
+    // does the segment from s to s+d*maxRatio pass through the box.
+    inline bool intersects(const osg::Vec3d& s, const osg::Vec3d& d, double maxRatio, const osg::BoundingBox& bb)
+    {
+        double tmin = 0.0;
+        double tmax = maxRatio;
+        for(unsigned int axis=0; axis<3; ++axis)
+        {
+            if (d[axis]==0.0)
+            {
+                if (s[axis]<bb._min[axis] || s[axis]>bb._max[axis]) return false;
+                continue;
+            }
+
+            double inv = 1.0/d[axis];
+            double t0 = (bb._min[axis]-s[axis])*inv;
+            double t1 = (bb._max[axis]-s[axis])*inv;
+            if (t0>t1) std::swap(t0, t1);
+            if (t0>tmin) tmin = t0;
+            if (t1<tmax) tmax = t1;
+            if (tmin>tmax) return false;
+        }
+        return true;
+    }
+}
+
+using namespace LineSegmentBatchIntersectorUtils;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  LineSegmentBatchIntersector
+//
+
+LineSegmentBatchIntersector::LineSegmentBatchIntersector(CoordinateFrame cf):
+    Intersector(cf),
+    _parent(0),
+    _hasMatrix(false),
+    _numIntersections(0),
+    _numActiveLists(0)
+{
+}
+
+unsigned int LineSegmentBatchIntersector::addLineSegment(const osg::Vec3d& start, const osg::Vec3d& end)
+{
+    unsigned int index = static_cast<unsigned int>(_segments.size());
+    _segments.push_back(Segment(start, end));
+    _bb.expandBy(start);
+    _bb.expandBy(end);
+    return index;
+}
+
+void LineSegmentBatchIntersector::setLineSegment(unsigned int i, const osg::Vec3d& start, const osg::Vec3d& end)
+{
+    Segment& segment = _segments[i];
+    if (segment.intersection.ratio>=0.0) --_numIntersections;
+
+    segment = Segment(start, end);
+
+    // leave the old end points in the combined bounds until the next reset(), it only has to contain the segments.
+    _bb.expandBy(start);
+    _bb.expandBy(end);
+}
+
+void LineSegmentBatchIntersector::clear()
+{
+    _segments.clear();
+    _bb.init();
+    _numIntersections = 0;
+}
+
+Intersector* LineSegmentBatchIntersector::clone(osgUtil::IntersectionVisitor& iv)
+{
+    osg::ref_ptr<LineSegmentBatchIntersector> lsbi = new LineSegmentBatchIntersector(_coordinateFrame);
+    lsbi->_parent = this;
+
+    if (_coordinateFrame==MODEL && iv.getModelMatrix()==0) return lsbi.release();
+
+    // compute the matrix that takes the local MODEL coordinate frame into this Intersector's CoordinateFrame.
+    osg::Matrix matrix;
+    switch (_coordinateFrame)
+    {
+        case(WINDOW):
+            if (iv.getWindowMatrix()) matrix.preMult( *iv.getWindowMatrix() );
+            if (iv.getProjectionMatrix()) matrix.preMult( *iv.getProjectionMatrix() );
+            if (iv.getViewMatrix()) matrix.preMult( *iv.getViewMatrix() );
+            if (iv.getModelMatrix()) matrix.preMult( *iv.getModelMatrix() );
+            break;
+        case(PROJECTION):
+            if (iv.getProjectionMatrix()) matrix.preMult( *iv.getProjectionMatrix() );
+            if (iv.getViewMatrix()) matrix.preMult( *iv.getViewMatrix() );
+            if (iv.getModelMatrix()) matrix.preMult( *iv.getModelMatrix() );
+            break;
+        case(VIEW):
+            if (iv.getViewMatrix()) matrix.preMult( *iv.getViewMatrix() );
+            if (iv.getModelMatrix()) matrix.preMult( *iv.getModelMatrix() );
+            break;
+        case(MODEL):
+            if (iv.getModelMatrix()) matrix = *iv.getModelMatrix();
+            break;
+    }
+
+    lsbi->_hasMatrix = true;
+    lsbi->_matrix = matrix;
+    lsbi->_inverse.invert(matrix);
+    return lsbi.release();
+}
+
+osg::BoundingBox LineSegmentBatchIntersector::toFrame(const osg::BoundingBox& bb) const
+{
+    if (!_hasMatrix) return bb;
+
+    osg::BoundingBox frameBB;
+    for(unsigned int i=0; i<8; ++i)
+    {
+        frameBB.expandBy(bb.corner(i)*_matrix);
+    }
+    return frameBB;
+}
+
+void LineSegmentBatchIntersector::collect(const osg::BoundingBox* bb, const osg::BoundingSphere* bs, ActiveList& active) const
+{
+    const LineSegmentBatchIntersector& root = getRoot();
+
+    active.segments.clear();
+    active.bb.init();
+
+    const ActiveList* current = 0;
+    if (!root._activeStack.empty() && root._activeStack.back()!=ALL_SEGMENTS) current = &root._activeLists[root._activeStack.back()];
+
+    // reject the lot when outside of the combined bounds of the current segments.
+    const osg::BoundingBox& currentBB = current ? current->bb : root._bb;
+    if (bb && !currentBB.intersects(*bb)) return;
+    if (bs && !bb)
+    {
+        osg::Vec3 radius(bs->_radius, bs->_radius, bs->_radius);
+        if (!currentBB.intersects(osg::BoundingBox(bs->_center-radius, bs->_center+radius))) return;
+    }
+
+    unsigned int numCurrent = current ? static_cast<unsigned int>(current->segments.size()) : static_cast<unsigned int>(root._segments.size());
+    for(unsigned int j=0; j<numCurrent; ++j)
+    {
+        unsigned int i = current ? current->segments[j] : j;
+        const Segment& segment = root._segments[i];
+        if (segment.nearestRatio<=0.0) continue;
+
+        osg::Vec3d d = segment.end-segment.start;
+        if (bb)
+        {
+            if (!intersects(segment.start, d, segment.nearestRatio, *bb)) continue;
+        }
+        else if (bs)
+        {
+            if (!intersects(segment.start, d, segment.nearestRatio, *bs)) continue;
+        }
+
+        active.segments.push_back(i);
+        active.bb.expandBy(segment.start);
+        active.bb.expandBy(segment.start+d*segment.nearestRatio);
+    }
+}
+
+bool LineSegmentBatchIntersector::push(const osg::BoundingBox* bb, const osg::BoundingSphere* bs)
+{
+    LineSegmentBatchIntersector& root = getRoot();
+
+    if (root._activeLists.size()<=root._numActiveLists) root._activeLists.resize(root._numActiveLists+1);
+
+    ActiveList& active = root._activeLists[root._numActiveLists];
+    collect(bb, bs, active);
+    if (active.segments.empty()) return false;
+
+    root._activeStack.push_back(root._numActiveLists++);
+    return true;
+}
+
+void LineSegmentBatchIntersector::pushCurrent()
+{
+    LineSegmentBatchIntersector& root = getRoot();
+    root._activeStack.push_back(root._activeStack.empty() ? ALL_SEGMENTS : root._activeStack.back());
+}
+
+bool LineSegmentBatchIntersector::enter(const osg::Node& node)
+{
+    if (getRoot()._segments.empty()) return false;
+
+    const osg::BoundingSphere& bs = node.getBound();
+
+    // if bs not valid then enter based on the assumption that an invalid sphere is yet to be defined.
+    if (!node.isCullingActive() || !bs.valid())
+    {
+        pushCurrent();
+        return true;
+    }
+
+    if (!_hasMatrix) return push(0, &bs);
+
+    // the sphere bounding bs in the CoordinateFrame, scaled by the largest scale of the matrix.
+    double scale2 = osg::maximum(osg::Vec3d(_matrix(0,0),_matrix(0,1),_matrix(0,2)).length2(),
+                    osg::maximum(osg::Vec3d(_matrix(1,0),_matrix(1,1),_matrix(1,2)).length2(),
+                                 osg::Vec3d(_matrix(2,0),_matrix(2,1),_matrix(2,2)).length2()));
+    osg::BoundingSphere frameBS(bs._center*_matrix, bs._radius*sqrt(scale2));
+    return push(0, &frameBS);
+}
+
+bool LineSegmentBatchIntersector::enterBoundingBox(const osg::BoundingBox& bb)
+{
+    if (getRoot()._segments.empty()) return false;
+
+    if (!bb.valid())
+    {
+        pushCurrent();
+        return true;
+    }
+
+    osg::BoundingBox frameBB = toFrame(bb);
+    return push(&frameBB, 0);
+}
+
+void LineSegmentBatchIntersector::leave()
+{
+    LineSegmentBatchIntersector& root = getRoot();
+
+    unsigned int index = root._activeStack.back();
+    root._activeStack.pop_back();
+
+    // free the list unless it is still in use by the parent node.
+    if (index!=ALL_SEGMENTS && (root._activeStack.empty() || root._activeStack.back()!=index)) --root._numActiveLists;
+}
+
+void LineSegmentBatchIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Drawable* drawable)
+{
+    LineSegmentBatchIntersector& root = getRoot();
+
+    const osg::BoundingBox& bb = drawable->getBound();
+    if (bb.valid())
+    {
+        osg::BoundingBox frameBB = toFrame(bb);
+        collect(&frameBB, 0, root._drawableActive);
+    }
+    else
+    {
+        collect(0, 0, root._drawableActive);
+    }
+
+    const std::vector<unsigned int>& active = root._drawableActive.segments;
+    if (active.empty()) return;
+
+    if (iv.getDoDummyTraversal()) return;
+
+    // the segments in the local coordinates, the ratios along them are the same as in the CoordinateFrame.
+    unsigned int numActive = static_cast<unsigned int>(active.size());
+    root._localStarts.resize(numActive);
+    root._localEnds.resize(numActive);
+    for(unsigned int j=0; j<numActive; ++j)
+    {
+        const Segment& segment = root._segments[active[j]];
+        root._localStarts[j] = _hasMatrix ? segment.start*_inverse : segment.start;
+        root._localEnds[j] = _hasMatrix ? segment.end*_inverse : segment.end;
+    }
+
+    osg::KdTree* kdTree = iv.getUseKdTreeWhenAvailable() ? dynamic_cast<osg::KdTree*>(drawable->getShape()) : 0;
+    if (kdTree)
+    {
+        osg::KdTree::LineSegmentIntersections& intersections = root._kdTreeIntersections;
+        intersections.assign(numActive, osg::KdTree::LineSegmentIntersection());
+        for(unsigned int j=0; j<numActive; ++j)
+        {
+            intersections[j].ratio = root._segments[active[j]].nearestRatio;
+        }
+
+        if (!kdTree->intersect(numActive, &root._localStarts.front(), &root._localEnds.front(), &intersections.front())) return;
+
+        for(unsigned int j=0; j<numActive; ++j)
+        {
+            const osg::KdTree::LineSegmentIntersection& lsi = intersections[j];
+            if (lsi.ratio>=root._segments[active[j]].nearestRatio) continue;
+
+            const unsigned int indices[3] = { lsi.p0, lsi.p1, lsi.p2 };
+            const float ratios[3] = { lsi.r0, lsi.r1, lsi.r2 };
+            setIntersection(iv, drawable, active[j], root._localStarts[j], root._localEnds[j],
+                            lsi.ratio, lsi.intersectionNormal, lsi.primitiveIndex, indices, ratios, 3);
+        }
+        return;
+    }
+
+    std::vector<double> nearestRatios(numActive);
+    for(unsigned int j=0; j<numActive; ++j)
+    {
+        nearestRatios[j] = root._segments[active[j]].nearestRatio;
+    }
+
+    osg::TriangleFunctor<TriangleBatchIntersector> ti;
+    ti.set(numActive, &root._localStarts.front(), &root._localEnds.front(), &nearestRatios.front());
+    drawable->accept(ti);
+
+    osg::Geometry* geometry = drawable->asGeometry();
+    osg::Vec3Array* vertices = geometry ? dynamic_cast<osg::Vec3Array*>(geometry->getVertexArray()) : 0;
+    const osg::Vec3* first = (vertices && !vertices->empty()) ? &(vertices->front()) : 0;
+
+    for(unsigned int j=0; j<numActive; ++j)
+    {
+        const TriangleBatchIntersector::Hit& triHit = ti._hits[j];
+        if (!triHit.hit) continue;
+
+        double ratio = ti._nearest[j]/ti._length[j];
+        if (ratio>=root._segments[active[j]].nearestRatio) continue;
+
+        unsigned int indices[3] = { 0, 0, 0 };
+        float ratios[3] = { 0.0f, 0.0f, 0.0f };
+        unsigned int numIndices = 0;
+        if (first && triHit.v1 && triHit.v2 && triHit.v3)
+        {
+            indices[0] = triHit.v1-first; ratios[0] = triHit.r1;
+            indices[1] = triHit.v2-first; ratios[1] = triHit.r2;
+            indices[2] = triHit.v3-first; ratios[2] = triHit.r3;
+            numIndices = 3;
+        }
+
+        setIntersection(iv, drawable, active[j], root._localStarts[j], root._localEnds[j],
+                        ratio, triHit.normal, triHit.index, indices, ratios, numIndices);
+    }
+}
+
+void LineSegmentBatchIntersector::setIntersection(osgUtil::IntersectionVisitor& iv, osg::Drawable* drawable, unsigned int i,
+                                                  const osg::Vec3d& localStart, const osg::Vec3d& localEnd,
+                                                  double ratio, const osg::Vec3& normal, unsigned int primitiveIndex,
+                                                  const unsigned int* indices, const float* ratios, unsigned int numIndices)
+{
+    LineSegmentBatchIntersector& root = getRoot();
+
+    Segment& segment = root._segments[i];
+    if (segment.intersection.ratio<0.0) ++root._numIntersections;
+
+    segment.nearestRatio = ratio;
+
+    Intersection& hit = segment.intersection;
+    hit.ratio = ratio;
+    hit.matrix = iv.getModelMatrix();
+    hit.nodePath = iv.getNodePath();
+    hit.drawable = drawable;
+    hit.primitiveIndex = primitiveIndex;
+    hit.localIntersectionPoint = localStart*(1.0-ratio) + localEnd*ratio;
+    hit.localIntersectionNormal = normal;
+
+    hit.indexList.clear();
+    hit.ratioList.clear();
+    for(unsigned int j=0; j<numIndices; ++j)
+    {
+        if (ratios[j]!=0.0f)
+        {
+            hit.indexList.push_back(indices[j]);
+            hit.ratioList.push_back(ratios[j]);
+        }
+    }
+}
+
+void LineSegmentBatchIntersector::reset()
+{
+    Intersector::reset();
+
+    _bb.init();
+    for(Segments::iterator itr = _segments.begin();
+        itr != _segments.end();
+        ++itr)
+    {
+        itr->nearestRatio = 1.0;
+        itr->intersection = Intersection();
+        _bb.expandBy(itr->start);
+        _bb.expandBy(itr->end);
+    }
+    _numIntersections = 0;
+
+    _activeStack.clear();
+    _numActiveLists = 0;
+}
@@ -102,7 +102,7 @@ void RenderBin::removeRenderBinPrototype(RenderBin* proto)
 
 static bool s_defaultBinSortModeInitialized = false;
 static RenderBin::SortMode s_defaultBinSortMode = RenderBin::SORT_BY_STATE;
-static osg::ApplicationUsageProxy RenderBin_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DEFAULT_BIN_SORT_MODE <type>","SORT_BY_STATE | SORT_BY_STATE_THEN_FRONT_TO_BACK | SORT_FRONT_TO_BACK | SORT_BACK_TO_FRONT");
+static osg::ApplicationUsageProxy RenderBin_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DEFAULT_BIN_SORT_MODE <type>","SORT_BY_STATE | SORT_BY_STATE_THEN_FRONT_TO_BACK | SORT_BY_STATE_THEN_DEPTH | SORT_FRONT_TO_BACK | SORT_BACK_TO_FRONT");
 
 void RenderBin::setDefaultRenderBinSortMode(RenderBin::SortMode mode)
 {
@@ -125,6 +125,7 @@ RenderBin::SortMode RenderBin::getDefaultRenderBinSortMode()
             else if (strcmp(str,"SORT_FRONT_TO_BACK")==0) s_defaultBinSortMode = RenderBin::SORT_FRONT_TO_BACK;
             else if (strcmp(str,"SORT_BACK_TO_FRONT")==0) s_defaultBinSortMode = RenderBin::SORT_BACK_TO_FRONT;
             else if (strcmp(str,"TRAVERSAL_ORDER")==0) s_defaultBinSortMode = RenderBin::TRAVERSAL_ORDER;
+            else if (strcmp(str,"SORT_BY_STATE_THEN_DEPTH")==0) s_defaultBinSortMode = RenderBin::SORT_BY_STATE_THEN_DEPTH;
         }
     }
     
@@ -137,6 +138,8 @@ RenderBin::RenderBin()
     _parent = NULL;
     _stage = NULL;
     _sorted = false;
+    _inUse = true;
+    _numFramesUnused = 0;
     _sortMode = getDefaultRenderBinSortMode();
 }
 
@@ -146,6 +149,8 @@ RenderBin::RenderBin(SortMode mode)
     _parent = NULL;
     _stage = NULL;
     _sorted = false;
+    _inUse = true;
+    _numFramesUnused = 0;
     _sortMode = mode;
 
 #if 1
@@ -176,7 +181,10 @@ RenderBin::RenderBin(const RenderBin& rhs,const CopyOp& copyop):
         _sortMode(rhs._sortMode),
         _sortCallback(rhs._sortCallback),
         _drawCallback(rhs._drawCallback),
-        _stateset(rhs._stateset)
+        _stateset(rhs._stateset),
+        _binName(rhs._binName),
+        _inUse(true),
+        _numFramesUnused(0)
 {
 
 }
@@ -189,8 +197,24 @@ void RenderBin::reset()
 {
     _stateGraphList.clear();
     _renderLeafList.clear();
-    _bins.clear();
     _sorted = false;
+    _numFramesUnused = _inUse ? 0 : _numFramesUnused+1;
+    _inUse = false;
+
+    for(RenderBinList::iterator itr = _bins.begin();
+        itr!=_bins.end();)
+    {
+        RenderBin* bin = itr->second.get();
+        if (bin->_inUse || bin->_numFramesUnused<StateGraph::DEFAULT_MAX_NUM_FRAMES_EMPTY)
+        {
+            bin->reset();
+            ++itr;
+        }
+        else
+        {
+            _bins.erase(itr++);
+        }
+    }
 }
 
 void RenderBin::sort()
@@ -237,6 +261,9 @@ void RenderBin::sortImplementation()
         case(TRAVERSAL_ORDER):
             sortTraversalOrder();
             break;
+        case(SORT_BY_STATE_THEN_DEPTH):
+            sortByStateThenDepth();
+            break;
     }
 }
 
@@ -279,58 +306,145 @@ void RenderBin::sortByStateThenFrontToBack()
     std::sort(_stateGraphList.begin(),_stateGraphList.end(),StateGraphFrontToBackSortFunctor());
 }
 
-struct FrontToBackSortFunctor
+/** Map a float onto an unsigned int that orders the same way, flipping the sign bit of positive values and all the
+  * bits of negative ones.*/
+static inline unsigned int depthSortKey(float depth)
 {
-    bool operator() (const RenderLeaf* lhs,const RenderLeaf* rhs) const
-    {
-        return (lhs->_depth<rhs->_depth);
-    }
-};
+    depth += 0.0f; // -0 to +0.
+    unsigned int bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
 
-    
 void RenderBin::sortFrontToBack()
 {
     copyLeavesFromStateGraphListToRenderLeafList();
 
     // now sort the list into acending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),FrontToBackSortFunctor());
-    
-//    cout << "sort front to back"<<endl;
+    _sortKeys.resize(_renderLeafList.size());
+    for(unsigned int i=0; i<_renderLeafList.size(); ++i)
+    {
+        _sortKeys[i]._key = depthSortKey(_renderLeafList[i]->_depth);
+        _sortKeys[i]._leaf = _renderLeafList[i];
+    }
+    sortRenderLeafListByKeys();
 }
 
-struct BackToFrontSortFunctor
+void RenderBin::sortBackToFront()
 {
-    bool operator() (const RenderLeaf* lhs,const RenderLeaf* rhs) const
+    copyLeavesFromStateGraphListToRenderLeafList();
+
+    // now sort the list into descending depth order.
+    _sortKeys.resize(_renderLeafList.size());
+    for(unsigned int i=0; i<_renderLeafList.size(); ++i)
     {
-        return (rhs->_depth<lhs->_depth);
+        _sortKeys[i]._key = ~depthSortKey(_renderLeafList[i]->_depth);
+        _sortKeys[i]._leaf = _renderLeafList[i];
     }
-};
+    sortRenderLeafListByKeys();
+}
 
-void RenderBin::sortBackToFront()
+void RenderBin::sortTraversalOrder()
 {
     copyLeavesFromStateGraphListToRenderLeafList();
 
-    // now sort the list into acending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),BackToFrontSortFunctor());
-
-//    cout << "sort back to front"<<endl;
+    // now sort the list into acending traversal order.
+    _sortKeys.resize(_renderLeafList.size());
+    for(unsigned int i=0; i<_renderLeafList.size(); ++i)
+    {
+        _sortKeys[i]._key = _renderLeafList[i]->_traversalNumber;
+        _sortKeys[i]._leaf = _renderLeafList[i];
+    }
+    sortRenderLeafListByKeys();
 }
 
-
-struct TraversalOrderFunctor
+void RenderBin::sortByStateThenDepth()
 {
-    bool operator() (const RenderLeaf* lhs,const RenderLeaf* rhs) const
+    copyLeavesFromStateGraphListToRenderLeafList();
+
+    // state key in the top 32 bits, depth in the bottom 32.
+    _sortKeys.resize(_renderLeafList.size());
+    for(unsigned int i=0; i<_renderLeafList.size(); ++i)
     {
-        return (lhs->_traversalNumber<rhs->_traversalNumber);
+        RenderLeaf* leaf = _renderLeafList[i];
+        _sortKeys[i]._key = (static_cast<unsigned long long>(leaf->_parent->_stateSortKey)<<32) | depthSortKey(leaf->_depth);
+        _sortKeys[i]._leaf = leaf;
     }
-};
+    sortRenderLeafListByKeys();
+}
 
-void RenderBin::sortTraversalOrder()
+void RenderBin::sortRenderLeafListByKeys()
 {
-    copyLeavesFromStateGraphListToRenderLeafList();
+    unsigned int numKeys = _sortKeys.size();
+    if (numKeys!=_renderLeafList.size())
+    {
+        osg::notify(osg::WARN)<<"Warning: RenderBin::sortRenderLeafListByKeys() number of keys doesn't match the number of RenderLeaf's."<<std::endl;
+        _sortKeys.clear();
+        return;
+    }
 
-    // now sort the list into acending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),TraversalOrderFunctor());
+    SortKey* keys = numKeys ? &_sortKeys[0] : 0;
+
+    if (numKeys<64)
+    {
+        // insertion sort, cheaper than the radix passes for short lists.
+        for(unsigned int i=1; i<numKeys; ++i)
+        {
+            SortKey key = keys[i];
+            unsigned int j = i;
+            for(; j>0 && key._key<keys[j-1]._key; --j)
+            {
+                keys[j] = keys[j-1];
+            }
+            keys[j] = key;
+        }
+    }
+    else
+    {
+        // least significant byte first radix sort, with the counts of all eight bytes gathered in one pass.
+        unsigned int counts[8][256];
+        memset(counts, 0, sizeof(counts));
+        for(unsigned int i=0; i<numKeys; ++i)
+        {
+            unsigned long long key = keys[i]._key;
+            for(unsigned int b=0; b<8; ++b)
+            {
+                ++counts[b][(key>>(b*8))&0xff];
+            }
+        }
+
+        _sortKeysBuffer.resize(numKeys);
+        SortKey* src = keys;
+        SortKey* dst = &_sortKeysBuffer[0];
+        for(unsigned int b=0; b<8; ++b)
+        {
+            unsigned int* count = counts[b];
+
+            // skip the bytes all the keys share, such as the top half of depth only keys.
+            if (count[(src[0]._key>>(b*8))&0xff]==numKeys) continue;
+
+            unsigned int offset = 0;
+            for(unsigned int d=0; d<256; ++d)
+            {
+                unsigned int n = count[d];
+                count[d] = offset;
+                offset += n;
+            }
+
+            for(unsigned int i=0; i<numKeys; ++i)
+            {
+                dst[count[(src[i]._key>>(b*8))&0xff]++] = src[i];
+            }
+            std::swap(src, dst);
+        }
+        keys = src;
+    }
+
+    for(unsigned int i=0; i<numKeys; ++i)
+    {
+        _renderLeafList[i] = keys[i]._leaf;
+    }
+    _sortKeys.clear();
 }
 
 void RenderBin::copyLeavesFromStateGraphListToRenderLeafList()
@@ -376,11 +490,91 @@ void RenderBin::copyLeavesFromStateGraphListToRenderLeafList()
     _stateGraphList.clear();
 }
 
+static StateGraph* findOrInsertStateGraph(StateGraph* rootStateGraph, StateGraph* binRootStateGraph, StateGraph* sg)
+{
+    if (sg==binRootStateGraph || !sg->_parent) return rootStateGraph;
+    return findOrInsertStateGraph(rootStateGraph, binRootStateGraph, sg->_parent)->find_or_insert(sg->getStateSet());
+}
+
+void RenderBin::merge(RenderBin* bin, StateGraph* rootStateGraph, StateGraph* binRootStateGraph, unsigned int traversalNumberOffset)
+{
+    if (!bin || bin==this) return;
+
+    for(StateGraphList::iterator itr=bin->_stateGraphList.begin();
+        itr!=bin->_stateGraphList.end();
+        ++itr)
+    {
+        StateGraph* sg = *itr;
+        StateGraph* target = findOrInsertStateGraph(rootStateGraph, binRootStateGraph, sg);
+
+        // as in CullVisitor::addDrawableAndDepth(), a StateGraph is only added to the bin its first leaf goes into.
+        if (target->leaves_empty()) _stateGraphList.push_back(target);
+
+        for(StateGraph::LeafList::iterator litr=sg->_leaves.begin();
+            litr!=sg->_leaves.end();
+            ++litr)
+        {
+            (*litr)->_traversalNumber += traversalNumberOffset;
+            target->addLeaf(litr->get());
+        }
+        sg->_leaves.clear();
+    }
+    bin->_stateGraphList.clear();
+    bin->_renderLeafList.clear();
+
+    for(RenderBinList::iterator bitr=bin->_bins.begin();
+        bitr!=bin->_bins.end();)
+    {
+        RenderBin* child = bitr->second.get();
+        if (!child->_inUse)
+        {
+            // kept from an earlier frame, nothing to merge.
+            ++bitr;
+            continue;
+        }
+
+        RenderBinList::iterator existing = _bins.find(bitr->first);
+        if (existing!=_bins.end() && (existing->second->_inUse || existing->second->_binName==child->_binName))
+        {
+            existing->second->_inUse = true;
+            existing->second->merge(child, rootStateGraph, binRootStateGraph, traversalNumberOffset);
+            ++bitr;
+        }
+        else
+        {
+            // move the bin itself over, then merge its previous contents back into it.
+            osg::ref_ptr<RenderBin> contents = new RenderBin;
+            contents->_stateGraphList.swap(child->_stateGraphList);
+            contents->_bins.swap(child->_bins);
+            child->_renderLeafList.clear();
+
+            child->_parent = this;
+            child->_stage = _stage;
+            _bins[bitr->first] = child;
+            bin->_bins.erase(bitr++);
+
+            child->merge(contents.get(), rootStateGraph, binRootStateGraph, traversalNumberOffset);
+        }
+    }
+}
+
 RenderBin* RenderBin::find_or_insert(int binNum,const std::string& binName)
 {
     // search for appropriate bin.
     RenderBinList::iterator itr = _bins.find(binNum);
-    if (itr!=_bins.end()) return itr->second.get();
+    if (itr!=_bins.end())
+    {
+        RenderBin* bin = itr->second.get();
+        if (bin->_inUse) return bin;
+
+        // a bin kept from the previous frame, reuse it if it is of the type asked for.
+        if (bin->_binName==binName)
+        {
+            bin->_inUse = true;
+            return bin;
+        }
+        _bins.erase(itr);
+    }
 
     // create a rendering bin and insert into bin list.
     RenderBin* rb = RenderBin::createRenderBin(binName);
@@ -400,6 +594,8 @@ RenderBin* RenderBin::find_or_insert(int binNum,const std::string& binName)
             rb->_binNum = binNum;
             rb->_parent = this;
             rb->_stage = _stage;
+            rb->_binName = binName;
+            rb->_inUse = true;
             _bins[binNum] = rb;
         }
     }
@@ -438,7 +634,7 @@ void RenderBin::drawImplementation(osg::RenderInfo& renderInfo,RenderLeaf*& prev
         rbitr!=_bins.end() && rbitr->first<0;
         ++rbitr)
     {
-        rbitr->second->draw(renderInfo,previous);
+        if (rbitr->second->_inUse) rbitr->second->draw(renderInfo,previous);
     }
 
     // draw fine grained ordering.
@@ -497,7 +693,7 @@ void RenderBin::drawImplementation(osg::RenderInfo& renderInfo,RenderLeaf*& prev
         rbitr!=_bins.end();
         ++rbitr)
     {
-        rbitr->second->draw(renderInfo,previous);
+        if (rbitr->second->_inUse) rbitr->second->draw(renderInfo,previous);
     }
 
     if (_stateset.valid())
@@ -23,11 +23,36 @@ void StateGraph::reset()
     _stateset = NULL;
 
     _depth = 0;
+    _numFramesEmpty = 0;
 
     _children.clear();
     _leaves.clear();
 }
 
+static inline unsigned int hashPointer(const void* ptr, unsigned int numBits)
+{
+    // Fibonacci hashing, the top bits of the product depend on all the bits of the address.
+    return (static_cast<unsigned int>(reinterpret_cast<size_t>(ptr)>>4) * 2654435761u) >> (32-numBits);
+}
+
+void StateGraph::computeStateSortKey()
+{
+    unsigned int programKey = _parent ? (_parent->_stateSortKey>>20) : 0;
+    unsigned int textureKey = _parent ? ((_parent->_stateSortKey>>8)&0xfff) : 0;
+
+    const osg::StateSet* stateset = getStateSet();
+    if (stateset)
+    {
+        const osg::StateAttribute* program = stateset->getAttribute(osg::StateAttribute::PROGRAM);
+        if (program) programKey = hashPointer(program, 12);
+
+        const osg::StateAttribute* texture = stateset->getTextureAttribute(0, osg::StateAttribute::TEXTURE);
+        if (texture) textureKey = hashPointer(texture, 12);
+    }
+
+    _stateSortKey = (programKey<<20) | (textureKey<<8) | hashPointer(this, 8);
+}
+
 /** recursively clean the StateGraph of all its drawables, lights and depths.
   * Leaves children intact, and ready to be populated again.*/
 void StateGraph::clean()
@@ -46,29 +71,38 @@ void StateGraph::clean()
 
 }
 
-/** recursively prune the StateGraph of empty children.*/
-void StateGraph::prune()
+/** recursively prune the StateGraph of children that have had no leaves for more than maxNumFramesEmpty prunes.*/
+void StateGraph::prune(unsigned int maxNumFramesEmpty)
 {
-    std::vector<const osg::StateSet*> toEraseList;
+#ifndef OSGUTIL_RENDERBACKEND_USE_REF_PTR
+    // the children are keyed on StateSet's they don't reference, so must be removed while their StateSet's are known to exist.
+    maxNumFramesEmpty = 0;
+#endif
+
+    bool hasLeaves = !_leaves.empty();
 
     // call prune on all children.
     for(ChildList::iterator citr=_children.begin();
-        citr!=_children.end();
-        ++citr)
+        citr!=_children.end();)
     {
-        citr->second->prune();
+        StateGraph* sg = citr->second.get();
+        sg->prune(maxNumFramesEmpty);
 
-        if (citr->second->empty())
+        if (sg->_numFramesEmpty==0)
         {
-            toEraseList.push_back(citr->first);
+            hasLeaves = true;
+            ++citr;
+        }
+        else if (sg->_numFramesEmpty>maxNumFramesEmpty)
+        {
+            _children.erase(citr++);
+        }
+        else
+        {
+            ++citr;
         }
     }
 
-    for(std::vector<const osg::StateSet*>::iterator eitr=toEraseList.begin();
-        eitr!=toEraseList.end();
-        ++eitr)
-    {
-        _children.erase(*eitr);
-    }
-
+    if (hasLeaves) _numFramesEmpty = 0;
+    else ++_numFramesEmpty;
 }
@@ -0,0 +1,171 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#ifndef OSGDB_PAK_ARCHIVE
+#define OSGDB_PAK_ARCHIVE 1
+
+#include <osgDB/Archive>
+#include <osgDB/fstream>
+
+#include <OpenThreads/Mutex>
+
+#include <vector>
+
+/** Packed archive : a single file holding many small database files, laid out as
+  *
+  *     Header | entry data (each entry aligned) ... | Index
+  *
+  * The Index is an open addressing hash table of the entry paths followed by the
+  * entry records and the path string table, so looking up a file costs a hash and
+  * a couple of memory compares rather than an open()/stat() per tile. In READ mode
+  * the whole file is memory mapped and uncompressed entries are handed out to the
+  * ReaderWriter's as istreams that read straight from the mapping.*/
+class PAKArchive : public osgDB::Archive
+{
+    public:
+
+#if defined(_MSC_VER)
+        typedef unsigned __int64 uint64;
+#else
+        typedef unsigned long long uint64;
+#endif
+        typedef unsigned int uint32;
+
+        enum Compression
+        {
+            NO_COMPRESSION = 0,
+            ZLIB_COMPRESSION = 1
+        };
+
+        struct Header
+        {
+            char        magic[8];
+            uint32      endianTag;
+            uint32      version;
+            uint32      alignment;
+            uint32      numEntries;
+            uint32      numBuckets;
+            uint32      masterEntry;
+            uint64      indexOffset;
+            uint64      indexSize;
+            uint64      reserved[2];
+        };
+
+        struct Entry
+        {
+            uint64      hash;
+            uint64      offset;
+            uint64      storedSize;
+            uint64      size;
+            uint32      nameOffset;
+            uint32      nameLength;
+            uint32      compression;
+            uint32      reserved;
+        };
+
+        PAKArchive();
+        virtual ~PAKArchive();
+
+        virtual const char* libraryName() const { return "pak"; }
+
+        virtual const char* className() const { return "PAKArchive"; }
+
+        virtual bool acceptsExtension(const std::string& /*extension*/) const { return true; }
+
+        /** open the archive, returns false on failure.*/
+        bool open(const std::string& filename, ArchiveStatus status, const osgDB::ReaderWriter::Options* options);
+
+        /** close the archive, completing the index when the archive was opened for writing.*/
+        virtual void close();
+
+        /** return true if file exists in archive.*/
+        virtual bool fileExists(const std::string& filename) const;
+
+        /** Get the file name which represents the master file recorded in the Archive.*/
+        virtual std::string getMasterFileName() const;
+
+        /** Get the full list of file names available in the archive.*/
+        virtual bool getFileNames(FileNameList& fileNameList) const;
+
+        /** Get a pointer into the memory mapped archive for an uncompressed entry, return false if the entry
+          * is not present, is compressed or the archive is not open for reading.*/
+        bool getEntryData(const std::string& filename, const char*& data, uint64& size) const;
+
+        /** Add a raw file to the archive, compressing it if requested and worthwhile.*/
+        bool addFile(const std::string& filename, const char* data, uint64 size, Compression compression=NO_COMPRESSION);
+
+        virtual ReadResult readObject(const std::string& /*fileName*/,const Options* =NULL) const;
+        virtual ReadResult readImage(const std::string& /*fileName*/,const Options* =NULL) const;
+        virtual ReadResult readHeightField(const std::string& /*fileName*/,const Options* =NULL) const;
+        virtual ReadResult readNode(const std::string& /*fileName*/,const Options* =NULL) const;
+
+        virtual WriteResult writeObject(const osg::Object& /*obj*/,const std::string& /*fileName*/,const Options* =NULL) const;
+        virtual WriteResult writeImage(const osg::Image& /*image*/,const std::string& /*fileName*/,const Options* =NULL) const;
+        virtual WriteResult writeHeightField(const osg::HeightField& /*heightField*/,const std::string& /*fileName*/,const Options* =NULL) const;
+        virtual WriteResult writeNode(const osg::Node& /*node*/,const std::string& /*fileName*/,const Options* =NULL) const;
+
+        /** Hash used for the index, FNV-1a over the normalized file name.*/
+        static uint64 hashFileName(const std::string& filename);
+
+        /** Convert a file name to the form stored in the index, unix style separators without leading ./ or /.*/
+        static std::string normalizeFileName(const std::string& filename);
+
+    protected:
+
+        class MappedFile;
+        struct ReadFunctor;
+        struct ReadObjectFunctor;
+        struct ReadImageFunctor;
+        struct ReadHeightFieldFunctor;
+        struct ReadNodeFunctor;
+        struct WriteFunctor;
+        struct WriteObjectFunctor;
+        struct WriteImageFunctor;
+        struct WriteHeightFieldFunctor;
+        struct WriteNodeFunctor;
+
+        ReadResult read(const ReadFunctor& readFunctor) const;
+        WriteResult write(const WriteFunctor& writeFunctor) const;
+
+        uint32 findEntryIndex(const std::string& name, uint64 hash) const;
+        bool findEntry(const std::string& filename, Entry& entry) const;
+        std::string getEntryName(const Entry& entry) const;
+
+        bool readIndex(const char* indexData, uint64 indexSize, bool copy);
+        bool writeIndex();
+        void rebuildBuckets();
+
+        typedef std::vector<uint32> BucketList;
+        typedef std::vector<Entry>  EntryList;
+
+        std::string                 _archiveFileName;
+        ArchiveStatus               _status;
+        Header                      _header;
+
+        MappedFile*                 _mappedFile;
+
+        const uint32*               _buckets;
+        const Entry*                _entries;
+        const char*                 _names;
+
+        // owned copies of the index, used while writing or when the archive was written on a cpu of other endianness.
+        BucketList                  _bucketList;
+        EntryList                   _entryList;
+        std::string                 _nameTable;
+
+        osgDB::fstream              _output;
+        uint64                      _writePosition;
+        mutable OpenThreads::Mutex  _writeMutex;
+};
+
+#endif